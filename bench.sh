@@ -0,0 +1,373 @@
+#!/bin/bash
+#
+# End-to-end dump/restore benchmark on loopback XFS file systems
+#
+# For each workload, builds an XFS image on a loop device, populates it,
+# dumps it with xfsdump to each target and restores the file dumps with
+# xfsrestore onto a second loopback XFS file system. The wall time of
+# each phase is taken from the time the phase's verbose log message
+# (ino map phase 1, dumping directories, reading directories, ...)
+# appears. Results are appended as CSV and as JSON, one record per
+# phase and one object per line, so that runs of different builds can be
+# compared. The logs of each run are left in the work directory.
+#
+# Must be run as root. Needs mkfs.xfs, losetup, setfattr and GNU time
+# (/usr/bin/time) for the peak RSS; without it the RSS is left empty.
+#
+
+usage()
+{
+	cat <<EOF
+usage: $0 [-b build] [-c] [-d workdir] [-k] [-n scale] [-o outbase]
+	[-r xfsrestore] [-s imagesize] [-t targets] [-w workloads]
+	[-x xfsdump]
+
+  -b build      label for this build in the results (default: git describe)
+  -c            drop the page cache before each dump and restore
+  -d workdir    images, mount points and dumps (default: /var/tmp/xfsbench)
+  -k            keep the images and dump files
+  -n scale      multiplies the size of each workload (default: 1)
+  -o outbase    append results to outbase.csv and outbase.json
+                (default: xfsbench)
+  -r xfsrestore xfsrestore to run (default: restore/xfsrestore if built)
+  -s imagesize  size of each image, as for truncate(1) (default: 8G)
+  -t targets    comma-separated dump targets: file, null (default: both)
+  -w workloads  comma-separated: small, sparse, deep, xattr, links
+                (default: all)
+  -x xfsdump    xfsdump to run (default: dump/xfsdump if built)
+EOF
+	exit 1
+}
+
+build=
+dropcache=false
+workdir=/var/tmp/xfsbench
+keep=false
+scale=1
+outbase=xfsbench
+imagesize=8G
+targets=file,null
+workloads=small,sparse,deep,xattr,links
+xfsdump=
+xfsrestore=
+
+while getopts "b:cd:kn:o:r:s:t:w:x:" c
+do
+	case $c in
+	b) build=$OPTARG ;;
+	c) dropcache=true ;;
+	d) workdir=$OPTARG ;;
+	k) keep=true ;;
+	n) scale=$OPTARG ;;
+	o) outbase=$OPTARG ;;
+	r) xfsrestore=$OPTARG ;;
+	s) imagesize=$OPTARG ;;
+	t) targets=$OPTARG ;;
+	w) workloads=$OPTARG ;;
+	x) xfsdump=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift `expr $OPTIND - 1`
+[ $# -eq 0 ] || usage
+
+here=`cd \`dirname $0\` && pwd`
+if [ -z "$xfsdump" ]; then
+	xfsdump=$here/dump/xfsdump
+	[ -x $xfsdump ] || xfsdump=xfsdump
+fi
+if [ -z "$xfsrestore" ]; then
+	xfsrestore=$here/restore/xfsrestore
+	[ -x $xfsrestore ] || xfsrestore=xfsrestore
+fi
+if [ -z "$build" ]; then
+	build=`cd $here && git describe --always --dirty 2>/dev/null`
+	if [ -z "$build" ]; then
+		. $here/VERSION
+		build=${PKG_MAJOR}.${PKG_MINOR}.${PKG_REVISION}
+	fi
+fi
+rssfile=$workdir/rss
+if [ -x /usr/bin/time ]; then
+	timecmd="/usr/bin/time -f %M -o $rssfile"
+else
+	timecmd=
+fi
+
+fail()
+{
+	echo "$0: $*" >&2
+	exit 1
+}
+
+[ `id -u` -eq 0 ] || fail "must be run as root"
+for cmd in mkfs.xfs losetup setfattr mount umount truncate
+do
+	type $cmd >/dev/null 2>&1 || fail "$cmd not found"
+done
+
+src=$workdir/src
+dst=$workdir/dst
+srcdev=
+dstdev=
+
+cleanup()
+{
+	cd /
+	umount $src 2>/dev/null
+	umount $dst 2>/dev/null
+	[ -n "$srcdev" ] && losetup -d $srcdev
+	[ -n "$dstdev" ] && losetup -d $dstdev
+	if ! $keep; then
+		rm -f $workdir/*.img $workdir/*.dump
+	fi
+	rm -f $rssfile
+	rmdir $src $dst 2>/dev/null
+}
+trap cleanup 0
+trap "exit 1" 1 2 3 15
+
+# mkimage name mountpoint: makes and mounts a fresh loopback XFS,
+# printing the loop device
+mkimage()
+{
+	truncate -s $imagesize $workdir/$1.img || exit 1
+	dev=`losetup -f --show $workdir/$1.img` || exit 1
+	mkfs.xfs -f -q $dev >/dev/null || exit 1
+	mkdir -p $2
+	mount $dev $2 || exit 1
+	echo $dev
+}
+
+dropcaches()
+{
+	if $dropcache; then
+		sync
+		echo 3 > /proc/sys/vm/drop_caches
+	fi
+}
+
+# the workloads. each populates the current directory.
+
+# many small files, 100 to a directory
+pop_small()
+{
+	local d f n
+	n=`expr $scale \* 200`
+	for ((d = 0; d < n; d++)); do
+		mkdir d$d
+		for ((f = 0; f < 100; f++)); do
+			printf "%*s" $(( (f * 37 + d) % 4096 + 1 )) "" > d$d/f$f
+		done
+	done
+}
+
+# a few huge sparse files, a block of data every 256MB
+pop_sparse()
+{
+	local f o n
+	n=`expr $scale \* 4`
+	for ((f = 0; f < n; f++)); do
+		truncate -s 16G s$f
+		for ((o = 0; o < 16 * 4; o++)); do
+			dd if=/dev/urandom of=s$f bs=64k count=1 \
+			   seek=$((o * 4096)) conv=notrunc 2>/dev/null
+		done
+	done
+}
+
+# deep hierarchies, a small file at each level
+pop_deep()
+{
+	local c l p n
+	n=`expr $scale \* 20`
+	for ((c = 0; c < n; c++)); do
+		p=chain$c
+		for ((l = 0; l < 100; l++)); do
+			mkdir -p $p
+			printf "%*s" $l "" > $p/f
+			p=$p/l$l
+		done
+	done
+}
+
+# files with many extended attributes, in each namespace
+pop_xattr()
+{
+	local d f a n
+	n=`expr $scale \* 20`
+	for ((d = 0; d < n; d++)); do
+		mkdir x$d
+		for ((f = 0; f < 100; f++)); do
+			printf "%*s" $f "" > x$d/f$f
+		done
+		for ((a = 0; a < 8; a++)); do
+			setfattr -n user.bench$a \
+				 -v `printf "%0*d" $((64 + a * 24)) $a` x$d/f*
+			setfattr -n trusted.bench$a -v $a x$d/f*
+		done
+	done
+}
+
+# hard links: each file is linked into four other directories
+pop_links()
+{
+	local d f l n
+	n=`expr $scale \* 20`
+	for ((d = 0; d < n; d++)); do
+		mkdir h$d
+		for ((f = 0; f < 100; f++)); do
+			printf "%*s" $f "" > h$d/f$d.$f
+		done
+	done
+	for ((d = 0; d < n; d++)); do
+		for ((l = 1; l <= 4; l++)); do
+			ln h$d/f$d.* h$(( (d + l) % n ))/
+		done
+	done
+}
+
+now()
+{
+	if [ -n "$EPOCHREALTIME" ]; then
+		echo $EPOCHREALTIME
+	else
+		date +%s.%N
+	fi
+}
+
+# stamp: prefixes each line of the log with the time it appeared
+stamp()
+{
+	local line
+	while IFS= read -r line; do
+		echo "`now` $line"
+	done
+}
+
+csv=$outbase.csv
+json=$outbase.json
+[ -s $csv ] ||
+	echo "time,build,workload,target,tool,phase,seconds,bytes,bytes_per_sec,maxrss_kb" > $csv
+
+# record tool phase seconds bytes maxrss
+record()
+{
+	local rate
+
+	rate=
+	if [ -n "$4" ]; then
+		rate=`echo "$4 $3" | awk '{ if ($2 > 0) printf "%.0f", $1 / $2 }'`
+	fi
+	echo "$stamp,$build,$wl,$target,$1,$2,$3,$4,$rate,$5" >> $csv
+	printf '{"time":%s,"build":"%s","workload":"%s","target":"%s",' \
+		$stamp "$build" $wl $target >> $json
+	printf '"tool":"%s","phase":"%s","seconds":%s,' $1 $2 $3 >> $json
+	printf '"bytes":%s,"bytes_per_sec":%s,"maxrss_kb":%s}\n' \
+		${4:-null} ${rate:-null} ${5:-null} >> $json
+}
+
+# phases log tool bytes: records the time from each phase's log
+# message to the next, then the total
+phases()
+{
+	local rss
+
+	awk -v tool=$2 '
+	function mark(name) {
+		if (cur != "")
+			printf "%s %.3f\n", cur, $1 - t
+		cur = name
+		t = $1
+	}
+	NR == 1 { start = $1 }
+	tool == "dump" && /ino map phase 1:/ { mark("inomap_phase1") }
+	tool == "dump" && /ino map phase 2:/ && cur != "inomap_phase2" \
+		{ mark("inomap_phase2") }
+	tool == "dump" && /ino map phase 3:/ { mark("inomap_phase3") }
+	tool == "dump" && /ino map construction complete/ { mark("setup") }
+	tool == "dump" && /dumping directories/ { mark("dirs") }
+	tool == "dump" && /dumping non-directory files/ { mark("nondirs") }
+	tool == "dump" && /ending media file/ { mark("end") }
+	tool == "restore" && /reading directories/ { mark("dirs") }
+	tool == "restore" && /directory post-processing/ { mark("treepost") }
+	tool == "restore" && /restoring non-directory files/ \
+		{ mark("nondirs") }
+	tool == "restore" && /restore complete/ { mark("end") }
+	{ last = $1 }
+	END {
+		mark("")
+		printf "total %.3f\n", last - start
+	}' $1 | grep -v '^end ' | while read phase secs; do
+		if [ $phase = total ]; then
+			rss=
+			[ -s $rssfile ] && rss=`tail -1 $rssfile`
+			record $2 total $secs $3 $rss
+		else
+			record $2 $phase $secs "" ""
+		fi
+	done
+}
+
+mkdir -p $workdir || exit 1
+rm -f $workdir/*.img
+dstdev=`mkimage dst $dst` || exit 1
+
+for wl in `echo $workloads | tr , ' '`
+do
+	type pop_$wl >/dev/null 2>&1 || fail "unknown workload $wl"
+	srcdev=`mkimage src $src` || exit 1
+	echo "$0: populating $wl"
+	( cd $src && pop_$wl ) || exit 1
+	umount $src && mount $srcdev $src || exit 1
+
+	for target in `echo $targets | tr , ' '`
+	do
+		stamp=`date +%s`
+		case $target in
+		file)	dumpto=$workdir/$wl.dump ;;
+		null)	dumpto=@null ;;
+		*)	fail "unknown target $target" ;;
+		esac
+		rm -f $workdir/$wl.dump
+		dropcaches
+
+		# time the whole run as well, so the total includes
+		# startup before the first log message
+		echo "$0: dumping $wl to $target"
+		log=$workdir/$wl.$target.dump.log
+		rm -f $rssfile
+		( echo "`now` start"
+		  $timecmd $xfsdump -J -F -l 0 -L bench -M bench \
+			-f $dumpto $src 2>&1 | stamp
+		  echo "`now` exit" ) > $log
+		bytes=`sed -n 's/.*dump size (non-dir files) : \([0-9]*\) bytes.*/\1/p' $log`
+		phases $log dump "$bytes"
+		grep -q "Dump Status: SUCCESS" $log ||
+			echo "$0: dump of $wl to $target failed, see $log" >&2
+
+		[ $target = file ] || continue
+
+		rm -rf $dst/$wl
+		mkdir $dst/$wl
+		dropcaches
+		echo "$0: restoring $wl"
+		log=$workdir/$wl.$target.restore.log
+		bytes=`stat -c %s $dumpto`
+		rm -f $rssfile
+		( echo "`now` start"
+		  $timecmd $xfsrestore -J -f $dumpto $dst/$wl \
+			2>&1 | stamp
+		  echo "`now` exit" ) > $log
+		phases $log restore "$bytes"
+		grep -q "Restore Status: SUCCESS" $log ||
+			echo "$0: restore of $wl failed, see $log" >&2
+		rm -rf $dst/$wl $dumpto
+	done
+
+	umount $src
+	losetup -d $srcdev
+	srcdev=
+done
+
+echo "$0: results appended to $csv and $json"
@@ -427,6 +427,22 @@ xlate_extenthdr(extenthdr_t *eh1, extenthdr_t *eh2, int dir)
 	BXLATE(eh_pad);
 }
 
+/*
+ * xlate_extentref - endian convert struct extentref
+ */
+void
+xlate_extentref(extentref_t *er1, extentref_t *er2, int dir)
+{
+	mlog(MLOG_NITTY, "xlate_extentref\n");
+
+	IXLATE(er1, er2, er_ino);
+	IXLATE(er1, er2, er_offset);
+	IXLATE(er1, er2, er_fprint[0]);
+	IXLATE(er1, er2, er_fprint[1]);
+	IXLATE(er1, er2, er_fprint[2]);
+	IXLATE(er1, er2, er_fprint[3]);
+}
+
 /*
  * xlate_direnthdr - endian convert struct direnthdr
  */
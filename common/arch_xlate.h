@@ -92,6 +92,11 @@ void xlate_bstat(bstat_t *bs1, bstat_t *bs2, int dir);
  */
 void xlate_extenthdr(extenthdr_t *eh1, extenthdr_t *eh2, int dir);
 
+/*
+ * xlate_extentref - endian convert struct extentref
+ */
+void xlate_extentref(extentref_t *er1, extentref_t *er2, int dir);
+
 /*
  * xlate_direnthdr - endian convert struct direnthdr
  */
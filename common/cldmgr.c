@@ -36,7 +36,6 @@
 
 extern size_t pgsz;
 
-#define CLD_MAX	( STREAM_SIMMAX * 2 )
 struct cld {
 	bool_t c_busy;
 	pid_t c_pid;
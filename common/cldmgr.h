@@ -21,6 +21,11 @@
 /* cldmgr.[hc] - manages all child threads
  */
 
+/* the most child threads which may exist at once: the streams, their
+ * drive slaves and compression threads all share the table
+ */
+#define CLD_MAX	( STREAM_SIMMAX * 2 )
+
 /* cldmgr_init - initializes child management
  * returns FALSE if trouble encountered.
  */
@@ -128,6 +128,12 @@ extern size_t content_statline( char **lines[ ] );
 	 * of the array is returned by value.
 	 */
 
+extern size_t content_statrec( char *buf, size_t bufsz );
+	/* formats a one-line machine-readable (JSON) progress record,
+	 * newline-terminated, for the progress record file (-K). returns
+	 * the record length, or zero if there is nothing to report.
+	 */
+
 extern bool_t content_media_change_needed;
 	/* queried by main thread to decide if interupt dialog needed
 	 * for media change confirmation.
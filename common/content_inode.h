@@ -130,6 +130,27 @@ typedef struct content_inode_hdr content_inode_hdr_t;
 #define CIH_DUMPATTR_DIRENTHDR_GEN		( 1 << 11 )
 #define CIH_DUMPATTR_EXTATTR			( 1 << 12 )
 #define CIH_DUMPATTR_EXTATTRHDR_CHECKSUM	( 1 << 13 )
+#define CIH_DUMPATTR_DYNPART			( 1 << 14 )
+	/* streams were handed inode ranges dynamically: each media
+	 * file may hold several ranges, ascending but interleaved with
+	 * those of other streams. cih_startpt is where the media file
+	 * begins; cih_endpt ends only the first range in it.
+	 */
+#define CIH_DUMPATTR_DIRREF			( 1 << 15 )
+	/* directories unchanged since the base dump (cih_last_id, or
+	 * cih_resume_id if resumed) are dumped as a file header with
+	 * FILEHDR_FLAGS_DIRREF and no entries. can only be restored
+	 * cumulatively on top of that base.
+	 */
+#define CIH_DUMPATTR_DEDUP			( 1 << 16 )
+	/* regular file data may hold EXTENTHDR_TYPE_REF extents, each
+	 * referring to a chunk dumped earlier in the same media file
+	 */
+#define CIH_DUMPATTR_METAONLY			( 1 << 17 )
+	/* regular files whose data is unchanged since the base dump
+	 * (cih_last_id) are dumped with FILEHDR_FLAGS_METAONLY. can only
+	 * be restored cumulatively on top of that base.
+	 */
 
 
 /* timestruct_t - time structure
@@ -228,6 +249,16 @@ typedef struct filehdr filehdr_t;
 		/* special file header followed by one file's (dir or nondir)
 		 * extended attributes.
 		 */
+#define FILEHDR_FLAGS_DIRREF	( 1 << 4 )
+		/* directory header not followed by its entries, not even
+		 * a null dirent: the directory is unchanged since the base
+		 * dump, so its entries are those already restored.
+		 */
+#define FILEHDR_FLAGS_METAONLY	( 1 << 5 )
+		/* regular file header followed by a lone EXTENTHDR_TYPE_LAST
+		 * extent header: only the file's metadata changed since the
+		 * base dump, so its data is that already restored.
+		 */
 
 
 /* extenthdr_t - a header placed at the beginning of every dumped
@@ -269,10 +300,34 @@ typedef struct extenthdr extenthdr_t;
 		 * position of the hole within the file and sz is the
 		 * hole extent length.
 		 */
+#define EXTENTHDR_TYPE_REF	16
+		/* a chunk of file data identical to one dumped earlier in
+		 * the same media file. offset and sz are those of the data
+		 * in this file; the hdr is followed by an extentref_t
+		 * locating the earlier copy, and not by the data.
+		 */
 
 #define EXTENTHDR_FLAGS_CHECKSUM	( 1 << 0 )
 
 
+/* extentref_t - follows an EXTENTHDR_TYPE_REF extent hdr. er_ino and
+ * er_offset locate the data, er_sz bytes of it, as first dumped: restore
+ * copies it from that file, once restored, and checks it against the
+ * fingerprint (see fprint.h).
+ */
+#define EXTENTREF_SZ	48
+
+struct extentref {
+	xfs_ino_t er_ino;
+	off64_t er_offset;
+	u_int64_t er_fprint[ 4 ];
+		/* FPRINT_WORDS
+		 */
+};
+
+typedef struct extentref extentref_t;
+
+
 /* direnthdr_t - placed at the beginning of every dumped directory entry.
  * a directory entry consists of the fixed size header followed by a variable
  * length NULL-terminated name string, followed by enough padding to make the
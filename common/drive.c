@@ -48,6 +48,7 @@ extern char *homedir;
 extern drive_strategy_t drive_strategy_simple;
 extern drive_strategy_t drive_strategy_scsitape;
 extern drive_strategy_t drive_strategy_rmt;
+extern drive_strategy_t drive_strategy_null;
 
 
 /* forward declarations of locally defined static functions ******************/
@@ -72,6 +73,7 @@ static drive_strategy_t *strategypp[] = {
 	&drive_strategy_simple,
 	&drive_strategy_scsitape,
 	&drive_strategy_rmt,
+	&drive_strategy_null,
 };
 
 
@@ -389,9 +391,17 @@ drive_alloc( char *pathname, ix_t driveix )
 	ASSERT( drivep );
 
 	/* convert the pathname to an absolute pathname
-	 * NOTE: string "stdio" is reserved to mean send to standard out
+	 * NOTE: string "stdio" is reserved to mean send to standard out,
+	 * and DRIVE_NULL_PATH and DRIVE_REPLAY_PREFIX name in-memory drives.
+	 * any other pathname, even one beginning with '@', is a file.
 	 */
-	if ( strcmp( pathname, "stdio" )) {
+	if ( strcmp( pathname, "stdio" )
+	     &&
+	     strcmp( pathname, DRIVE_NULL_PATH )
+	     &&
+	     strncmp( pathname,
+		      DRIVE_REPLAY_PREFIX,
+		      strlen( DRIVE_REPLAY_PREFIX ))) {
 		pathname = path_reltoabs( pathname, homedir );
 	}
 
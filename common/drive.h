@@ -173,6 +173,14 @@ typedef struct drive_strategy drive_strategy_t;
 #define DRIVE_STRATEGY_SIMPLE	1
 #define DRIVE_STRATEGY_RMT	0  /* same as SCSITAPE for now */
 
+/* pseudo-pathnames of the in-memory drives of drive_null.c. a dump may be
+ * sent to DRIVE_NULL_PATH; a restore may read a recorded media file from
+ * memory by giving its pathname after DRIVE_REPLAY_PREFIX. these two are
+ * not made absolute; any other pathname is.
+ */
+#define DRIVE_NULL_PATH		"@null"
+#define DRIVE_REPLAY_PREFIX	"@replay="
+
 
 /* drive_mark_t - token identifying a mark within a media object file
  *
@@ -203,6 +211,10 @@ struct drive_markrec {
 	drive_mcbfp_t dm_cbfuncp;	/* caller's callback function */
 	void *dm_cbcontextp;		/* caller's context */
 	struct drive_markrec *dm_nextp;	/* for linked list */
+	xfs_ino_t dm_ino;		/* if non-zero, the file header of
+					 * this ino begins at the mark. may be
+					 * used to index the media file.
+					 */
 };
 
 typedef struct drive_markrec drive_markrec_t;
@@ -380,6 +392,24 @@ struct drive_ops {
 				 *	DEVICE - device error;
 				 * if currently at a mark, will go to the next.
 				 */
+	bool_t ( * do_seek_ino )( drive_t *drivep, xfs_ino_t ino );
+				/* optional. if the media file carries an
+				 * index of the file headers within it,
+				 * skips forward to the last indexed
+				 * file header of an ino not greater than
+				 * ino. returns TRUE if the read position
+				 * was moved; FALSE if the file is not
+				 * indexed, or no indexed header lies far
+				 * enough beyond the read position to make
+				 * skipping worthwhile.
+				 */
+	intgen_t ( * do_skip )( drive_t *drivep, off64_t cnt );
+				/* optional. discards the next cnt bytes of
+				 * the media file, seeking over them rather
+				 * than reading them if the media allows.
+				 * returns zero or an error as for
+				 * do_seek_mark.
+				 */
 	void ( *do_end_read )( drive_t *drivep );
 				/* ends the file read. must be called prior
 				 * to beginning another read or write session.
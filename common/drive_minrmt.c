@@ -47,6 +47,7 @@
 #include "rec_hdr.h"
 #include "arch_xlate.h"
 #include "ts_mtio.h"
+#include "perfstat.h"
 
 
 /* drive_minrmt.c - drive strategy for non-SGI rmt tape devices
@@ -118,6 +119,13 @@ static intgen_t open_masked_signals( char *path, int oflags );
 #define RINGLEN_MAX	 		10
 #define RINGLEN_DEFAULT 		3
 
+/* number of rmt commands kept in flight (see librmt/rmtpipe.c).
+ * must not exceed RMT_WINMAX in librmt/rmtlib.h.
+ */
+#define RMTWINDOW_MIN	 		1
+#define RMTWINDOW_MAX	 		16
+#define RMTWINDOW_DEFAULT 		1
+
 /* tape i/o request retry limit
  */
 #define MTOP_TRIES_MAX	 		10
@@ -236,6 +244,10 @@ struct drive_context {
 	off64_t dc_filesz;
 			/* media file size given as argument
 			 */
+	intgen_t dc_rmtwindow;
+			/* number of remote writes kept in flight, and of
+			 * records read ahead. 1 waits for each reply.
+			 */
 };
 
 typedef struct drive_context drive_context_t;
@@ -264,6 +276,7 @@ extern int rmtfstat( int, struct stat * );
 extern int rmtioctl( int, int, ... );
 extern int rmtread( int, void*, uint);
 extern int rmtwrite( int, const void *, uint);
+extern int rmtsetwindow( int, int );
 #endif /* RMT */
 
 
@@ -395,6 +408,8 @@ static drive_ops_t drive_ops = {
 	do_get_mark,		/* do_get_mark */
 	do_seek_mark,		/* do_seek_mark */
 	do_next_mark,		/* do_next_mark */
+	0,			/* do_seek_ino */
+	0,			/* do_skip */
 	do_end_read,		/* do_end_read */
 	do_begin_write,		/* do_begin_write */
 	do_set_mark,		/* do_set_mark */
@@ -519,6 +534,7 @@ ds_instantiate( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
 	contextp->dc_unloadokpr = BOOL_FALSE;
 	contextp->dc_filesz = 0;
 	contextp->dc_isQICpr = BOOL_FALSE;
+	contextp->dc_rmtwindow = RMTWINDOW_DEFAULT;
 	optind = 1;
 	opterr = 0;
 	while ( ( c = getopt( argc, argv, GETOPT_CMDSTRING )) != EOF ) {
@@ -556,6 +572,27 @@ ds_instantiate( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
 		case GETOPT_QIC:
 			contextp->dc_isQICpr = BOOL_TRUE;
 			break;
+		case GETOPT_RMTWINDOW:
+			if ( ! optarg || optarg[ 0 ] == '-' ) {
+				mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+				      _("-%c argument missing\n"),
+				      c );
+				return BOOL_FALSE;
+			}
+			contextp->dc_rmtwindow = atoi( optarg );
+			if ( contextp->dc_rmtwindow < RMTWINDOW_MIN
+			     ||
+			     contextp->dc_rmtwindow > RMTWINDOW_MAX ) {
+				mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+				      _("-%c argument must be "
+				      "between %u and %u: ignoring %d\n"),
+				      c,
+				      RMTWINDOW_MIN,
+				      RMTWINDOW_MAX,
+				      contextp->dc_rmtwindow );
+				return BOOL_FALSE;
+			}
+			break;
 #ifdef DUMP
 		case GETOPT_OVERWRITE:
 			contextp->dc_overwritepr = BOOL_TRUE;
@@ -3441,6 +3478,25 @@ Open( drive_t *drivep )
 		return BOOL_FALSE;
 	}
 
+#ifdef RMT
+	/* keep several records in flight on the link to the remote
+	 * drive. rmtsetwindow ignores local devices.
+	 */
+	if ( contextp->dc_rmtwindow > 1 ) {
+		if ( rmtsetwindow( contextp->dc_fd,
+				   ( int )contextp->dc_rmtwindow )) {
+			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+			      _("unable to set rmt window to %d: %s\n"),
+			      contextp->dc_rmtwindow,
+			      strerror( errno ));
+		} else {
+			mlog( MLOG_DEBUG | MLOG_DRIVE,
+			      "rmt window set to %d\n",
+			      contextp->dc_rmtwindow );
+		}
+	}
+#endif /* RMT */
+
 	return BOOL_TRUE;
 }
 
@@ -3500,6 +3556,7 @@ Write( drive_t *drivep, char *bufp, size_t cnt, intgen_t *errnop )
 {
 	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
 	intgen_t nwritten;
+	perf_timer_t perftimer;
 
 	mlog( MLOG_DEBUG | MLOG_DRIVE,
 	      "tape op: writing %u bytes\n",
@@ -3509,7 +3566,12 @@ Write( drive_t *drivep, char *bufp, size_t cnt, intgen_t *errnop )
 	ASSERT( bufp );
 	*errnop = 0;
 	errno = 0;
+	perf_begin( &perftimer );
 	nwritten = write( contextp->dc_fd, ( void * )bufp, cnt );
+	perf_end( ( intgen_t )drivep->d_index,
+		  PERF_RECWRITE,
+		  &perftimer,
+		  ( off64_t )nwritten );
 	if ( nwritten < 0 ) {
 		*errnop = errno;
 		mlog( MLOG_NITTY | MLOG_DRIVE,
@@ -3874,6 +3936,11 @@ calc_max_lost( drive_t *drivep )
 		contextp->dc_lostrecmax = 2;
 	}
 
+	/* a pipelined rmt write reports an error only after the
+	 * records sent behind it were acknowledged to us.
+	 */
+	contextp->dc_lostrecmax += ( off64_t )( contextp->dc_rmtwindow - 1 );
+
 }
 
 static void
@@ -0,0 +1,1019 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+#include <xfs/jdm.h>
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <malloc.h>
+
+#include "types.h"
+#include "util.h"
+#include "stream.h"
+#include "mlog.h"
+#include "global.h"
+#include "drive.h"
+#include "media.h"
+#include "arch_xlate.h"
+
+
+/* drive_null.c - in-memory drive strategies, for measuring the rest of
+ * dump and restore without the cost of any device.
+ *
+ * for dump, the null sink (DRIVE_NULL_PATH): accepts the stream at memory
+ * speed and discards it, keeping the marks and byte counts as though it
+ * had been written to a file.
+ *
+ * for restore, the synthetic source (DRIVE_REPLAY_PREFIX followed by a
+ * pathname): loads a media file recorded by drive_simple.c into memory
+ * when instantiated, and supplies it from there. the media file may be
+ * a dump of any file system, real or generated. it may not be compressed.
+ *
+ * the streams are those of drive_simple.c, so the strategy id is its.
+ */
+
+
+/* structure definitions used locally ****************************************/
+
+/* drive context - drive-specific context
+ * buf must be page-aligned and at least 1 page in size
+ */
+#define PGPERBUF	64	/* write buffer */
+#define BUFSZ		( PGPERBUF * PGSZ )
+
+/* operational mode
+ */
+typedef enum { OM_NONE, OM_READ, OM_WRITE } om_t;
+
+/* drive_simple.c records the stream codec after the first mark
+ */
+#define DN_CODECP( dhp )	( ( u_int32_t * )( ( dhp )->dh_specific \
+					   + sizeof( drive_mark_t )))
+
+struct drive_context {
+	char dc_buf[ BUFSZ ];	/* write buffer, never flushed (dump) */
+	om_t dc_mode;		/* current mode of operation */
+	ix_t dc_fmarkcnt;	/* how many file marks to the left */
+	char *dc_ownedp;	/* first byte owned by caller */
+	size_t dc_ownedsz;	/* how much owned by caller (write only) */
+	char *dc_nextp;		/* next byte avail. to write (dump) */
+	char *dc_emptyp;	/* first empty slot in buffer (dump) */
+	off64_t dc_bufstroff;	/* offset in stream of top of buf (dump) */
+	char *dc_strmp;		/* the recorded media file (restore) */
+	off64_t dc_strmsz;
+	off64_t dc_strmoff;	/* offset of the next byte to read */
+	drive_mark_t dc_firstmark;/* first mark's offset within mfile */
+	ix_t dc_markcnt;	/* count of marks set (dump) */
+	off64_t dc_bytecnt;	/* bytes accepted or supplied */
+	off64_t dc_elapsed;	/* microseconds between begin and end */
+	struct timeval dc_begintv;
+};
+
+typedef struct drive_context drive_context_t;
+
+
+/* declarations of externally defined global variables ***********************/
+
+extern size_t pgsz;
+
+
+/* forward declarations of locally defined static functions ******************/
+
+/* strategy functions
+ */
+static intgen_t ds_match( int, char *[], drive_t *, bool_t );
+static intgen_t ds_instantiate( int, char *[], drive_t *, bool_t );
+
+/* declare manager operators
+ */
+static bool_t do_init( drive_t * );
+static bool_t do_sync( drive_t * );
+static intgen_t do_begin_read( drive_t * );
+static char *do_read( drive_t *, size_t , size_t *, intgen_t * );
+static void do_return_read_buf( drive_t *, char *, size_t );
+static void do_get_mark( drive_t *, drive_mark_t * );
+static intgen_t do_seek_mark( drive_t *, drive_mark_t * );
+static intgen_t do_next_mark( drive_t * );
+static intgen_t do_skip( drive_t *, off64_t );
+static void do_end_read( drive_t * );
+static intgen_t do_begin_write( drive_t * );
+static void do_set_mark( drive_t *, drive_mcbfp_t, void *, drive_markrec_t * );
+static char * do_get_write_buf( drive_t *, size_t , size_t * );
+static intgen_t do_write( drive_t *, char *, size_t );
+static size_t do_get_align_cnt( drive_t * );
+static intgen_t do_end_write( drive_t *, off64_t * );
+static intgen_t do_rewind( drive_t * );
+static intgen_t do_get_device_class( drive_t * );
+static void do_display_metrics( drive_t * );
+static void do_quit( drive_t * );
+
+/* misc. local utility funcs
+ */
+#ifdef RESTORE
+static bool_t dn_load( drive_t *, char * );
+#endif /* RESTORE */
+static off64_t dn_usecs( struct timeval * );
+
+
+/* definition of locally defined global variables ****************************/
+
+/* in-memory drive strategy. referenced by drive.c
+ */
+drive_strategy_t drive_strategy_null = {
+	DRIVE_STRATEGY_SIMPLE,		/* ds_id */
+#ifdef DUMP
+	"null sink (drive_null)",	/* ds_description */
+#endif /* DUMP */
+#ifdef RESTORE
+	"synthetic source (drive_null)",/* ds_description */
+#endif /* RESTORE */
+	ds_match,			/* ds_match */
+	ds_instantiate,			/* ds_instantiate */
+	0x1000000ll,			/* ds_recmarksep */
+	OFF64MAX			/* ds_recmfilesz */
+};
+
+
+/* definition of locally defined static variables *****************************/
+
+/* drive operators
+ */
+static drive_ops_t drive_ops = {
+	do_init,		/* do_init */
+	do_sync,		/* do_sync */
+	do_begin_read,		/* do_begin_read */
+	do_read,		/* do_read */
+	do_return_read_buf,	/* do_return_read_buf */
+	do_get_mark,		/* do_get_mark */
+	do_seek_mark,		/* do_seek_mark */
+	do_next_mark,		/* do_next_mark */
+	0,			/* do_seek_ino */
+	do_skip,		/* do_skip */
+	do_end_read,		/* do_end_read */
+	do_begin_write,		/* do_begin_write */
+	do_set_mark,		/* do_set_mark */
+	do_get_write_buf,	/* do_get_write_buf */
+	do_write,		/* do_write */
+	do_get_align_cnt,	/* do_get_align_cnt */
+	do_end_write,		/* do_end_write */
+	0,			/* do_fsf */
+	0,			/* do_bsf */
+	do_rewind,		/* do_rewind */
+	0,			/* do_erase */
+	0,			/* do_eject_media */
+	do_get_device_class,	/* do_get_device_class */
+	do_display_metrics,	/* do_display_metrics */
+	do_quit,		/* do_quit */
+};
+
+/* definition of locally defined global functions ****************************/
+
+
+/* definition of locally defined static functions ****************************/
+
+/* strategy match - claims only its own pseudo-pathnames
+ */
+/* ARGSUSED */
+static intgen_t
+ds_match( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
+{
+#ifdef DUMP
+	if ( ! strcmp( drivep->d_pathname, DRIVE_NULL_PATH )) {
+		return 10;
+	}
+#endif /* DUMP */
+#ifdef RESTORE
+	if ( ! strncmp( drivep->d_pathname,
+			DRIVE_REPLAY_PREFIX,
+			strlen( DRIVE_REPLAY_PREFIX ))) {
+		return 10;
+	}
+#endif /* RESTORE */
+
+	return -10;
+}
+
+/* strategy instantiate - initializes the pre-allocated drive descriptor
+ */
+/*ARGSUSED*/
+static bool_t
+ds_instantiate( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
+{
+	drive_context_t *contextp;
+
+	/* hook up the drive ops
+	 */
+	drivep->d_opsp = &drive_ops;
+
+	/* initialize the drive context - allocate a page-aligned
+	 * structure, so the buffer is page-aligned.
+	 */
+	contextp = ( drive_context_t * )memalign( PGSZ,
+						  sizeof( drive_context_t ));
+	ASSERT( contextp );
+	ASSERT( ( void * )contextp->dc_buf == ( void * )contextp );
+	memset( ( void * )contextp, 0, sizeof( *contextp ));
+	drivep->d_contextp = ( void * )contextp;
+
+	/* the sink is like a pipe; the source like a regular file
+	 */
+	drivep->d_capabilities = 0;
+	drivep->d_capabilities |= DRIVE_CAP_AUTOREWIND;
+#ifdef RESTORE
+	drivep->d_capabilities |= DRIVE_CAP_REWIND;
+	drivep->d_capabilities |= DRIVE_CAP_READ;
+
+	if ( ! dn_load( drivep,
+			drivep->d_pathname + strlen( DRIVE_REPLAY_PREFIX ))) {
+		free( ( void * )contextp );
+		drivep->d_contextp = 0;
+		return BOOL_FALSE;
+	}
+#endif /* RESTORE */
+
+	/* initialize the operational mode. fmarkcnt is bumped on each
+	 * end_read and end_write, set back to 0 on rewind.
+	 */
+	contextp->dc_mode = OM_NONE;
+	contextp->dc_fmarkcnt = 0;
+
+	drivep->d_cap_est = -1;
+	drivep->d_rate_est = -1;
+
+	return BOOL_TRUE;
+}
+
+/* drive op init - second pass drive manager init - nothing to do
+ */
+/* ARGSUSED */
+static bool_t
+do_init( drive_t *drivep )
+{
+#ifdef DUMP
+	drive_hdr_t *dwhdrp = drivep->d_writehdrp;
+	media_hdr_t *mwhdrp = ( media_hdr_t * )dwhdrp->dh_upper;
+
+	/* fill in media strategy id: as for drive_simple.c
+	 */
+	mwhdrp->mh_strategyid = MEDIA_STRATEGY_SIMPLE;
+#endif /* DUMP */
+
+	return BOOL_TRUE;
+}
+
+/* drive op init - third pass drive manager init - nothing to do
+ */
+/* ARGSUSED */
+static bool_t
+do_sync( drive_t *drivep )
+{
+	return BOOL_TRUE;
+}
+
+/* drive op begin_read - prepare to supply the recorded media file - main
+ * job is to check and translate the media file header
+ */
+static intgen_t
+do_begin_read( drive_t *drivep )
+{
+#ifdef DEBUG
+	intgen_t dcaps = drivep->d_capabilities;
+#endif
+	global_hdr_t *grhdrp = drivep->d_greadhdrp;
+	drive_hdr_t *drhdrp = drivep->d_readhdrp;
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	global_hdr_t		*tmphdr = ( global_hdr_t * )contextp->dc_strmp;
+	drive_hdr_t		*tmpdh = (drive_hdr_t *)tmphdr->gh_upper;
+	media_hdr_t		*tmpmh = (media_hdr_t *)tmpdh->dh_upper;
+	content_hdr_t		*tmpch = (content_hdr_t *)tmpmh->mh_upper;
+	content_inode_hdr_t	*tmpcih = (content_inode_hdr_t *)tmpch->ch_specific;
+	drive_hdr_t		*dh = (drive_hdr_t *)grhdrp->gh_upper;
+	media_hdr_t		*mh = (media_hdr_t *)dh->dh_upper;
+	content_hdr_t		*ch = (content_hdr_t *)mh->mh_upper;
+	content_inode_hdr_t	*cih = (content_inode_hdr_t *)ch->ch_specific;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null begin_read( )\n" );
+
+	/* verify protocol being followed
+	 */
+	ASSERT( dcaps & DRIVE_CAP_READ );
+	ASSERT( contextp->dc_strmp );
+	ASSERT( contextp->dc_mode == OM_NONE );
+
+	/* can only read one media file
+	 */
+	if ( contextp->dc_fmarkcnt > 0 ) {
+		return DRIVE_ERROR_EOM;
+	}
+
+	if ( contextp->dc_strmsz == 0 ) {
+		return DRIVE_ERROR_BLANK;
+	}
+	if ( contextp->dc_strmsz < ( off64_t )GLOBAL_HDR_SZ ) {
+		return DRIVE_ERROR_FORMAT;
+	}
+
+	/* check the checksum
+	 */
+	if ( ! global_hdr_checksum_check( tmphdr )) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("media file header checksum error\n") );
+		return DRIVE_ERROR_CORRUPTION;
+	}
+
+	xlate_global_hdr(tmphdr, grhdrp, 1);
+	xlate_drive_hdr(tmpdh, dh, 1);
+	*(( drive_mark_t * )dh->dh_specific) =
+		INT_GET(*(( drive_mark_t * )tmpdh->dh_specific), ARCH_CONVERT);
+	*DN_CODECP( dh ) = INT_GET(*DN_CODECP( tmpdh ), ARCH_CONVERT);
+	xlate_media_hdr(tmpmh, mh, 1);
+	xlate_content_hdr(tmpch, ch, 1);
+	xlate_content_inode_hdr(tmpcih, cih, 1);
+
+	/* check the magic number
+	 */
+	if ( strncmp( grhdrp->gh_magic, GLOBAL_HDR_MAGIC, GLOBAL_HDR_MAGIC_SZ)) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("media file header magic number mismatch: %s, %s\n"),
+		      grhdrp->gh_magic,
+		      GLOBAL_HDR_MAGIC);
+		return DRIVE_ERROR_FORMAT;
+	}
+
+	/* check the version
+	 */
+	if ( global_version_check( grhdrp->gh_version ) != BOOL_TRUE ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("unrecognized media file header version (%d)\n"),
+		      grhdrp->gh_version );
+		return DRIVE_ERROR_VERSION;
+	}
+
+	/* check the strategy id
+	 */
+	if ( drhdrp->dh_strategyid != drive_strategy_null.ds_id ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("unrecognized drive strategy ID "
+		      "(media says %d, expected %d)\n"),
+		      drhdrp->dh_strategyid, drive_strategy_null.ds_id );
+		return DRIVE_ERROR_FORMAT;
+	}
+
+	/* the stream is supplied as recorded, so must not be compressed
+	 */
+	if ( *DN_CODECP( drhdrp )) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("cannot replay a compressed media file\n") );
+		return DRIVE_ERROR_FORMAT;
+	}
+
+	/* record the offset of the first mark
+	 */
+	contextp->dc_firstmark = *( drive_mark_t * )drhdrp->dh_specific;
+	if ( contextp->dc_firstmark ) {
+		drivep->d_capabilities |= DRIVE_CAP_NEXTMARK;
+	}
+
+	/* note that a successful begin_read ocurred
+	 */
+	contextp->dc_ownedp = 0;
+	contextp->dc_strmoff = ( off64_t )GLOBAL_HDR_SZ;
+	contextp->dc_bytecnt = ( off64_t )GLOBAL_HDR_SZ;
+	contextp->dc_mode = OM_READ;
+	gettimeofday( &contextp->dc_begintv, 0 );
+	return 0;
+}
+
+/* read - supply the caller with the next part of the recorded media file,
+ * in place
+ */
+static char *
+do_read( drive_t *drivep,
+         size_t wantedcnt,
+         size_t *actualcntp,
+         intgen_t *rvalp )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	off64_t remainingcnt;
+	size_t actualcnt;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null read( want %u )\n",
+	      wantedcnt );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	ASSERT( ! contextp->dc_ownedp );
+	ASSERT( wantedcnt > 0 );
+
+	*rvalp = 0;
+
+	remainingcnt = contextp->dc_strmsz - contextp->dc_strmoff;
+	if ( remainingcnt <= 0 ) {
+		*rvalp = DRIVE_ERROR_EOD;
+		return 0;
+	}
+	actualcnt = ( size_t )min( ( off64_t )wantedcnt, remainingcnt );
+
+	contextp->dc_ownedp = contextp->dc_strmp + contextp->dc_strmoff;
+	contextp->dc_strmoff += ( off64_t )actualcnt;
+	contextp->dc_bytecnt += ( off64_t )actualcnt;
+
+	*actualcntp = actualcnt;
+	return contextp->dc_ownedp;
+}
+
+/* return_read_buf - lets the caller give back all of the
+ * buffer obtained from a call to do_read().
+ */
+/* ARGSUSED */
+static void
+do_return_read_buf( drive_t *drivep, char *retp, size_t retcnt )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null return_read_buf( returning %u )\n",
+	      retcnt );
+
+	/* verify protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	ASSERT( contextp->dc_ownedp );
+	ASSERT( retp == contextp->dc_ownedp );
+	ASSERT( contextp->dc_ownedp + retcnt
+		==
+		contextp->dc_strmp + contextp->dc_strmoff );
+
+	contextp->dc_ownedp = 0;
+}
+
+/* the mark is simply the offset into the media file of the
+ * next byte to be read
+ */
+static void
+do_get_mark( drive_t *drivep, drive_mark_t *markp )
+{
+        drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null get_mark( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	ASSERT( ! contextp->dc_ownedp );
+
+	*markp = ( drive_mark_t )contextp->dc_strmoff;
+}
+
+/* seek forward to the specified mark. the caller must not have already read
+ * past that point.
+ */
+static intgen_t
+do_seek_mark( drive_t *drivep, drive_mark_t *markp )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	off64_t mark = *( off64_t * )markp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null seek_mark( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	ASSERT( ! contextp->dc_ownedp );
+
+	if ( contextp->dc_strmoff > mark ) {
+		return DRIVE_ERROR_CORE;
+	}
+	if ( mark > contextp->dc_strmsz ) {
+		contextp->dc_strmoff = contextp->dc_strmsz;
+		return DRIVE_ERROR_EOD;
+	}
+	contextp->dc_strmoff = mark;
+
+	return 0;
+}
+
+/* seek forward to the next mark. we only know of one mark, the first
+ * mark in the media file (recorded in the header).
+ */
+static intgen_t
+do_next_mark( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	drive_mark_t mark = contextp->dc_firstmark;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null next_mark( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( drivep->d_capabilities & DRIVE_CAP_NEXTMARK );
+	ASSERT( contextp->dc_mode == OM_READ );
+
+	if ( ! mark ) {
+		return DRIVE_ERROR_EOF;
+	}
+
+	return do_seek_mark( drivep, &mark );
+}
+
+/* skip - discards the next cnt bytes
+ */
+static intgen_t
+do_skip( drive_t *drivep, off64_t cnt )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	drive_mark_t mark = ( drive_mark_t )( contextp->dc_strmoff + cnt );
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null skip( %lld )\n",
+	      cnt );
+
+	return do_seek_mark( drivep, &mark );
+}
+
+/* end_read - tell the drive we are done reading the media file
+ */
+static void
+do_end_read( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null end_read( )\n" );
+
+	/* be sure we are following protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	contextp->dc_mode = OM_NONE;
+	contextp->dc_elapsed += dn_usecs( &contextp->dc_begintv );
+
+	/* bump the file mark cnt
+	 */
+	contextp->dc_fmarkcnt++;
+	ASSERT( contextp->dc_fmarkcnt == 1 );
+}
+
+/* begin_write - prepare to accept a media file
+ */
+static intgen_t
+do_begin_write( drive_t *drivep )
+{
+	global_hdr_t *gwhdrp = drivep->d_gwritehdrp;
+	drive_hdr_t *dwhdrp = drivep->d_writehdrp;
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	intgen_t rval;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null begin_write( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_NONE );
+
+	/* only one media file may be written
+	 */
+	if ( contextp->dc_fmarkcnt > 0 ) {
+		return DRIVE_ERROR_EOM;
+	}
+
+	/* indicate in the header that there is no recorded mark,
+	 * and that the stream is not compressed
+	 */
+	*( ( off64_t * )dwhdrp->dh_specific ) = 0;
+	*DN_CODECP( dwhdrp ) = 0;
+
+	/* prepare the drive context as drive_simple.c does, so the
+	 * caller sees the same buffer boundaries and alignment
+	 */
+	contextp->dc_ownedp = 0;
+	contextp->dc_nextp = contextp->dc_buf;
+	contextp->dc_emptyp = contextp->dc_buf + sizeof( contextp->dc_buf );
+	contextp->dc_bufstroff = 0;
+	contextp->dc_markcnt = 0;
+	contextp->dc_firstmark = 0;
+	contextp->dc_bytecnt = 0;
+	contextp->dc_mode = OM_WRITE;
+	gettimeofday( &contextp->dc_begintv, 0 );
+
+	/* the header is discarded with the rest, so need not be put in
+	 * media byte order
+	 */
+	rval = write_buf( ( char * )gwhdrp,
+			  GLOBAL_HDR_SZ,
+			  ( void * )drivep,
+			  ( gwbfp_t )drivep->d_opsp->do_get_write_buf,
+			  ( wfp_t )drivep->d_opsp->do_write );
+	if ( rval ) {
+		contextp->dc_mode = OM_NONE;
+	}
+
+	return rval;
+}
+
+/* do_set_mark - record a markrecord and callback
+ */
+static void
+do_set_mark( drive_t *drivep,
+	     drive_mcbfp_t cbfuncp,
+	     void *cbcontextp,
+	     drive_markrec_t *markrecp )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	drive_mark_t mark;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null set_mark( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_WRITE );
+	ASSERT( ! contextp->dc_ownedp );
+	ASSERT( contextp->dc_nextp );
+
+	mark = ( drive_mark_t )( contextp->dc_bufstroff
+				 +
+				 ( off64_t )
+				 ( contextp->dc_nextp - contextp->dc_buf ));
+	markrecp->dm_log = mark;
+
+	contextp->dc_markcnt++;
+	if ( contextp->dc_markcnt == 1 ) {
+		contextp->dc_firstmark = mark;
+	}
+
+	/* if all written are committed, send the mark back immediately.
+	 * otherwise put the mark record on the tail of the queue, to be
+	 * committed when the buffer is next "flushed".
+	 */
+	if ( contextp->dc_nextp == contextp->dc_buf ) {
+		ASSERT( drivep->d_markrecheadp == 0 );
+		( * cbfuncp )( cbcontextp, markrecp, BOOL_TRUE );
+		return;
+	}
+	markrecp->dm_cbfuncp = cbfuncp;
+	markrecp->dm_cbcontextp = cbcontextp;
+	markrecp->dm_nextp = 0;
+	if ( drivep->d_markrecheadp == 0 ) {
+		drivep->d_markrecheadp = markrecp;
+		drivep->d_markrectailp = markrecp;
+	} else {
+		ASSERT( drivep->d_markrectailp );
+		drivep->d_markrectailp->dm_nextp = markrecp;
+		drivep->d_markrectailp = markrecp;
+	}
+}
+
+/* get_write_buf - supply the caller with buffer space
+ */
+/*ARGSUSED*/
+static char *
+do_get_write_buf( drive_t *drivep, size_t wanted_bufsz, size_t *actual_bufszp )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	size_t remaining_bufsz;
+	size_t actual_bufsz;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null get_write_buf( want %u )\n",
+	      wanted_bufsz );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_WRITE );
+	ASSERT( ! contextp->dc_ownedp );
+	ASSERT( contextp->dc_nextp );
+	ASSERT( contextp->dc_nextp < contextp->dc_emptyp );
+	ASSERT( contextp->dc_ownedsz == 0 );
+
+	remaining_bufsz =( size_t )( contextp->dc_emptyp - contextp->dc_nextp );
+	actual_bufsz = min( wanted_bufsz, remaining_bufsz );
+
+	contextp->dc_ownedp = contextp->dc_nextp;
+	contextp->dc_ownedsz = actual_bufsz;
+	contextp->dc_nextp = 0;
+
+	*actual_bufszp = actual_bufsz;
+	return contextp->dc_ownedp;
+}
+
+/* write - accept ownership of the portion of the buffer owned by the
+ * caller. a full buffer is counted and discarded.
+ */
+/*ARGSUSED*/
+static intgen_t
+do_write( drive_t *drivep, char *bufp, size_t writesz )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null write( size %u )\n",
+	      writesz );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_WRITE );
+	ASSERT( contextp->dc_ownedp );
+	ASSERT( bufp == contextp->dc_ownedp );
+	ASSERT( ! contextp->dc_nextp );
+	ASSERT( contextp->dc_ownedp < contextp->dc_emptyp );
+	ASSERT( writesz == contextp->dc_ownedsz );
+
+	contextp->dc_nextp = contextp->dc_ownedp + writesz;
+	ASSERT( contextp->dc_nextp <= contextp->dc_emptyp );
+	contextp->dc_ownedp = 0;
+	contextp->dc_ownedsz = 0;
+
+	if ( contextp->dc_nextp == contextp->dc_emptyp ) {
+		contextp->dc_bufstroff += ( off64_t )sizeof( contextp->dc_buf );
+		contextp->dc_bytecnt += ( off64_t )sizeof( contextp->dc_buf );
+		drive_mark_commit( drivep, contextp->dc_bufstroff );
+		contextp->dc_nextp = contextp->dc_buf;
+	}
+
+	return 0;
+}
+
+/* get_align_cnt - returns the number of bytes which must be written to
+ * cause the next call to get_write_buf() to be page-aligned.
+ */
+static size_t
+do_get_align_cnt( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	__psint_t next_alignment_off;
+	char *next_alignment_point;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null get_align_cnt( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_WRITE );
+	ASSERT( ! contextp->dc_ownedp );
+	ASSERT( contextp->dc_nextp );
+	ASSERT( contextp->dc_nextp < contextp->dc_emptyp );
+
+	next_alignment_off = ( __psint_t )contextp->dc_nextp;
+	next_alignment_off +=  PGMASK;
+	next_alignment_off &= ~PGMASK;
+	next_alignment_point = ( char * )next_alignment_off;
+	ASSERT( next_alignment_point <= contextp->dc_emptyp );
+
+	return ( size_t )( next_alignment_point - contextp->dc_nextp );
+}
+
+/* end_write - count what remains in the buffer, and return by reference
+ * how many bytes were committed: all of them.
+ */
+static intgen_t
+do_end_write( drive_t *drivep, off64_t *ncommittedp )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	size_t remaining_bufsz;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null end_write( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_WRITE );
+	ASSERT( ! contextp->dc_ownedp );
+	ASSERT( contextp->dc_nextp );
+	ASSERT( contextp->dc_nextp < contextp->dc_emptyp );
+
+	remaining_bufsz = ( size_t )( contextp->dc_nextp - contextp->dc_buf );
+	contextp->dc_bufstroff += ( off64_t )remaining_bufsz;
+	contextp->dc_bytecnt += ( off64_t )remaining_bufsz;
+	drive_mark_commit( drivep, contextp->dc_bufstroff );
+	contextp->dc_nextp = contextp->dc_buf;
+	contextp->dc_elapsed += dn_usecs( &contextp->dc_begintv );
+
+	/* bump the file mark cnt
+	 */
+	contextp->dc_fmarkcnt++;
+	ASSERT( contextp->dc_fmarkcnt == 1 );
+
+	*ncommittedp = contextp->dc_bufstroff;
+	contextp->dc_mode = OM_NONE;
+	return 0;
+}
+
+/* rewind - return to the beginning of the recorded media file
+ */
+static intgen_t
+do_rewind( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null rewind( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_NONE );
+	ASSERT( drivep->d_capabilities & DRIVE_CAP_REWIND );
+
+	contextp->dc_strmoff = 0;
+	contextp->dc_fmarkcnt = 0;
+
+	return 0;
+}
+
+/* get_media_class()
+ */
+/* ARGSUSED */
+static intgen_t
+do_get_device_class( drive_t *drivep )
+{
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null get_device_class( )\n" );
+	ASSERT( drivep );
+	return DEVICE_NONREMOVABLE;
+}
+
+/* display_metrics - the bytes accepted or supplied, and how fast: the
+ * ceiling the rest of dump or restore puts on any real device.
+ */
+static void
+do_display_metrics( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	off64_t elapsed = contextp->dc_elapsed;
+	off64_t rate;
+
+	if ( contextp->dc_mode != OM_NONE ) {
+		elapsed += dn_usecs( &contextp->dc_begintv );
+	}
+	rate = elapsed > 0 ? contextp->dc_bytecnt * 1000000 / elapsed : 0;
+
+	if ( drivecnt > 1 ) {
+		mlog( MLOG_NORMAL | MLOG_BARE | MLOG_NOLOCK | MLOG_DRIVE,
+		      _("drive %u "),
+		      drivep->d_index );
+	}
+#ifdef DUMP
+	mlog( MLOG_NORMAL | MLOG_BARE | MLOG_NOLOCK | MLOG_DRIVE,
+	      _("null sink: %lld bytes, %u marks "
+	      "in %lld.%06lld seconds: %lld bytes/sec\n"),
+	      contextp->dc_bytecnt,
+	      contextp->dc_markcnt,
+	      elapsed / 1000000,
+	      elapsed % 1000000,
+	      rate );
+#endif /* DUMP */
+#ifdef RESTORE
+	mlog( MLOG_NORMAL | MLOG_BARE | MLOG_NOLOCK | MLOG_DRIVE,
+	      _("synthetic source: %lld bytes "
+	      "in %lld.%06lld seconds: %lld bytes/sec\n"),
+	      contextp->dc_bytecnt,
+	      elapsed / 1000000,
+	      elapsed % 1000000,
+	      rate );
+#endif /* RESTORE */
+}
+
+static void
+do_quit( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_null quit( )\n" );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp );
+	ASSERT( contextp->dc_mode == OM_NONE );
+
+	if ( mlog_level_ss[ MLOG_SS_DRIVE ] >= MLOG_VERBOSE ) {
+		do_display_metrics( drivep );
+	}
+
+	if ( contextp->dc_strmp ) {
+		free( ( void * )contextp->dc_strmp );
+		contextp->dc_strmp = 0;
+	}
+
+	free( ( void * )contextp );
+	drivep->d_contextp = 0;
+}
+
+#ifdef RESTORE
+
+/* dn_load - reads the recorded media file into memory
+ */
+static bool_t
+dn_load( drive_t *drivep, char *pathname )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	struct stat64 statbuf;
+	off64_t off;
+	intgen_t fd;
+
+	fd = open( pathname, O_RDONLY );
+	if ( fd < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("unable to open %s: %s\n"),
+		      pathname,
+		      strerror( errno ));
+		return BOOL_FALSE;
+	}
+	if ( fstat64( fd, &statbuf )) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("stat of %s failed: %s\n"),
+		      pathname,
+		      strerror( errno ));
+		close( fd );
+		return BOOL_FALSE;
+	}
+	if ( ! S_ISREG( statbuf.st_mode )) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("cannot replay %s: not a regular file\n"),
+		      pathname );
+		close( fd );
+		return BOOL_FALSE;
+	}
+
+	/* page-aligned, as though read into a drive buffer. at least
+	 * a page, so the header can be looked at even if short.
+	 */
+	contextp->dc_strmsz = statbuf.st_size;
+	contextp->dc_strmp = ( char * )memalign( PGSZ,
+						 ( size_t )max( statbuf.st_size,
+								( off64_t )PGSZ ));
+	if ( ! contextp->dc_strmp ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("cannot replay %s: "
+		      "unable to allocate %lld bytes\n"),
+		      pathname,
+		      statbuf.st_size );
+		close( fd );
+		return BOOL_FALSE;
+	}
+
+	for ( off = 0 ; off < contextp->dc_strmsz ; ) {
+		size_t reqcnt;
+		ssize_t nread;
+
+		reqcnt = ( size_t )min( contextp->dc_strmsz - off,
+					( off64_t )INTGENMAX );
+		nread = read( fd, contextp->dc_strmp + off, reqcnt );
+		if ( nread <= 0 ) {
+			mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+			      _("read of %s failed: %s\n"),
+			      pathname,
+			      nread < 0 ? strerror( errno ) : _("short file") );
+			close( fd );
+			free( ( void * )contextp->dc_strmp );
+			contextp->dc_strmp = 0;
+			return BOOL_FALSE;
+		}
+		off += ( off64_t )nread;
+	}
+	close( fd );
+
+	mlog( MLOG_VERBOSE | MLOG_DRIVE, _(
+	      "replaying %lld bytes of %s from memory\n"),
+	      contextp->dc_strmsz,
+	      pathname );
+
+	return BOOL_TRUE;
+}
+
+#endif /* RESTORE */
+
+/* dn_usecs - microseconds since *tvp
+ */
+static off64_t
+dn_usecs( struct timeval *tvp )
+{
+	struct timeval now;
+
+	gettimeofday( &now, 0 );
+	return ( off64_t )( now.tv_sec - tvp->tv_sec ) * 1000000
+	       +
+	       ( off64_t )( now.tv_usec - tvp->tv_usec );
+}
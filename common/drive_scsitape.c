@@ -47,6 +47,7 @@
 #include "rec_hdr.h"
 #include "arch_xlate.h"
 #include "ts_mtio.h"
+#include "perfstat.h"
 
 /* drive_scsitape.c - drive strategy for all scsi tape devices
  */
@@ -442,6 +443,8 @@ static drive_ops_t drive_ops = {
 	do_get_mark,		/* do_get_mark */
 	do_seek_mark,		/* do_seek_mark */
 	do_next_mark,		/* do_next_mark */
+	0,			/* do_seek_ino */
+	0,			/* do_skip */
 	do_end_read,		/* do_end_read */
 	do_begin_write,		/* do_begin_write */
 	do_set_mark,		/* do_set_mark */
@@ -4748,6 +4751,7 @@ Write( drive_t *drivep, char *bufp, size_t cnt, intgen_t *errnop )
 {
 	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
 	intgen_t nwritten;
+	perf_timer_t perftimer;
 
 	mlog( MLOG_DEBUG | MLOG_DRIVE,
 	      "tape op: writing %u bytes\n",
@@ -4757,7 +4761,12 @@ Write( drive_t *drivep, char *bufp, size_t cnt, intgen_t *errnop )
 	ASSERT( bufp );
 	*errnop = 0;
 	errno = 0;
+	perf_begin( &perftimer );
 	nwritten = write( contextp->dc_fd, ( void * )bufp, cnt );
+	perf_end( ( intgen_t )drivep->d_index,
+		  PERF_RECWRITE,
+		  &perftimer,
+		  ( off64_t )nwritten );
 	if ( nwritten < 0 ) {
 		*errnop = errno;
 		mlog( MLOG_NITTY | MLOG_DRIVE,
@@ -25,6 +25,7 @@
 #include <errno.h>
 #include <malloc.h>
 #include <sched.h>
+#include <signal.h>
 
 #include "types.h"
 #include "util.h"
@@ -34,6 +35,12 @@
 #include "drive.h"
 #include "media.h"
 #include "arch_xlate.h"
+#include "perfstat.h"
+#include "getopt.h"
+#include "lock.h"
+#include "qlock.h"
+#include "cldmgr.h"
+#include "lzb.h"
 
 #ifdef RMT
 /* this rmt junk is here because the rmt protocol supports writing ordinary
@@ -71,6 +78,95 @@ extern int rmtwrite( int, const void *, uint);
  */
 typedef enum { OM_NONE, OM_READ, OM_WRITE } om_t;
 
+/* stream codec, recorded in the drive header after the first mark.
+ * dumps which predate compression have zero there.
+ */
+#define DS_CODEC_NONE	0	/* stream is not framed */
+#define DS_CODEC_LZB	1	/* frames compressed by lzb_compress( ) */
+
+#define DS_CODECP( dhp )	( ( u_int32_t * )( ( dhp )->dh_specific \
+					   + sizeof( drive_mark_t )))
+
+/* a compressed stream is the media file header as is, followed by
+ * frames. each frame holds one buffer of the stream, compressed or,
+ * if that does not make it smaller, stored. the header gives the
+ * stream offset of the buffer, so marks remain stream offsets and
+ * frames after a damaged one can be found by scanning for the magic.
+ * on media the header is big-endian.
+ */
+#define DS_FRAME_MAGIC		"xfsdzfr"
+#define DS_FRAME_MAGIC_SZ	8
+
+struct ds_frame {
+	char fr_magic[ DS_FRAME_MAGIC_SZ ];
+	off64_t fr_logoff;	/* stream offset of the first byte */
+	u_int32_t fr_codec;	/* DS_CODEC_NONE if stored */
+	u_int32_t fr_rawlen;	/* length before compression */
+	u_int32_t fr_zlen;	/* length of the payload */
+	u_int32_t fr_padlen;	/* zeros after the payload (raw devices) */
+	u_int32_t fr_zsum;	/* checksum of the payload */
+	u_int32_t fr_hdrsum;	/* checksum of the above */
+};
+
+typedef struct ds_frame ds_frame_t;
+
+#define DS_ZTHRDMAX	16	/* compression threads */
+#define DS_ZOUTSZ	( sizeof( ds_frame_t ) + BUFSZ + BBSIZE )
+#define DS_ZINSZ	( 2 * BUFSZ )
+
+/* compression slot - one buffer of the stream on its way to the media.
+ * slots are queued in stream order and written in that order once
+ * compressed.
+ */
+struct ds_zslot {
+	char *zs_rawp;		/* copy of the buffer */
+	size_t zs_rawlen;
+	off64_t zs_logoff;	/* stream offset of zs_rawp[ 0 ] */
+	char *zs_outp;		/* frame header, payload and padding */
+	size_t zs_outlen;
+	void *zs_tabp;		/* lzb_compress( ) scratch */
+	qsemh_t zs_readyqsemh;	/* V'd when zs_outp is filled */
+};
+
+typedef struct ds_zslot ds_zslot_t;
+
+/* a media file written to a file or pipe ends with an index of the file
+ * headers within it, so that a restore reading a regular file can skip
+ * the files it does not need. an entry is kept for the first file header
+ * at least d_recmarksep beyond the previous entry, beginning with the first
+ * file header, where the directories end. the physical offset is where
+ * reading must begin to reach the file header: the mark itself, or the
+ * frame holding it if the stream is compressed. the index is preceded by
+ * a header and followed by a copy of it, the trailer, which locates the
+ * index from the end of the media file. none of this is part of the
+ * stream: a restore stops reading at the end of the stream, and the
+ * header tells one reading frames where they end. on media all of it
+ * is big-endian.
+ */
+#define DS_IDX_MAGIC		"xfsdidx"
+#define DS_IDX_MAGIC_SZ		8
+#define DS_IDXINITCNT		1024
+
+struct ds_idxent {
+	xfs_ino_t ie_ino;
+	off64_t ie_mark;	/* stream offset of the file header */
+	off64_t ie_physoff;	/* media file offset to read from */
+};
+
+typedef struct ds_idxent ds_idxent_t;
+
+struct ds_idxtrl {
+	char it_magic[ DS_IDX_MAGIC_SZ ];
+	uuid_t it_dumpid;	/* from the media file header */
+	off64_t it_off;		/* media file offset of the index header */
+	u_int32_t it_cnt;	/* entries */
+	u_int32_t it_sum;	/* checksum of the entries */
+	u_int32_t it_pad;
+	u_int32_t it_hdrsum;	/* checksum of the above */
+};
+
+typedef struct ds_idxtrl ds_idxtrl_t;
+
 struct drive_context {
 	char dc_buf[ BUFSZ ];	/* input/output buffer */
 	om_t dc_mode;		/* current mode of operation */
@@ -86,6 +182,30 @@ struct drive_context {
 	bool_t dc_rampr;	/* can randomly access file (not a pipe) */
 	bool_t dc_isrmtpr;	/* is accessed via rmt */
 	bool_t dc_israwdevpr;	/* is a raw disk partition */
+	bool_t dc_singlethreadedpr;
+	u_int32_t dc_codec;	/* stream codec: DS_CODEC_... */
+	off64_t dc_physoff;	/* bytes written to or read from dc_fd */
+	size_t dc_zthrdcnt;	/* compression threads asked for (dump) */
+	size_t dc_zthrdlive;	/* compression threads running */
+	ds_zslot_t *dc_zslotp;
+	size_t dc_zslotcnt;
+	size_t dc_zhead;	/* oldest slot not yet written */
+	size_t dc_zcnt;		/* slots queued */
+	size_t dc_znext;	/* next slot for a compression thread.
+				 * MUST be modified under lock( )
+				 */
+	bool_t dc_zdiepr;	/* tells the compression threads to exit */
+	bool_t dc_zerrpr;	/* a frame could not be written */
+	off64_t dc_zcommitted;	/* stream offset written through */
+	qsemh_t dc_zworkqsemh;	/* one count per slot queued */
+	qsemh_t dc_zquitqsemh;	/* V'd by each exiting thread */
+	char *dc_zinp;		/* frames read but not yet decoded */
+	size_t dc_zinoff;
+	size_t dc_zincnt;
+	ds_idxent_t *dc_idxp;	/* media file index */
+	size_t dc_idxcnt;
+	size_t dc_idxsz;	/* entries allocated (dump) */
+	size_t dc_idxresolved;	/* entries whose frame is written (dump) */
 };
 
 typedef struct drive_context drive_context_t;
@@ -113,6 +233,8 @@ static void do_return_read_buf( drive_t *, char *, size_t );
 static void do_get_mark( drive_t *, drive_mark_t * );
 static intgen_t do_seek_mark( drive_t *, drive_mark_t * );
 static intgen_t do_next_mark( drive_t * );
+static bool_t do_seek_ino( drive_t *, xfs_ino_t );
+static intgen_t do_skip( drive_t *, off64_t );
 static void do_get_mark( drive_t *, drive_mark_t * );
 static void do_end_read( drive_t * );
 static intgen_t do_begin_write( drive_t * );
@@ -126,6 +248,27 @@ static intgen_t do_erase( drive_t * );
 static intgen_t do_get_device_class( drive_t * );
 static void do_quit( drive_t * );
 
+/* compression
+ */
+#ifdef DUMP
+static bool_t ds_zinit( drive_t * );
+static int ds_zworker( void * );
+#endif /* DUMP */
+static void ds_zcompress( drive_context_t *, ds_zslot_t * );
+static intgen_t ds_zqueue( drive_t *, size_t );
+static intgen_t ds_zretire( drive_t * );
+static void ds_zquit( drive_context_t * );
+static intgen_t ds_zfill( drive_context_t *, size_t );
+static intgen_t ds_zread( drive_t *, off64_t *, size_t * );
+static void ds_frame_put( ds_frame_t *, char * );
+static bool_t ds_frame_get( char *, ds_frame_t * );
+static u_int32_t ds_sum( char *, size_t );
+static void ds_idxadd( drive_t *, xfs_ino_t, drive_mark_t );
+static void ds_idxput( drive_t * );
+static void ds_idxget( drive_t * );
+static void ds_idxfree( drive_context_t * );
+static bool_t ds_jump( drive_t *, off64_t, off64_t );
+
 
 /* definition of locally defined global variables ****************************/
 
@@ -154,6 +297,8 @@ static drive_ops_t drive_ops = {
 	do_get_mark,		/* do_get_mark */
 	do_seek_mark,		/* do_seek_mark */
 	do_next_mark,		/* do_next_mark */
+	do_seek_ino,		/* do_seek_ino */
+	do_skip,		/* do_skip */
 	do_end_read,		/* do_end_read */
 	do_begin_write,		/* do_begin_write */
 	do_set_mark,		/* do_set_mark */
@@ -226,6 +371,9 @@ static bool_t
 ds_instantiate( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
 {
 	drive_context_t *contextp;
+#ifdef DUMP
+	intgen_t c;
+#endif /* DUMP */
 
 	/* hook up the drive ops
 	 */
@@ -239,6 +387,59 @@ ds_instantiate( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
 	ASSERT( contextp );
 	ASSERT( ( void * )contextp->dc_buf == ( void * )contextp );
 	memset( ( void * )contextp, 0, sizeof( *contextp ));
+	contextp->dc_singlethreadedpr = singlethreaded;
+
+#ifdef DUMP
+	/* scan the command line for the compression option
+	 */
+	contextp->dc_codec = DS_CODEC_NONE;
+	optind = 1;
+	opterr = 0;
+	while ( ( c = getopt( argc, argv, GETOPT_CMDSTRING )) != EOF ) {
+		switch ( c ) {
+		case GETOPT_COMPRESS:
+			if ( ! optarg || optarg[ 0 ] == '-' ) {
+				mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+				      _("-%c argument missing\n"),
+				      c );
+				return BOOL_FALSE;
+			}
+			contextp->dc_zthrdcnt = ( size_t )atoi( optarg );
+			if ( contextp->dc_zthrdcnt > DS_ZTHRDMAX ) {
+				mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+				      _("-%c argument must be "
+				      "between 0 and %u\n"),
+				      c,
+				      DS_ZTHRDMAX );
+				return BOOL_FALSE;
+			}
+			contextp->dc_codec = DS_CODEC_LZB;
+			break;
+		}
+	}
+
+	/* the compression threads share the child thread table with the
+	 * streams and their slaves, created later: give each drive an
+	 * equal share of what those leave.
+	 */
+	if ( contextp->dc_codec != DS_CODEC_NONE && ! singlethreaded ) {
+		size_t share = ( CLD_MAX - 2 * drivecnt ) / drivecnt;
+
+		if ( contextp->dc_zthrdcnt > share ) {
+			if ( drivep->d_index == 0 ) {
+				mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+				      _("-%c %u reduced to %u compression "
+				      "threads per stream: "
+				      "too many threads for %u streams\n"),
+				      GETOPT_COMPRESS,
+				      contextp->dc_zthrdcnt,
+				      share,
+				      drivecnt );
+			}
+			contextp->dc_zthrdcnt = share;
+		}
+	}
+#endif /* DUMP */
 
 	/* scan drive device pathname to see if remote tape
 	 */
@@ -381,14 +582,16 @@ ds_instantiate( int argc, char *argv[], drive_t *drivep, bool_t singlethreaded )
 	return BOOL_TRUE;
 }
 
-/* drive op init - second pass drive manager init - nothing to do,
- * since async I/O not used.
+/* drive op init - second pass drive manager init - async I/O is not
+ * used, but if the stream is to be compressed, start the compression
+ * threads.
  */
 /* ARGSUSED */
 static bool_t
 do_init( drive_t *drivep )
 {
 #ifdef DUMP
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
 	drive_hdr_t *dwhdrp = drivep->d_writehdrp;
 	media_hdr_t *mwhdrp = ( media_hdr_t * )dwhdrp->dh_upper;
 #endif /* DUMP */
@@ -397,6 +600,17 @@ do_init( drive_t *drivep )
 	/* fill in media strategy id: artifact of first version of xfsdump
 	 */
 	mwhdrp->mh_strategyid = MEDIA_STRATEGY_SIMPLE;
+
+	if ( contextp->dc_codec != DS_CODEC_NONE ) {
+		/* an older xfsrestore would take the frames for dump
+		 * records: mark the stream with a version it refuses
+		 */
+		drivep->d_gwritehdrp->gh_version = GLOBAL_HDR_VERSION_3;
+
+		if ( ! ds_zinit( drivep )) {
+			return BOOL_FALSE;
+		}
+	}
 #endif /* DUMP */
 
 	return BOOL_TRUE;
@@ -457,6 +671,9 @@ do_begin_read( drive_t *drivep )
 	contextp->dc_emptyp = &contextp->dc_buf[ 0 ];
 	contextp->dc_nextp = contextp->dc_emptyp;
 	contextp->dc_bufstroff = 0;
+	contextp->dc_codec = DS_CODEC_NONE;
+	contextp->dc_zinoff = 0;
+	contextp->dc_zincnt = 0;
 
 	/* read the global header using the read_buf() utility function and
 	 * my own read and return_read_buf operators. spoof the mode
@@ -517,6 +734,7 @@ do_begin_read( drive_t *drivep )
 	xlate_drive_hdr(tmpdh, dh, 1);
 	*(( drive_mark_t * )dh->dh_specific) =
 		INT_GET(*(( drive_mark_t * )tmpdh->dh_specific), ARCH_CONVERT);
+	*DS_CODECP( dh ) = INT_GET(*DS_CODECP( tmpdh ), ARCH_CONVERT);
 	xlate_media_hdr(tmpmh, mh, 1);
 	xlate_content_hdr(tmpch, ch, 1);
 	xlate_content_inode_hdr(tmpcih, cih, 1);
@@ -555,6 +773,42 @@ do_begin_read( drive_t *drivep )
 	 */
 	contextp->dc_firstmark = *( drive_mark_t * )drhdrp->dh_specific;
 
+	/* if the stream is compressed, what was read beyond the header
+	 * is the start of the first frame. move it to the frame input
+	 * buffer: from here on do_read( ) fills dc_buf by decoding frames.
+	 */
+	switch ( *DS_CODECP( drhdrp )) {
+	case DS_CODEC_NONE:
+		break;
+	case DS_CODEC_LZB:
+		if ( ! contextp->dc_zinp ) {
+			contextp->dc_zinp = ( char * )malloc( DS_ZINSZ );
+			ASSERT( contextp->dc_zinp );
+		}
+		ASSERT( contextp->dc_emptyp >= contextp->dc_nextp );
+		contextp->dc_zincnt = ( size_t )( contextp->dc_emptyp
+						  -
+						  contextp->dc_nextp );
+		memcpy( ( void * )contextp->dc_zinp,
+			( void * )contextp->dc_nextp,
+			contextp->dc_zincnt );
+		contextp->dc_physoff = contextp->dc_bufstroff
+				       +
+				       ( off64_t )( contextp->dc_emptyp
+						    -
+						    contextp->dc_buf );
+		contextp->dc_emptyp = contextp->dc_nextp;
+		contextp->dc_codec = DS_CODEC_LZB;
+		mlog( MLOG_DEBUG | MLOG_DRIVE,
+		      "media file is compressed\n" );
+		break;
+	default:
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("unrecognized compression (%u)\n"),
+		      *DS_CODECP( drhdrp ));
+		return DRIVE_ERROR_FORMAT;
+	}
+
 	/* adjust the drive capabilities based on presence of first mark.
 	 * this is a hack workaround for a bug in xfsdump which causes the
 	 * first mark offset to not always be placed in the hdr.
@@ -563,6 +817,27 @@ do_begin_read( drive_t *drivep )
 		drivep->d_capabilities |= DRIVE_CAP_NEXTMARK;
 	}
 
+#ifdef RESTORE
+	/* see if the media file can be seeked rather than read through
+	 */
+	contextp->dc_rampr = BOOL_FALSE;
+	if ( ! contextp->dc_isrmtpr ) {
+		struct stat64 statbuf;
+
+		if ( ! fstat64( contextp->dc_fd, &statbuf )
+		     &&
+		     ( S_ISREG( statbuf.st_mode )
+		       ||
+		       S_ISBLK( statbuf.st_mode ))) {
+			contextp->dc_rampr = BOOL_TRUE;
+		}
+	}
+#endif /* RESTORE */
+
+	/* if reading a regular file, load the index at its end, if any
+	 */
+	ds_idxget( drivep );
+
 	/* note that a successful begin_read ocurred
 	 */
 	contextp->dc_mode = OM_READ;
@@ -614,6 +889,43 @@ do_read( drive_t *drivep,
 		bufhowfullcnt = ( size_t )
 				( contextp->dc_emptyp - contextp->dc_buf );
 
+		/* if the stream is compressed, decode the next frame.
+		 * the frame gives the offset of the top of the buffer:
+		 * frames may have been skipped if corrupt.
+		 */
+		if ( contextp->dc_codec != DS_CODEC_NONE ) {
+			off64_t logoff;
+			size_t rawlen;
+			intgen_t rval;
+
+			rval = ds_zread( drivep, &logoff, &rawlen );
+			if ( rval == DRIVE_ERROR_DEVICE ) {
+				*rvalp = rval;
+				return 0;
+			}
+			if ( rval == DRIVE_ERROR_EOD ) {
+				contextp->dc_bufstroff +=
+						( off64_t )bufhowfullcnt;
+				contextp->dc_emptyp = contextp->dc_buf;
+				contextp->dc_nextp = contextp->dc_buf;
+				*rvalp = rval;
+				return 0;
+			}
+			contextp->dc_bufstroff = logoff;
+			contextp->dc_emptyp = contextp->dc_buf + rawlen;
+			contextp->dc_nextp = contextp->dc_buf;
+
+			/* report the skip now, and supply the
+			 * frame on the next call
+			 */
+			if ( rval ) {
+				*rvalp = rval;
+				return 0;
+			}
+			remainingcnt = rawlen;
+			goto supply;
+		}
+
 		/* attempt to fill the buffer. nread may be less if at EOF
 		 */
 		nread = read( contextp->dc_fd, contextp->dc_buf, BUFSZ );
@@ -646,6 +958,7 @@ do_read( drive_t *drivep,
 		remainingcnt = ( size_t )nread;
 	}
 
+supply:
 	/* the caller specified at most how many bytes he wants. if less
 	 * than that remain unread in buffer, just return that many.
 	 */
@@ -737,6 +1050,7 @@ do_seek_mark( drive_t *drivep, drive_mark_t *markp )
 	off64_t mark = *( off64_t * )markp;
 	off64_t nextoff;
 	off64_t strmoff;
+	off64_t bufendoff;
 	/* REFERENCED */
 	intgen_t nread;
 	off64_t nreadneeded64;
@@ -763,22 +1077,64 @@ do_seek_mark( drive_t *drivep, drive_mark_t *markp )
 	if ( strmoff > mark ) {
 		return DRIVE_ERROR_CORE;
 	}
-	
+
+	/* if the media file can be seeked, seek over what is not yet
+	 * buffered. a compressed stream can only be entered at a frame,
+	 * so seek to the last indexed one not beyond the mark, if any.
+	 */
+	bufendoff = contextp->dc_bufstroff
+		    +
+		    ( off64_t )( contextp->dc_emptyp - contextp->dc_buf );
+	if ( contextp->dc_rampr && mark > bufendoff ) {
+		if ( contextp->dc_codec == DS_CODEC_NONE ) {
+			( void )ds_jump( drivep, mark, mark );
+		} else if ( contextp->dc_idxp ) {
+			size_t lo = 0;
+			size_t hi = contextp->dc_idxcnt;
+
+			while ( lo < hi ) {
+				size_t mid = ( lo + hi ) / 2;
+				if ( contextp->dc_idxp[ mid ].ie_mark <= mark ) {
+					lo = mid + 1;
+				} else {
+					hi = mid;
+				}
+			}
+			if ( lo > 0
+			     &&
+			     contextp->dc_idxp[ lo - 1 ].ie_mark
+			     >=
+			     bufendoff + ( off64_t )BUFSZ ) {
+				ds_idxent_t *entp = &contextp->dc_idxp[ lo - 1 ];
+				( void )ds_jump( drivep,
+						 entp->ie_physoff,
+						 entp->ie_mark );
+			}
+		}
+	}
+
 	/* use read_buf util func to eat up difference
 	 */
-	nreadneeded64 = mark - strmoff;
-	ASSERT( nreadneeded64 <= INTGENMAX );
-	nreadneeded = ( intgen_t )nreadneeded64;
-	nread = read_buf( 0,
-			  ( size_t )nreadneeded,
-			  ( void * )drivep,
-			  ( rfp_t )drivep->d_opsp->do_read,
-			  ( rrbfp_t )drivep->d_opsp->do_return_read_buf,
-			  &rval );
-	if  ( rval ) {
-		return rval;
+	for ( ; ; ) {
+		nextoff = ( off64_t )( contextp->dc_nextp - contextp->dc_buf );
+		strmoff = contextp->dc_bufstroff + nextoff;
+		ASSERT( strmoff <= mark );
+		if ( strmoff == mark ) {
+			break;
+		}
+		nreadneeded64 = min( mark - strmoff, ( off64_t )INTGENMAX );
+		nreadneeded = ( intgen_t )nreadneeded64;
+		nread = read_buf( 0,
+				  ( size_t )nreadneeded,
+				  ( void * )drivep,
+				  ( rfp_t )drivep->d_opsp->do_read,
+				  ( rrbfp_t )drivep->d_opsp->do_return_read_buf,
+				  &rval );
+		if  ( rval ) {
+			return rval;
+		}
+		ASSERT( nread == nreadneeded );
 	}
-	ASSERT( nread == nreadneeded );
 
 	/* verify we are on the mark
 	 */
@@ -824,6 +1180,175 @@ do_next_mark( drive_t *drivep )
 	return 0;
 }
 
+/* seek_ino - if the media file is indexed, skips forward to the last
+ * indexed file header of an ino not beyond ino
+ */
+static bool_t
+do_seek_ino( drive_t *drivep, xfs_ino_t ino )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	ds_idxent_t *entp;
+	drive_mark_t mark;
+	off64_t strmoff;
+	size_t lo;
+	size_t hi;
+	intgen_t rval;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_simple seek_ino( %llu )\n",
+	      ino );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	ASSERT( ! contextp->dc_ownedp );
+
+	if ( ! contextp->dc_idxp ) {
+		return BOOL_FALSE;
+	}
+
+	/* find the last entry not beyond ino
+	 */
+	lo = 0;
+	hi = contextp->dc_idxcnt;
+	while ( lo < hi ) {
+		size_t mid = ( lo + hi ) / 2;
+		if ( contextp->dc_idxp[ mid ].ie_ino <= ino ) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if ( lo == 0 ) {
+		return BOOL_FALSE;
+	}
+	entp = &contextp->dc_idxp[ lo - 1 ];
+
+	/* not worth a seek unless it saves reading at least a buffer
+	 */
+	strmoff = contextp->dc_bufstroff
+		  +
+		  ( off64_t )( contextp->dc_nextp - contextp->dc_buf );
+	if ( entp->ie_mark < strmoff + ( off64_t )BUFSZ ) {
+		return BOOL_FALSE;
+	}
+
+	if ( ! ds_jump( drivep, entp->ie_physoff, entp->ie_mark )) {
+		return BOOL_FALSE;
+	}
+
+	mlog( MLOG_DEBUG | MLOG_DRIVE,
+	      "skipped from stream offset %lld to ino %llu at %lld\n",
+	      strmoff,
+	      entp->ie_ino,
+	      entp->ie_mark );
+
+	/* within a frame, read up to the file header
+	 */
+	mark = ( drive_mark_t )entp->ie_mark;
+	rval = do_seek_mark( drivep, &mark );
+	if ( rval ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("unable to read up to ino %llu "
+		      "at stream offset %lld\n"),
+		      entp->ie_ino,
+		      entp->ie_mark );
+	}
+
+	return BOOL_TRUE;
+}
+
+/* skip - discards the next cnt bytes. do_seek_mark( ) seeks over them
+ * if the media file can be seeked.
+ */
+static intgen_t
+do_skip( drive_t *drivep, off64_t cnt )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	off64_t mark;
+
+	mlog( MLOG_NITTY | MLOG_DRIVE,
+	      "drive_simple skip( %lld )\n",
+	      cnt );
+
+	/* assert protocol
+	 */
+	ASSERT( contextp->dc_mode == OM_READ );
+	ASSERT( ! contextp->dc_ownedp );
+	ASSERT( cnt >= 0 );
+
+	mark = contextp->dc_bufstroff
+	       +
+	       ( off64_t )( contextp->dc_nextp - contextp->dc_buf )
+	       +
+	       cnt;
+
+	return do_seek_mark( drivep, ( drive_mark_t * )&mark );
+}
+
+/* ds_jump - repositions reading at media file offset physoff, beyond
+ * what is buffered, discarding the buffer. physoff must be the stream
+ * offset mark, or for a compressed stream the frame holding it; that
+ * frame is checked before seeking to it, and if damaged the jump is not
+ * made: reading on will resync. returns FALSE if not repositioned. the
+ * caller reads on from the top of the frame up to the mark.
+ */
+static bool_t
+ds_jump( drive_t *drivep, off64_t physoff, off64_t mark )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	off64_t bufstroff = physoff;
+	off64_t newoff;
+
+	if ( contextp->dc_codec != DS_CODEC_NONE ) {
+		ds_frame_t frame;
+		char hdr[ sizeof( ds_frame_t ) ];
+		intgen_t nread;
+
+		nread = pread64( contextp->dc_fd, hdr, sizeof( hdr ), physoff );
+		if ( nread != ( intgen_t )sizeof( hdr )
+		     ||
+		     ! ds_frame_get( hdr, &frame )
+		     ||
+		     mark < frame.fr_logoff
+		     ||
+		     mark >= frame.fr_logoff + ( off64_t )frame.fr_rawlen ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+			      _("media file index does not match "
+			      "the compressed block at offset %lld\n"),
+			      physoff );
+			return BOOL_FALSE;
+		}
+		bufstroff = frame.fr_logoff;
+	}
+
+	newoff = lseek64( contextp->dc_fd, physoff, SEEK_SET );
+	if ( newoff != physoff ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("unable to seek %s: %s\n"),
+		      drivep->d_pathname,
+		      strerror( errno ));
+		return BOOL_FALSE;
+	}
+
+	mlog( MLOG_DEBUG | MLOG_DRIVE,
+	      "seeked to media file offset %lld for stream offset %lld\n",
+	      physoff,
+	      mark );
+
+	/* discard what is buffered. the next read refills the buffer
+	 * from the new position.
+	 */
+	contextp->dc_bufstroff = bufstroff;
+	contextp->dc_emptyp = contextp->dc_buf;
+	contextp->dc_nextp = contextp->dc_buf;
+	contextp->dc_physoff = physoff;
+	contextp->dc_zinoff = 0;
+	contextp->dc_zincnt = 0;
+
+	return BOOL_TRUE;
+}
+
 /* end_read - tell the drive we are done reading the media file
  * just discards any buffered data
  */
@@ -884,9 +1409,11 @@ do_begin_write( drive_t *drivep )
 		return DRIVE_ERROR_EOM;
 	}
 
-	/* indicate in the header that there is no recorded mark.
+	/* indicate in the header that there is no recorded mark,
+	 * and whether the rest of the media file is compressed.
 	 */
 	*( ( off64_t * )dwhdrp->dh_specific ) = 0;
+	*DS_CODECP( dwhdrp ) = contextp->dc_codec;
 	
 	/* prepare the drive context. initially the caller does not own
 	 * any of the write buffer, so the next portion of the buffer to
@@ -899,6 +1426,10 @@ do_begin_write( drive_t *drivep )
 	contextp->dc_emptyp = contextp->dc_buf + sizeof( contextp->dc_buf );
 	contextp->dc_bufstroff = 0;
 	contextp->dc_markcnt = 0;
+	contextp->dc_physoff = 0;
+	contextp->dc_zerrpr = BOOL_FALSE;
+	contextp->dc_zcommitted = 0;
+	ds_idxfree( contextp );
 
 	/* truncate the destination if it supports read.
 	 */
@@ -930,6 +1461,7 @@ do_begin_write( drive_t *drivep )
 	INT_SET(*(( drive_mark_t * )tmpdh->dh_specific),
 		ARCH_CONVERT,
 		*(( drive_mark_t * )dh->dh_specific));
+	INT_SET(*DS_CODECP( tmpdh ), ARCH_CONVERT, *DS_CODECP( dh ));
 	xlate_media_hdr(mh, tmpmh, 1);
 	xlate_content_hdr(ch, tmpch, 1);
 	xlate_content_inode_hdr(cih, tmpcih, 1);
@@ -1012,6 +1544,12 @@ do_set_mark( drive_t *drivep,
 	 */
 	markrecp->dm_log = mark;
 
+	/* if a file begins at the mark, it may be indexed
+	 */
+	if ( markrecp->dm_ino ) {
+		ds_idxadd( drivep, markrecp->dm_ino, mark );
+	}
+
 	/* bump the mark count. if this is the first mark, record it
 	 * in the drive strategy-specific header. this allows multiple
 	 * media object restores to work. NOTE that the mark will not
@@ -1102,6 +1640,9 @@ do_set_mark( drive_t *drivep,
 				INT_SET(*(( drive_mark_t * )tmpdh->dh_specific),
 					ARCH_CONVERT,
 					*(( drive_mark_t * )dh->dh_specific));
+				INT_SET(*DS_CODECP( tmpdh ),
+					ARCH_CONVERT,
+					*DS_CODECP( dh ));
 				xlate_media_hdr(mh, tmpmh, 1);
 				xlate_content_hdr(ch, tmpch, 1);
 				xlate_content_inode_hdr(cih, tmpcih, 1);
@@ -1133,9 +1674,9 @@ do_set_mark( drive_t *drivep,
 				free(tmphdr);
 
 				newoff = lseek64( contextp->dc_fd,
-						  contextp->dc_bufstroff,
+						  contextp->dc_physoff,
 						  SEEK_SET );
-				ASSERT( newoff == contextp->dc_bufstroff );
+				ASSERT( newoff == contextp->dc_physoff );
 			}
 		}
 	}
@@ -1143,7 +1684,9 @@ do_set_mark( drive_t *drivep,
 	/* if all written are committed, send the mark back immediately.
 	 * otherwise put the mark record on the tail of the queue.
 	 */
-	if ( contextp->dc_nextp == contextp->dc_buf ) {
+	if ( contextp->dc_nextp == contextp->dc_buf
+	     &&
+	     contextp->dc_zcnt == 0 ) {
 		ASSERT( drivep->d_markrecheadp == 0 );
 		( * cbfuncp )( cbcontextp, markrecp, BOOL_TRUE );
 		return;
@@ -1256,10 +1799,21 @@ do_write( drive_t *drivep, char *bufp, size_t writesz )
 		return 0; /* returning unused buffer */
 	}
 
-	/* if buffer is full, flush it
+	/* if buffer is full, flush it. if compressing, hand it to the
+	 * compression slots instead.
 	 */
+	if ( contextp->dc_nextp == contextp->dc_emptyp
+	     &&
+	     contextp->dc_codec != DS_CODEC_NONE ) {
+		intgen_t rval;
+
+		rval = ds_zqueue( drivep, sizeof( contextp->dc_buf ));
+		contextp->dc_nextp = contextp->dc_buf;
+		return rval;
+	}
 	if ( contextp->dc_nextp == contextp->dc_emptyp ) {
 		intgen_t nwritten;
+		perf_timer_t perftimer;
 
 		mlog( MLOG_DEBUG | MLOG_DRIVE,
 		      "flushing write buf addr 0x%x size 0x%x\n",
@@ -1267,9 +1821,14 @@ do_write( drive_t *drivep, char *bufp, size_t writesz )
 		      sizeof( contextp->dc_buf ));
 
 		contextp->dc_nextp = 0;
+		perf_begin( &perftimer );
 		nwritten = write( contextp->dc_fd,
 				  contextp->dc_buf,
 				  sizeof( contextp->dc_buf ));
+		perf_end( ( intgen_t )drivep->d_index,
+			  PERF_RECWRITE,
+			  &perftimer,
+			  ( off64_t )nwritten );
 		if ( nwritten < 0 ) {
 			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
 			      _("write to %s failed: %d (%s)\n"),
@@ -1279,6 +1838,7 @@ do_write( drive_t *drivep, char *bufp, size_t writesz )
 			nwritten = 0;
 		}
 		contextp->dc_bufstroff += ( off64_t )nwritten;
+		contextp->dc_physoff += ( off64_t )nwritten;
 		drive_mark_commit( drivep, contextp->dc_bufstroff );
 		contextp->dc_nextp = contextp->dc_buf;
 		if ( ( size_t )nwritten < sizeof( contextp->dc_buf )) {
@@ -1348,8 +1908,34 @@ do_end_write( drive_t *drivep, off64_t *ncommittedp )
 	ASSERT( contextp->dc_nextp >= contextp->dc_buf );
 	remaining_bufsz = ( size_t )( contextp->dc_nextp - contextp->dc_buf );
 
+	/* if compressing, queue the remainder and wait for all slots to
+	 * be written.
+	 */
+	if ( contextp->dc_codec != DS_CODEC_NONE ) {
+		intgen_t rval = 0;
+
+		if ( remaining_bufsz ) {
+			rval = ds_zqueue( drivep, remaining_bufsz );
+		}
+		while ( contextp->dc_zcnt ) {
+			intgen_t rv = ds_zretire( drivep );
+			if ( ! rval ) {
+				rval = rv;
+			}
+		}
+		contextp->dc_nextp = contextp->dc_buf;
+		if ( rval ) {
+			drive_mark_discard( drivep );
+			*ncommittedp = contextp->dc_zcommitted;
+			contextp->dc_mode = OM_NONE;
+			return rval;
+		}
+		remaining_bufsz = 0;
+	}
+
 	if ( remaining_bufsz ) {
 		int nwritten;
+		perf_timer_t perftimer;
 		if ( contextp->dc_israwdevpr ) {
 			remaining_bufsz = ( remaining_bufsz + ( BBSIZE - 1 ))
 					  &
@@ -1361,9 +1947,14 @@ do_end_write( drive_t *drivep, off64_t *ncommittedp )
 		      contextp->dc_buf,
 		      remaining_bufsz );
 
+		perf_begin( &perftimer );
 		nwritten = write( contextp->dc_fd,
 				  contextp->dc_buf,
 				  remaining_bufsz );
+		perf_end( ( intgen_t )drivep->d_index,
+			  PERF_RECWRITE,
+			  &perftimer,
+			  ( off64_t )nwritten );
 		if ( nwritten < 0 ) {
 			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
 			      _("write to %s failed: %d (%s)\n"),
@@ -1376,6 +1967,7 @@ do_end_write( drive_t *drivep, off64_t *ncommittedp )
 			return DRIVE_ERROR_DEVICE;
 		}
 		contextp->dc_bufstroff += ( off64_t )nwritten;
+		contextp->dc_physoff += ( off64_t )nwritten;
 		drive_mark_commit( drivep, contextp->dc_bufstroff );
 		if ( ( size_t )nwritten < remaining_bufsz ) {
 			*ncommittedp = contextp->dc_bufstroff;
@@ -1384,6 +1976,10 @@ do_end_write( drive_t *drivep, off64_t *ncommittedp )
 		}
 	}
 
+	/* all of the stream is on media: follow it with the index
+	 */
+	ds_idxput( drivep );
+
 	/* bump the file mark cnt
 	 */
 	contextp->dc_fmarkcnt++;
@@ -1503,6 +2099,15 @@ do_quit( drive_t *drivep )
 	ASSERT( contextp->dc_mode == OM_NONE );
 	ASSERT( contextp );
 
+	/* stop the compression threads and free the slots
+	 */
+	ds_zquit( contextp );
+	if ( contextp->dc_zinp ) {
+		free( ( void * )contextp->dc_zinp );
+		contextp->dc_zinp = 0;
+	}
+	ds_idxfree( contextp );
+
 	/* close file
 	 */
 	if ( contextp->dc_fd > 1 ) {
@@ -1515,3 +2120,820 @@ do_quit( drive_t *drivep )
 	free( ( void * )contextp );
 	drivep->d_contextp = 0;
 }
+
+#ifdef DUMP
+/* ds_zinit - allocates the compression slots and, unless single-threaded,
+ * starts the compression threads. with no threads each buffer is
+ * compressed and written by the stream as it is queued, so one slot does.
+ * the Linux dump always runs single-threaded (see in_miniroot_heuristic( )),
+ * so this inline path is the one used there; the threads are kept for
+ * when multiple streams are supported.
+ */
+static bool_t
+ds_zinit( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	size_t thrdcnt;
+	ix_t slotix;
+
+	thrdcnt = contextp->dc_singlethreadedpr ? 0 : contextp->dc_zthrdcnt;
+	contextp->dc_zslotcnt = thrdcnt ? 2 * thrdcnt : 1;
+	contextp->dc_zslotp = ( ds_zslot_t * )calloc( contextp->dc_zslotcnt,
+						     sizeof( ds_zslot_t ));
+	if ( ! contextp->dc_zslotp ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+		      _("unable to allocate compression buffers\n") );
+		return BOOL_FALSE;
+	}
+	for ( slotix = 0 ; slotix < contextp->dc_zslotcnt ; slotix++ ) {
+		ds_zslot_t *slotp = &contextp->dc_zslotp[ slotix ];
+
+		slotp->zs_rawp = ( char * )malloc( BUFSZ );
+		slotp->zs_outp = ( char * )malloc( DS_ZOUTSZ );
+		slotp->zs_tabp = malloc( LZB_TABSZ );
+		if ( ! slotp->zs_rawp || ! slotp->zs_outp || ! slotp->zs_tabp ) {
+			mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_DRIVE,
+			      _("unable to allocate compression buffers\n") );
+			ds_zquit( contextp );
+			return BOOL_FALSE;
+		}
+		slotp->zs_readyqsemh = qsem_alloc( 0 );
+		ASSERT( slotp->zs_readyqsemh );
+	}
+	contextp->dc_zhead = 0;
+	contextp->dc_zcnt = 0;
+	contextp->dc_znext = 0;
+	contextp->dc_zdiepr = BOOL_FALSE;
+
+	if ( thrdcnt ) {
+		contextp->dc_zworkqsemh = qsem_alloc( 0 );
+		ASSERT( contextp->dc_zworkqsemh );
+		contextp->dc_zquitqsemh = qsem_alloc( 0 );
+		ASSERT( contextp->dc_zquitqsemh );
+		while ( contextp->dc_zthrdlive < thrdcnt ) {
+			if ( ! cldmgr_create( ds_zworker,
+					      CLONE_VM,
+					      ( ix_t )-1,
+					      _("compression"),
+					      ( void * )contextp )) {
+				break;
+			}
+			contextp->dc_zthrdlive++;
+		}
+		if ( contextp->dc_zthrdlive < thrdcnt ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+			      _("started only %u of %u compression threads\n"),
+			      contextp->dc_zthrdlive,
+			      thrdcnt );
+		}
+	}
+
+	mlog( MLOG_DEBUG | MLOG_DRIVE,
+	      "compression: %u threads, %u slots\n",
+	      contextp->dc_zthrdlive,
+	      contextp->dc_zslotcnt );
+
+	return BOOL_TRUE;
+}
+
+static int
+ds_zworker( void *arg1 )
+{
+	drive_context_t *contextp = ( drive_context_t * )arg1;
+
+	sigset( SIGHUP, SIG_IGN );
+	sigset( SIGINT, SIG_IGN );
+	sigset( SIGQUIT, SIG_IGN );
+	sigset( SIGPIPE, SIG_IGN );
+	sigset( SIGALRM, SIG_IGN );
+	sigset( SIGCLD, SIG_IGN );
+
+	for ( ; ; ) {
+		ds_zslot_t *slotp;
+
+		qsemP( contextp->dc_zworkqsemh );
+
+		lock( );
+		if ( contextp->dc_zdiepr ) {
+			unlock( );
+			break;
+		}
+		slotp = &contextp->dc_zslotp[ contextp->dc_znext ];
+		contextp->dc_znext = ( contextp->dc_znext + 1 )
+				     %
+				     contextp->dc_zslotcnt;
+		unlock( );
+
+		ds_zcompress( contextp, slotp );
+
+		qsemV( slotp->zs_readyqsemh );
+	}
+
+	qsemV( contextp->dc_zquitqsemh );
+	exit( 0 );
+}
+
+#endif /* DUMP */
+
+/* ds_zcompress - builds the frame for the buffer in a slot
+ */
+static void
+ds_zcompress( drive_context_t *contextp, ds_zslot_t *slotp )
+{
+	char *payloadp = slotp->zs_outp + sizeof( ds_frame_t );
+	ds_frame_t frame;
+	size_t zlen;
+
+	ASSERT( slotp->zs_rawlen > 0 );
+	ASSERT( slotp->zs_rawlen <= BUFSZ );
+
+	zlen = lzb_compress( slotp->zs_rawp,
+			     slotp->zs_rawlen,
+			     payloadp,
+			     slotp->zs_rawlen - 1,
+			     slotp->zs_tabp );
+	if ( zlen ) {
+		frame.fr_codec = contextp->dc_codec;
+	} else {
+		memcpy( ( void * )payloadp,
+			( void * )slotp->zs_rawp,
+			slotp->zs_rawlen );
+		zlen = slotp->zs_rawlen;
+		frame.fr_codec = DS_CODEC_NONE;
+	}
+
+	frame.fr_logoff = slotp->zs_logoff;
+	frame.fr_rawlen = ( u_int32_t )slotp->zs_rawlen;
+	frame.fr_zlen = ( u_int32_t )zlen;
+	frame.fr_padlen = 0;
+	frame.fr_zsum = ds_sum( payloadp, zlen );
+	slotp->zs_outlen = sizeof( ds_frame_t ) + zlen;
+
+	/* raw devices take whole basic blocks
+	 */
+	if ( contextp->dc_israwdevpr ) {
+		size_t outlen = ( slotp->zs_outlen + ( BBSIZE - 1 ))
+				&
+				~( BBSIZE - 1 );
+		frame.fr_padlen = ( u_int32_t )( outlen - slotp->zs_outlen );
+		memset( ( void * )( slotp->zs_outp + slotp->zs_outlen ),
+			0,
+			frame.fr_padlen );
+		slotp->zs_outlen = outlen;
+	}
+	ASSERT( slotp->zs_outlen <= DS_ZOUTSZ );
+
+	ds_frame_put( &frame, slotp->zs_outp );
+}
+
+/* ds_zqueue - queues the first len bytes of dc_buf for compression and
+ * advances dc_bufstroff past them. the media file header, at the top of
+ * the first buffer, is written as is. if no slot is free, or there are
+ * no compression threads, writes the oldest. returns 0 or the error
+ * from writing.
+ */
+static intgen_t
+ds_zqueue( drive_t *drivep, size_t len )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	char *bufp = contextp->dc_buf;
+	ds_zslot_t *slotp;
+	intgen_t rval = 0;
+
+	if ( contextp->dc_bufstroff == 0 ) {
+		intgen_t nwritten;
+
+		ASSERT( len >= GLOBAL_HDR_SZ );
+		nwritten = write( contextp->dc_fd, bufp, GLOBAL_HDR_SZ );
+		if ( nwritten < 0 ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+			      _("write to %s failed: %d (%s)\n"),
+			      drivep->d_pathname,
+			      errno,
+			      strerror( errno ));
+			nwritten = 0;
+		}
+		contextp->dc_physoff += ( off64_t )nwritten;
+		contextp->dc_bufstroff = GLOBAL_HDR_SZ;
+		if ( nwritten < GLOBAL_HDR_SZ ) {
+			contextp->dc_zerrpr = BOOL_TRUE;
+			return DRIVE_ERROR_EOM;
+		}
+		contextp->dc_zcommitted = GLOBAL_HDR_SZ;
+		bufp += GLOBAL_HDR_SZ;
+		len -= GLOBAL_HDR_SZ;
+		if ( len == 0 ) {
+			return 0;
+		}
+	}
+
+	if ( contextp->dc_zcnt == contextp->dc_zslotcnt ) {
+		rval = ds_zretire( drivep );
+	}
+
+	slotp = &contextp->dc_zslotp[ ( contextp->dc_zhead + contextp->dc_zcnt )
+				      %
+				      contextp->dc_zslotcnt ];
+	memcpy( ( void * )slotp->zs_rawp, ( void * )bufp, len );
+	slotp->zs_rawlen = len;
+	slotp->zs_logoff = contextp->dc_bufstroff;
+	contextp->dc_bufstroff += ( off64_t )len;
+	contextp->dc_zcnt++;
+
+	if ( contextp->dc_zthrdlive ) {
+		qsemV( contextp->dc_zworkqsemh );
+	} else {
+		intgen_t rv;
+
+		ds_zcompress( contextp, slotp );
+		rv = ds_zretire( drivep );
+		if ( ! rval ) {
+			rval = rv;
+		}
+	}
+
+	return rval;
+}
+
+/* ds_zretire - waits for the oldest slot to be compressed and writes it.
+ * once a write fails no more are attempted, so that the media file ends
+ * at a frame boundary.
+ */
+static intgen_t
+ds_zretire( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	ds_zslot_t *slotp = &contextp->dc_zslotp[ contextp->dc_zhead ];
+	intgen_t nwritten;
+	perf_timer_t perftimer;
+
+	ASSERT( contextp->dc_zcnt > 0 );
+
+	if ( contextp->dc_zthrdlive ) {
+		qsemP( slotp->zs_readyqsemh );
+	}
+	contextp->dc_zhead = ( contextp->dc_zhead + 1 ) % contextp->dc_zslotcnt;
+	contextp->dc_zcnt--;
+
+	if ( contextp->dc_zerrpr ) {
+		return DRIVE_ERROR_EOM;
+	}
+
+	/* index entries for marks within this frame can now be located
+	 */
+	while ( contextp->dc_idxresolved < contextp->dc_idxcnt
+		&&
+		contextp->dc_idxp[ contextp->dc_idxresolved ].ie_mark
+		<
+		slotp->zs_logoff + ( off64_t )slotp->zs_rawlen ) {
+		contextp->dc_idxp[ contextp->dc_idxresolved ].ie_physoff =
+							contextp->dc_physoff;
+		contextp->dc_idxresolved++;
+	}
+
+	mlog( MLOG_DEBUG | MLOG_DRIVE,
+	      "writing frame offset %lld size 0x%x from 0x%x\n",
+	      slotp->zs_logoff,
+	      slotp->zs_outlen,
+	      slotp->zs_rawlen );
+
+	perf_begin( &perftimer );
+	nwritten = write( contextp->dc_fd, slotp->zs_outp, slotp->zs_outlen );
+	perf_end( ( intgen_t )drivep->d_index,
+		  PERF_RECWRITE,
+		  &perftimer,
+		  ( off64_t )nwritten );
+	if ( nwritten < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("write to %s failed: %d (%s)\n"),
+		      drivep->d_pathname,
+		      errno,
+		      strerror( errno ));
+		nwritten = 0;
+	}
+	contextp->dc_physoff += ( off64_t )nwritten;
+	if ( ( size_t )nwritten < slotp->zs_outlen ) {
+		contextp->dc_zerrpr = BOOL_TRUE;
+		return DRIVE_ERROR_EOM;
+	}
+
+	contextp->dc_zcommitted = slotp->zs_logoff + ( off64_t )slotp->zs_rawlen;
+	drive_mark_commit( drivep, contextp->dc_zcommitted );
+
+	return 0;
+}
+
+/* ds_zquit - stops the compression threads, if any, and frees the slots
+ */
+static void
+ds_zquit( drive_context_t *contextp )
+{
+	ix_t slotix;
+	size_t thrdix;
+
+	if ( contextp->dc_zthrdlive ) {
+		lock( );
+		contextp->dc_zdiepr = BOOL_TRUE;
+		unlock( );
+		for ( thrdix = 0 ; thrdix < contextp->dc_zthrdlive ; thrdix++ ) {
+			qsemV( contextp->dc_zworkqsemh );
+		}
+		for ( thrdix = 0 ; thrdix < contextp->dc_zthrdlive ; thrdix++ ) {
+			qsemP( contextp->dc_zquitqsemh );
+		}
+		contextp->dc_zthrdlive = 0;
+		qsem_free( contextp->dc_zworkqsemh );
+		qsem_free( contextp->dc_zquitqsemh );
+	}
+
+	if ( ! contextp->dc_zslotp ) {
+		return;
+	}
+	for ( slotix = 0 ; slotix < contextp->dc_zslotcnt ; slotix++ ) {
+		ds_zslot_t *slotp = &contextp->dc_zslotp[ slotix ];
+
+		if ( slotp->zs_readyqsemh ) {
+			qsem_free( slotp->zs_readyqsemh );
+		}
+		free( ( void * )slotp->zs_rawp );
+		free( ( void * )slotp->zs_outp );
+		free( slotp->zs_tabp );
+	}
+	free( ( void * )contextp->dc_zslotp );
+	contextp->dc_zslotp = 0;
+	contextp->dc_zslotcnt = 0;
+}
+
+/* ds_zfill - reads until at least cnt bytes of frames are buffered,
+ * from dc_zinp[ dc_zinoff ]. returns the number buffered, which is
+ * less than cnt only at the end of the media file, or -1 on error.
+ */
+static intgen_t
+ds_zfill( drive_context_t *contextp, size_t cnt )
+{
+	ASSERT( cnt <= DS_ZINSZ );
+
+	if ( contextp->dc_zinoff + cnt > DS_ZINSZ ) {
+		memmove( ( void * )contextp->dc_zinp,
+			 ( void * )( contextp->dc_zinp + contextp->dc_zinoff ),
+			 contextp->dc_zincnt );
+		contextp->dc_zinoff = 0;
+	}
+
+	while ( contextp->dc_zincnt < cnt ) {
+		size_t endoff = contextp->dc_zinoff + contextp->dc_zincnt;
+		intgen_t nread;
+
+		nread = read( contextp->dc_fd,
+			      contextp->dc_zinp + endoff,
+			      DS_ZINSZ - endoff );
+		if ( nread < 0 ) {
+			return -1;
+		}
+		if ( nread == 0 ) {
+			break;
+		}
+		contextp->dc_zincnt += ( size_t )nread;
+		contextp->dc_physoff += ( off64_t )nread;
+	}
+
+	return ( intgen_t )contextp->dc_zincnt;
+}
+
+/* ds_zread - decodes the next frame into dc_buf, returning by reference
+ * its stream offset and length. a frame which fails its checks is
+ * skipped by scanning forward for the next good one; DRIVE_ERROR_CORRUPTION
+ * is then returned along with that frame. returns DRIVE_ERROR_EOD if no
+ * frame remains, or DRIVE_ERROR_DEVICE.
+ */
+static intgen_t
+ds_zread( drive_t *drivep, off64_t *logoffp, size_t *rawlenp )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	bool_t skippedpr = BOOL_FALSE;
+
+	for ( ; ; ) {
+		ds_frame_t frame;
+		char *hdrp;
+		char *payloadp;
+		size_t framesz;
+		intgen_t nbuf;
+		intgen_t rawlen;
+
+		nbuf = ds_zfill( contextp, sizeof( ds_frame_t ));
+		if ( nbuf < 0 ) {
+			return DRIVE_ERROR_DEVICE;
+		}
+		if ( ( size_t )nbuf < sizeof( ds_frame_t )) {
+			if ( nbuf > 0 && ! skippedpr ) {
+				mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+				      _("media file ends within a "
+				      "compressed block\n") );
+			}
+			contextp->dc_zincnt = 0;
+			return DRIVE_ERROR_EOD;
+		}
+
+		hdrp = contextp->dc_zinp + contextp->dc_zinoff;
+
+		/* the media file index follows the last frame
+		 */
+		if ( ! strncmp( hdrp, DS_IDX_MAGIC, DS_IDX_MAGIC_SZ )) {
+			contextp->dc_zincnt = 0;
+			return DRIVE_ERROR_EOD;
+		}
+
+		if ( ds_frame_get( hdrp, &frame )) {
+			framesz = sizeof( ds_frame_t )
+				  +
+				  ( size_t )frame.fr_zlen
+				  +
+				  ( size_t )frame.fr_padlen;
+			nbuf = ds_zfill( contextp, framesz );
+			if ( nbuf < 0 ) {
+				return DRIVE_ERROR_DEVICE;
+			}
+			hdrp = contextp->dc_zinp + contextp->dc_zinoff;
+			payloadp = hdrp + sizeof( ds_frame_t );
+
+			if ( ( size_t )nbuf >= framesz
+			     &&
+			     ds_sum( payloadp, frame.fr_zlen )
+			     ==
+			     frame.fr_zsum ) {
+				if ( frame.fr_codec == DS_CODEC_NONE ) {
+					memcpy( ( void * )contextp->dc_buf,
+						( void * )payloadp,
+						frame.fr_zlen );
+					rawlen = ( intgen_t )frame.fr_zlen;
+				} else {
+					rawlen = lzb_decompress(
+							payloadp,
+							frame.fr_zlen,
+							contextp->dc_buf,
+							BUFSZ );
+				}
+				if ( rawlen == ( intgen_t )frame.fr_rawlen ) {
+					contextp->dc_zinoff += framesz;
+					contextp->dc_zincnt -= framesz;
+					*logoffp = frame.fr_logoff;
+					*rawlenp = ( size_t )rawlen;
+					return skippedpr
+					       ?
+					       DRIVE_ERROR_CORRUPTION
+					       :
+					       0;
+				}
+			}
+		}
+
+		/* not a good frame. look for the next one a byte further on
+		 */
+		if ( ! skippedpr ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+			      _("corrupt compressed block at media file "
+			      "offset %lld: skipping to next block\n"),
+			      contextp->dc_physoff
+			      -
+			      ( off64_t )contextp->dc_zincnt );
+			skippedpr = BOOL_TRUE;
+		}
+		contextp->dc_zinoff++;
+		contextp->dc_zincnt--;
+	}
+	/* NOTREACHED */
+}
+
+/* ds_frame_put - writes a frame header to the media buffer bufp
+ */
+static void
+ds_frame_put( ds_frame_t *framep, char *bufp )
+{
+	ds_frame_t tmpframe;
+
+	memset( ( void * )&tmpframe, 0, sizeof( tmpframe ));
+	strncpy( tmpframe.fr_magic, DS_FRAME_MAGIC, DS_FRAME_MAGIC_SZ );
+	INT_SET( tmpframe.fr_logoff, ARCH_CONVERT, framep->fr_logoff );
+	INT_SET( tmpframe.fr_codec, ARCH_CONVERT, framep->fr_codec );
+	INT_SET( tmpframe.fr_rawlen, ARCH_CONVERT, framep->fr_rawlen );
+	INT_SET( tmpframe.fr_zlen, ARCH_CONVERT, framep->fr_zlen );
+	INT_SET( tmpframe.fr_padlen, ARCH_CONVERT, framep->fr_padlen );
+	INT_SET( tmpframe.fr_zsum, ARCH_CONVERT, framep->fr_zsum );
+	INT_SET( tmpframe.fr_hdrsum,
+		 ARCH_CONVERT,
+		 ds_sum( ( char * )&tmpframe,
+			 offsetofmember( ds_frame_t, fr_hdrsum )));
+	memcpy( ( void * )bufp, ( void * )&tmpframe, sizeof( tmpframe ));
+}
+
+/* ds_frame_get - reads a frame header from the media buffer bufp.
+ * returns FALSE if it is not a plausible frame header.
+ */
+static bool_t
+ds_frame_get( char *bufp, ds_frame_t *framep )
+{
+	ds_frame_t tmpframe;
+
+	if ( strncmp( bufp, DS_FRAME_MAGIC, DS_FRAME_MAGIC_SZ )) {
+		return BOOL_FALSE;
+	}
+	memcpy( ( void * )&tmpframe, ( void * )bufp, sizeof( tmpframe ));
+	if ( INT_GET( tmpframe.fr_hdrsum, ARCH_CONVERT )
+	     !=
+	     ds_sum( ( char * )&tmpframe,
+		     offsetofmember( ds_frame_t, fr_hdrsum ))) {
+		return BOOL_FALSE;
+	}
+
+	framep->fr_logoff = INT_GET( tmpframe.fr_logoff, ARCH_CONVERT );
+	framep->fr_codec = INT_GET( tmpframe.fr_codec, ARCH_CONVERT );
+	framep->fr_rawlen = INT_GET( tmpframe.fr_rawlen, ARCH_CONVERT );
+	framep->fr_zlen = INT_GET( tmpframe.fr_zlen, ARCH_CONVERT );
+	framep->fr_padlen = INT_GET( tmpframe.fr_padlen, ARCH_CONVERT );
+	framep->fr_zsum = INT_GET( tmpframe.fr_zsum, ARCH_CONVERT );
+
+	if ( framep->fr_logoff < 0
+	     ||
+	     framep->fr_rawlen == 0
+	     ||
+	     framep->fr_rawlen > BUFSZ
+	     ||
+	     framep->fr_zlen > BUFSZ
+	     ||
+	     framep->fr_padlen >= BBSIZE
+	     ||
+	     ( framep->fr_codec != DS_CODEC_NONE
+	       &&
+	       framep->fr_codec != DS_CODEC_LZB )) {
+		return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+/* ds_sum - adler-32 checksum
+ */
+#define DS_SUMMOD	65521
+#define DS_SUMNMAX	5552	/* bytes before the sums could overflow */
+
+static u_int32_t
+ds_sum( char *bufp, size_t len )
+{
+	u_char_t *p = ( u_char_t * )bufp;
+	u_int32_t a = 1;
+	u_int32_t b = 0;
+
+	while ( len ) {
+		size_t n = min( len, DS_SUMNMAX );
+
+		len -= n;
+		while ( n-- ) {
+			a += *p++;
+			b += a;
+		}
+		a %= DS_SUMMOD;
+		b %= DS_SUMMOD;
+	}
+
+	return ( b << 16 ) | a;
+}
+
+/* ds_idxadd - called for each mark at which a file begins. adds an entry
+ * to the index if the mark is far enough beyond the last one. the frame
+ * of a compressed stream is located once it is written, by ds_zretire( ).
+ */
+static void
+ds_idxadd( drive_t *drivep, xfs_ino_t ino, drive_mark_t mark )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	ds_idxent_t *entp;
+
+	if ( contextp->dc_idxcnt > 0
+	     &&
+	     mark - contextp->dc_idxp[ contextp->dc_idxcnt - 1 ].ie_mark
+	     <
+	     drivep->d_recmarksep ) {
+		return;
+	}
+
+	if ( contextp->dc_idxcnt == contextp->dc_idxsz ) {
+		contextp->dc_idxsz = contextp->dc_idxsz
+				     ?
+				     2 * contextp->dc_idxsz
+				     :
+				     DS_IDXINITCNT;
+		contextp->dc_idxp = ( ds_idxent_t * )
+				    realloc( ( void * )contextp->dc_idxp,
+					     contextp->dc_idxsz
+					     *
+					     sizeof( ds_idxent_t ));
+		ASSERT( contextp->dc_idxp );
+	}
+
+	entp = &contextp->dc_idxp[ contextp->dc_idxcnt++ ];
+	entp->ie_ino = ino;
+	entp->ie_mark = ( off64_t )mark;
+	entp->ie_physoff = ( contextp->dc_codec == DS_CODEC_NONE )
+			   ?
+			   ( off64_t )mark
+			   :
+			   -1;
+}
+
+/* ds_idxput - writes the index and its trailer after the stream. not
+ * done for raw devices, whose reads and writes must be aligned. failure
+ * to write them is not an error: the media file is complete without.
+ */
+static void
+ds_idxput( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	global_hdr_t *gwhdrp = drivep->d_gwritehdrp;
+	ds_idxtrl_t trl;
+	size_t idxsz;
+	ix_t ix;
+	intgen_t nwritten;
+
+	if ( contextp->dc_israwdevpr || contextp->dc_idxcnt == 0 ) {
+		ds_idxfree( contextp );
+		return;
+	}
+	ASSERT( contextp->dc_codec == DS_CODEC_NONE
+		||
+		contextp->dc_idxresolved == contextp->dc_idxcnt );
+
+	/* convert the entries in place: they are not needed after this
+	 */
+	for ( ix = 0 ; ix < contextp->dc_idxcnt ; ix++ ) {
+		ds_idxent_t *entp = &contextp->dc_idxp[ ix ];
+		ds_idxent_t tmpent;
+
+		INT_SET( tmpent.ie_ino, ARCH_CONVERT, entp->ie_ino );
+		INT_SET( tmpent.ie_mark, ARCH_CONVERT, entp->ie_mark );
+		INT_SET( tmpent.ie_physoff, ARCH_CONVERT, entp->ie_physoff );
+		*entp = tmpent;
+	}
+	idxsz = contextp->dc_idxcnt * sizeof( ds_idxent_t );
+
+	memset( ( void * )&trl, 0, sizeof( trl ));
+	strncpy( trl.it_magic, DS_IDX_MAGIC, DS_IDX_MAGIC_SZ );
+	uuid_copy( trl.it_dumpid, gwhdrp->gh_dumpid );
+	INT_SET( trl.it_off, ARCH_CONVERT, contextp->dc_physoff );
+	INT_SET( trl.it_cnt, ARCH_CONVERT, ( u_int32_t )contextp->dc_idxcnt );
+	INT_SET( trl.it_sum,
+		 ARCH_CONVERT,
+		 ds_sum( ( char * )contextp->dc_idxp, idxsz ));
+	INT_SET( trl.it_hdrsum,
+		 ARCH_CONVERT,
+		 ds_sum( ( char * )&trl,
+			 offsetofmember( ds_idxtrl_t, it_hdrsum )));
+
+	mlog( MLOG_DEBUG | MLOG_DRIVE,
+	      "writing index of %u file headers at offset %lld\n",
+	      contextp->dc_idxcnt,
+	      contextp->dc_physoff );
+
+	nwritten = write( contextp->dc_fd, &trl, sizeof( trl ));
+	if ( nwritten == ( intgen_t )sizeof( trl )) {
+		contextp->dc_physoff += ( off64_t )nwritten;
+		nwritten = write( contextp->dc_fd, contextp->dc_idxp, idxsz );
+	}
+	if ( nwritten == ( intgen_t )idxsz ) {
+		contextp->dc_physoff += ( off64_t )nwritten;
+		nwritten = write( contextp->dc_fd, &trl, sizeof( trl ));
+		if ( nwritten == ( intgen_t )sizeof( trl )) {
+			contextp->dc_physoff += ( off64_t )nwritten;
+			ds_idxfree( contextp );
+			return;
+		}
+	}
+	if ( nwritten < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("unable to write media file index to %s: %s\n"),
+		      drivep->d_pathname,
+		      strerror( errno ));
+	} else {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("unable to write media file index to %s\n"),
+		      drivep->d_pathname );
+	}
+
+	ds_idxfree( contextp );
+}
+
+/* ds_idxget - if the media file is a regular file ending with an index
+ * of this dump, loads the index. not done through rmt.
+ */
+static void
+ds_idxget( drive_t *drivep )
+{
+	drive_context_t *contextp = ( drive_context_t * )drivep->d_contextp;
+	global_hdr_t *grhdrp = drivep->d_greadhdrp;
+	struct stat64 statbuf;
+	ds_idxtrl_t trl;
+	ds_idxent_t *idxp;
+	off64_t idxoff;
+	size_t idxcnt;
+	size_t idxsz;
+	ix_t ix;
+	intgen_t nread;
+
+	ds_idxfree( contextp );
+
+	if ( contextp->dc_isrmtpr ) {
+		return;
+	}
+	if ( fstat64( contextp->dc_fd, &statbuf )
+	     ||
+	     ! S_ISREG( statbuf.st_mode )
+	     ||
+	     statbuf.st_size < ( off64_t )( GLOBAL_HDR_SZ + sizeof( trl ))) {
+		return;
+	}
+
+	nread = pread64( contextp->dc_fd,
+			 &trl,
+			 sizeof( trl ),
+			 statbuf.st_size - ( off64_t )sizeof( trl ));
+	if ( nread != ( intgen_t )sizeof( trl )
+	     ||
+	     strncmp( trl.it_magic, DS_IDX_MAGIC, DS_IDX_MAGIC_SZ )
+	     ||
+	     INT_GET( trl.it_hdrsum, ARCH_CONVERT )
+	     !=
+	     ds_sum( ( char * )&trl,
+		     offsetofmember( ds_idxtrl_t, it_hdrsum ))
+	     ||
+	     uuid_compare( trl.it_dumpid, grhdrp->gh_dumpid )) {
+		mlog( MLOG_DEBUG | MLOG_DRIVE,
+		      "media file is not indexed\n" );
+		return;
+	}
+
+	idxoff = INT_GET( trl.it_off, ARCH_CONVERT );
+	idxcnt = ( size_t )INT_GET( trl.it_cnt, ARCH_CONVERT );
+	idxsz = idxcnt * sizeof( ds_idxent_t );
+	if ( idxcnt == 0
+	     ||
+	     idxoff < ( off64_t )GLOBAL_HDR_SZ
+	     ||
+	     idxoff + ( off64_t )( idxsz + 2 * sizeof( trl ))
+	     !=
+	     statbuf.st_size ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("media file index is malformed: not used\n") );
+		return;
+	}
+
+	idxp = ( ds_idxent_t * )malloc( idxsz );
+	if ( ! idxp ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("no memory for media file index of %u entries: "
+		      "not used\n"),
+		      idxcnt );
+		return;
+	}
+	nread = pread64( contextp->dc_fd,
+			 idxp,
+			 idxsz,
+			 idxoff + ( off64_t )sizeof( trl ));
+	if ( nread != ( intgen_t )idxsz
+	     ||
+	     INT_GET( trl.it_sum, ARCH_CONVERT )
+	     !=
+	     ds_sum( ( char * )idxp, idxsz )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_DRIVE,
+		      _("media file index is corrupt: not used\n") );
+		free( ( void * )idxp );
+		return;
+	}
+
+	for ( ix = 0 ; ix < idxcnt ; ix++ ) {
+		ds_idxent_t *entp = &idxp[ ix ];
+
+		entp->ie_ino = INT_GET( entp->ie_ino, ARCH_CONVERT );
+		entp->ie_mark = INT_GET( entp->ie_mark, ARCH_CONVERT );
+		entp->ie_physoff = INT_GET( entp->ie_physoff, ARCH_CONVERT );
+	}
+
+	contextp->dc_idxp = idxp;
+	contextp->dc_idxcnt = idxcnt;
+
+	mlog( MLOG_DEBUG | MLOG_DRIVE,
+	      "media file index has %u entries\n",
+	      idxcnt );
+}
+
+/* ds_idxfree - discards the index
+ */
+static void
+ds_idxfree( drive_context_t *contextp )
+{
+	if ( contextp->dc_idxp ) {
+		free( ( void * )contextp->dc_idxp );
+	}
+	contextp->dc_idxp = 0;
+	contextp->dc_idxcnt = 0;
+	contextp->dc_idxsz = 0;
+	contextp->dc_idxresolved = 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+
+#include <string.h>
+
+#include "types.h"
+#include "fprint.h"
+
+
+/* structure definitions used locally ****************************************/
+
+#define FPRINT_BLKSZ	64
+	/* SHA-256 consumes its input in blocks of this many bytes
+	 */
+
+#define FPRINT_ROTR( x, r )	( ( ( x ) >> ( r )) | ( ( x ) << ( 32 - ( r ))))
+
+static u_int32_t fprint_k[ 64 ] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static u_int32_t fprint_h0[ 8 ] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static void fprint_blk( u_int32_t h[ 8 ], u_char_t *p );
+
+
+/* definition of locally defined global functions ****************************/
+
+void
+fprint_calc( char *bufp, size_t sz, u_int64_t fp[ FPRINT_WORDS ] )
+{
+	u_int32_t h[ 8 ];
+	u_char_t tail[ 2 * FPRINT_BLKSZ ];
+	size_t nblks = sz / FPRINT_BLKSZ;
+	size_t tailsz = sz % FPRINT_BLKSZ;
+	size_t padsz;
+	u_int64_t bitcnt;
+	size_t ix;
+
+	memcpy( ( void * )h, ( void * )fprint_h0, sizeof( h ));
+	for ( ix = 0 ; ix < nblks ; ix++ ) {
+		fprint_blk( h, ( u_char_t * )bufp + ix * FPRINT_BLKSZ );
+	}
+
+	/* pad the rest with a one bit, zeros and the length in bits, to
+	 * one or two more blocks
+	 */
+	padsz = tailsz < FPRINT_BLKSZ - 8 ? FPRINT_BLKSZ : 2 * FPRINT_BLKSZ;
+	memset( ( void * )tail, 0, padsz );
+	memcpy( ( void * )tail,
+		( void * )( bufp + nblks * FPRINT_BLKSZ ),
+		tailsz );
+	tail[ tailsz ] = 0x80;
+	bitcnt = ( u_int64_t )sz << 3;
+	for ( ix = 0 ; ix < 8 ; ix++ ) {
+		tail[ padsz - 1 - ix ] = ( u_char_t )( bitcnt >> ( 8 * ix ));
+	}
+	for ( ix = 0 ; ix < padsz ; ix += FPRINT_BLKSZ ) {
+		fprint_blk( h, tail + ix );
+	}
+
+	/* the digest is big-endian; pack it into the words the same way,
+	 * so a fingerprint means the same on every host
+	 */
+	for ( ix = 0 ; ix < FPRINT_WORDS ; ix++ ) {
+		fp[ ix ] = ( ( u_int64_t )h[ 2 * ix ] << 32 ) | h[ 2 * ix + 1 ];
+	}
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+static void
+fprint_blk( u_int32_t h[ 8 ], u_char_t *p )
+{
+	u_int32_t w[ 64 ];
+	u_int32_t a, b, c, d, e, f, g, hh;
+	u_int32_t t1, t2;
+	size_t ix;
+
+	for ( ix = 0 ; ix < 16 ; ix++ ) {
+		w[ ix ] = ( ( u_int32_t )p[ 4 * ix ] << 24 )
+			  |
+			  ( ( u_int32_t )p[ 4 * ix + 1 ] << 16 )
+			  |
+			  ( ( u_int32_t )p[ 4 * ix + 2 ] << 8 )
+			  |
+			  ( u_int32_t )p[ 4 * ix + 3 ];
+	}
+	for ( ix = 16 ; ix < 64 ; ix++ ) {
+		u_int32_t s0;
+		u_int32_t s1;
+
+		s0 = FPRINT_ROTR( w[ ix - 15 ], 7 )
+		     ^
+		     FPRINT_ROTR( w[ ix - 15 ], 18 )
+		     ^
+		     ( w[ ix - 15 ] >> 3 );
+		s1 = FPRINT_ROTR( w[ ix - 2 ], 17 )
+		     ^
+		     FPRINT_ROTR( w[ ix - 2 ], 19 )
+		     ^
+		     ( w[ ix - 2 ] >> 10 );
+		w[ ix ] = w[ ix - 16 ] + s0 + w[ ix - 7 ] + s1;
+	}
+
+	a = h[ 0 ];
+	b = h[ 1 ];
+	c = h[ 2 ];
+	d = h[ 3 ];
+	e = h[ 4 ];
+	f = h[ 5 ];
+	g = h[ 6 ];
+	hh = h[ 7 ];
+	for ( ix = 0 ; ix < 64 ; ix++ ) {
+		t1 = hh
+		     +
+		     ( FPRINT_ROTR( e, 6 )
+		       ^
+		       FPRINT_ROTR( e, 11 )
+		       ^
+		       FPRINT_ROTR( e, 25 ))
+		     +
+		     ( ( e & f ) ^ ( ~e & g ))
+		     +
+		     fprint_k[ ix ]
+		     +
+		     w[ ix ];
+		t2 = ( FPRINT_ROTR( a, 2 )
+		       ^
+		       FPRINT_ROTR( a, 13 )
+		       ^
+		       FPRINT_ROTR( a, 22 ))
+		     +
+		     ( ( a & b ) ^ ( a & c ) ^ ( b & c ));
+		hh = g;
+		g = f;
+		f = e;
+		e = d + t1;
+		d = c;
+		c = b;
+		b = a;
+		a = t1 + t2;
+	}
+	h[ 0 ] += a;
+	h[ 1 ] += b;
+	h[ 2 ] += c;
+	h[ 3 ] += d;
+	h[ 4 ] += e;
+	h[ 5 ] += f;
+	h[ 6 ] += g;
+	h[ 7 ] += hh;
+}
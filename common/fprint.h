@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef FPRINT_H
+#define FPRINT_H
+
+/* fprint.[hc] - content fingerprints for deduplicated file data
+ *
+ * the SHA-256 digest of the data. xfsdump dumps a chunk as a reference
+ * to another on the strength of their fingerprints alone, so these must
+ * not collide even for file contents chosen to make them collide.
+ *
+ * the digest is packed into the words big-endian whatever the host, so a
+ * fingerprint computed by xfsdump may be checked by xfsrestore on
+ * another architecture.
+ */
+
+#define FPRINT_WORDS	4
+
+/* fprint_calc - fingerprints the sz bytes at bufp into fp
+ */
+extern void fprint_calc( char *bufp, size_t sz, u_int64_t fp[ FPRINT_WORDS ] );
+
+#endif /* FPRINT_H */
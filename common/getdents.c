@@ -103,6 +103,11 @@ struct kernel_dirent64
 #ifndef DIRENT_SET_DP_INO
 # define DIRENT_SET_DP_INO(dp, value) (dp)->d_ino = (value)
 #endif
+#ifndef __GETDENTS
+# define GETDENTS_FN getdents_wrap
+#else
+# define GETDENTS_FN __GETDENTS
+#endif
 
 /* The problem here is that we cannot simply read the next NBYTES
    bytes.  We need to take the additional field into account.  We use
@@ -113,7 +118,7 @@ struct kernel_dirent64
    reset the file descriptor.  In practice the kernel is limiting the
    amount of data returned much more then the reduced buffer size.  */
 int
-getdents_wrap (int fd, char *buf, size_t nbytes)
+GETDENTS_FN (int fd, char *buf, size_t nbytes)
 {
   DIRENT_TYPE *dp;
   off64_t last_offset = -1;
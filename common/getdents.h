@@ -20,4 +20,9 @@
 
 int getdents_wrap (int fd, char *buf, size_t nbytes);
 
+/* fills buf with struct dirent64 records, so inode numbers above 32 bits
+ * are returned intact on every platform and compilation mode
+ */
+int getdents64_wrap (int fd, char *buf, size_t nbytes);
+
 #endif /* GETDENTS_H */
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* getdents64_wrap - like getdents_wrap, but returns struct dirent64
+ * records, whose d_ino is 64 bits regardless of how the program was
+ * compiled. built from the same source, the way the GNU C Library
+ * builds getdents64 from getdents.
+ */
+
+#ifndef _LARGEFILE64_SOURCE
+#define _LARGEFILE64_SOURCE
+#endif
+#include <dirent.h>
+
+#define __GETDENTS getdents64_wrap
+#define DIRENT_TYPE struct dirent64
+
+#include "getdents.c"
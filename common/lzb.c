@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+
+#include <string.h>
+
+#include "types.h"
+#include "lzb.h"
+
+
+/* structure definitions used locally ****************************************/
+
+#define LZB_HASHLOG	14
+	/* log2 of the number of hash table entries. must agree with
+	 * LZB_TABSZ
+	 */
+
+#define LZB_MINMATCH	4
+#define LZB_MAXOFF	0xffff
+
+#define LZB_LASTLITERALS	5
+#define LZB_MFLIMIT		12
+	/* the format requires the last five bytes of a block to be
+	 * literals, and no match to begin in the last twelve
+	 */
+
+#define LZB_RUNMASK	0xf
+	/* a length nibble of this value is continued in following bytes
+	 */
+
+#define LZB_SKIPSHIFT	6
+	/* after every 64 bytes without a match, look at one byte in two,
+	 * then one in three, ... so incompressible data costs little
+	 */
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static u_int32_t lzb_read32( char *p );
+static u_int32_t lzb_hash( u_int32_t v );
+static char *lzb_putlen( char *op, size_t len );
+static bool_t lzb_emit( char **opp,
+			char *oend,
+			char *litp,
+			size_t litlen,
+			size_t off,
+			size_t mlen );
+
+
+/* definition of locally defined global functions ****************************/
+
+size_t
+lzb_compress( char *srcp,
+	      size_t srclen,
+	      char *dstp,
+	      size_t dstsz,
+	      void *tabp )
+{
+	u_int32_t *tabv = ( u_int32_t * )tabp;
+	char *op = dstp;
+	char *oend = dstp + dstsz;
+	size_t anchor = 0;
+	size_t ip;
+
+	memset( tabp, 0, LZB_TABSZ );
+
+	/* table entries are offsets into srcp. an empty entry reads as
+	 * offset zero, which is always verified before use.
+	 */
+	if ( srclen > LZB_MFLIMIT ) {
+		size_t limit = srclen - LZB_MFLIMIT;
+		size_t matchlimit = srclen - LZB_LASTLITERALS;
+
+		ip = 1;
+		while ( ip <= limit ) {
+			u_int32_t seq = lzb_read32( srcp + ip );
+			u_int32_t h = lzb_hash( seq );
+			size_t ref = ( size_t )tabv[ h ];
+			size_t mlen;
+
+			tabv[ h ] = ( u_int32_t )ip;
+			if ( ref >= ip
+			     ||
+			     ip - ref > LZB_MAXOFF
+			     ||
+			     lzb_read32( srcp + ref ) != seq ) {
+				ip += 1 + ( ( ip - anchor ) >> LZB_SKIPSHIFT );
+				continue;
+			}
+
+			/* extend the match backward over pending literals,
+			 * then forward
+			 */
+			while ( ip > anchor
+				&&
+				ref > 0
+				&&
+				srcp[ ip - 1 ] == srcp[ ref - 1 ] ) {
+				ip--;
+				ref--;
+			}
+			mlen = LZB_MINMATCH;
+			while ( ip + mlen < matchlimit
+				&&
+				srcp[ ref + mlen ] == srcp[ ip + mlen ] ) {
+				mlen++;
+			}
+
+			if ( ! lzb_emit( &op,
+					 oend,
+					 srcp + anchor,
+					 ip - anchor,
+					 ip - ref,
+					 mlen )) {
+				return 0;
+			}
+			ip += mlen;
+			anchor = ip;
+
+			/* index a position inside the match, which often
+			 * begins the next one
+			 */
+			tabv[ lzb_hash( lzb_read32( srcp + ip - 2 )) ] =
+							( u_int32_t )( ip - 2 );
+		}
+	}
+
+	if ( ! lzb_emit( &op, oend, srcp + anchor, srclen - anchor, 0, 0 )) {
+		return 0;
+	}
+
+	return ( size_t )( op - dstp );
+}
+
+intgen_t
+lzb_decompress( char *srcp, size_t srclen, char *dstp, size_t dstsz )
+{
+	u_char_t *ip = ( u_char_t * )srcp;
+	u_char_t *iend = ip + srclen;
+	char *op = dstp;
+	char *oend = dstp + dstsz;
+
+	while ( ip < iend ) {
+		u_char_t token = *ip++;
+		size_t litlen = ( size_t )( token >> 4 );
+		size_t mlen = ( size_t )( token & LZB_RUNMASK );
+		size_t off;
+
+		if ( litlen == LZB_RUNMASK ) {
+			u_char_t c;
+			do {
+				if ( ip >= iend ) {
+					return -1;
+				}
+				c = *ip++;
+				litlen += ( size_t )c;
+			} while ( c == 0xff );
+		}
+		if ( litlen > ( size_t )( iend - ip )
+		     ||
+		     litlen > ( size_t )( oend - op )) {
+			return -1;
+		}
+		memcpy( ( void * )op, ( void * )ip, litlen );
+		ip += litlen;
+		op += litlen;
+
+		/* the last sequence has no match
+		 */
+		if ( ip == iend ) {
+			break;
+		}
+
+		if ( iend - ip < 2 ) {
+			return -1;
+		}
+		off = ( size_t )ip[ 0 ] | ( ( size_t )ip[ 1 ] << 8 );
+		ip += 2;
+		if ( off == 0 || off > ( size_t )( op - dstp )) {
+			return -1;
+		}
+
+		if ( mlen == LZB_RUNMASK ) {
+			u_char_t c;
+			do {
+				if ( ip >= iend ) {
+					return -1;
+				}
+				c = *ip++;
+				mlen += ( size_t )c;
+			} while ( c == 0xff );
+		}
+		mlen += LZB_MINMATCH;
+		if ( mlen > ( size_t )( oend - op )) {
+			return -1;
+		}
+
+		/* a match may overlap its own output, repeating a short
+		 * pattern
+		 */
+		if ( off >= mlen ) {
+			memcpy( ( void * )op, ( void * )( op - off ), mlen );
+			op += mlen;
+		} else {
+			char *refp = op - off;
+			while ( mlen-- ) {
+				*op++ = *refp++;
+			}
+		}
+	}
+
+	return ( intgen_t )( op - dstp );
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+static u_int32_t
+lzb_read32( char *p )
+{
+	u_int32_t v;
+
+	memcpy( ( void * )&v, ( void * )p, sizeof( v ));
+	return v;
+}
+
+static u_int32_t
+lzb_hash( u_int32_t v )
+{
+	return ( v * 2654435761U ) >> ( 32 - LZB_HASHLOG );
+}
+
+/* writes the continuation bytes of a length whose nibble was saturated
+ */
+static char *
+lzb_putlen( char *op, size_t len )
+{
+	len -= LZB_RUNMASK;
+	while ( len >= 0xff ) {
+		*op++ = ( char )0xff;
+		len -= 0xff;
+	}
+	*op++ = ( char )len;
+	return op;
+}
+
+/* appends a sequence: litlen literals from litp followed by a match of
+ * mlen bytes off bytes back. mlen zero means the final, literal-only
+ * sequence. returns FALSE if the sequence would not fit.
+ */
+static bool_t
+lzb_emit( char **opp,
+	  char *oend,
+	  char *litp,
+	  size_t litlen,
+	  size_t off,
+	  size_t mlen )
+{
+	char *op = *opp;
+	char *tokenp;
+	size_t worst;
+
+	worst = 1 + litlen / 0xff + 1 + litlen + 2 + mlen / 0xff + 1;
+	if ( worst > ( size_t )( oend - op )) {
+		return BOOL_FALSE;
+	}
+
+	tokenp = op++;
+	if ( litlen >= LZB_RUNMASK ) {
+		*tokenp = ( char )( LZB_RUNMASK << 4 );
+		op = lzb_putlen( op, litlen );
+	} else {
+		*tokenp = ( char )( litlen << 4 );
+	}
+	memcpy( ( void * )op, ( void * )litp, litlen );
+	op += litlen;
+
+	if ( mlen ) {
+		size_t mcode = mlen - LZB_MINMATCH;
+
+		*op++ = ( char )( off & 0xff );
+		*op++ = ( char )( off >> 8 );
+		if ( mcode >= LZB_RUNMASK ) {
+			*tokenp |= ( char )LZB_RUNMASK;
+			op = lzb_putlen( op, mcode );
+		} else {
+			*tokenp |= ( char )mcode;
+		}
+	}
+
+	*opp = op;
+	return BOOL_TRUE;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef LZB_H
+#define LZB_H
+
+/* lzb.[hc] - block compression for the dump stream
+ *
+ * a small LZ77 coder which reads and writes the LZ4 block format: a
+ * series of sequences, each a token byte, a run of literals and a
+ * back-reference of at least four bytes at most 64K back, the last
+ * sequence being literals only. it is greedy, with a single-entry hash
+ * table, trading ratio for speed so as to keep ahead of the drive.
+ *
+ * each call is independent: a block carries no state from the previous
+ * one, so blocks may be compressed in any order and any block may be
+ * decoded without the others.
+ */
+
+#define LZB_TABSZ	( ( 1 << 14 ) * sizeof( u_int32_t ))
+	/* size of the scratch table the caller supplies to lzb_compress( )
+	 */
+
+/* lzb_compress - compresses srclen bytes at srcp into the dstsz bytes at
+ * dstp, using the LZB_TABSZ bytes at tabp as scratch. returns the
+ * compressed length, or zero if the result would not fit.
+ */
+extern size_t lzb_compress( char *srcp,
+			    size_t srclen,
+			    char *dstp,
+			    size_t dstsz,
+			    void *tabp );
+
+/* lzb_decompress - decompresses the srclen bytes at srcp into the dstsz
+ * bytes at dstp. returns the decompressed length, or -1 if the input is
+ * malformed or would overrun dstp. never reads or writes out of bounds.
+ */
+extern intgen_t lzb_decompress( char *srcp,
+				size_t srclen,
+				char *dstp,
+				size_t dstsz );
+
+#endif /* LZB_H */
@@ -48,6 +48,7 @@
 #include "media.h"
 #include "content.h"
 #include "inventory.h"
+#include "perfstat.h"
 
 #ifdef DUMP
 /* main.c - main for dump
@@ -69,6 +70,7 @@
 #define ABORT_TIMEOUT	10	/* seconds after abort req. before abort */
 #define MINSTACKSZ	0x02000000
 #define MAXSTACKSZ	0x08000000
+#define PROGRECSZ	16384	/* largest progress record */
 
 
 /* declarations of externally defined global symbols *************************/
@@ -92,6 +94,9 @@ static void mrh_sighandler( int );
 #endif
 static void sighandler( int );
 static int childmain( void * );
+static bool_t progrec_init( void );
+static void progrec_write( void );
+static void progrec_put( char *recp, size_t reclen );
 static bool_t sigint_dialog( void );
 static char *sigintstr( void );
 #ifdef DUMP
@@ -147,6 +152,10 @@ static intgen_t sigstray_received;
 static bool_t progrpt_enabledpr;
 static time32_t progrpt_interval;
 static time32_t progrpt_deadline;
+static char *progrec_path;
+static intgen_t progrec_fd = -1;
+static bool_t progrec_openedpr;
+static qlockh_t progrec_qlockh;
 
 
 /* definition of locally defined global functions ****************************/
@@ -299,6 +308,16 @@ main( int argc, char *argv[] )
 				progrpt_enabledpr = BOOL_FALSE;
 			}
 			break;
+		case GETOPT_PROGRESSFILE:
+			if ( ! optarg || optarg[ 0 ] == '-' ) {
+				mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_NOLOCK,
+				      _("-%c argument missing\n"),
+				      c );
+				usage( );
+				return mlog_exit(EXIT_ERROR, RV_OPT);
+			}
+			progrec_path = optarg;
+			break;
 		}
 	}
 
@@ -377,6 +396,15 @@ main( int argc, char *argv[] )
 	lock_init( );
 	rmt_turnonmsgs(1); /* turn on WARNING msgs for librmt */
 
+	/* open the progress record file, if one was specified
+	 */
+	if ( progrec_path && ! infoonly ) {
+		ok = progrec_init( );
+		if ( ! ok ) {
+			return mlog_exit(EXIT_ERROR, RV_INIT);
+		}
+	}
+
 	mlog( MLOG_NITTY + 1, "INTGENMAX == %ld (0x%lx)\n", INTGENMAX, INTGENMAX );
 	mlog( MLOG_NITTY + 1, "UINTGENMAX == %lu (0x%lx)\n", UINTGENMAX, UINTGENMAX );
 	mlog( MLOG_NITTY + 1, "OFF64MAX == %lld (0x%llx)\n", OFF64MAX, OFF64MAX );
@@ -619,6 +647,10 @@ main( int argc, char *argv[] )
 #ifdef RESTORE
 		exitcode = content_stream_restore( 0 );
 #endif /* RESTORE */
+		/* write the final progress record first: content_complete( )
+		 * may discard the restore's persistent state it reads
+		 */
+		progrec_write( );
 		if ( exitcode != EXIT_NORMAL ) {
 			( void )content_complete( );
 						/* for cleanup side-effect */
@@ -878,6 +910,8 @@ main( int argc, char *argv[] )
 					mlog( MLOG_NORMAL,
 					      statline[ i ] );
 				}
+				perf_report( );
+				progrec_write( );
 			}
 			( void )alarm( ( u_intgen_t )( progrpt_deadline
 						       -
@@ -922,8 +956,10 @@ main( int argc, char *argv[] )
 	}
 
 	/* determine if dump or restore was interrupted
-	 * or an initialization error occurred.
+	 * or an initialization error occurred. write the final progress
+	 * record before content_complete( ), as above.
 	 */
+	progrec_write( );
 	if ( init_error ) {
 		( void )content_complete( );
 		exitcode = EXIT_ERROR;
@@ -974,7 +1010,10 @@ usage( void )
 	ULO(_("<dump media file size> "),		GETOPT_FILESZ );
 	ULO(_("(allow files to be excluded)"),		GETOPT_EXCLUDEFILES );
 	ULO(_("<destination> ..."),			GETOPT_DUMPDEST );
+	ULO(_("(omit unchanged data of changed files)"),	GETOPT_METAONLY );
 	ULO(_("(help)"),				GETOPT_HELP );
+	ULO(_("<rmt commands in flight>"),		GETOPT_RMTWINDOW );
+	ULO(_("(report I/O stall times)"),		GETOPT_PERFSTAT );
 	ULO(_("<level>"),				GETOPT_LEVEL );
 	ULO(_("(force usage of minimal rmt)"),		GETOPT_MINRMT );
 	ULO(_("(overwrite tape)"),			GETOPT_OVERWRITE );
@@ -982,7 +1021,9 @@ usage( void )
 	ULO(_("<use QIC tape settings>"),		GETOPT_QIC );
 	ULO(_("<subtree> ..."),				GETOPT_SUBTREE );
 	ULO(_("<file> (use file mtime for dump time"),	GETOPT_DUMPTIME );
+	ULO(_("(dump repeated file data as references)"),	GETOPT_DEDUP );
 	ULO(_("<verbosity {silent, verbose, trace}>"),	GETOPT_VERBOSITY );
+	ULO(_("<compression threads>"),			GETOPT_COMPRESS );
 	ULO(_("<maximum file size>"),			GETOPT_MAXDUMPFILESIZE );
 	ULO(_("(don't dump extended file attributes)"),	GETOPT_NOEXTATTR );
 #ifdef BASED
@@ -991,6 +1032,7 @@ usage( void )
 #ifdef REVEAL
 	ULO(_("(generate tape record checksums)"),	GETOPT_RECCHKSUM );
 #endif /* REVEAL */
+	ULO(_("(omit unchanged directory entries)"),	GETOPT_DIRREF );
 	ULO(_("(pre-erase media)"),			GETOPT_ERASE );
 	ULO(_("(don't prompt)"),			GETOPT_FORCE );
 #ifdef REVEAL
@@ -999,6 +1041,7 @@ usage( void )
 #endif /* REVEAL */
 	ULO(_("(display dump inventory)"),		GETOPT_INVPRINT );
 	ULO(_("(inhibit inventory update)"),		GETOPT_NOINVUPDATE );
+	ULO(_("<progress record file or fd>"),		GETOPT_PROGRESSFILE );
 	ULO(_("<session label>"),			GETOPT_DUMPLABEL );
 	ULO(_("<media label> ..."),			GETOPT_MEDIALABEL );
 #ifdef REVEAL
@@ -1008,6 +1051,7 @@ usage( void )
 #ifdef REVEAL
 	ULO(_("(pin down I/O buffers)"),		GETOPT_RINGPIN );
 #endif /* REVEAL */
+	ULO(_("<ranges per stream>"),			GETOPT_DYNPART );
 	ULO(_("(resume)"),				GETOPT_RESUME );
 	ULO(_("(don't timeout dialogs)"),		GETOPT_NOTIMEOUTS );
 #ifdef REVEAL
@@ -1015,6 +1059,7 @@ usage( void )
 	ULO(_("(show subsystem in messages)"),		GETOPT_SHOWLOGSS );
 	ULO(_("(show verbosity in messages)"),		GETOPT_SHOWLOGLEVEL );
 #endif /* REVEAL */
+	ULO(_("(keep directory tree cache)"),		GETOPT_TREECACHE );
 	ULO(_("<I/O buffer ring length>"),		GETOPT_RINGLEN );
 #ifdef REVEAL
 	ULO(_("(miniroot restrictions)"),		GETOPT_MINIROOT );
@@ -1030,6 +1075,8 @@ usage( void )
 	ULO(_("<source> ..."),				GETOPT_DUMPDEST );
 	ULO(_("(help)"),				GETOPT_HELP );
 	ULO(_("(interactive)"),				GETOPT_INTERACTIVE );
+	ULO(_("<rmt commands in flight>"),		GETOPT_RMTWINDOW );
+	ULO(_("(contents from directories only)"),	GETOPT_TOCDIRS );
 	ULO(_("(force usage of minimal rmt)"),		GETOPT_MINRMT );
 	ULO(_("<file> (restore only if newer than)"),	GETOPT_NEWER );
 	ULO(_("(restore owner/group even if not root)"),GETOPT_OWNER );
@@ -1038,6 +1085,7 @@ usage( void )
 	ULO(_("(cumulative restore)"),			GETOPT_CUMULATIVE );
 	ULO(_("<subtree> ..."),				GETOPT_SUBTREE );
 	ULO(_("(contents only)"),			GETOPT_TOC );
+	ULO(_("(accept holes in part of a -u dump)"),	GETOPT_REFHOLES );
 	ULO(_("<verbosity {silent, verbose, trace}>"),	GETOPT_VERBOSITY );
 	ULO(_("(use small tree window)"),		GETOPT_SMALLWINDOW );
 	ULO(_("(don't restore extended file attributes)"),GETOPT_NOEXTATTR );
@@ -1050,6 +1098,7 @@ usage( void )
 	ULO(_("(don't prompt)"),			GETOPT_FORCE );
 	ULO(_("(display dump inventory)"),		GETOPT_INVPRINT );
 	ULO(_("(inhibit inventory update)"),		GETOPT_NOINVUPDATE );
+	ULO(_("<progress record file or fd>"),		GETOPT_PROGRESSFILE );
 	ULO(_("<session label>"),			GETOPT_DUMPLABEL );
 #ifdef REVEAL
 	ULO(_("(timestamp messages)"),			GETOPT_TIMESTAMP );
@@ -1110,6 +1159,8 @@ preemptchk( int flg )
 				mlog( MLOG_NORMAL,
 				      statline[ i ] );
 			}
+			perf_report( );
+			progrec_write( );
 		}
 	}
 
@@ -1665,6 +1716,88 @@ sighandler( int signo )
 	exit( 0 );
 }
 
+/* progress record file: the -K argument is either the number of an
+ * already-open file descriptor (e.g. one inherited from a scheduler) or
+ * the pathname of a file to append records to.
+ */
+static bool_t
+progrec_init( void )
+{
+	if ( strspn( progrec_path, "0123456789" ) == strlen( progrec_path )) {
+		progrec_fd = atoi( progrec_path );
+		if ( fcntl( progrec_fd, F_GETFL ) < 0 ) {
+			mlog( MLOG_NORMAL | MLOG_ERROR, _(
+			      "progress record fd %d not open: %s\n"),
+			      progrec_fd,
+			      strerror( errno ));
+			progrec_fd = -1;
+			return BOOL_FALSE;
+		}
+	} else {
+		progrec_fd = open( progrec_path,
+				   O_WRONLY | O_CREAT | O_APPEND,
+				   S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+		if ( progrec_fd < 0 ) {
+			mlog( MLOG_NORMAL | MLOG_ERROR, _(
+			      "unable to open progress record file %s: %s\n"),
+			      progrec_path,
+			      strerror( errno ));
+			return BOOL_FALSE;
+		}
+		progrec_openedpr = BOOL_TRUE;
+	}
+
+	progrec_qlockh = qlock_alloc( QLOCK_ORD_PROGREC );
+	ASSERT( progrec_qlockh );
+
+	return BOOL_TRUE;
+}
+
+/* write a progress record, plus the I/O stall accounting line if
+ * enabled (-k). each record is a single line, written with one write( )
+ * so concurrent readers of a pipe see whole lines.
+ */
+static void
+progrec_write( void )
+{
+	static char recbuf[ PROGRECSZ ];
+	size_t reclen;
+
+	if ( progrec_fd < 0 ) {
+		return;
+	}
+
+	qlock_lock( progrec_qlockh );
+	reclen = content_statrec( recbuf, sizeof( recbuf ));
+	if ( reclen ) {
+		progrec_put( recbuf, reclen );
+	}
+	if ( perf_enabled( ) && progrec_fd >= 0 ) {
+		reclen = perf_statline( recbuf, sizeof( recbuf ) - 1 );
+		recbuf[ reclen++ ] = '\n';
+		progrec_put( recbuf, reclen );
+	}
+	qlock_unlock( progrec_qlockh );
+}
+
+static void
+progrec_put( char *recp, size_t reclen )
+{
+	ssize_t nwritten;
+
+	nwritten = write( progrec_fd, recp, reclen );
+	if ( nwritten != ( ssize_t )reclen ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "write to progress record file failed: %s: "
+		      "no further progress records will be written\n"),
+		      nwritten < 0 ? strerror( errno ) : _("short write") );
+		if ( progrec_openedpr ) {
+			close( progrec_fd );
+		}
+		progrec_fd = -1;
+	}
+}
+
 static int
 childmain( void *arg1 )
 {
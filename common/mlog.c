@@ -25,6 +25,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
+#include <signal.h>
 #include <getopt.h>
 
 #include "types.h"
@@ -61,8 +62,6 @@ static intgen_t mlog_sym_lookup( char * );
 
 static size_t mlog_streamcnt;
 
-static char mlog_levelstr[ 3 ]; 
-
 #define MLOG_SS_NAME_MAX	15
 #ifdef DUMP
 #define PROGSTR "dump"
@@ -73,9 +72,9 @@ static char mlog_levelstr[ 3 ];
 #endif /* DUMP */
 #define N(a) (sizeof((a)) / sizeof((a)[0]))
 
-static char mlog_ssstr[ MLOG_SS_NAME_MAX + 2 ];
-
-static char mlog_tsstr[ 10 ];
+#define MLOG_PREAMBLESZ	( 64 + MLOG_SS_NAME_MAX )
+#define MLOG_TBUFSZ	8192	/* per-stream debug message buffer */
+#define MLOG_TBUF_AGE	1	/* max seconds a message stays buffered */
 
 struct mlog_sym {
 	char *sym;
@@ -84,6 +83,17 @@ struct mlog_sym {
 
 typedef struct mlog_sym mlog_sym_t;
 
+/* debug message buffer. each is written only by the stream owning it,
+ * so messages can be formatted into it without the mlog lock.
+ */
+struct mlog_tbuf {
+	size_t tb_len;
+	time_t tb_first;	/* when the oldest buffered message was put */
+	char tb_buf[ MLOG_TBUFSZ ];
+};
+
+typedef struct mlog_tbuf mlog_tbuf_t;
+
 char *mlog_ss_names[ MLOG_SS_CNT ] = {
 	"general",	/* MLOG_SS_GEN */
 	"proc",		/* MLOG_SS_PROC */
@@ -113,6 +123,23 @@ static mlog_sym_t mlog_sym[ ] = {
 	{"nitty",	MLOG_NITTY}
 };
 
+/* one buffer per stream, plus one (index 0) for the main thread
+ */
+static mlog_tbuf_t mlog_tbuf[ STREAM_SIMMAX + 1 ];
+
+static mlog_tbuf_t *mlog_tbuf_get( intgen_t streamix );
+static bool_t mlog_tbuf_put( mlog_tbuf_t *tbp,
+			     intgen_t levelarg,
+			     intgen_t streamix,
+			     char *fmt,
+			     va_list args );
+static void mlog_tbuf_flush( mlog_tbuf_t *tbp, bool_t lockpr );
+static void mlog_fatal( int signo );
+static size_t mlog_preamble( char *buf,
+			     size_t bufsz,
+			     intgen_t levelarg,
+			     intgen_t streamix );
+
 static qlockh_t mlog_qlockh;
 static int mlog_main_exit_code = -1;
 static rv_t mlog_main_exit_return = RV_NONE;
@@ -121,6 +148,7 @@ static rv_t mlog_main_exit_hint = RV_NONE;
 void
 mlog_init0( void )
 {
+	struct sigaction sa;
 	int i;
 
 #ifdef DUMP
@@ -138,6 +166,20 @@ mlog_init0( void )
 	for( i = 0 ; i < MLOG_SS_CNT ; i++ ) {
 		mlog_level_ss[ i ] = MLOG_VERBOSE;
 	}
+
+	/* the messages just before a failed ASSERT, an abort( ) or a
+	 * crash are the ones most wanted: write out the debug message
+	 * buffers before the process dies
+	 */
+	memset( ( void * )&sa, 0, sizeof( sa ));
+	sa.sa_handler = mlog_fatal;
+	sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+	sigemptyset( &sa.sa_mask );
+	( void )sigaction( SIGABRT, &sa, 0 );
+	( void )sigaction( SIGSEGV, &sa, 0 );
+	( void )sigaction( SIGBUS, &sa, 0 );
+	( void )sigaction( SIGFPE, &sa, 0 );
+	( void )sigaction( SIGILL, &sa, 0 );
 }
 
 bool_t
@@ -278,15 +320,6 @@ mlog_init1( intgen_t argc, char *argv[ ] )
 		}
 	}
 
-	/* prepare a string for optionally displaying the log level
-	 */
-	mlog_levelstr[ 0 ] = 0;
-	mlog_levelstr[ 1 ] = 0;
-	mlog_levelstr[ 2 ] = 0;
-	if ( mlog_showlevel ) {
-		mlog_levelstr[ 0 ] = ':';
-	}
-
 #ifdef DUMP
 	/* note if dump going to stdout. if so, can't
 	 * send mlog output there. since at compile time
@@ -356,8 +389,10 @@ mlog_override_level( intgen_t levelarg )
 	}
 }
 
+/* parenthesized to bypass the level gate macro in mlog.h
+ */
 void
-mlog( intgen_t levelarg, char *fmt, ... )
+( mlog )( intgen_t levelarg, char *fmt, ... )
 {
 	va_list args;
 	va_start( args, fmt );
@@ -370,6 +405,8 @@ mlog_va( intgen_t levelarg, char *fmt, va_list args )
 {
 	intgen_t level;
 	ix_t ss;
+	intgen_t streamix;
+	mlog_tbuf_t *tbp;
 
 	level = levelarg & MLOG_LEVELMASK;
 	ss = ( ix_t )( ( levelarg & MLOG_SS_MASK ) >> MLOG_SS_SHIFT );
@@ -378,85 +415,261 @@ mlog_va( intgen_t levelarg, char *fmt, va_list args )
 	if ( level > mlog_level_ss[ ss ] ) {
 		return;
 	}
+
+	streamix = stream_getix( getpid() );
+	tbp = mlog_tbuf_get( streamix );
+
+	/* debug chatter is buffered, without taking the lock
+	 */
+	if ( tbp
+	     &&
+	     level >= MLOG_DEBUG
+	     &&
+	     ! ( levelarg & ( MLOG_NOTE | MLOG_WARNING | MLOG_ERROR
+			      | MLOG_NOLOCK ))) {
+		if ( mlog_tbuf_put( tbp, levelarg, streamix, fmt, args )) {
+			return;
+		}
+	}
 	
 	if ( ! ( levelarg & MLOG_NOLOCK )) {
 		mlog_lock( );
 	}
 
+	/* keep this stream's messages in order
+	 */
+	if ( tbp ) {
+		mlog_tbuf_flush( tbp, BOOL_FALSE );
+	}
+
 	if ( ! ( levelarg & MLOG_BARE )) {
-		intgen_t streamix;
-		streamix = stream_getix( getpid() );
+		char preamble[ MLOG_PREAMBLESZ ];
 
-		if ( mlog_showss ) {
-			sprintf( mlog_ssstr, ":%s", mlog_ss_names[ ss ] );
-		} else {
-			mlog_ssstr[ 0 ] = 0;
+		( void )mlog_preamble( preamble,
+				       sizeof( preamble ),
+				       levelarg,
+				       streamix );
+		fputs( preamble, mlog_fp );
+	}
+
+	vfprintf( mlog_fp, fmt, args );
+	fflush( mlog_fp );
+
+	if ( ! ( levelarg & MLOG_NOLOCK )) {
+		mlog_unlock( );
+	}
+}
+
+void
+mlog_flush( void )
+{
+	mlog_tbuf_t *tbp;
+
+	tbp = mlog_tbuf_get( stream_getix( getpid( )));
+	if ( tbp ) {
+		mlog_tbuf_flush( tbp, BOOL_TRUE );
+	}
+}
+
+/* returns the debug message buffer owned by the calling thread, or NULL
+ * if the caller is neither a stream nor the main thread.
+ */
+static mlog_tbuf_t *
+mlog_tbuf_get( intgen_t streamix )
+{
+	if ( streamix >= 0 ) {
+		ASSERT( streamix < STREAM_SIMMAX );
+		return &mlog_tbuf[ streamix + 1 ];
+	}
+	if ( getpid( ) == parentpid ) {
+		return &mlog_tbuf[ 0 ];
+	}
+	return 0;
+}
+
+/* formats a message into the buffer, flushing older messages to make
+ * room. returns BOOL_FALSE if the message will not fit even in an empty
+ * buffer; the caller must then log it directly.
+ */
+static bool_t
+mlog_tbuf_put( mlog_tbuf_t *tbp,
+	       intgen_t levelarg,
+	       intgen_t streamix,
+	       char *fmt,
+	       va_list args )
+{
+	time_t now;
+
+	now = time( 0 );
+	if ( tbp->tb_len && now - tbp->tb_first >= MLOG_TBUF_AGE ) {
+		mlog_tbuf_flush( tbp, BOOL_TRUE );
+	}
+
+	for ( ; ; ) {
+		char *p = tbp->tb_buf + tbp->tb_len;
+		size_t room = MLOG_TBUFSZ - tbp->tb_len;
+		size_t len = 0;
+
+		if ( ! ( levelarg & MLOG_BARE )) {
+			len = mlog_preamble( p, room, levelarg, streamix );
+		}
+		if ( len < room ) {
+			va_list cargs;
+			intgen_t rval;
+
+			va_copy( cargs, args );
+			rval = vsnprintf( p + len, room - len, fmt, cargs );
+			va_end( cargs );
+			if ( rval < 0 ) {
+				return BOOL_FALSE;
+			}
+			len += ( size_t )rval;
 		}
+		if ( len < room ) {
+			if ( ! tbp->tb_len ) {
+				tbp->tb_first = now;
+			}
+			tbp->tb_len += len;
+			return BOOL_TRUE;
+		}
+		if ( ! tbp->tb_len ) {
+			return BOOL_FALSE;
+		}
+		mlog_tbuf_flush( tbp, BOOL_TRUE );
+	}
+	/* NOTREACHED */
+}
 
-		if ( mlog_timestamp ) {
-			time_t now = time( 0 );
-			struct tm *tmp = localtime( &now );
-			sprintf( mlog_tsstr,
-				 ":%02d.%02d.%02d",
-				 tmp->tm_hour,
-				 tmp->tm_min,
-				 tmp->tm_sec );
-			ASSERT( strlen( mlog_tsstr ) < sizeof( mlog_tsstr ));
-		} else {
-			mlog_tsstr[ 0 ] = 0;
+static void
+mlog_tbuf_flush( mlog_tbuf_t *tbp, bool_t lockpr )
+{
+	if ( ! tbp->tb_len ) {
+		return;
+	}
+
+	if ( lockpr ) {
+		mlog_lock( );
+	}
+	fwrite( tbp->tb_buf, 1, tbp->tb_len, mlog_fp );
+	fflush( mlog_fp );
+	tbp->tb_len = 0;
+	if ( lockpr ) {
+		mlog_unlock( );
+	}
+}
+
+/* handler for the signals which kill the process. writes out every debug
+ * message buffer with write( 2 ), which is safe in a signal handler, and
+ * without the lock, which the dying thread may hold. the handler is reset
+ * on entry, so raising the signal again kills the process as before.
+ */
+static void
+mlog_fatal( int signo )
+{
+	intgen_t fd = fileno( mlog_fp );
+	ix_t ix;
+
+	for ( ix = 0 ; ix < STREAM_SIMMAX + 1 ; ix++ ) {
+		mlog_tbuf_t *tbp = &mlog_tbuf[ ix ];
+
+		if ( tbp->tb_len && tbp->tb_len <= MLOG_TBUFSZ ) {
+			( void )write( fd, tbp->tb_buf, tbp->tb_len );
+			tbp->tb_len = 0;
 		}
+	}
+	( void )raise( signo );
+}
 
-		if ( mlog_showlevel ) {
-			mlog_levelstr[ 0 ] = ':';
-			if ( level > 9 ) {
-				mlog_levelstr[ 1 ] = '?';
-			} else {
-				mlog_levelstr[ 1 ] = ( char )
-						     ( level
-						       +
-						       ( intgen_t )'0' );
-			}
+/* formats the message preamble. returns the number of characters that
+ * would have been placed in buf, as snprintf( 3 ).
+ */
+static size_t
+mlog_preamble( char *buf, size_t bufsz, intgen_t levelarg, intgen_t streamix )
+{
+	intgen_t level;
+	ix_t ss;
+	char ssstr[ MLOG_SS_NAME_MAX + 2 ];
+	char tsstr[ 10 ];
+	char levelstr[ 3 ];
+	intgen_t rval;
+
+	level = levelarg & MLOG_LEVELMASK;
+	ss = ( ix_t )( ( levelarg & MLOG_SS_MASK ) >> MLOG_SS_SHIFT );
+
+	if ( mlog_showss ) {
+		sprintf( ssstr, ":%s", mlog_ss_names[ ss ] );
+	} else {
+		ssstr[ 0 ] = 0;
+	}
+
+	if ( mlog_timestamp ) {
+		time_t now = time( 0 );
+		struct tm tm;
+		( void )localtime_r( &now, &tm );
+		sprintf( tsstr,
+			 ":%02d.%02d.%02d",
+			 tm.tm_hour,
+			 tm.tm_min,
+			 tm.tm_sec );
+		ASSERT( strlen( tsstr ) < sizeof( tsstr ));
+	} else {
+		tsstr[ 0 ] = 0;
+	}
+
+	if ( mlog_showlevel ) {
+		levelstr[ 0 ] = ':';
+		if ( level > 9 ) {
+			levelstr[ 1 ] = '?';
 		} else {
-			mlog_levelstr[ 0 ] = 0;
+			levelstr[ 1 ] = ( char )( level + ( intgen_t )'0' );
 		}
-		if ( streamix != -1 && mlog_streamcnt > 1 ) {
-			fprintf( mlog_fp,
+		levelstr[ 2 ] = 0;
+	} else {
+		levelstr[ 0 ] = 0;
+	}
+
+	if ( streamix != -1 && mlog_streamcnt > 1 ) {
+		rval = snprintf( buf,
+				 bufsz,
 				 _("%s%s%s%s: drive %d: "),
 				 progname,
-				 mlog_tsstr,
-				 mlog_ssstr,
-				 mlog_levelstr,
+				 tsstr,
+				 ssstr,
+				 levelstr,
 				 streamix );
-		} else {
-			fprintf( mlog_fp,
+	} else {
+		rval = snprintf( buf,
+				 bufsz,
 				 "%s%s%s%s: ",
 				 progname,
-				 mlog_tsstr,
-				 mlog_ssstr,
-				 mlog_levelstr );
-		}
-		if ( levelarg & MLOG_NOTE ) {
-			fprintf( mlog_fp,
-				 "NOTE: " );
-		}
-		if ( levelarg & MLOG_WARNING ) {
-			fprintf( mlog_fp,
-				 "WARNING: " );
-		}
-		if ( levelarg & MLOG_ERROR ) {
-			fprintf( mlog_fp,
-				 "ERROR: " );
-		}
+				 tsstr,
+				 ssstr,
+				 levelstr );
+	}
+	if ( rval < 0 ) {
+		buf[ 0 ] = 0;
+		return 0;
 	}
 
-	vfprintf( mlog_fp, fmt, args );
-	fflush( mlog_fp );
-
-	if ( ! ( levelarg & MLOG_NOLOCK )) {
-		mlog_unlock( );
+	if ( levelarg & ( MLOG_NOTE | MLOG_WARNING | MLOG_ERROR )) {
+		size_t len = ( size_t )rval;
+		if ( len < bufsz ) {
+			rval = snprintf( buf + len,
+					 bufsz - len,
+					 "%s%s%s",
+					 ( levelarg & MLOG_NOTE )
+					 ? "NOTE: " : "",
+					 ( levelarg & MLOG_WARNING )
+					 ? "WARNING: " : "",
+					 ( levelarg & MLOG_ERROR )
+					 ? "ERROR: " : "" );
+			len += rval > 0 ? ( size_t )rval : 0;
+		}
+		return len;
 	}
-}
 
+	return ( size_t )rval;
+}
 
 static const char *exit_strings[] =
 	{ "SUCCESS", "ERROR", "INTERRUPT", "", "FAULT" };
@@ -575,10 +788,18 @@ _mlog_exit( const char *file, int line, int exit_code, rv_t rv )
 {
 	pid_t pid;
 	const struct rv_map *rvp;
+	mlog_tbuf_t *tbp;
 
 	pid = getpid();
 	rvp = rv_getdesc(rv);
 
+	/* streams call this on their way out; don't strand their
+	 * buffered messages
+	 */
+	tbp = mlog_tbuf_get( stream_getix( pid ));
+	if ( tbp ) {
+		mlog_tbuf_flush( tbp, BOOL_FALSE );
+	}
 
 	mlog( MLOG_DEBUG | MLOG_NOLOCK,
 	      "%s: %d: mlog_exit called: "
@@ -712,6 +933,10 @@ mlog_exit_flush(void)
 	const char *status_str;
 	rv_t rv;
 
+	/* all streams are done; write out whatever they left buffered */
+	for (i = 0; i < STREAM_SIMMAX + 1; i++)
+		mlog_tbuf_flush(&mlog_tbuf[i], BOOL_FALSE);
+
 	if (mlog_level_ss[MLOG_SS_GEN] == MLOG_SILENT)
 		return;
 
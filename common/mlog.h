@@ -107,10 +107,35 @@ extern void mlog_tell_streamcnt( size_t streamcnt );
  */
 void mlog_override_level( intgen_t levelarg );
 
+/* mlog_enabled - cheap test of whether a message at the given level and
+ * subsystem would be logged. use to guard expensive argument preparation.
+ */
+#define mlog_enabled( levelarg )					\
+	( ( ( levelarg ) & MLOG_LEVELMASK )				\
+	  <=								\
+	  mlog_level_ss[ ( ( levelarg ) & MLOG_SS_MASK ) >> MLOG_SS_SHIFT ] )
+
 /* vprintf-based message format
+ *
+ * the mlog macro applies the level gate inline, so calls suppressed by
+ * the -v option cost one compare and do not evaluate their arguments.
+ *
+ * messages at MLOG_DEBUG and above without a NOTE, WARNING or ERROR
+ * flag are formatted without the mlog lock into a buffer owned by the
+ * calling stream, and written out under the lock when the buffer fills,
+ * when it has aged MLOG_TBUF_AGE seconds, or when that stream logs any
+ * other message. all buffers are also written out at mlog_exit( ), and
+ * when a failed ASSERT, abort( ) or a fatal signal kills the process.
  */
 extern void mlog( intgen_t level, char *fmt, ... );
+#define mlog( levelarg, ... )						\
+	( mlog_enabled( levelarg ) ?					\
+	  mlog( ( levelarg ), __VA_ARGS__ ) : ( void )0 )
 extern void mlog_va( intgen_t levelarg, char *fmt, va_list args );
+
+/* mlog_flush - writes out any messages buffered by the calling stream
+ */
+extern void mlog_flush( void );
 #define mlog_exit( e, r ) _mlog_exit( __FILE__, __LINE__, (e), (r) )
 extern int  _mlog_exit( const char *file, int line, int exit_code, rv_t return_code );
 #define mlog_exit_hint( r ) _mlog_exit_hint( __FILE__, __LINE__, (r) )
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+#include <xfs/jdm.h>
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "mlog.h"
+#include "stream.h"
+#include "perfstat.h"
+
+
+/* structure definitions used locally ****************************************/
+
+#define PERF_LINESZ	16384	/* room for all categories of STREAM_SIMMAX */
+
+/* accumulated time, operation count and byte count for one category
+ */
+struct perf_acct {
+	u_int64_t pa_usec;
+	u_int64_t pa_cnt;
+	u_int64_t pa_bytes;
+};
+
+typedef struct perf_acct perf_acct_t;
+
+
+/* declarations of externally defined global variables ***********************/
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static intgen_t perf_streamix( void );
+static u_int64_t perf_usec_since( struct timeval *tvp );
+
+
+/* definition of locally defined global variables ****************************/
+
+
+/* definition of locally defined static variables *****************************/
+
+static bool_t perf_enabledpr = BOOL_FALSE;
+static struct timeval perf_starttime;
+static perf_acct_t perf_acct[ STREAM_SIMMAX ][ PERF_CNT ];
+static intgen_t perf_hiix = -1;
+static char perf_line[ PERF_LINESZ ];
+
+/* short names of the categories, used as JSON keys and in the summary.
+ * must match order of perf_cat_t.
+ */
+static char *perf_catname[ PERF_CNT ] = {
+	"bulkstat",
+	"read",
+	"getbmap",
+	"extattr",
+	"getwritebuf",
+	"write",
+	"recwrite",
+	"dirread"
+};
+
+
+/* definition of locally defined global functions ****************************/
+
+void
+perf_init( bool_t enabledpr )
+{
+	memset( ( void * )perf_acct, 0, sizeof( perf_acct ));
+	perf_hiix = -1;
+	( void )gettimeofday( &perf_starttime, 0 );
+	perf_enabledpr = enabledpr;
+}
+
+bool_t
+perf_enabled( void )
+{
+	return perf_enabledpr;
+}
+
+void
+perf_begin( perf_timer_t *timerp )
+{
+	if ( ! perf_enabledpr ) {
+		return;
+	}
+	timerp->pt_streamix = perf_streamix( );
+	timerp->pt_recwriteusec =
+		perf_acct[ timerp->pt_streamix ][ PERF_RECWRITE ].pa_usec;
+	( void )gettimeofday( &timerp->pt_begin, 0 );
+}
+
+void
+perf_end( intgen_t streamix,
+	  perf_cat_t cat,
+	  perf_timer_t *timerp,
+	  off64_t bytecnt )
+{
+	perf_acct_t *acctp;
+	u_int64_t usec;
+
+	if ( ! perf_enabledpr ) {
+		return;
+	}
+
+	if ( streamix < 0 ) {
+		streamix = perf_streamix( );
+	}
+	ASSERT( streamix < STREAM_SIMMAX );
+	ASSERT( cat < PERF_CNT );
+
+	/* take out the device writes the drive made meanwhile
+	 */
+	usec = perf_usec_since( &timerp->pt_begin );
+	if ( cat == PERF_GETWRITEBUF || cat == PERF_WRITE ) {
+		u_int64_t recwriteusec;
+
+		recwriteusec = perf_acct[ timerp->pt_streamix ]
+					[ PERF_RECWRITE ].pa_usec
+			       -
+			       timerp->pt_recwriteusec;
+		usec = usec > recwriteusec ? usec - recwriteusec : 0;
+	}
+
+	acctp = &perf_acct[ streamix ][ cat ];
+	acctp->pa_usec += usec;
+	acctp->pa_cnt++;
+	if ( bytecnt > 0 ) {
+		acctp->pa_bytes += ( u_int64_t )bytecnt;
+	}
+	if ( streamix > perf_hiix ) {
+		perf_hiix = streamix;
+	}
+}
+
+size_t
+perf_statline( char *buf, size_t bufsz )
+{
+	size_t len;
+	intgen_t ix;
+	intgen_t catix;
+
+	ASSERT( bufsz > 0 );
+
+	len = ( size_t )snprintf( buf,
+				  bufsz,
+				  "{\"perfstat\":1,\"elapsed_usec\":%llu,"
+				  "\"streams\":[",
+				  ( unsigned long long )
+				  perf_usec_since( &perf_starttime ));
+	for ( ix = 0 ; ix <= perf_hiix && len < bufsz ; ix++ ) {
+		len += ( size_t )snprintf( buf + len,
+					   bufsz - len,
+					   "%s{\"stream\":%d",
+					   ix ? "," : "",
+					   ix );
+		for ( catix = 0 ; catix < PERF_CNT && len < bufsz ; catix++ ) {
+			perf_acct_t *acctp = &perf_acct[ ix ][ catix ];
+			len += ( size_t )snprintf( buf + len,
+						   bufsz - len,
+						   ",\"%s\":{\"usec\":%llu,"
+						   "\"cnt\":%llu,"
+						   "\"bytes\":%llu}",
+						   perf_catname[ catix ],
+						   ( unsigned long long )
+						   acctp->pa_usec,
+						   ( unsigned long long )
+						   acctp->pa_cnt,
+						   ( unsigned long long )
+						   acctp->pa_bytes );
+		}
+		if ( len < bufsz ) {
+			len += ( size_t )snprintf( buf + len,
+						   bufsz - len,
+						   "}" );
+		}
+	}
+	if ( len < bufsz ) {
+		len += ( size_t )snprintf( buf + len, bufsz - len, "]}" );
+	}
+
+	/* snprintf returns the length it would have written; clamp
+	 */
+	if ( len >= bufsz ) {
+		len = bufsz - 1;
+	}
+
+	return len;
+}
+
+void
+perf_report( void )
+{
+	if ( ! perf_enabledpr ) {
+		return;
+	}
+
+	/* bare, so that each line is a JSON object a script can parse
+	 */
+	( void )perf_statline( perf_line, sizeof( perf_line ));
+	mlog( MLOG_NORMAL | MLOG_BARE, "%s\n", perf_line );
+}
+
+void
+perf_summary( void )
+{
+	intgen_t ix;
+	intgen_t catix;
+
+	if ( ! perf_enabledpr ) {
+		return;
+	}
+
+	mlog( MLOG_VERBOSE, _(
+	      "I/O stall time summary (seconds, operations, bytes):\n") );
+	for ( ix = 0 ; ix <= perf_hiix ; ix++ ) {
+		for ( catix = 0 ; catix < PERF_CNT ; catix++ ) {
+			perf_acct_t *acctp = &perf_acct[ ix ][ catix ];
+			if ( ! acctp->pa_cnt ) {
+				continue;
+			}
+			mlog( MLOG_VERBOSE, _(
+			      "stream %d %-11s %10.3f %10llu %14llu\n"),
+			      ix,
+			      perf_catname[ catix ],
+			      ( double )acctp->pa_usec / 1000000.0,
+			      ( unsigned long long )acctp->pa_cnt,
+			      ( unsigned long long )acctp->pa_bytes );
+		}
+	}
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+/* miniroot runs the only stream in the main thread, which is never
+ * registered; charge that to stream 0.
+ */
+static intgen_t
+perf_streamix( void )
+{
+	intgen_t streamix;
+
+	streamix = stream_getix( getpid( ));
+	if ( streamix < 0 ) {
+		streamix = 0;
+	}
+
+	return streamix;
+}
+
+static u_int64_t
+perf_usec_since( struct timeval *tvp )
+{
+	struct timeval now;
+	int64_t usec;
+
+	( void )gettimeofday( &now, 0 );
+	usec = ( int64_t )( now.tv_sec - tvp->tv_sec ) * 1000000
+	       +
+	       ( int64_t )( now.tv_usec - tvp->tv_usec );
+
+	/* guard against the clock being stepped backwards
+	 */
+	return usec > 0 ? ( u_int64_t )usec : 0;
+}
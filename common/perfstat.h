@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef PERFSTAT_H
+#define PERFSTAT_H
+
+/* perfstat.[hc] - per-stream I/O pipeline stall accounting
+ *
+ * each stream accumulates the wall-clock time it spends blocked in the
+ * operations listed below. the totals are used to decide whether a dump
+ * is bound by the source filesystem, by content generation, or by the
+ * media. accounting is off unless perf_init( ) is called with
+ * BOOL_TRUE; when off, perf_begin( ) and perf_end( ) cost one test.
+ *
+ * each stream updates only its own counters, so no locking is needed.
+ * the reporter may see a slightly stale value, which is harmless.
+ *
+ * the categories are disjoint, so a stream's totals never add up to more
+ * than the time elapsed: the device writes a drive makes from within
+ * do_get_write_buf or do_write are charged to PERF_RECWRITE alone, and
+ * taken out of PERF_GETWRITEBUF or PERF_WRITE.
+ */
+
+#include <sys/time.h>
+
+/* categories of time accounted
+ */
+typedef enum {
+	PERF_BULKSTAT,		/* XFS_IOC_FSBULKSTAT */
+	PERF_READ,		/* reading file data (dump_extent_group) */
+	PERF_GETBMAP,		/* XFS_IOC_GETBMAPX */
+	PERF_EXTATTR,		/* extended attribute retrieval */
+	PERF_GETWRITEBUF,	/* blocked in drive do_get_write_buf,
+				 * less PERF_RECWRITE */
+	PERF_WRITE,		/* blocked in drive do_write, less
+				 * PERF_RECWRITE */
+	PERF_RECWRITE,		/* drive record writes to the device */
+	PERF_DIRREAD,		/* directory open and getdents */
+	PERF_CNT		/* NOTE: must be last */
+} perf_cat_t;
+
+/* a timer is the start time of an accounted operation, and the time the
+ * calling stream had spent in PERF_RECWRITE by then
+ */
+struct perf_timer {
+	struct timeval pt_begin;
+	u_int64_t pt_recwriteusec;
+	intgen_t pt_streamix;
+};
+
+typedef struct perf_timer perf_timer_t;
+
+/* perf_init - enable or disable stall accounting and zero all counters.
+ * must be called before any streams are created.
+ */
+extern void perf_init( bool_t enabledpr );
+
+/* perf_enabled - returns BOOL_TRUE if stall accounting is enabled
+ */
+extern bool_t perf_enabled( void );
+
+/* perf_begin - note the start of an accounted operation
+ */
+extern void perf_begin( perf_timer_t *timerp );
+
+/* perf_end - charge the time elapsed since perf_begin( ) to the given
+ * stream and category. bytecnt is added to the category byte count;
+ * pass zero if not meaningful. a negative streamix charges the stream
+ * of the calling thread.
+ */
+extern void perf_end( intgen_t streamix,
+		      perf_cat_t cat,
+		      perf_timer_t *timerp,
+		      off64_t bytecnt );
+
+/* perf_statline - formats the current counters of all active streams
+ * as a single-line JSON object (no trailing newline). returns the
+ * number of bytes placed in buf.
+ */
+extern size_t perf_statline( char *buf, size_t bufsz );
+
+/* perf_report - logs the perf_statline( ) JSON line. called at each
+ * progress report interval (-p).
+ */
+extern void perf_report( void );
+
+/* perf_summary - logs the per-stream totals at the end of a session
+ */
+extern void perf_summary( void );
+
+#endif /* PERFSTAT_H */
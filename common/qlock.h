@@ -48,6 +48,9 @@
 #define QLOCK_ORD_MLOG	3
 	/* ordinal for mlog lock
 	 */
+#define QLOCK_ORD_PROGREC	4
+	/* ordinal for progress record file lock
+	 */
 
 typedef void *qlockh_t;
 #define QLOCKH_NULL	0
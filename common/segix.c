@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+#include <xfs/jdm.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "global.h"
+#include "content.h"
+#include "content_inode.h"
+#include "drive.h"
+#include "media.h"
+#include "inomap.h"
+#include "segix.h"
+
+
+/* structure definitions used locally ****************************************/
+
+#define SEGIX_MINSLOTS	64
+
+#define SEGIX_HASHMUL	0x9e3779b97f4a7c15ULL
+	/* 2^64 / golden ratio. spreads the consecutive keys of a dense
+	 * allocation group evenly over the table.
+	 */
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static bool_t segix_alloc( segix_t *sip, size_t slotcnt );
+static void segix_insert( segix_t *sip, hnk_t *hnkp, size_t segix );
+
+
+/* definition of locally defined global functions ****************************/
+
+bool_t
+segix_init( segix_t *sip, size_t segcnt )
+{
+	size_t slotcnt;
+
+	for ( slotcnt = SEGIX_MINSLOTS ; slotcnt < 2 * segcnt ; slotcnt *= 2 )
+		;
+
+	sip->si_segcnt = 0;
+	return segix_alloc( sip, slotcnt );
+}
+
+bool_t
+segix_add( segix_t *sip, hnk_t *hnkp, size_t segix )
+{
+	seg_t *segp = &hnkp[ segix / SEGPERHNK ].seg[ segix % SEGPERHNK ];
+
+	ASSERT( sip->si_slotp );
+
+	if ( segp->base % INOPERSEG ) {
+		return BOOL_FALSE;
+	}
+	if ( ( u_int64_t )segix >= ( u_int64_t )UINT32MAX ) {
+		return BOOL_FALSE;
+	}
+
+	/* keep the load at most one half, so probe sequences stay short
+	 */
+	if ( 2 * ( sip->si_segcnt + 1 ) > sip->si_slotcnt ) {
+		u_int32_t *oldslotp = sip->si_slotp;
+		size_t oldslotcnt = sip->si_slotcnt;
+		size_t slotix;
+
+		if ( ! segix_alloc( sip, 2 * oldslotcnt )) {
+			sip->si_slotp = oldslotp;
+			sip->si_slotcnt = oldslotcnt;
+			return BOOL_FALSE;
+		}
+		for ( slotix = 0 ; slotix < oldslotcnt ; slotix++ ) {
+			if ( oldslotp[ slotix ] ) {
+				segix_insert( sip,
+					      hnkp,
+					      ( size_t )oldslotp[ slotix ] - 1 );
+			}
+		}
+		free( ( void * )oldslotp );
+	}
+
+	segix_insert( sip, hnkp, segix );
+	sip->si_segcnt++;
+
+	return BOOL_TRUE;
+}
+
+seg_t *
+segix_find( segix_t *sip, hnk_t *hnkp, xfs_ino_t ino, size_t *segixp )
+{
+	u_int64_t key = ino / INOPERSEG;
+	size_t mask = sip->si_slotcnt - 1;
+	size_t slotix;
+
+	ASSERT( sip->si_slotp );
+
+	for ( slotix = ( size_t )( ( key * SEGIX_HASHMUL ) >> sip->si_shift )
+	      ;
+	      sip->si_slotp[ slotix ]
+	      ;
+	      slotix = ( slotix + 1 ) & mask ) {
+		size_t segix = ( size_t )sip->si_slotp[ slotix ] - 1;
+		seg_t *segp = &hnkp[ segix / SEGPERHNK ].seg[ segix % SEGPERHNK ];
+
+		if ( segp->base / INOPERSEG == key ) {
+			*segixp = segix;
+			return segp;
+		}
+	}
+
+	return 0;
+}
+
+void
+segix_free( segix_t *sip )
+{
+	if ( sip->si_slotp ) {
+		free( ( void * )sip->si_slotp );
+	}
+	memset( ( void * )sip, 0, sizeof( *sip ));
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+static bool_t
+segix_alloc( segix_t *sip, size_t slotcnt )
+{
+	intgen_t shift;
+
+	ASSERT( ( slotcnt & ( slotcnt - 1 )) == 0 );
+
+	sip->si_slotp = ( u_int32_t * )calloc( slotcnt, sizeof( u_int32_t ));
+	if ( ! sip->si_slotp ) {
+		return BOOL_FALSE;
+	}
+	sip->si_slotcnt = slotcnt;
+	for ( shift = 64 ; slotcnt > 1 ; slotcnt >>= 1 ) {
+		shift--;
+	}
+	sip->si_shift = shift;
+
+	return BOOL_TRUE;
+}
+
+/* segix_insert - places a segment in the first free slot of its probe
+ * sequence. the table must have a free slot.
+ */
+static void
+segix_insert( segix_t *sip, hnk_t *hnkp, size_t segix )
+{
+	seg_t *segp = &hnkp[ segix / SEGPERHNK ].seg[ segix % SEGPERHNK ];
+	u_int64_t key = segp->base / INOPERSEG;
+	size_t mask = sip->si_slotcnt - 1;
+	size_t slotix;
+
+	for ( slotix = ( size_t )( ( key * SEGIX_HASHMUL ) >> sip->si_shift )
+	      ;
+	      sip->si_slotp[ slotix ]
+	      ;
+	      slotix = ( slotix + 1 ) & mask )
+		;
+	sip->si_slotp[ slotix ] = ( u_int32_t )( segix + 1 );
+}
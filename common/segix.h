@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef SEGIX_H
+#define SEGIX_H
+
+/* segix.[hc] - inode map segment index
+ *
+ * the inode map is an array of hunks of segments, in increasing ino
+ * order, each segment covering the INOPERSEG inos of one inode cluster.
+ * finding the segment of an ino by binary search costs a dozen or more
+ * cache misses on a large map. the segment index is a hash table keyed
+ * by ino / INOPERSEG, giving the segment in about one probe.
+ *
+ * slots hold the segment's index in the map ( hunk * SEGPERHNK + seg )
+ * plus one, so the table is a quarter of the size of the map or less.
+ * the key of an occupied slot is read from the segment itself, which
+ * the caller is about to use anyway.
+ *
+ * this relies on segment bases being multiples of INOPERSEG, as XFS
+ * inode cluster start inos are. segix_add( ) refuses others; the caller
+ * should then free the index and fall back to searching the map.
+ *
+ * uses the hnk_t and seg_t of the including program's inomap.h.
+ */
+
+struct segix {
+	u_int32_t *si_slotp;
+		/* segment index plus one, or zero if empty. NULL if
+		 * the index is not in use.
+		 */
+	size_t si_slotcnt;
+		/* a power of two, at least twice si_segcnt
+		 */
+	intgen_t si_shift;
+		/* 64 - log2( si_slotcnt ), for the multiplicative hash
+		 */
+	size_t si_segcnt;
+		/* number of segments added
+		 */
+};
+
+typedef struct segix segix_t;
+
+/* segix_init - allocates an empty index sized for segcnt segments.
+ * returns FALSE if out of memory.
+ */
+extern bool_t segix_init( segix_t *sip, size_t segcnt );
+
+/* segix_add - adds segment segix of the map hnkp. the index grows as
+ * needed. returns FALSE if the segment base is not aligned or memory
+ * is exhausted.
+ */
+extern bool_t segix_add( segix_t *sip, hnk_t *hnkp, size_t segix );
+
+/* segix_find - returns the segment of the map hnkp containing ino and
+ * its index in *segixp, or NULL if ino is in no segment.
+ */
+extern seg_t *segix_find( segix_t *sip,
+			  hnk_t *hnkp,
+			  xfs_ino_t ino,
+			  size_t *segixp );
+
+/* segix_free - frees the index. sip->si_slotp becomes NULL.
+ */
+extern void segix_free( segix_t *sip );
+
+#endif /* SEGIX_H */
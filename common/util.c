@@ -30,6 +30,7 @@
 #include "util.h"
 #include "mlog.h"
 #include "getdents.h"
+#include "perfstat.h"
 
 extern size_t pgsz;
 
@@ -42,19 +43,24 @@ write_buf( char *bufp,
 {
 	char *mbufp;	/* buffer obtained from manager */
 	size_t mbufsz;/* size of buffer obtained from manager */
+	perf_timer_t perftimer;
 
 	while ( bufsz ) {
 		int rval;
 
 		ASSERT( bufsz > 0 );
+		perf_begin( &perftimer );
 		mbufp = ( *get_write_buf_funcp )( contextp, bufsz, &mbufsz );
+		perf_end( -1, PERF_GETWRITEBUF, &perftimer, 0 );
 		ASSERT( mbufsz <= bufsz );
 		if ( bufp ) {
 			(void)memcpy( ( void * )mbufp, ( void * )bufp, mbufsz );
 		} else {
 			(void)memset( ( void * )mbufp, 0, mbufsz );
 		}
+		perf_begin( &perftimer );
 		rval = ( * write_funcp )( contextp, mbufp, mbufsz );
+		perf_end( -1, PERF_WRITE, &perftimer, ( off64_t )mbufsz );
 		if ( rval ) {
 			return rval;
 		}
@@ -129,6 +135,7 @@ bigstat_iter( jdm_fshandle_t *fshandlep,
 	intgen_t saved_errno;
 	intgen_t bulkstatcnt;
         xfs_fsop_bulkreq_t bulkreq;
+	perf_timer_t perftimer;
 
 	/* stat set with return from callback func
 	 */
@@ -157,10 +164,12 @@ bigstat_iter( jdm_fshandle_t *fshandlep,
 	bulkreq.icount = buflenin;
 	bulkreq.ubuffer = buf;
 	bulkreq.ocount = &buflenout;
+	perf_begin( &perftimer );
 	while (!ioctl(fsfd, XFS_IOC_FSBULKSTAT, &bulkreq)) {
 		xfs_bstat_t *p;
 		xfs_bstat_t *endp;
 
+		perf_end( -1, PERF_BULKSTAT, &perftimer, 0 );
 		if ( buflenout == 0 ) {
 			mlog( MLOG_NITTY + 1,
 			      "bulkstat returns buflen %d\n",
@@ -235,6 +244,7 @@ bigstat_iter( jdm_fshandle_t *fshandlep,
 
 		mlog( MLOG_NITTY + 1,
 		      "calling bulkstat\n" );
+		perf_begin( &perftimer );
 	}
 
 	saved_errno = errno;
@@ -263,6 +273,36 @@ bigstat_one( intgen_t fsfd,
 	return xfsctl(NULL, fsfd, XFS_IOC_FSBULKSTAT_SINGLE, &bulkreq);
 }
 
+intgen_t
+bigstat_range( intgen_t fsfd,
+	       xfs_ino_t ino,
+	       xfs_bstat_t *buf,
+	       size_t buflen,
+	       intgen_t *cntp )
+{
+        xfs_fsop_bulkreq_t bulkreq;
+	xfs_ino_t lastino;
+	perf_timer_t perftimer;
+	intgen_t rval;
+
+	ASSERT( ino > 0 );
+	ASSERT( buflen > 0 );
+
+	/* bulkstat starts after lastip
+	 */
+	lastino = ino - 1;
+	*cntp = 0;
+        bulkreq.lastip = (__u64 *)&lastino;
+        bulkreq.icount = ( __s32 )buflen;
+        bulkreq.ubuffer = buf;
+        bulkreq.ocount = cntp;
+	perf_begin( &perftimer );
+	rval = ioctl( fsfd, XFS_IOC_FSBULKSTAT, &bulkreq );
+	perf_end( -1, PERF_BULKSTAT, &perftimer, 0 );
+
+	return rval;
+}
+
 /* call the given callback for each inode group in the filesystem.
  */
 #define INOGRPLEN	256
@@ -328,7 +368,8 @@ inogrp_iter( intgen_t fsfd,
  *
  * if the callback returns non-zero, returns 1 with cbrval set to the
  * callback's return value. if syscall fails, returns -1 with errno set.
- * otherwise returns 0.
+ * if some entries could not be read or stat'ed, the callback is still
+ * invoked for the others, but returns -1. otherwise returns 0.
  *
  * caller may supply a dirent buffer. if not, will malloc one
  */
@@ -347,19 +388,20 @@ diriter( jdm_fshandle_t *fshandlep,
 	 size_t usrgdsz )
 {
 	size_t gdsz;
-	struct dirent *gdp;
+	struct dirent64 *gdp;
 	intgen_t fd;
 	intgen_t gdcnt;
 	intgen_t scrval;
 	intgen_t cbrval;
+	bool_t partialpr;
 
 	if ( usrgdp ) {
-		ASSERT( usrgdsz >= sizeof( struct dirent ) );
+		ASSERT( usrgdsz >= sizeof( struct dirent64 ) );
 		gdsz = usrgdsz;
-		gdp = ( struct dirent * )usrgdp;
+		gdp = ( struct dirent64 * )usrgdp;
 	} else {
 		gdsz = pgsz;
-		gdp = ( struct dirent * )malloc( gdsz );
+		gdp = ( struct dirent64 * )malloc( gdsz );
 		ASSERT( gdp );
 	}
 
@@ -384,15 +426,16 @@ diriter( jdm_fshandle_t *fshandlep,
 	 */
 	scrval = 0;
 	cbrval = 0;
+	partialpr = BOOL_FALSE;
 	for ( gdcnt = 1 ; ; gdcnt++ ) {
-		struct dirent *p;
+		struct dirent64 *p;
 		intgen_t nread;
 		register size_t reclen;
 
 		ASSERT( scrval == 0 );
 		ASSERT( cbrval == 0 );
 
-		nread = getdents_wrap( fd, (char *)gdp, gdsz );
+		nread = getdents64_wrap( fd, (char *)gdp, gdsz );
 		
 		/* negative count indicates something very bad happened;
 		 * try to gracefully end this dir.
@@ -405,6 +448,7 @@ diriter( jdm_fshandle_t *fshandlep,
 			      statp->bs_ino,
 			      strerror( errno ));
 			nread = 0; /* pretend we are done */
+			partialpr = BOOL_TRUE;
 		}
 
 		/* no more directory entries: break;
@@ -422,7 +466,7 @@ diriter( jdm_fshandle_t *fshandlep,
 		      ;
 		      nread -= ( intgen_t )reclen,
 		      ASSERT( nread >= 0 ),
-		      p = ( struct dirent * )( ( char * )p + reclen ),
+		      p = ( struct dirent64 * )( ( char * )p + reclen ),
 		      reclen = ( size_t )p->d_reclen ) {
 			xfs_bstat_t statbuf;
 			ASSERT( scrval == 0 );
@@ -453,23 +497,10 @@ diriter( jdm_fshandle_t *fshandlep,
 				      ( xfs_ino_t )p->d_ino,
 				      strerror( errno ));
 				scrval = 0;
+				partialpr = BOOL_TRUE;
 				continue;
 			}
 
-			/* if getdents64() not yet available, and ino
-			 * occupied more than 32 bits, warn and skip.
-			 */
-#ifndef __USE_LARGEFILE64
-			if ( statbuf.bs_ino > ( xfs_ino_t )INOMAX ) {
-				mlog( MLOG_NORMAL,
-				      _("WARNING: unable to process dirent %s: "
-				      "ino %llu too large\n"),
-				      p->d_name,
-				      ( xfs_ino_t )p->d_ino );
-				continue;
-			}
-#endif
-
 			/* invoke the callback
 			 */
 			cbrval = ( * cbfp )( arg1,
@@ -501,6 +532,9 @@ diriter( jdm_fshandle_t *fshandlep,
 	} else if ( cbrval ) {
 		*cbrvalp = cbrval;
 		return 1;
+	} else if ( partialpr ) {
+		*cbrvalp = 0;
+		return -1;
 	} else {
 		*cbrvalp = 0;
 		return 0;
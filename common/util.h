@@ -112,6 +112,16 @@ extern intgen_t bigstat_one( intgen_t fsfd,
 			     xfs_ino_t ino,
 			     xfs_bstat_t *statp );
 
+/* bigstat_range - a single bulkstat call, filling buf with up to buflen
+ * in-use inodes beginning with ino. sets *cntp to the number returned.
+ * returns zero on success, else -1 with errno set.
+ */
+extern intgen_t bigstat_range( intgen_t fsfd,
+			       xfs_ino_t ino,
+			       xfs_bstat_t *buf,
+			       size_t buflen,
+			       intgen_t *cntp );
+
 extern intgen_t inogrp_iter( intgen_t fsfd,
 			     intgen_t ( * fp )( void *arg1,
 				     		intgen_t fsfd,
@@ -130,7 +140,8 @@ extern intgen_t inogrp_iter( intgen_t fsfd,
  *
  * if the callback returns non-zero, returns 1 with cbrval set to the
  * callback's return value. if syscall fails, returns -1 with errno set.
- * otherwise returns 0.
+ * if some entries could not be read or stat'ed, the callback is still
+ * invoked for the others, but returns -1. otherwise returns 0.
  */
 extern intgen_t diriter( jdm_fshandle_t *fshandlep,
 			 intgen_t fsfd,
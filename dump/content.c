@@ -63,6 +63,11 @@
 #include "inventory.h"
 #include "getdents.h"
 #include "arch_xlate.h"
+#include "perfstat.h"
+#include "treecache.h"
+#include "inolist.h"
+#include "fprint.h"
+#include "dedup.h"
 
 #undef SYNCDIR
 #define SYNCDIR
@@ -93,6 +98,10 @@
  */
 #define FS_DEFAULT	"xfs"
 
+/* maximum number of chunks per stream when dynamically partitioned (-Q)
+ */
+#define DYNPART_MAX	64
+
 /* marks consist of a opaque drive layer cookie and a startpoint.
  * the drive layer requires that it be passed a pointer to a drive_markrec_t.
  * we tack on content-specific baggage (startpt_t). this works because we
@@ -130,6 +139,14 @@ struct context {
 	size_t cc_getdentsbufsz;
 			/* pre-allocated buffer for getdents() syscall
 			 */
+	xfs_bstat_t *cc_genbufp;
+	intgen_t cc_genbuflen;
+	xfs_ino_t cc_genfirst;
+			/* pre-allocated buffer for dirent generation lookups:
+			 * the in-use inodes from cc_genfirst through the last
+			 * entry, as returned by one bulkstat. cc_genbuflen is
+			 * zero if empty.
+			 */
 	char *cc_mdirentbufp;
 	size_t cc_mdirentbufsz;
 			/* pre-allocated buffer for on-media dirent
@@ -184,6 +201,26 @@ struct context {
 	bes_t cc_Media_begin_entrystate;
 			/* Media_mfile_begin context entry state
 			 */
+	ix_t *cc_dynchunkixp;
+	size_t cc_dynchunkcnt;
+	ix_t cc_dynchunkcur;
+	startpt_t cc_dynstartpt;
+			/* dynamic partitioning (-Q) only: the chunks claimed
+			 * by this stream in ascending order, the one now
+			 * being dumped, and where that one begins
+			 */
+	dedup_t *cc_dedupp;
+	char *cc_dedupbufp;
+			/* dedup (-u) only: the chunks dumped so far in this
+			 * media file, and a DEDUP_CHUNKSZ buffer to read a
+			 * chunk into. NULL if this stream does not dedup
+			 */
+	size64_t cc_dedupchunkcnt;
+	size64_t cc_deduprefcnt;
+	size64_t cc_deduprefbytes;
+			/* dedup (-u) only: chunks in this media file, those
+			 * dumped as references and the data they replace
+			 */
 };
 
 typedef struct context context_t;
@@ -208,6 +245,12 @@ typedef struct extent_group_context extent_group_context_t;
  */
 #define GETDENTSBUF_SZ_MIN	( 2 * pgsz )
 
+/* number of inodes fetched by one bulkstat when resolving the generation
+ * of dirents missing from the inomap: one XFS inode cluster. must be a
+ * power of two.
+ */
+#define GENBUF_LEN		64
+
 
 /* minimum sizes for extended attributes buffers
  */
@@ -239,6 +282,10 @@ struct pds {
 	       PDS_TERMDUMP		/* writing stream terminator */
 	} pds_phase;
 	size64_t pds_dirdone;		/* number of directories done */
+	size64_t pds_datadone;		/* non-dir data bytes dumped */
+	time32_t pds_nondirstart;	/* when non-dir dump phase began */
+	time32_t pds_dirstart;		/* when directory dump phase began */
+	time32_t pds_dirend;		/* when it ended, or 0 if not yet */
 };
 
 typedef struct pds pds_t;
@@ -260,6 +307,7 @@ extern size_t pgsz;
 /* file dumpers
  */
 static rv_t dump_dirs( ix_t strmix,
+		       drive_t *drivep,
 		       xfs_bstat_t *bstatbufp,
 		       size_t bstatbuflen,
 		       void *inomap_contextp );
@@ -267,13 +315,43 @@ static rv_t dump_dirs( ix_t strmix,
 static rv_t dump_dirs_rendezvous( void );
 #endif /* SYNCDIR */
 static rv_t dump_dir( ix_t strmix,
+		      drive_t *drivep,
 		      jdm_fshandle_t *,
 		      intgen_t,
 		      xfs_bstat_t * );
+static rv_t dump_dir_entries( drive_t *drivep,
+			      context_t *contextp,
+			      intgen_t fsfd,
+			      xfs_bstat_t *statp,
+			      struct dirent64 *gdp,
+			      intgen_t nread );
+static u_int32_t dump_dirent_gen( context_t *contextp,
+				  intgen_t fsfd,
+				  xfs_ino_t ino,
+				  char *name );
 static rv_t dump_file( void *,
 		       jdm_fshandle_t *,
 		       intgen_t,
 		       xfs_bstat_t * );
+
+/* directory section cache
+ */
+static void dircache_init( void );
+static rv_t dircache_dump( ix_t strmix,
+			   drive_t *drivep,
+			   xfs_bstat_t *bstatbufp,
+			   size_t bstatbuflen,
+			   void *inomap_contextp );
+static rv_t dircache_copy( ix_t strmix, drive_t *drivep );
+
+/* status reporting
+ */
+static double dirrate( pds_t *pdsp, time_t now );
+static char * dircache_get_write_buf( drive_t *drivep,
+				      size_t wantedcnt,
+				      size_t *actualcntp );
+static intgen_t dircache_write( drive_t *drivep, char *bufp, size_t bufsz );
+static bool_t dircache_flush( void );
 static rv_t dump_file_reg( drive_t *drivep,
 			   context_t *contextp,
 			   content_inode_hdr_t *scwhdrp,
@@ -283,6 +361,14 @@ static rv_t dump_file_spec( drive_t *drivep,
 			    context_t *contextp,
 			    jdm_fshandle_t *,
 			    xfs_bstat_t * );
+static bool_t dynpart_claim( context_t *contextp );
+static void dynpart_setrange( context_t *contextp,
+			      content_inode_hdr_t *scwhdrp );
+static void dynpart_locate( context_t *contextp,
+			    content_inode_hdr_t *scwhdrp );
+static bool_t dynpart_next( context_t *contextp,
+			    content_inode_hdr_t *scwhdrp );
+static bool_t sess_strmsordered( inv_session_t *sessp );
 static rv_t dump_filehdr( drive_t *drivep,
 			  context_t *contextp,
 			  xfs_bstat_t *,
@@ -294,6 +380,10 @@ static rv_t dump_extenthdr( drive_t *drivep,
 			    int32_t,
 			    off64_t,
 			    off64_t );
+static rv_t dump_extentref( drive_t *drivep,
+			    xfs_ino_t,
+			    off64_t,
+			    u_int64_t * );
 static rv_t dump_dirent( drive_t *drivep,
 			 context_t *contextp,
 			 xfs_bstat_t *,
@@ -315,6 +405,13 @@ static rv_t dump_extent_group( drive_t *drivep,
 			       off64_t *,
 			       off64_t *,
 			       bool_t * );
+static rv_t dump_extent_dedup( drive_t *drivep,
+			       context_t *contextp,
+			       xfs_bstat_t *,
+			       extent_group_context_t *,
+			       off64_t,
+			       off64_t,
+			       off64_t * );
 static bool_t dump_session_inv( drive_t *drivep,
 			        context_t *contextp,
 			        media_hdr_t *mwhdrp,
@@ -438,7 +535,35 @@ static xfs_bstat_t *sc_rootxfsstatp = 0;
 	/* pointer to loaded bulkstat for root directory
 	 */
 static startpt_t *sc_startptp = 0;
-	/* an array of stream ino/offset start points
+	/* an array of stream ino/offset start points. if dynamic
+	 * partitioning, the start points of each chunk.
+	 */
+static bool_t sc_dirrefpr = BOOL_FALSE;
+	/* -D: directories unchanged since the base dump are dumped as
+	 * a header only (FILEHDR_FLAGS_DIRREF), without their entries
+	 */
+static bool_t sc_treecachepr = BOOL_FALSE;
+	/* -X: reuse and update the directory tree cache (treecache.c)
+	 */
+static bool_t sc_deduppr = BOOL_FALSE;
+	/* -u: regular file data chunks already dumped in the media file
+	 * are dumped as references to them (dedup.c)
+	 */
+static bool_t sc_metaonlypr = BOOL_FALSE;
+	/* -g: regular files whose data is unchanged since the base dump
+	 * are dumped without it (FILEHDR_FLAGS_METAONLY). the files whose
+	 * data each dump leaves restored are kept in a list (inolist.c).
+	 */
+static bool_t sc_dynpartpr = BOOL_FALSE;
+static size_t sc_dynchunkcnt = 0;
+	/* dynamic partitioning (-Q): the non-dirs are divided into
+	 * several chunks per stream, claimed in ascending order by
+	 * whichever stream is free. evens out streams whose media or
+	 * files differ in speed. never set while drive_init1( ) accepts
+	 * only one destination, as on Linux
+	 */
+static ix_t sc_dynchunknext = 0;
+	/* the next unclaimed chunk. MUST be accessed under lock( )
 	 */
 static time32_t sc_stat_starttime = 0;
 	/* for cacluating elapsed time
@@ -494,6 +619,33 @@ static size_t sc_thrdswaitingdirdumpsync2 = 0;
 static qbarrierh_t sc_barrierh;
 #endif /* SYNCDIR */
 
+/* directory section cache. when there is more than one stream, the
+ * first stream to reach the directory dump generates the directory
+ * section into an unlinked temporary file, by running dump_dirs( )
+ * against a pseudo drive. every stream then copies that file to its
+ * media file, including each time it begins a new media file. the
+ * state MUST be modified under lock( ).
+ *
+ * with one stream there is nothing to share and dircache_init( ) does
+ * nothing. as long as in_miniroot_heuristic( ) in main.c holds, as it
+ * does on Linux, drive_init1( ) accepts only one destination, so the
+ * cache is never used there.
+ */
+#define DIRCACHE_NONE		0	/* not yet generated */
+#define DIRCACHE_BUILDING	1	/* being generated by one stream */
+#define DIRCACHE_READY		2	/* ready to be copied */
+#define DIRCACHE_FAILED		3	/* unusable: dump dirs directly */
+#define DIRCACHE_BUFSZ		( 1024 * 1024 )
+
+static intgen_t sc_dircachefd = -1;
+static intgen_t sc_dircachestate = DIRCACHE_NONE;
+static off64_t sc_dircachesz = 0;
+static size64_t sc_dircachedircnt = 0;
+static char *sc_dircachebufp = 0;
+static size_t sc_dircachebuflen = 0;
+static drive_t sc_dircachedrive;
+static drive_ops_t sc_dircacheops;
+
 static bool_t sc_savequotas = BOOL_TRUE;
 /* save quota information in dump
  */
@@ -547,6 +699,10 @@ content_init( intgen_t argc,
 	intgen_t qstat;
 	intgen_t rval;
 	bool_t ok;
+	bool_t perfstatpr;
+	size_t dynpartcnt;
+	size_t startptcnt;
+	bool_t samedynpartpr = BOOL_FALSE;
 	extern char *optarg;
 	extern int optind, opterr, optopt;
 #ifdef BASED
@@ -572,6 +728,7 @@ content_init( intgen_t argc,
 	ASSERT( sizeof( bstat_t ) == BSTAT_SZ );
 	ASSERT( sizeof( filehdr_t ) == FILEHDR_SZ );
 	ASSERT( sizeof( extenthdr_t ) == EXTENTHDR_SZ );
+	ASSERT( sizeof( extentref_t ) == EXTENTREF_SZ );
 	ASSERT( sizeof( direnthdr_t ) == DIRENTHDR_SZ );
 	ASSERT( DIRENTHDR_SZ % DIRENTHDR_ALIGN == 0 );
 	ASSERT( sizeofmember( content_hdr_t, ch_specific )
@@ -591,6 +748,8 @@ content_init( intgen_t argc,
 	optind = 1;
 	opterr = 0;
 	subtreecnt = 0;
+	perfstatpr = BOOL_FALSE;
+	dynpartcnt = 0;
 #ifdef BASED
 	baseuuidvalpr = BOOL_FALSE;
 #endif /* BASED */
@@ -681,6 +840,40 @@ content_init( intgen_t argc,
 		case GETOPT_DUMPASOFFLINE:
 			sc_dumpasoffline = BOOL_TRUE;
 			break;
+		case GETOPT_PERFSTAT:
+			perfstatpr = BOOL_TRUE;
+			break;
+		case GETOPT_DIRREF:
+			sc_dirrefpr = BOOL_TRUE;
+			break;
+		case GETOPT_TREECACHE:
+			sc_treecachepr = BOOL_TRUE;
+			break;
+		case GETOPT_DEDUP:
+			sc_deduppr = BOOL_TRUE;
+			break;
+		case GETOPT_METAONLY:
+			sc_metaonlypr = BOOL_TRUE;
+			break;
+		case GETOPT_DYNPART:
+			if ( ! optarg || optarg[ 0 ] == '-' ) {
+				mlog( MLOG_NORMAL | MLOG_ERROR, _(
+				      "-%c argument missing\n"),
+				      c );
+				usage( );
+				return BOOL_FALSE;
+			}
+			dynpartcnt = ( size_t )atoi( optarg );
+			if ( dynpartcnt < 1 || dynpartcnt > DYNPART_MAX ) {
+				mlog( MLOG_NORMAL | MLOG_ERROR, _(
+				      "-%c argument must be "
+				      "between 1 and %d\n"),
+				      c,
+				      DYNPART_MAX );
+				usage( );
+				return BOOL_FALSE;
+			}
+			break;
 #ifdef BASED
 		case GETOPT_BASED:
 			if ( ! optarg || optarg[ 0 ] == '-' ) {
@@ -705,6 +898,22 @@ content_init( intgen_t argc,
 		}
 	}
 
+	/* enable I/O stall accounting if requested. must be done before
+	 * the streams are created.
+	 */
+	perf_init( perfstatpr );
+
+	/* dynamic partitioning only makes sense with several streams
+	 */
+	if ( dynpartcnt && drivecnt > 1 ) {
+		sc_dynpartpr = BOOL_TRUE;
+		sc_dynchunkcnt = drivecnt * dynpartcnt;
+	} else if ( dynpartcnt ) {
+		mlog( MLOG_VERBOSE | MLOG_NOTE, _(
+		      "-%c ignored: only one dump stream\n"),
+		      GETOPT_DYNPART );
+	}
+
 #ifdef BASED
 	if ( resumereqpr && baseuuidvalpr ) {
 		mlog( MLOG_NORMAL | MLOG_ERROR, _(
@@ -918,6 +1127,7 @@ content_init( intgen_t argc,
 			uuid_copy (sameid, sessp->s_sesid);
 			samepartialpr = sessp->s_ispartial;
 			sameinterruptedpr = BOOL_TRUE;
+			samedynpartpr = ! sess_strmsordered( sessp );
 			sc_resumerangecnt =  ( size_t )sessp->s_nstreams;
 			sc_resumerangep = ( drange_t * )calloc( sc_resumerangecnt,
 								sizeof( drange_t ));
@@ -1063,6 +1273,7 @@ content_init( intgen_t argc,
 		uuid_copy(sameid, sessp->s_sesid);
 		samepartialpr = sessp->s_ispartial;
 		sameinterruptedpr = BOOL_FALSE;
+		samedynpartpr = ! sess_strmsordered( sessp );
 		sc_resumerangecnt =  ( size_t )sessp->s_nstreams;
 		sc_resumerangep = ( drange_t * )calloc( sc_resumerangecnt,
 						        sizeof( drange_t ));
@@ -1287,6 +1498,19 @@ baseuuidbypass:
 		}
 	}
 
+	/* the resume ranges are derived from the stream start points,
+	 * which only works if each stream dumped one contiguous range.
+	 */
+	if ( sc_resumepr && samedynpartpr ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR, _(
+		      "cannot resume interrupted level %d dump: "
+		      "its streams were given inode ranges "
+		      "dynamically (-%c)\n"),
+		      sc_level,
+		      GETOPT_DYNPART );
+		return BOOL_FALSE;
+	}
+
 	/* don't allow interrupted dumps of a lesser level to be bases
 	 */
 	if ( sc_incrpr && underinterruptedpr ) {
@@ -1454,8 +1678,40 @@ baseuuidbypass:
 	 */
 	sc_stat_inomapcnt = ( size64_t )fs_getinocnt( mntpnt );
 
-	sc_startptp = ( startpt_t * )calloc( drivecnt, sizeof( startpt_t ));
+	startptcnt = sc_dynpartpr ? sc_dynchunkcnt : drivecnt;
+	sc_startptp = ( startpt_t * )calloc( startptcnt, sizeof( startpt_t ));
 	ASSERT( sc_startptp );
+	if ( sc_treecachepr ) {
+		treecache_init( &fsid, ( time32_t )time( 0 ));
+	}
+
+	/* the list of files restored by this dump is only of use to a
+	 * later dump based on it: it must cover the whole file system,
+	 * be in the inventory and not be resumed, which keeps no record
+	 * of the files dumped before the interruption.
+	 */
+	if ( sc_metaonlypr && ( subtreecnt || ! sc_inv_updatepr || sc_resumepr )) {
+		mlog( MLOG_VERBOSE | MLOG_NOTE, _(
+		      "-%c ignored: %s\n"),
+		      GETOPT_METAONLY,
+		      subtreecnt
+		      ?
+		      _("subtree dump")
+		      :
+		      ( ! sc_inv_updatepr
+			?
+			_("inventory not updated")
+			:
+			_("resumed dump") ));
+		sc_metaonlypr = BOOL_FALSE;
+	}
+	if ( sc_metaonlypr ) {
+		inolist_init( sc_fshandlep,
+			      &fsid,
+			      &gwhdrtemplatep->gh_dumpid,
+			      sc_incrpr ? &sc_incrbaseid : 0,
+			      sc_incrbasetime );
+	}
 	ok = inomap_build( sc_fshandlep,
 			   sc_fsfd,
 			   sc_rootxfsstatp,
@@ -1468,22 +1724,61 @@ baseuuidbypass:
 			   subtreep,
 			   subtreecnt,
 			   sc_startptp,
-			   drivecnt,
+			   startptcnt,
 			   &sc_stat_inomapphase,
 			   &sc_stat_inomappass,
 			   sc_stat_inomapcnt,
 			   &sc_stat_inomapdone );
+	if ( sc_treecachepr ) {
+		treecache_end( ok );
+	}
+	if ( sc_metaonlypr && ! ok ) {
+		inolist_end( BOOL_FALSE );
+	}
 	free( ( void * )subtreep );
 	subtreep = 0;
 	if ( ! ok ) {
 		return BOOL_FALSE;
 	}
+
+	/* inomap_build( ) stops placing start points when it runs out
+	 * of data, leaving the rest zeroed. only the first chunk may
+	 * legitimately begin at ino zero. the first drivecnt chunks are
+	 * handed to the streams directly, the rest are claimed as the
+	 * streams run dry.
+	 */
+	if ( sc_dynpartpr ) {
+		ix_t chunkix;
+
+		for ( chunkix = 1 ; chunkix < sc_dynchunkcnt ; chunkix++ ) {
+			if ( sc_startptp[ chunkix ].sp_ino == 0 ) {
+				break;
+			}
+		}
+		sc_dynchunkcnt = chunkix;
+		sc_dynchunknext = min( drivecnt, sc_dynchunkcnt );
+		mlog( MLOG_VERBOSE, _(
+		      "non-directory files divided into %u ranges "
+		      "for %u streams\n"),
+		      sc_dynchunkcnt,
+		      drivecnt );
+	}
 	
 	/* ask var to ask inomap to skip files under var if var is in
 	 * the fs being dumped
 	 */
 	var_skip( &fsid, inomap_skip );
 
+	/* unchanged directories can only be left out if restore has a
+	 * base dump to take their entries from
+	 */
+	if ( sc_dirrefpr && ! sc_incrpr && ! sc_resumepr ) {
+		mlog( MLOG_VERBOSE | MLOG_NOTE, _(
+		      "-%c ignored: not an incremental or resumed dump\n"),
+		      GETOPT_DIRREF );
+		sc_dirrefpr = BOOL_FALSE;
+	}
+
 	/* fill in write header template content info. always produce
 	 * an inomap and dir dump for each media file. flag the checksums
 	 * available if so compiled (see -D...CHECKSUM in Makefile).
@@ -1500,6 +1795,31 @@ baseuuidbypass:
 	if ( sc_inv_updatepr ) {
 		scwhdrtemplatep->cih_dumpattr |= CIH_DUMPATTR_INVENTORY;
 	}
+	if ( sc_dynpartpr ) {
+		scwhdrtemplatep->cih_dumpattr |= CIH_DUMPATTR_DYNPART;
+	}
+	if ( sc_dirrefpr ) {
+		scwhdrtemplatep->cih_dumpattr |= CIH_DUMPATTR_DIRREF;
+	}
+	if ( sc_deduppr ) {
+		scwhdrtemplatep->cih_dumpattr |= CIH_DUMPATTR_DEDUP;
+	}
+	if ( sc_metaonlypr && inolist_base( )) {
+		scwhdrtemplatep->cih_dumpattr |= CIH_DUMPATTR_METAONLY;
+	}
+
+	/* an older xfsrestore would misread these dumps rather than
+	 * refuse them: mark them with a header version it does not know
+	 */
+	if ( scwhdrtemplatep->cih_dumpattr
+	     &
+	     ( CIH_DUMPATTR_DIRREF
+	       |
+	       CIH_DUMPATTR_DEDUP
+	       |
+	       CIH_DUMPATTR_METAONLY )) {
+		gwhdrtemplatep->gh_version = GLOBAL_HDR_VERSION_3;
+	}
 #ifdef FILEHDR_CHECKSUM
 	scwhdrtemplatep->cih_dumpattr |= CIH_DUMPATTR_FILEHDR_CHECKSUM;
 #endif /* FILEHDR_CHECKSUM */
@@ -1594,7 +1914,7 @@ baseuuidbypass:
 			    ( extenthdr_t * )calloc( 1, sizeof( extenthdr_t ));
 		ASSERT( contextp->cc_extenthdrp );
 
-		contextp->cc_getdentsbufsz = sizeof( struct dirent )
+		contextp->cc_getdentsbufsz = sizeof( struct dirent64 )
 					       +
 					       NAME_MAX + 1;
 		if ( contextp->cc_getdentsbufsz < GETDENTSBUF_SZ_MIN ) {
@@ -1604,6 +1924,33 @@ baseuuidbypass:
 			   ( char * ) calloc( 1, contextp->cc_getdentsbufsz );
 		ASSERT( contextp->cc_getdentsbufp );
 
+		contextp->cc_genbufp =
+			( xfs_bstat_t * )calloc( GENBUF_LEN,
+						 sizeof( xfs_bstat_t ));
+		ASSERT( contextp->cc_genbufp );
+		contextp->cc_genbuflen = 0;
+
+		if ( sc_deduppr ) {
+			contextp->cc_dedupp = dedup_create( );
+			contextp->cc_dedupbufp =
+				( char * )malloc( DEDUP_CHUNKSZ );
+			if ( ! contextp->cc_dedupp
+			     ||
+			     ! contextp->cc_dedupbufp ) {
+				mlog( MLOG_NORMAL | MLOG_WARNING, _(
+				      "unable to allocate dedup index "
+				      "for stream %u: "
+				      "dumping all file data\n"),
+				      ( u_intgen_t )strmix );
+				if ( contextp->cc_dedupp ) {
+					dedup_destroy( contextp->cc_dedupp );
+					contextp->cc_dedupp = 0;
+				}
+				free( ( void * )contextp->cc_dedupbufp );
+				contextp->cc_dedupbufp = 0;
+			}
+		}
+
 		contextp->cc_mdirentbufsz = sizeof( direnthdr_t  )
 					    +
 					    NAME_MAX + 1
@@ -1643,6 +1990,12 @@ baseuuidbypass:
 		ASSERT( contextp->cc_readlinkbufp );
 
 		contextp->cc_inomap_contextp = inomap_alloc_context( );
+
+		if ( sc_dynpartpr ) {
+			contextp->cc_dynchunkixp =
+			    ( ix_t * )calloc( sc_dynchunkcnt, sizeof( ix_t ));
+			ASSERT( contextp->cc_dynchunkixp );
+		}
 	}
 
 	/* look for command line media labels. these will be assigned
@@ -1813,6 +2166,10 @@ baseuuidbypass:
 		ix_t driveix;
 		for ( driveix = 0 ; driveix < STREAM_SIMMAX ; driveix++ ) {
 			sc_stat_pds[ driveix ].pds_phase = PDS_NULL;
+			sc_stat_pds[ driveix ].pds_datadone = 0;
+			sc_stat_pds[ driveix ].pds_nondirstart = 0;
+			sc_stat_pds[ driveix ].pds_dirstart = 0;
+			sc_stat_pds[ driveix ].pds_dirend = 0;
 		}
 	}
 
@@ -1831,12 +2188,36 @@ baseuuidbypass:
 
 #endif /* SYNCDIR */
 
+	/* prepare to generate the directory section only once
+	 */
+	dircache_init( );
 
 	return BOOL_TRUE;
 }
 
 #define STATLINESZ	160
 
+/* directories per second dumped by a stream in its current or most
+ * recent directory phase
+ */
+static double
+dirrate( pds_t *pdsp, time_t now )
+{
+	time_t end;
+
+	if ( ! pdsp->pds_dirstart ) {
+		return 0.0;
+	}
+	end = pdsp->pds_dirend ? ( time_t )pdsp->pds_dirend : now;
+	if ( end <= ( time_t )pdsp->pds_dirstart ) {
+		return 0.0;
+	}
+
+	return ( double )pdsp->pds_dirdone
+	       /
+	       ( double )( end - ( time_t )pdsp->pds_dirstart );
+}
+
 size_t
 content_statline( char **linespp[ ] )
 {
@@ -1986,9 +2367,10 @@ content_statline( char **linespp[ ] )
 		case PDS_DIRDUMP:
 			sprintf( &statline[ statlinecnt ]
 					  [ strlen( statline[ statlinecnt ] ) ],
-				 "%llu/%llu directories dumped",
+				 "%llu/%llu directories dumped, %.0f dirs/sec",
 				 (unsigned long long)pdsp->pds_dirdone,
-				 (unsigned long long)sc_stat_dircnt );
+				 (unsigned long long)sc_stat_dircnt,
+				 dirrate( pdsp, now ));
 			break;
 		case PDS_INVSYNC:
 			strcat( statline[ statlinecnt ],
@@ -2015,6 +2397,160 @@ content_statline( char **linespp[ ] )
 	return statlinecnt;
 }
 
+/* names of the per-drive phases, used in progress records.
+ * must match order of pds_phase enum.
+ */
+static char *pds_phasestr[ ] = {
+	"null",
+	"inomap",
+	"dirrendezvous",
+	"dirdump",
+	"nondir",
+	"invsync",
+	"invdump",
+	"termdump"
+};
+
+size_t
+content_statrec( char *buf, size_t bufsz )
+{
+	size64_t nondirdone;
+	size64_t datadone;
+	size64_t pdsdatadone[ STREAM_SIMMAX ];
+	time32_t nondirstart;
+	time_t elapsed;
+	time_t now;
+	double percent;
+	double rate;
+	long eta;
+	size_t len;
+	ix_t i;
+
+	if ( ! sc_stat_starttime ) {
+		return 0;
+	}
+
+	now = time( 0 );
+	elapsed = now - sc_stat_starttime;
+
+	lock( );
+	nondirdone = sc_stat_nondirdone;
+	datadone = sc_stat_datadone;
+	for ( i = 0 ; i < drivecnt ; i++ ) {
+		pdsdatadone[ i ] = sc_stat_pds[ i ].pds_datadone;
+	}
+	unlock( );
+
+	if ( sc_stat_datasz ) {
+		percent = ( double )datadone / ( double )sc_stat_datasz;
+		percent *= 100.0;
+		if ( percent > 100.0 ) {
+			percent = 100.0;
+		}
+	} else {
+		percent = 0.0;
+	}
+
+	/* base the aggregate rate and the ETA on the earliest start of
+	 * the non-dir phase; the inomap and directory phases move no data.
+	 */
+	nondirstart = 0;
+	for ( i = 0 ; i < drivecnt ; i++ ) {
+		time32_t start = sc_stat_pds[ i ].pds_nondirstart;
+		if ( start && ( ! nondirstart || start < nondirstart )) {
+			nondirstart = start;
+		}
+	}
+	rate = 0.0;
+	eta = -1;
+	if ( nondirstart && now > nondirstart ) {
+		rate = ( double )datadone / ( double )( now - nondirstart );
+		if ( rate > 0.0 && sc_stat_datasz >= datadone ) {
+			eta = ( long )( ( double )( sc_stat_datasz - datadone )
+					/
+					rate );
+		}
+	}
+
+	len = ( size_t )snprintf( buf,
+				  bufsz,
+				  "{\"prog\":\"xfsdump\","
+				  "\"time\":%ld,"
+				  "\"elapsed\":%ld,"
+				  "\"inomap_phase\":%u,"
+				  "\"inomap_pass\":%u,"
+				  "\"inomap_done\":%llu,"
+				  "\"inomap_cnt\":%llu,"
+				  "\"dirs_total\":%llu,"
+				  "\"inodes_done\":%llu,"
+				  "\"inodes_total\":%llu,"
+				  "\"bytes_done\":%llu,"
+				  "\"bytes_total\":%llu,"
+				  "\"percent\":%.1f,"
+				  "\"rate\":%.0f,"
+				  "\"eta\":%ld,"
+				  "\"drives\":[",
+				  ( long )now,
+				  ( long )elapsed,
+				  ( unsigned int )sc_stat_inomapphase,
+				  ( unsigned int )sc_stat_inomappass,
+				  ( unsigned long long )sc_stat_inomapdone,
+				  ( unsigned long long )sc_stat_inomapcnt,
+				  ( unsigned long long )sc_stat_dircnt,
+				  ( unsigned long long )nondirdone,
+				  ( unsigned long long )sc_stat_nondircnt,
+				  ( unsigned long long )datadone,
+				  ( unsigned long long )sc_stat_datasz,
+				  percent,
+				  rate,
+				  eta );
+
+	for ( i = 0 ; i < drivecnt && len < bufsz ; i++ ) {
+		pds_t *pdsp = &sc_stat_pds[ i ];
+		drive_hdr_t *dwhdrp = drivepp[ i ]->d_writehdrp;
+		media_hdr_t *mwhdrp = ( media_hdr_t * )dwhdrp->dh_upper;
+		double drate = 0.0;
+
+		if ( pdsp->pds_nondirstart && now > pdsp->pds_nondirstart ) {
+			drate = ( double )pdsdatadone[ i ]
+				/
+				( double )( now - pdsp->pds_nondirstart );
+		}
+		len += ( size_t )snprintf( buf + len,
+					   bufsz - len,
+					   "%s{\"drive\":%u,"
+					   "\"phase\":\"%s\","
+					   "\"dirs_done\":%llu,"
+					   "\"dir_rate\":%.0f,"
+					   "\"bytes_done\":%llu,"
+					   "\"rate\":%.0f,"
+					   "\"dumpfile\":%d,"
+					   "\"mediafile\":%d}",
+					   i ? "," : "",
+					   ( unsigned int )i,
+					   pds_phasestr[ pdsp->pds_phase ],
+					   ( unsigned long long )
+					   pdsp->pds_dirdone,
+					   dirrate( pdsp, now ),
+					   ( unsigned long long )
+					   pdsdatadone[ i ],
+					   drate,
+					   ( intgen_t )mwhdrp->mh_dumpfileix,
+					   ( intgen_t )mwhdrp->mh_mediafileix );
+	}
+	if ( len < bufsz ) {
+		len += ( size_t )snprintf( buf + len, bufsz - len, "]}\n" );
+	}
+
+	/* a truncated record is useless to a parser; drop it
+	 */
+	if ( len >= bufsz ) {
+		return 0;
+	}
+
+	return len;
+}
+
 static void
 mark_set( drive_t *drivep, xfs_ino_t ino, off64_t offset, int32_t flags )
 {
@@ -2039,6 +2575,13 @@ mark_set( drive_t *drivep, xfs_ino_t ino, off64_t offset, int32_t flags )
 	markp->startpt.sp_ino = ino;
 	markp->startpt.sp_offset = offset;
 	markp->startpt.sp_flags = flags;
+
+	/* tell the drive when a file begins at the mark, so it may
+	 * index the media file
+	 */
+	if ( offset == 0 && flags == 0 ) {
+		markp->dm.dm_ino = ino;
+	}
 	( * dop->do_set_mark )( drivep,
 				mark_callback,
 				( void * )drivep->d_index,
@@ -2176,11 +2719,33 @@ content_stream_dump( ix_t strmix )
 
 	/* fill in write hdr stream start and end points
 	 */
-	scwhdrp->cih_startpt = sc_startptp[ strmix ];
-	if ( strmix < drivecnt - 1 ) {
-		scwhdrp->cih_endpt = sc_startptp[ strmix + 1 ];
+	if ( sc_dynpartpr ) {
+		contextp->cc_dynchunkcnt = 0;
+		contextp->cc_dynchunkcur = 0;
+		if ( strmix < sc_dynchunkcnt ) {
+			contextp->cc_dynchunkixp[ 0 ] = strmix;
+			contextp->cc_dynchunkcnt = 1;
+		} else {
+			( void )dynpart_claim( contextp );
+		}
+		if ( contextp->cc_dynchunkcnt ) {
+			scwhdrp->cih_startpt =
+			       sc_startptp[ contextp->cc_dynchunkixp[ 0 ]];
+			dynpart_setrange( contextp, scwhdrp );
+		} else {
+			/* fewer chunks than streams: nothing to dump
+			 */
+			scwhdrp->cih_startpt.sp_ino = INO64MAX;
+			scwhdrp->cih_startpt.sp_offset = 0;
+			scwhdrp->cih_endpt.sp_flags = STARTPT_FLAGS_END;
+		}
 	} else {
-		scwhdrp->cih_endpt.sp_flags = STARTPT_FLAGS_END;
+		scwhdrp->cih_startpt = sc_startptp[ strmix ];
+		if ( strmix < drivecnt - 1 ) {
+			scwhdrp->cih_endpt = sc_startptp[ strmix + 1 ];
+		} else {
+			scwhdrp->cih_endpt.sp_flags = STARTPT_FLAGS_END;
+		}
 	}
 
 	/* fill in inomap fields of write hdr
@@ -2217,6 +2782,7 @@ content_stream_dump( ix_t strmix )
 	 */
 	for ( ; ; ) {
 		xfs_ino_t startino;
+		xfs_ino_t iterino;
 		bool_t stop_requested;
 		bool_t hit_eom;
 		bool_t all_dirs_committed;
@@ -2249,6 +2815,13 @@ content_stream_dump( ix_t strmix )
 		 */
 		scwhdrp->cih_startpt.sp_flags &= ~STARTPT_FLAGS_NULL;
 
+		/* the media file may begin in any chunk this stream has
+		 * claimed so far. the header must say which.
+		 */
+		if ( sc_dynpartpr ) {
+			dynpart_locate( contextp, scwhdrp );
+		}
+
 		/* save the original start points, to be given to
 		 * the inventory at the end of each media file.
 		 */
@@ -2264,6 +2837,16 @@ content_stream_dump( ix_t strmix )
 		 */
 		contextp->cc_mfilesz = 0;
 
+		/* references may only be made to data in the same media
+		 * file: forget the chunks dumped in the last one.
+		 */
+		if ( contextp->cc_dedupp ) {
+			dedup_reset( contextp->cc_dedupp );
+			contextp->cc_dedupchunkcnt = 0;
+			contextp->cc_deduprefcnt = 0;
+			contextp->cc_deduprefbytes = 0;
+		}
+
 		/* tell the Media abstraction to position a media object
 		 * and begin a new media file. This will dump the media
 		 * file header if successful.
@@ -2353,10 +2936,31 @@ content_stream_dump( ix_t strmix )
 		 * for each directory in the bitmap.
 		 */
 		sc_stat_pds[ strmix ].pds_dirdone = 0;
-		rv = dump_dirs( strmix,
-				bstatbufp,
-				bstatbuflen,
-				inomap_contextp );
+		sc_stat_pds[ strmix ].pds_dirstart = time( 0 );
+		sc_stat_pds[ strmix ].pds_dirend = 0;
+		if ( sc_dircachefd >= 0 ) {
+			rv = dircache_dump( strmix,
+					    drivep,
+					    bstatbufp,
+					    bstatbuflen,
+					    inomap_contextp );
+		} else {
+			rv = dump_dirs( strmix,
+					drivep,
+					bstatbufp,
+					bstatbuflen,
+					inomap_contextp );
+		}
+		sc_stat_pds[ strmix ].pds_dirend = time( 0 );
+		if ( rv == RV_OK ) {
+			pds_t *pdsp = &sc_stat_pds[ strmix ];
+			mlog( MLOG_VERBOSE, _(
+			      "directory phase: %llu directories "
+			      "in %ld seconds (%.0f dirs/sec)\n"),
+			      ( unsigned long long )pdsp->pds_dirdone,
+			      ( long )( pdsp->pds_dirend - pdsp->pds_dirstart ),
+			      dirrate( pdsp, pdsp->pds_dirend ));
+		}
 		if ( rv == RV_INTR ) {
 			stop_requested = BOOL_TRUE;
 			goto decision_more;
@@ -2394,52 +2998,70 @@ content_stream_dump( ix_t strmix )
 			mlog( MLOG_VERBOSE, _(
 			      "dumping non-directory files\n") );
 			sc_stat_pds[ strmix ].pds_phase = PDS_NONDIR;
-			rv = RV_OK;
-			inomap_reset_context(inomap_contextp);
-			rval = bigstat_iter( sc_fshandlep,
-					     sc_fsfd,
-					     BIGSTAT_ITER_NONDIR,
-					     scwhdrp->cih_startpt.sp_ino,
-					     ( bstat_cbfp_t )dump_file,
-					     ( void * )strmix,
-					     inomap_next_nondir,
-					     inomap_contextp,
-					     ( intgen_t * )&rv,
-					     ( miniroot || pipeline ) ?
-					       (bool_t (*)(int))preemptchk : 0,
-					     bstatbufp,
-					     bstatbuflen );
-			if ( rval ) {
-				free( ( void * )bstatbufp );
-				return mlog_exit(EXIT_FAULT, RV_CORE);
-			}
-			if ( rv == RV_INTR ) {
-				stop_requested = BOOL_TRUE;
-				goto decision_more;
-			}
-			if ( rv == RV_EOM ) {
-				hit_eom = BOOL_TRUE;
-				goto decision_more;
+			if ( ! sc_stat_pds[ strmix ].pds_nondirstart ) {
+				sc_stat_pds[ strmix ].pds_nondirstart =
+								time( 0 );
 			}
-			if ( rv == RV_EOF ) {
-				goto decision_more;
-			}
-			if ( rv == RV_DRIVE ) {
-				free( ( void * )bstatbufp );
-				return mlog_exit(EXIT_NORMAL, rv);
-			}
-			if ( rv == RV_ERROR ) {
-				free( ( void * )bstatbufp );
-				return mlog_exit(EXIT_ERROR, rv);
-			}
-			if ( rv == RV_CORE ) {
-				free( ( void * )bstatbufp );
-				return mlog_exit(EXIT_FAULT, rv);
-			}
-			ASSERT( rv == RV_OK || rv == RV_NOMORE );
-			if ( rv != RV_OK && rv != RV_NOMORE ) {
-				free( ( void * )bstatbufp );
-				return mlog_exit(EXIT_FAULT, rv);
+			iterino = scwhdrp->cih_startpt.sp_ino;
+			for ( ; ; ) {
+				rv = RV_OK;
+				inomap_reset_context(inomap_contextp);
+				rval = bigstat_iter( sc_fshandlep,
+						     sc_fsfd,
+						     BIGSTAT_ITER_NONDIR,
+						     iterino,
+						     ( bstat_cbfp_t )dump_file,
+						     ( void * )strmix,
+						     inomap_next_nondir,
+						     inomap_contextp,
+						     ( intgen_t * )&rv,
+						     ( miniroot || pipeline ) ?
+						       (bool_t (*)(int))preemptchk : 0,
+						     bstatbufp,
+						     bstatbuflen );
+				if ( rval ) {
+					free( ( void * )bstatbufp );
+					return mlog_exit(EXIT_FAULT, RV_CORE);
+				}
+				if ( rv == RV_INTR ) {
+					stop_requested = BOOL_TRUE;
+					goto decision_more;
+				}
+				if ( rv == RV_EOM ) {
+					hit_eom = BOOL_TRUE;
+					goto decision_more;
+				}
+				if ( rv == RV_EOF ) {
+					goto decision_more;
+				}
+				if ( rv == RV_DRIVE ) {
+					free( ( void * )bstatbufp );
+					return mlog_exit(EXIT_NORMAL, rv);
+				}
+				if ( rv == RV_ERROR ) {
+					free( ( void * )bstatbufp );
+					return mlog_exit(EXIT_ERROR, rv);
+				}
+				if ( rv == RV_CORE ) {
+					free( ( void * )bstatbufp );
+					return mlog_exit(EXIT_FAULT, rv);
+				}
+				ASSERT( rv == RV_OK || rv == RV_NOMORE );
+				if ( rv != RV_OK && rv != RV_NOMORE ) {
+					free( ( void * )bstatbufp );
+					return mlog_exit(EXIT_FAULT, rv);
+				}
+
+				/* if dynamically partitioned, go on to the
+				 * next chunk claimed by or available to this
+				 * stream
+				 */
+				if ( ! sc_dynpartpr
+				     ||
+				     ! dynpart_next( contextp, scwhdrp )) {
+					break;
+				}
+				iterino = contextp->cc_dynstartpt.sp_ino;
 			}
 		}
 
@@ -2529,6 +3151,14 @@ decision_more:
 		mlog( MLOG_VERBOSE, _(
 		      "media file size %lld bytes\n"),
 		      ncommitted );
+		if ( contextp->cc_dedupp ) {
+			mlog( MLOG_VERBOSE, _(
+			      "%llu of %llu file data chunks dumped "
+			      "as references, %llu bytes not dumped\n"),
+			      contextp->cc_deduprefcnt,
+			      contextp->cc_dedupchunkcnt,
+			      contextp->cc_deduprefbytes );
+		}
 
 		/* if at least one mark committed, we know all of
 		 * the inomap and dirdump was committed.
@@ -2714,6 +3344,20 @@ content_complete( void )
 	      "dump size (non-dir files) : %llu bytes\n"),
 	      sc_stat_datadone );
 
+	/* final I/O stall accounting, if requested (-k)
+	 */
+	perf_report( );
+	perf_summary( );
+
+	if ( sc_dircachefd >= 0 ) {
+		( void )close( sc_dircachefd );
+		sc_dircachefd = -1;
+	}
+
+	if ( sc_metaonlypr ) {
+		inolist_end( completepr );
+	}
+
 	if ( completepr ) {
 		if( sc_savequotas ) {
 			for(i = 0; i < (sizeof(quotas) / sizeof(quotas[0])); i++) {
@@ -2840,6 +3484,7 @@ update_cc_Media_useterminatorpr( drive_t *drivep, context_t *contextp )
 
 static rv_t
 dump_dirs( ix_t strmix,
+	   drive_t *drivep,
 	   xfs_bstat_t *bstatbufp,
 	   size_t bstatbuflen,
 	   void *inomap_contextp )
@@ -2847,6 +3492,7 @@ dump_dirs( ix_t strmix,
 	xfs_ino_t lastino;
 	size_t bulkstatcallcnt;
         xfs_fsop_bulkreq_t bulkreq;
+	perf_timer_t perftimer;
 
 	inomap_reset_context(inomap_contextp);
 
@@ -2860,9 +3506,14 @@ dump_dirs( ix_t strmix,
 		intgen_t rval;
 
 #ifdef SYNCDIR
-		/* have all threads rendezvous
+		/* have all threads rendezvous. not when generating the
+		 * directory cache: the other streams are waiting for it.
 		 */
-		if ( sc_thrdsdirdumpsynccnt > 1 && stream_cnt( ) > 1 ) {
+		if ( sc_thrdsdirdumpsynccnt > 1
+		     &&
+		     stream_cnt( ) > 1
+		     &&
+		     drivep != &sc_dircachedrive ) {
 			rv_t rv;
 			mlog( bulkstatcallcnt == 0 ? MLOG_VERBOSE : MLOG_NITTY,
 			      _("waiting for synchronized directory dump\n") );
@@ -2899,7 +3550,9 @@ dump_dirs( ix_t strmix,
 		bulkreq.ubuffer = bstatbufp;
 		bulkreq.ocount = &buflenout;
 
+		perf_begin( &perftimer );
 		rval = ioctl(sc_fsfd, XFS_IOC_FSBULKSTAT, &bulkreq);
+		perf_end( ( intgen_t )strmix, PERF_BULKSTAT, &perftimer, 0 );
 
 		if ( rval ) {
 			mlog( MLOG_NORMAL, _(
@@ -2955,7 +3608,7 @@ dump_dirs( ix_t strmix,
 				continue;
 			}
                         
-			rv = dump_dir( strmix, sc_fshandlep, sc_fsfd, p );
+			rv = dump_dir( strmix, drivep, sc_fshandlep, sc_fsfd, p );
 			if ( rv != RV_OK ) {
 				return rv;
 			}
@@ -3026,55 +3679,314 @@ dump_dirs_rendezvous( void )
 }
 #endif /* SYNCDIR */
 
-static rv_t
-dump_dir( ix_t strmix,
-	  jdm_fshandle_t *fshandlep,
-	  intgen_t fsfd,
-	  xfs_bstat_t *statp )
+static void
+dircache_init( void )
 {
-	context_t *contextp = &sc_contextp[ strmix ];
-	drive_t *drivep = drivepp[ strmix ];
-	void *inomap_contextp = contextp->cc_inomap_contextp;
-	intgen_t state;
-	intgen_t fd;
-	struct dirent *gdp = ( struct dirent *)contextp->cc_getdentsbufp;
-	size_t gdsz = contextp->cc_getdentsbufsz;
-	intgen_t gdcnt;
-	u_int32_t gen;
-	rv_t rv;
+	char *tmpdir;
+	char path[ MAXPATHLEN ];
 
-	/* no way this can be non-dir, but check anyway
+	/* always so when single-threaded (miniroot)
 	 */
-	ASSERT( ( statp->bs_mode & S_IFMT ) == S_IFDIR );
-	if ( ( statp->bs_mode & S_IFMT ) != S_IFDIR ) {
-		return RV_OK;
+	if ( drivecnt <= 1 ) {
+		return;
 	}
 
-	/* skip if no links
-	 */
-	if ( statp->bs_nlink < 1 ) {
-		return RV_OK;
+	tmpdir = getenv( "TMPDIR" );
+	if ( ! tmpdir || ! *tmpdir ) {
+		tmpdir = "/tmp";
+	}
+	( void )snprintf( path,
+			  sizeof( path ),
+			  "%s/xfsdumpdirsXXXXXX",
+			  tmpdir );
+	sc_dircachefd = mkstemp( path );
+	if ( sc_dircachefd < 0 ) {
+		mlog( MLOG_VERBOSE | MLOG_WARNING, _(
+		      "unable to create directory cache in %s: %s: "
+		      "each stream will dump directories itself\n"),
+		      tmpdir,
+		      strerror( errno ));
+		return;
 	}
+	( void )unlink( path );
 
-	/* see what the inomap says about this ino
-	 */
-	state = inomap_get_state( inomap_contextp, statp->bs_ino );
+	sc_dircachebufp = ( char * )malloc( DIRCACHE_BUFSZ );
+	ASSERT( sc_dircachebufp );
+	sc_dircachebuflen = 0;
+	sc_dircachesz = 0;
 
-	/* skip if not in inomap
-	 */
-	if ( state == MAP_INO_UNUSED
-	     ||
-	     state == MAP_DIR_NOCHNG
-	     ||
-	     state == MAP_NDR_NOCHNG ) {
-		if ( state == MAP_NDR_NOCHNG ) {
-			mlog( MLOG_DEBUG,
-			      "inomap inconsistency ino %llu: "
-			      "map says is non-dir but is dir: skipping\n",
-			      statp->bs_ino );
-		}
-		return RV_OK;
-	}
+	memset( ( void * )&sc_dircacheops, 0, sizeof( sc_dircacheops ));
+	sc_dircacheops.do_get_write_buf = dircache_get_write_buf;
+	sc_dircacheops.do_write = dircache_write;
+	memset( ( void * )&sc_dircachedrive, 0, sizeof( sc_dircachedrive ));
+	sc_dircachedrive.d_opsp = &sc_dircacheops;
+
+	sc_dircachestate = DIRCACHE_NONE;
+}
+
+static rv_t
+dircache_dump( ix_t strmix,
+	       drive_t *drivep,
+	       xfs_bstat_t *bstatbufp,
+	       size_t bstatbuflen,
+	       void *inomap_contextp )
+{
+	intgen_t state;
+	rv_t rv;
+
+	lock( );
+	state = sc_dircachestate;
+	if ( state == DIRCACHE_NONE ) {
+		sc_dircachestate = DIRCACHE_BUILDING;
+	}
+	unlock( );
+
+	/* the first stream here generates the cache
+	 */
+	if ( state == DIRCACHE_NONE ) {
+		sc_dircachedrive.d_index = strmix;
+		rv = dump_dirs( strmix,
+				&sc_dircachedrive,
+				bstatbufp,
+				bstatbuflen,
+				inomap_contextp );
+		if ( rv == RV_OK && ! dircache_flush( )) {
+			rv = RV_DRIVE;
+		}
+		free( ( void * )sc_dircachebufp );
+		sc_dircachebufp = 0;
+
+		if ( rv == RV_OK ) {
+			sc_dircachedircnt = sc_stat_pds[ strmix ].pds_dirdone;
+			mlog( MLOG_VERBOSE, _(
+			      "directory cache holds %llu directories "
+			      "in %lld bytes\n"),
+			      sc_dircachedircnt,
+			      sc_dircachesz );
+			state = DIRCACHE_READY;
+		} else {
+			state = DIRCACHE_FAILED;
+		}
+		lock( );
+		sc_dircachestate = state;
+		unlock( );
+
+		/* RV_DRIVE can only come from the cache file
+		 */
+		if ( rv == RV_DRIVE ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "directory cache unusable: "
+			      "each stream will dump directories itself\n") );
+		} else if ( rv != RV_OK ) {
+			return rv;
+		}
+	}
+
+	/* wait for the generating stream
+	 */
+	while ( state == DIRCACHE_BUILDING ) {
+		sc_stat_pds[ strmix ].pds_phase = PDS_DIRRENDEZVOUS;
+		sleep( 1 );
+		if ( cldmgr_stop_requested( )) {
+			return RV_INTR;
+		}
+		lock( );
+		state = sc_dircachestate;
+		unlock( );
+	}
+
+	sc_stat_pds[ strmix ].pds_dirdone = 0;
+	if ( state == DIRCACHE_FAILED ) {
+		return dump_dirs( strmix,
+				  drivep,
+				  bstatbufp,
+				  bstatbuflen,
+				  inomap_contextp );
+	}
+
+	ASSERT( state == DIRCACHE_READY );
+	return dircache_copy( strmix, drivep );
+}
+
+/* copies the cached directory section to the stream's media file
+ */
+static rv_t
+dircache_copy( ix_t strmix, drive_t *drivep )
+{
+	drive_ops_t *dop = drivep->d_opsp;
+	char *bufp;
+	off64_t off;
+	rv_t rv;
+
+	mlog( MLOG_VERBOSE, _(
+	      "dumping directories from directory cache\n") );
+	sc_stat_pds[ strmix ].pds_phase = PDS_DIRDUMP;
+
+	bufp = ( char * )malloc( DIRCACHE_BUFSZ );
+	ASSERT( bufp );
+
+	rv = RV_OK;
+	for ( off = 0 ; off < sc_dircachesz ; ) {
+		size_t cnt;
+		ssize_t nread;
+		intgen_t rval;
+
+		if ( cldmgr_stop_requested( )) {
+			rv = RV_INTR;
+			break;
+		}
+
+		cnt = ( size_t )min( ( off64_t )DIRCACHE_BUFSZ,
+				     sc_dircachesz - off );
+		nread = pread64( sc_dircachefd, bufp, cnt, off );
+		if ( nread != ( ssize_t )cnt ) {
+			mlog( MLOG_NORMAL | MLOG_ERROR, _(
+			      "unable to read directory cache: %s\n"),
+			      nread < 0 ? strerror( errno ) : _("short read") );
+			rv = RV_ERROR;
+			break;
+		}
+
+		rval = write_buf( bufp,
+				  cnt,
+				  ( void * )drivep,
+				  ( gwbfp_t )dop->do_get_write_buf,
+				  ( wfp_t )dop->do_write );
+		switch ( rval ) {
+		case 0:
+			rv = RV_OK;
+			break;
+		case DRIVE_ERROR_MEDIA:
+		case DRIVE_ERROR_EOM:
+			rv = RV_EOM;
+			break;
+		case DRIVE_ERROR_DEVICE:
+			rv = RV_DRIVE;
+			break;
+		case DRIVE_ERROR_CORE:
+		default:
+			rv = RV_CORE;
+			break;
+		}
+		if ( rv != RV_OK ) {
+			break;
+		}
+		off += ( off64_t )cnt;
+	}
+
+	free( ( void * )bufp );
+
+	if ( rv == RV_OK ) {
+		sc_stat_pds[ strmix ].pds_dirdone = sc_dircachedircnt;
+	}
+
+	return rv;
+}
+
+/* do_get_write_buf and do_write of the pseudo drive used to generate
+ * the directory cache. buffers writes to the cache file.
+ */
+/* ARGSUSED */
+static char *
+dircache_get_write_buf( drive_t *drivep, size_t wantedcnt, size_t *actualcntp )
+{
+	size_t remaining;
+
+	ASSERT( drivep == &sc_dircachedrive );
+	ASSERT( sc_dircachebuflen < DIRCACHE_BUFSZ );
+
+	remaining = DIRCACHE_BUFSZ - sc_dircachebuflen;
+	*actualcntp = min( wantedcnt, remaining );
+
+	return sc_dircachebufp + sc_dircachebuflen;
+}
+
+/* ARGSUSED */
+static intgen_t
+dircache_write( drive_t *drivep, char *bufp, size_t bufsz )
+{
+	ASSERT( drivep == &sc_dircachedrive );
+	ASSERT( bufp == sc_dircachebufp + sc_dircachebuflen );
+
+	sc_dircachebuflen += bufsz;
+	if ( sc_dircachebuflen == DIRCACHE_BUFSZ && ! dircache_flush( )) {
+		return DRIVE_ERROR_DEVICE;
+	}
+
+	return 0;
+}
+
+static bool_t
+dircache_flush( void )
+{
+	ssize_t nwritten;
+
+	if ( ! sc_dircachebuflen ) {
+		return BOOL_TRUE;
+	}
+
+	nwritten = write( sc_dircachefd, sc_dircachebufp, sc_dircachebuflen );
+	if ( nwritten != ( ssize_t )sc_dircachebuflen ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to write directory cache: %s\n"),
+		      nwritten < 0 ? strerror( errno ) : _("short write") );
+		return BOOL_FALSE;
+	}
+	sc_dircachesz += ( off64_t )nwritten;
+	sc_dircachebuflen = 0;
+
+	return BOOL_TRUE;
+}
+
+static rv_t
+dump_dir( ix_t strmix,
+	  drive_t *drivep,
+	  jdm_fshandle_t *fshandlep,
+	  intgen_t fsfd,
+	  xfs_bstat_t *statp )
+{
+	context_t *contextp = &sc_contextp[ strmix ];
+	void *inomap_contextp = contextp->cc_inomap_contextp;
+	intgen_t state;
+	intgen_t fd;
+	struct dirent64 *gdp = ( struct dirent64 * )contextp->cc_getdentsbufp;
+	size_t gdsz = contextp->cc_getdentsbufsz;
+	intgen_t gdcnt;
+	perf_timer_t perftimer;
+	rv_t rv;
+
+	/* no way this can be non-dir, but check anyway
+	 */
+	ASSERT( ( statp->bs_mode & S_IFMT ) == S_IFDIR );
+	if ( ( statp->bs_mode & S_IFMT ) != S_IFDIR ) {
+		return RV_OK;
+	}
+
+	/* skip if no links
+	 */
+	if ( statp->bs_nlink < 1 ) {
+		return RV_OK;
+	}
+
+	/* see what the inomap says about this ino
+	 */
+	state = inomap_get_state( inomap_contextp, statp->bs_ino );
+
+	/* skip if not in inomap
+	 */
+	if ( state == MAP_INO_UNUSED
+	     ||
+	     state == MAP_DIR_NOCHNG
+	     ||
+	     state == MAP_NDR_NOCHNG ) {
+		if ( state == MAP_NDR_NOCHNG ) {
+			mlog( MLOG_DEBUG,
+			      "inomap inconsistency ino %llu: "
+			      "map says is non-dir but is dir: skipping\n",
+			      statp->bs_ino );
+		}
+		return RV_OK;
+	}
 
 	/* note if map says a non-dir
 	 */
@@ -3090,24 +4002,34 @@ dump_dir( ix_t strmix,
 	 */
 	sc_stat_pds[ strmix ].pds_dirdone++;
 
-        /* if bulkstat ino# occupied more than 32 bits and
-         * linux ino# for getdents is 32 bits then
-         * warn and skip.
-         */
-	if ( statp->bs_ino > ( xfs_ino_t )INOMAX ) {
-		mlog( MLOG_NORMAL | MLOG_WARNING, _(
-		      "unable to dump directory: ino %llu too large\n"),
+	/* a directory dumped only to support the hierarchy has not
+	 * changed since the base dump. if asked, just say so: restore
+	 * keeps the entries it got from the base.
+	 */
+	if ( state == MAP_DIR_SUPPRT && sc_dirrefpr ) {
+		mlog( MLOG_TRACE,
+		      "dumping unchanged directory ino %llu by reference\n",
 		      statp->bs_ino );
-		return RV_OK; /* continue anyway */
+		return dump_filehdr( drivep,
+				     contextp,
+				     statp,
+				     0,
+				     FILEHDR_FLAGS_DIRREF );
 	}
-	
+
 	mlog( MLOG_TRACE,
 	      "dumping directory ino %llu\n",
 	      statp->bs_ino );
 
+	/* generations looked up for a previous directory may be stale
+	 */
+	contextp->cc_genbuflen = 0;
+
 	/* open the directory named by statp
 	 */
+	perf_begin( &perftimer );
 	fd = jdm_open( fshandlep, statp, O_RDONLY );
+	perf_end( ( intgen_t )strmix, PERF_DIRREAD, &perftimer, 0 );
 	if ( fd < 0 ) {
 		mlog( MLOG_NORMAL | MLOG_WARNING, _(
 		      "unable to open directory: ino %llu: %s\n"),
@@ -3122,16 +4044,19 @@ dump_dir( ix_t strmix,
 		close( fd );
 		return rv;
 	}
-	
+
 	/* dump dirents - lots of buffering done here, to achieve OS-
 	 * independence. if proves to be to much overhead, can streamline.
 	 */
 	for ( gdcnt = 1, rv = RV_OK ; rv == RV_OK ; gdcnt++ ) {
-		struct dirent *p;
 		intgen_t nread;
-		register size_t reclen;
 
-		nread = getdents_wrap( fd, (char *)gdp, gdsz );
+		perf_begin( &perftimer );
+		nread = getdents64_wrap( fd, (char *)gdp, gdsz );
+		perf_end( ( intgen_t )strmix,
+			  PERF_DIRREAD,
+			  &perftimer,
+			  ( off64_t )( nread > 0 ? nread : 0 ));
 		
 		/* negative count indicates something very bad happened;
 		 * try to gracefully end this dir.
@@ -3158,93 +4083,7 @@ dump_dir( ix_t strmix,
 			break;
 		}
 
-		/* translate and dump each entry: skip "." and ".."
-		 * and null entries.
-		 */
-		for ( p = gdp,
-		      reclen = ( size_t )p->d_reclen
-		      ;
-		      nread > 0
-		      ;
-		      nread -= ( intgen_t )reclen,
-		      ASSERT( nread >= 0 ),
-		      p = ( struct dirent * )( ( char * )p + reclen ),
-		      reclen = ( size_t )p->d_reclen ) {
-			xfs_ino_t ino;
-			register size_t namelen = strlen( p->d_name );
-#ifdef DEBUG
-			register size_t nameszmax = ( size_t )reclen
-						    -
-						    offsetofmember( struct dirent,
-								    d_name );
-
-			/* getdents(2) guarantees that the string will
-			 * be null-terminated, but the record may have
-			 * padding after the null-termination.
-			 */
-			ASSERT( namelen < nameszmax );
-#endif
-
-			/* skip "." and ".."
-			 */
-			if ( *( p->d_name + 0 ) == '.'
-			     &&
-			     ( *( p->d_name + 1 ) == 0
-			       ||
-			       ( *( p->d_name + 1 ) == '.'
-				 &&
-				 *( p->d_name + 2 ) == 0 ))) {
-				continue;
-			}
-
-			ino = (xfs_ino_t)p->d_ino;
-
-			if ( ino == 0 ) {
-				mlog( MLOG_NORMAL | MLOG_WARNING, _(
-				      "encountered 0 ino (%s) in "
-				      "directory ino %llu: NOT dumping\n"),
-				      p->d_name,
-				      statp->bs_ino );
-				continue;
-			}
-
-			/* lookup the gen number in the ino-to-gen map.
-			 * if it's not there, we have to get it the slow way.
-			 */
-			gen = inomap_get_gen( NULL, p->d_ino );
-			if (gen == GEN_NULL) {
-				xfs_bstat_t statbuf;
-				intgen_t scrval;
-				
-				scrval = bigstat_one( fsfd,
-						      p->d_ino,
-						      &statbuf );
-				if ( scrval ) {
-					mlog( MLOG_NORMAL | MLOG_WARNING, _(
-					      "could not stat "
-					      "dirent %s ino %llu: %s: "
-					      "using null generation count "
-					      "in directory entry\n"),
-					      p->d_name,
-					      ( xfs_ino_t )p->d_ino,
-					      strerror( errno ));
-					gen = 0;
-				} else {
-					gen = statbuf.bs_gen;
-				}
-			}
-
-			rv = dump_dirent( drivep,
-					  contextp,
-					  statp,
-					  ino,
-					  gen,
-					  p->d_name,
-					  namelen );
-			if ( rv != RV_OK ) {
-				break;
-			}
-		}
+		rv = dump_dir_entries( drivep, contextp, fsfd, statp, gdp, nread );
 	}
 
 	/* write a null dirent hdr, unless trouble encountered in the loop
@@ -3268,6 +4107,174 @@ dump_dir( ix_t strmix,
 	return rv;
 }
 
+/* dump_dirent_gen - returns the generation of a dirent's inode.
+ * normally found in the ino-to-gen map. inodes missing from the map
+ * (created since the map was built, or unchanged in a partial map) are
+ * looked up with one bulkstat per inode cluster, so a directory full of
+ * them costs one ioctl per cluster instead of one per name.
+ */
+static u_int32_t
+dump_dirent_gen( context_t *contextp,
+		 intgen_t fsfd,
+		 xfs_ino_t ino,
+		 char *name )
+{
+	xfs_bstat_t *bufp = contextp->cc_genbufp;
+	xfs_bstat_t statbuf;
+	gen_t gen;
+	intgen_t lo;
+	intgen_t hi;
+
+	gen = inomap_get_gen( NULL, ino );
+	if ( gen != GEN_NULL ) {
+		return gen;
+	}
+
+	/* refill the buffer with the cluster holding ino, unless it
+	 * already covers ino
+	 */
+	if ( contextp->cc_genbuflen == 0
+	     ||
+	     ino < contextp->cc_genfirst
+	     ||
+	     ino > bufp[ contextp->cc_genbuflen - 1 ].bs_ino ) {
+		xfs_ino_t first;
+
+		first = ino & ~( xfs_ino_t )( GENBUF_LEN - 1 );
+		if ( first == 0 ) {
+			first = 1;
+		}
+		contextp->cc_genfirst = first;
+		if ( bigstat_range( fsfd,
+				    first,
+				    bufp,
+				    GENBUF_LEN,
+				    &contextp->cc_genbuflen )) {
+			contextp->cc_genbuflen = 0;
+		}
+	}
+
+	/* bulkstat returns inodes in ascending order
+	 */
+	lo = 0;
+	hi = contextp->cc_genbuflen - 1;
+	while ( lo <= hi ) {
+		intgen_t mid = ( lo + hi ) / 2;
+		xfs_bstat_t *p = &bufp[ mid ];
+
+		if ( p->bs_ino == ino ) {
+			/* inode being modified: ask for it alone below
+			 */
+			if ( ! p->bs_nlink || ! p->bs_mode ) {
+				break;
+			}
+			return p->bs_gen;
+		}
+		if ( p->bs_ino < ino ) {
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	/* not returned by the bulkstat. try once more the slow way,
+	 * mainly to report why.
+	 */
+	if ( bigstat_one( fsfd, ino, &statbuf )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "could not stat "
+		      "dirent %s ino %llu: %s: "
+		      "using null generation count "
+		      "in directory entry\n"),
+		      name,
+		      ino,
+		      strerror( errno ));
+		return 0;
+	}
+
+	return statbuf.bs_gen;
+}
+
+/* translate and dump each entry of a getdents64_wrap( ) buffer: skip "."
+ * and ".." and null entries.
+ */
+static rv_t
+dump_dir_entries( drive_t *drivep,
+		  context_t *contextp,
+		  intgen_t fsfd,
+		  xfs_bstat_t *statp,
+		  struct dirent64 *gdp,
+		  intgen_t nread )
+{
+	struct dirent64 *p;
+	register size_t reclen;
+	u_int32_t gen;
+	rv_t rv;
+
+	for ( p = gdp,
+	      reclen = ( size_t )p->d_reclen
+	      ;
+	      nread > 0
+	      ;
+	      nread -= ( intgen_t )reclen,
+	      ASSERT( nread >= 0 ),
+	      p = ( struct dirent64 * )( ( char * )p + reclen ),
+	      reclen = ( size_t )p->d_reclen ) {
+		xfs_ino_t ino;
+		register size_t namelen = strlen( p->d_name );
+#ifdef DEBUG
+		register size_t nameszmax = ( size_t )reclen
+					    -
+					    offsetofmember( struct dirent64,
+							    d_name );
+
+		/* getdents(2) guarantees that the string will
+		 * be null-terminated, but the record may have
+		 * padding after the null-termination.
+		 */
+		ASSERT( namelen < nameszmax );
+#endif
+
+		/* skip "." and ".."
+		 */
+		if ( *( p->d_name + 0 ) == '.'
+		     &&
+		     ( *( p->d_name + 1 ) == 0
+		       ||
+		       ( *( p->d_name + 1 ) == '.'
+			 &&
+			 *( p->d_name + 2 ) == 0 ))) {
+			continue;
+		}
+
+		ino = (xfs_ino_t)p->d_ino;
+
+		if ( ino == 0 ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "encountered 0 ino (%s) in "
+			      "directory ino %llu: NOT dumping\n"),
+			      p->d_name,
+			      statp->bs_ino );
+			continue;
+		}
+
+		gen = dump_dirent_gen( contextp, fsfd, ino, p->d_name );
+
+		rv = dump_dirent( drivep,
+				  contextp,
+				  statp,
+				  ino,
+				  gen,
+				  p->d_name,
+				  namelen );
+		if ( rv != RV_OK ) {
+			return rv;
+		}
+	}
+
+	return RV_OK;
+}
+
 static rv_t
 dump_extattrs( drive_t *drivep,
 	       context_t *contextp,
@@ -3277,6 +4284,7 @@ dump_extattrs( drive_t *drivep,
 	ix_t pass;
 	int flag;
 	attrlist_cursor_t cursor;
+	perf_timer_t perftimer;
 	rv_t rv;
 	bool_t abort;
 
@@ -3320,10 +4328,15 @@ dump_extattrs( drive_t *drivep,
 			attrlist_t *listp;
 			int rval = 0;
 
+			perf_begin( &perftimer );
 			rval = jdm_attr_list(fshandlep, statp,
 				contextp->cc_extattrlistbufp,
 				( int )contextp->cc_extattrlistbufsz,
 				flag, &cursor );
+			perf_end( ( intgen_t )drivep->d_index,
+				  PERF_EXTATTR,
+				  &perftimer,
+				  0 );
 			if ( rval ) {
 				mlog( MLOG_NORMAL | MLOG_WARNING, _(
 				      "could not get list of %s attributes for "
@@ -3383,6 +4396,7 @@ dump_extattr_list( drive_t *drivep,
 	char *endp;
 	size_t bufsz;
 	intgen_t rval = 0;
+	perf_timer_t perftimer;
 	rv_t rv;
 	char *dumpbufendp = contextp->cc_extattrdumpbufp
 			    +
@@ -3468,10 +4482,15 @@ dump_extattr_list( drive_t *drivep,
 
 		rtrvcnt = rtrvix;
 		if (rtrvcnt > 0) {
+			perf_begin( &perftimer );
 			rval = jdm_attr_multi( fshandlep, statp,
 					(void *)contextp->cc_extattrrtrvarrayp,
 					( int )rtrvcnt,
 					0 );
+			perf_end( ( intgen_t )drivep->d_index,
+				  PERF_EXTATTR,
+				  &perftimer,
+				  0 );
 			if ( rval ) {
 				mlog( MLOG_NORMAL | MLOG_WARNING, _(
 				      "could not retrieve %s attributes for "
@@ -3947,6 +4966,9 @@ dump_file( void *arg1,
 			      "inomap inconsistency ino %llu: "
 			      "hsm detected error: NOT dumping\n"),
 			      statp->bs_ino);
+			if ( ( statp->bs_mode & S_IFMT ) == S_IFREG ) {
+				inolist_skip( statp->bs_ino );
+			}
 			if ( statp->bs_ino > contextp->cc_stat_lastino ) {
 				contextp->cc_stat_lastino = statp->bs_ino;
 			}
@@ -3981,6 +5003,7 @@ dump_file( void *arg1,
 				      "ino %llu increased beyond maximum size: "
 				      "NOT dumping\n",
 				      statp->bs_ino);
+				inolist_skip( statp->bs_ino );
 				return RV_OK;
 			}
 		}
@@ -4093,6 +5116,18 @@ dump_file_reg( drive_t *drivep,
 		offset = 0;
 	}
 
+	/* if dynamically partitioned, the media file may have begun in an
+	 * earlier chunk; the current chunk may begin within this file.
+	 */
+	if ( sc_dynpartpr
+	     &&
+	     statp->bs_ino == contextp->cc_dynstartpt.sp_ino
+	     &&
+	     contextp->cc_dynstartpt.sp_offset > offset ) {
+		offset = contextp->cc_dynstartpt.sp_offset;
+		ASSERT( ( offset & ( off64_t )( BBSIZE - 1 )) == 0 );
+	}
+
 	/* if this is a resumed dump and the resumption begins somewhere
 	 * within this file, and that point is greater than offset set
 	 * above, and that file hasn't changed since the resumed dump,
@@ -4144,6 +5179,52 @@ dump_file_reg( drive_t *drivep,
 	      sosig ? stopoffset : statp->bs_size,
 	      statp->bs_size );
 
+	/* with -g, if the data is that already restored from the base,
+	 * dump just the file header and a LAST extent header. a file
+	 * spanning a start point is dumped whole by the first stream.
+	 */
+	if ( inolist_dataunchanged( statp )) {
+		if ( offset > 0 ) {
+			return RV_OK;
+		}
+		mark_set( drivep, statp->bs_ino, offset, 0 );
+		if ( contextp->cc_mfilesz >= drivep->d_recmfilesz ){
+			return RV_EOF;
+		}
+		if ( cldmgr_stop_requested( )) {
+			mlog( MLOG_NORMAL, _(
+			      "dump interrupted prior to ino %llu offset %lld\n"),
+			      statp->bs_ino,
+			      offset );
+			mlog_exit_hint(RV_INTR);
+			return RV_INTR;
+		}
+		mlog( MLOG_DEBUG,
+		      "dumping metadata of ino %llu: data unchanged\n",
+		      statp->bs_ino );
+		rv = dump_filehdr( drivep,
+				   contextp,
+				   statp,
+				   offset,
+				   FILEHDR_FLAGS_METAONLY );
+		if ( rv != RV_OK ) {
+			return rv;
+		}
+		rv = dump_extenthdr( drivep,
+				     contextp,
+				     EXTENTHDR_TYPE_LAST,
+				     0,
+				     0,
+				     0 );
+		if ( rv != RV_OK ) {
+			return rv;
+		}
+		contextp->cc_mfilesz += sizeof( filehdr_t )
+					+
+					sizeof( extenthdr_t );
+		return RV_OK;
+	}
+
 	/* calculate the maximum extent group size. files larger than this
 	 * will be broken into multiple extent groups, each with its own
 	 * filehdr_t.
@@ -4163,6 +5244,7 @@ dump_file_reg( drive_t *drivep,
 		      statp->bs_ino,
 		      statp->bs_mode,
 		      strerror( errno ));
+		inolist_skip( statp->bs_ino );
 		return RV_OK;
 	}
 
@@ -4254,6 +5336,7 @@ dump_file_reg( drive_t *drivep,
 		 */
 		lock( );
 		sc_stat_datadone += ( size64_t )bc;
+		sc_stat_pds[ drivep->d_index ].pds_datadone += ( size64_t )bc;
 		unlock( );
 
 		/* dump LAST extent hdr. one of these is placed at the
@@ -4482,6 +5565,8 @@ dump_extent_group( drive_t *drivep,
 					XFS_XFLAG_REALTIME );
 	off64_t nextoffset;
 	off64_t bytecnt;	/* accumulates total bytes sent to media */
+	intgen_t streamix = ( intgen_t )drivep->d_index;
+	perf_timer_t perftimer;
 	intgen_t rval;
 	rv_t rv;
 
@@ -4555,7 +5640,9 @@ dump_extent_group( drive_t *drivep,
 			mlog( MLOG_NITTY,
 			      "calling getbmapx for ino %llu\n",
 			      statp->bs_ino );
+			perf_begin( &perftimer );
 			rval = ioctl( gcp->eg_fd, XFS_IOC_GETBMAPX, gcp->eg_bmap );
+			perf_end( streamix, PERF_GETBMAP, &perftimer, 0 );
 			gcp->eg_gbmcnt++;
 			entrycnt = gcp->eg_bmap[ 0 ].bmv_entries;
 			if ( entrycnt < 0 ) { /* workaround for getbmap bug */
@@ -4853,6 +5940,34 @@ dump_extent_group( drive_t *drivep,
 			      statp->bs_size );
 		}
 
+		/* with -u, the extent is dumped a chunk at a time, each
+		 * either as data or as a reference to an identical chunk
+		 * already in the media file. realtime files are dumped
+		 * whole, since restore must write them with direct I/O.
+		 */
+		if ( contextp->cc_dedupp && ! isrealtime ) {
+			ASSERT( ( offset & ( off64_t )( BBSIZE - 1 )) == 0 );
+			ASSERT( ( extsz & ( off64_t )( BBSIZE - 1 )) == 0 );
+			nextoffset = offset + extsz;
+			rv = dump_extent_dedup( drivep,
+						contextp,
+						statp,
+						gcp,
+						offset,
+						extsz,
+						&bytecnt );
+			if ( rv != RV_OK ) {
+				*nextoffsetp = nextoffset;
+				*bytecntp = bytecnt;
+				*cmpltflgp = BOOL_TRUE; /* moot since rv != OK */
+				return rv;
+			}
+
+			/* the top of the loop advances to the next extent
+			 */
+			continue;
+		}
+
 		/* I/O performance is better if we align the media write
 		 * buffer to a page boundary. do this if the extent is
 		 * at least a page in length. Also, necessary for real time
@@ -4933,9 +6048,11 @@ dump_extent_group( drive_t *drivep,
 				INTGENMAX
 				:
 				( size_t )extsz;
+			perf_begin( &perftimer );
 			bufp = ( * dop->do_get_write_buf )( drivep,
 							    reqsz,
 							    &actualsz );
+			perf_end( streamix, PERF_GETWRITEBUF, &perftimer, 0 );
 			ASSERT( actualsz <= reqsz );
 			new_off = lseek64( gcp->eg_fd, offset, SEEK_SET );
 			if ( new_off == ( off64_t )( -1 )) {
@@ -4944,7 +6061,12 @@ dump_extent_group( drive_t *drivep,
 				      statp->bs_ino );
 				nread = 0;
 			} else {
+				perf_begin( &perftimer );
 				nread = read( gcp->eg_fd, bufp, actualsz);
+				perf_end( streamix,
+					  PERF_READ,
+					  &perftimer,
+					  ( off64_t )nread );
 			}
 			if ( nread < 0 ) {
 #ifdef HIDDEN
@@ -4979,9 +6101,14 @@ dump_extent_group( drive_t *drivep,
 					actualsz - ( size_t )nread );
 			}
 
+			perf_begin( &perftimer );
 			rval = ( * dop->do_write )( drivep,
 						    bufp,
 						    actualsz );
+			perf_end( streamix,
+				  PERF_WRITE,
+				  &perftimer,
+				  ( off64_t )actualsz );
 			switch ( rval ) {
 			case 0:
 				rv = RV_OK;
@@ -5056,6 +6183,151 @@ dump_extent_group( drive_t *drivep,
 	/* NOTREACHED */
 }
 
+/* dumps the extent of extsz bytes at offset a chunk at a time (-u). chunks
+ * end at multiples of DEDUP_CHUNKSZ. each is read and fingerprinted, then
+ * dumped as a reference if an identical chunk is already in the media
+ * file, otherwise as data and entered in the index. as in
+ * dump_extent_group( ), a short read is taken to be EOF and the rest of
+ * the extent is zeros.
+ */
+static rv_t
+dump_extent_dedup( drive_t *drivep,
+		   context_t *contextp,
+		   xfs_bstat_t *statp,
+		   extent_group_context_t *gcp,
+		   off64_t offset,
+		   off64_t extsz,
+		   off64_t *bytecntp )
+{
+	drive_ops_t *dop = drivep->d_opsp;
+	char *bufp = contextp->cc_dedupbufp;
+	intgen_t streamix = ( intgen_t )drivep->d_index;
+	bool_t eofpr = BOOL_FALSE;
+	perf_timer_t perftimer;
+
+	while ( extsz ) {
+		u_int64_t fp[ FPRINT_WORDS ];
+		xfs_ino_t refino;
+		off64_t refoffset;
+		size_t chunksz;
+		intgen_t nread;
+		intgen_t rval;
+		rv_t rv;
+
+		chunksz = DEDUP_CHUNKSZ
+			  -
+			  ( size_t )( offset & ( off64_t )( DEDUP_CHUNKSZ - 1 ));
+		if ( ( off64_t )chunksz > extsz ) {
+			chunksz = ( size_t )extsz;
+		}
+
+		nread = 0;
+		if ( ! eofpr ) {
+			perf_begin( &perftimer );
+			nread = pread64( gcp->eg_fd, bufp, chunksz, offset );
+			perf_end( streamix,
+				  PERF_READ,
+				  &perftimer,
+				  ( off64_t )nread );
+			if ( nread < 0 ) {
+				nread = 0;
+			}
+		}
+		if ( ( size_t )nread < chunksz ) {
+			memset( ( void * )( bufp + nread ),
+				0,
+				chunksz - ( size_t )nread );
+			eofpr = BOOL_TRUE;
+		}
+
+		fprint_calc( bufp, chunksz, fp );
+		contextp->cc_dedupchunkcnt++;
+
+		/* a chunk may refer to an earlier one in its own file,
+		 * but never to itself or one after it
+		 */
+		if ( dedup_find( contextp->cc_dedupp,
+				 fp,
+				 chunksz,
+				 &refino,
+				 &refoffset )
+		     &&
+		     ( refino != statp->bs_ino || refoffset < offset )) {
+			mlog( MLOG_NITTY,
+			      "ino %llu offset %lld sz %u "
+			      "refers to ino %llu offset %lld\n",
+			      statp->bs_ino,
+			      offset,
+			      chunksz,
+			      refino,
+			      refoffset );
+			rv = dump_extenthdr( drivep,
+					     contextp,
+					     EXTENTHDR_TYPE_REF,
+					     0,
+					     offset,
+					     ( off64_t )chunksz );
+			if ( rv != RV_OK ) {
+				return rv;
+			}
+			*bytecntp += sizeof( extenthdr_t );
+			rv = dump_extentref( drivep, refino, refoffset, fp );
+			if ( rv != RV_OK ) {
+				return rv;
+			}
+			*bytecntp += sizeof( extentref_t );
+			contextp->cc_deduprefcnt++;
+			contextp->cc_deduprefbytes += ( size64_t )chunksz;
+		} else {
+			dedup_add( contextp->cc_dedupp,
+				   fp,
+				   chunksz,
+				   statp->bs_ino,
+				   offset );
+			rv = dump_extenthdr( drivep,
+					     contextp,
+					     EXTENTHDR_TYPE_DATA,
+					     0,
+					     offset,
+					     ( off64_t )chunksz );
+			if ( rv != RV_OK ) {
+				return rv;
+			}
+			*bytecntp += sizeof( extenthdr_t );
+			rval = write_buf( bufp,
+					  chunksz,
+					  ( void * )drivep,
+					  ( gwbfp_t )dop->do_get_write_buf,
+					  ( wfp_t )dop->do_write );
+			switch ( rval ) {
+			case 0:
+				rv = RV_OK;
+				break;
+			case DRIVE_ERROR_MEDIA:
+			case DRIVE_ERROR_EOM:
+				rv = RV_EOM;
+				break;
+			case DRIVE_ERROR_DEVICE:
+				rv = RV_DRIVE;
+				break;
+			case DRIVE_ERROR_CORE:
+			default:
+				rv = RV_CORE;
+				break;
+			}
+			if ( rv != RV_OK ) {
+				return rv;
+			}
+			*bytecntp += ( off64_t )chunksz;
+		}
+
+		offset += ( off64_t )chunksz;
+		extsz -= ( off64_t )chunksz;
+	}
+
+	return RV_OK;
+}
+
 /* Note: assumes the pad fields in dst have been zeroed. */
 static void
 copy_xfs_bstat(bstat_t *dst, xfs_bstat_t *src)
@@ -5084,6 +6356,132 @@ copy_xfs_bstat(bstat_t *dst, xfs_bstat_t *src)
 	dst->bs_dmstate = src->bs_dmstate;
 }
 
+/* dynamic partitioning: claims the next unclaimed chunk for this stream.
+ * returns BOOL_FALSE if there are none left.
+ */
+static bool_t
+dynpart_claim( context_t *contextp )
+{
+	ix_t chunkix;
+
+	lock( );
+	chunkix = sc_dynchunknext;
+	if ( chunkix < sc_dynchunkcnt ) {
+		sc_dynchunknext++;
+	}
+	unlock( );
+
+	if ( chunkix >= sc_dynchunkcnt ) {
+		return BOOL_FALSE;
+	}
+
+	ASSERT( contextp->cc_dynchunkcnt < sc_dynchunkcnt );
+	contextp->cc_dynchunkixp[ contextp->cc_dynchunkcnt++ ] = chunkix;
+	mlog( MLOG_VERBOSE, _(
+	      "claiming range %u of %u: ino %llu offset %lld\n"),
+	      chunkix,
+	      sc_dynchunkcnt,
+	      sc_startptp[ chunkix ].sp_ino,
+	      sc_startptp[ chunkix ].sp_offset );
+
+	return BOOL_TRUE;
+}
+
+/* sets the stream end point to the end of the current chunk, which is
+ * the start of the next chunk in ino order regardless of who claims it.
+ */
+static void
+dynpart_setrange( context_t *contextp, content_inode_hdr_t *scwhdrp )
+{
+	ix_t chunkix;
+
+	ASSERT( contextp->cc_dynchunkcur < contextp->cc_dynchunkcnt );
+	chunkix = contextp->cc_dynchunkixp[ contextp->cc_dynchunkcur ];
+	contextp->cc_dynstartpt = sc_startptp[ chunkix ];
+	if ( chunkix < sc_dynchunkcnt - 1 ) {
+		scwhdrp->cih_endpt = sc_startptp[ chunkix + 1 ];
+	} else {
+		memset( ( void * )&scwhdrp->cih_endpt,
+			0,
+			sizeof( scwhdrp->cih_endpt ));
+		scwhdrp->cih_endpt.sp_flags = STARTPT_FLAGS_END;
+	}
+}
+
+/* makes the current chunk the one holding the stream start point. used
+ * at the beginning of each media file, since marks committed in the
+ * previous one may have moved the start point into a later chunk.
+ */
+static void
+dynpart_locate( context_t *contextp, content_inode_hdr_t *scwhdrp )
+{
+	startpt_t *startptp = &scwhdrp->cih_startpt;
+	ix_t cur;
+
+	if ( ! contextp->cc_dynchunkcnt
+	     ||
+	     ( startptp->sp_flags & STARTPT_FLAGS_END )) {
+		return;
+	}
+
+	for ( cur = contextp->cc_dynchunkcnt - 1 ; cur > 0 ; cur-- ) {
+		startpt_t *chunkp =
+			  &sc_startptp[ contextp->cc_dynchunkixp[ cur ]];
+		if ( chunkp->sp_ino < startptp->sp_ino
+		     ||
+		     ( chunkp->sp_ino == startptp->sp_ino
+		       &&
+		       chunkp->sp_offset <= startptp->sp_offset )) {
+			break;
+		}
+	}
+	contextp->cc_dynchunkcur = cur;
+	dynpart_setrange( contextp, scwhdrp );
+}
+
+/* advances to the next chunk already claimed by this stream, or claims
+ * a new one. returns BOOL_FALSE if the stream has no more work.
+ */
+static bool_t
+dynpart_next( context_t *contextp, content_inode_hdr_t *scwhdrp )
+{
+	if ( contextp->cc_dynchunkcur + 1 >= contextp->cc_dynchunkcnt
+	     &&
+	     ! dynpart_claim( contextp )) {
+		return BOOL_FALSE;
+	}
+	contextp->cc_dynchunkcur++;
+	dynpart_setrange( contextp, scwhdrp );
+
+	return BOOL_TRUE;
+}
+
+/* returns BOOL_FALSE if any stream of the session ended beyond the start
+ * of the following stream, as happens with dynamic partitioning. the
+ * resume logic assumes the undumped portions lie between one stream's
+ * end and the next stream's start.
+ */
+static bool_t
+sess_strmsordered( inv_session_t *sessp )
+{
+	ix_t strmix;
+
+	for ( strmix = 0 ; strmix + 1 < sessp->s_nstreams ; strmix++ ) {
+		inv_stream_t *bsp = &sessp->s_streams[ strmix ];
+		inv_stream_t *esp = bsp + 1;
+
+		if ( bsp->st_endino > esp->st_startino
+		     ||
+		     ( bsp->st_endino == esp->st_startino
+		       &&
+		       bsp->st_endino_off > esp->st_startino_off )) {
+			return BOOL_FALSE;
+		}
+	}
+
+	return BOOL_TRUE;
+}
+
 static rv_t
 dump_filehdr( drive_t *drivep,
 	      context_t *contextp,
@@ -5178,6 +6576,9 @@ dump_extenthdr( drive_t *drivep,
 		case EXTENTHDR_TYPE_HOLE: 
 			strcpy( typestr, "HOLE" );
 			break;
+		case EXTENTHDR_TYPE_REF: 
+			strcpy( typestr, "REF" );
+			break;
 		default:
 			strcpy( typestr, "UNKNOWN" );
 	}
@@ -5227,6 +6628,52 @@ dump_extenthdr( drive_t *drivep,
 	return rv;
 }
 
+static rv_t
+dump_extentref( drive_t *drivep,
+		xfs_ino_t ino,
+		off64_t offset,
+		u_int64_t *fp )
+{
+	drive_ops_t *dop = drivep->d_opsp;
+	extentref_t eref;
+	extentref_t tmperef;
+	intgen_t rval;
+	rv_t rv;
+
+	( void )memset( ( void * )&eref, 0, sizeof( eref ));
+	eref.er_ino = ino;
+	eref.er_offset = offset;
+	memcpy( ( void * )eref.er_fprint,
+		( void * )fp,
+		sizeof( eref.er_fprint ));
+
+	xlate_extentref( &eref, &tmperef, 1 );
+	rval = write_buf( ( char * )&tmperef,
+			  sizeof( tmperef ),
+			  ( void * )drivep,
+			  ( gwbfp_t )dop->do_get_write_buf,
+			  ( wfp_t )dop->do_write );
+
+	switch ( rval ) {
+	case 0:
+		rv = RV_OK;
+		break;
+	case DRIVE_ERROR_MEDIA:
+	case DRIVE_ERROR_EOM:
+		rv = RV_EOM;
+		break;
+	case DRIVE_ERROR_DEVICE:
+		rv = RV_DRIVE;
+		break;
+	case DRIVE_ERROR_CORE:
+	default:
+		rv = RV_CORE;
+		break;
+	}
+
+	return rv;
+}
+
 static rv_t
 dump_dirent( drive_t *drivep,
 	     context_t *contextp,
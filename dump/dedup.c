@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "fprint.h"
+#include "dedup.h"
+
+
+/* structure definitions used locally ****************************************/
+
+#define DEDUP_BUCKETCNT	( 1 << 18 )
+#define DEDUP_WAYS	4
+	/* a million entries, 56MB per stream: room to recognize 64GB
+	 * of distinct full chunks. both must be powers of two
+	 */
+
+/* an index entry. de_sz is zero if the entry is free; a chunk is never
+ * empty.
+ */
+struct dedup_ent {
+	u_int64_t de_fp[ FPRINT_WORDS ];
+	xfs_ino_t de_ino;
+	off64_t de_offset;
+	u_int32_t de_sz;
+	u_int32_t de_pad;
+};
+
+typedef struct dedup_ent dedup_ent_t;
+
+struct dedup {
+	dedup_ent_t *d_entp;
+		/* DEDUP_BUCKETCNT buckets of DEDUP_WAYS entries
+		 */
+};
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static dedup_ent_t *dedup_bucket( dedup_t *dp, u_int64_t fp[ FPRINT_WORDS ] );
+
+
+/* definition of locally defined global functions ****************************/
+
+dedup_t *
+dedup_create( void )
+{
+	dedup_t *dp;
+
+	dp = ( dedup_t * )calloc( 1, sizeof( dedup_t ));
+	if ( ! dp ) {
+		return 0;
+	}
+	dp->d_entp = ( dedup_ent_t * )calloc( DEDUP_BUCKETCNT * DEDUP_WAYS,
+					      sizeof( dedup_ent_t ));
+	if ( ! dp->d_entp ) {
+		free( ( void * )dp );
+		return 0;
+	}
+
+	return dp;
+}
+
+void
+dedup_reset( dedup_t *dp )
+{
+	memset( ( void * )dp->d_entp,
+		0,
+		DEDUP_BUCKETCNT * DEDUP_WAYS * sizeof( dedup_ent_t ));
+}
+
+bool_t
+dedup_find( dedup_t *dp,
+	    u_int64_t fp[ FPRINT_WORDS ],
+	    size_t sz,
+	    xfs_ino_t *inop,
+	    off64_t *offsetp )
+{
+	dedup_ent_t *entp = dedup_bucket( dp, fp );
+	ix_t ix;
+
+	for ( ix = 0 ; ix < DEDUP_WAYS ; ix++, entp++ ) {
+		if ( entp->de_sz == ( u_int32_t )sz
+		     &&
+		     ! memcmp( ( void * )entp->de_fp,
+			       ( void * )fp,
+			       sizeof( entp->de_fp ))) {
+			*inop = entp->de_ino;
+			*offsetp = entp->de_offset;
+			return BOOL_TRUE;
+		}
+	}
+
+	return BOOL_FALSE;
+}
+
+void
+dedup_add( dedup_t *dp,
+	   u_int64_t fp[ FPRINT_WORDS ],
+	   size_t sz,
+	   xfs_ino_t ino,
+	   off64_t offset )
+{
+	dedup_ent_t *entp = dedup_bucket( dp, fp );
+	ix_t ix;
+
+	ASSERT( sz > 0 && sz <= DEDUP_CHUNKSZ );
+
+	/* take a free entry if there is one, else evict the one the
+	 * other half of the fingerprint picks
+	 */
+	for ( ix = 0 ; ix < DEDUP_WAYS ; ix++ ) {
+		if ( entp[ ix ].de_sz == 0 ) {
+			break;
+		}
+	}
+	if ( ix == DEDUP_WAYS ) {
+		ix = ( ix_t )( fp[ 1 ] & ( DEDUP_WAYS - 1 ));
+	}
+	entp += ix;
+
+	memcpy( ( void * )entp->de_fp, ( void * )fp, sizeof( entp->de_fp ));
+	entp->de_ino = ino;
+	entp->de_offset = offset;
+	entp->de_sz = ( u_int32_t )sz;
+}
+
+void
+dedup_destroy( dedup_t *dp )
+{
+	free( ( void * )dp->d_entp );
+	free( ( void * )dp );
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+static dedup_ent_t *
+dedup_bucket( dedup_t *dp, u_int64_t fp[ FPRINT_WORDS ] )
+{
+	return dp->d_entp
+	       +
+	       ( size_t )( fp[ 0 ] & ( DEDUP_BUCKETCNT - 1 )) * DEDUP_WAYS;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef DEDUP_H
+#define DEDUP_H
+
+/* dedup.[hc] - index of the file data chunks already in a media file
+ *
+ * with -u, dump_extent_group( ) cuts regular file data into chunks at
+ * fixed file offsets and fingerprints each. a chunk whose fingerprint
+ * is in the index is dumped as an EXTENTHDR_TYPE_REF extent naming the
+ * ino and offset it was first dumped at, instead of the data.
+ *
+ * one index per stream, emptied at the start of each media file, so a
+ * reference always resolves to data earlier in the same media file:
+ * a media file restarted after EOM never refers to data lost with the
+ * old one, and any media file can be restored on its own.
+ *
+ * the index is a fixed size cache, DEDUP_WAYS entries to a bucket. when
+ * a bucket is full a new chunk replaces one of its entries, losing only
+ * the chance to refer to that one.
+ */
+
+#define DEDUP_CHUNKSZ	( 1 << 16 )
+	/* chunks begin at multiples of this file offset, so identical
+	 * files are cut identically whatever their extent layout. a
+	 * chunk is shorter only at the edges of an extent. must be a
+	 * power of two and a multiple of BBSIZE
+	 */
+
+struct dedup;
+
+typedef struct dedup dedup_t;
+
+/* dedup_create - allocates an empty index. returns NULL if the memory
+ * is not available.
+ */
+extern dedup_t *dedup_create( void );
+
+/* dedup_reset - empties the index
+ */
+extern void dedup_reset( dedup_t *dp );
+
+/* dedup_find - if a chunk of sz bytes with fingerprint fp is in the
+ * index, returns BOOL_TRUE and the ino and offset it was dumped at.
+ */
+extern bool_t dedup_find( dedup_t *dp,
+			  u_int64_t fp[ FPRINT_WORDS ],
+			  size_t sz,
+			  xfs_ino_t *inop,
+			  off64_t *offsetp );
+
+/* dedup_add - enters a chunk just dumped as data
+ */
+extern void dedup_add( dedup_t *dp,
+		       u_int64_t fp[ FPRINT_WORDS ],
+		       size_t sz,
+		       xfs_ino_t ino,
+		       off64_t offset );
+
+/* dedup_destroy - frees the index
+ */
+extern void dedup_destroy( dedup_t *dp );
+
+#endif /* DEDUP_H */
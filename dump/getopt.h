@@ -27,7 +27,7 @@
  * facilitating easy changes.
  */
 
-#define GETOPT_CMDSTRING	"ab:c:d:ef:hl:mop:qs:t:v:z:AB:CEFG:H:I:JL:M:NO:PRSTUVWY:Z"
+#define GETOPT_CMDSTRING	"ab:c:d:ef:ghj:kl:mop:qs:t:uv:y:z:AB:CDEFG:H:I:JK:L:M:NO:PQ:RSTUVWXY:Z"
 
 #define GETOPT_DUMPASOFFLINE	'a'	/* dump DMF dualstate files as offline */
 #define	GETOPT_BLOCKSIZE	'b'	/* blocksize for rmt */
@@ -35,11 +35,11 @@
 #define	GETOPT_FILESZ		'd'	/* Media file size to use in Mb */
 #define GETOPT_EXCLUDEFILES	'e'	/* allow files to be excluded */
 #define	GETOPT_DUMPDEST		'f'	/* dump dest. file (drive.c) */
-/*				'g'	*/
+#define	GETOPT_METAONLY		'g'	/* omit data of ctime-only changes (inolist.c) */
 #define	GETOPT_HELP		'h'	/* display version and usage */
 /*				'i'	*/
-/*				'j'	*/
-/*				'k'	*/
+#define	GETOPT_RMTWINDOW	'j'	/* rmt commands in flight (drive_minrmt.c) */
+#define	GETOPT_PERFSTAT		'k'	/* report I/O stall times (perfstat.c) */
 #define	GETOPT_LEVEL		'l'	/* dump level (content_inode.c) */
 #define GETOPT_MINRMT		'm'	/* use minimal rmt protocol */
 /*				'n'	*/
@@ -49,36 +49,36 @@
 /*				'r'	*/
 #define	GETOPT_SUBTREE		's'	/* subtree dump (content_inode.c) */
 #define GETOPT_DUMPTIME		't'	/* use mtime of file as dump time */
-/*				'u' */
+#define	GETOPT_DEDUP		'u'	/* dedup file data chunks (content.c) */
 #define	GETOPT_VERBOSITY	'v'	/* verbosity level (0 to 4 ) */
 /*				'w' */
 /*				'x'	   used in irix for xvm snapshot */
-/*				'y' */
+#define GETOPT_COMPRESS		'y'	/* compress stream (drive_simple.c) */
 #define GETOPT_MAXDUMPFILESIZE	'z'	/* prune files over specified size */
 #define	GETOPT_NOEXTATTR	'A'	/* do not dump ext. file attributes */
 #define	GETOPT_BASED		'B'	/* specify session to base increment */
 #define GETOPT_RECCHKSUM	'C'	/* use record checksums */
-/*				'D'	*/
+#define	GETOPT_DIRREF		'D'	/* omit unchanged dir entries (content.c) */
 #define	GETOPT_ERASE		'E'	/* pre-erase media */
 #define GETOPT_FORCE		'F'	/* don't prompt (getopt.c) */
 #define GETOPT_MINSTACKSZ	'G'	/* minimum stack size (bytes) */
 #define GETOPT_MAXSTACKSZ	'H'	/* maximum stack size (bytes) */
 #define GETOPT_INVPRINT         'I'     /* just display the inventory */
 #define	GETOPT_NOINVUPDATE	'J'	/* do not update the dump inventory */
-/*				'K'	*/
+#define	GETOPT_PROGRESSFILE	'K'	/* progress record file or fd (main.c) */
 #define	GETOPT_DUMPLABEL	'L'	/* dump session label (global.c) */
 #define	GETOPT_MEDIALABEL	'M'	/* media object label (media.c) */
 #define	GETOPT_TIMESTAMP	'N'	/* show timestamps in log msgs */
 #define	GETOPT_OPTFILE		'O'	/* specifycmd line options file */
 #define	GETOPT_RINGPIN		'P'	/* pin down I/O buffer ring */
-/*				'Q'	*/
+#define	GETOPT_DYNPART		'Q'	/* dynamic stream ranges (content.c) */
 #define	GETOPT_RESUME		'R'	/* resume intr dump (content_inode.c) */
 #define	GETOPT_SINGLEMFILE	'S'	/* obsolete - now the default */
 #define	GETOPT_NOTIMEOUTS	'T'	/* don't timeout dialogs */
 #define	GETOPT_UNLOAD		'U'	/* unload media when change needed */
 #define	GETOPT_SHOWLOGSS	'V'	/* show subsystem of log messages */
 #define	GETOPT_SHOWLOGLEVEL	'W'	/* show level of log messages */
-/*				'X'	*/
+#define	GETOPT_TREECACHE	'X'	/* keep directory tree cache (treecache.c) */
 #define	GETOPT_RINGLEN		'Y'	/* specify I/O buffer ring length */
 #define	GETOPT_MINIROOT		'Z'	/* apply miniroot restrictions */
 
@@ -0,0 +1,774 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+#include <xfs/jdm.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <uuid/uuid.h>
+
+#include "types.h"
+#include "mlog.h"
+#include "global.h"
+#include "inventory.h"
+#include "lock.h"
+#include "inolist.h"
+
+
+/* structure definitions used locally ****************************************/
+
+/* the list file is a header followed by an entry for each file, in
+ * ascending ino order. like the directory tree cache, it is in host
+ * byte order and never leaves the host which wrote it.
+ */
+#define IL_MAGIC	"xfsdil1"
+#define IL_VERSION	3
+#define IL_PREFIX	"inolist."
+
+struct il_hdr {
+	char ih_magic[ 8 ];
+	u_int32_t ih_version;
+	u_int32_t ih_pad1;
+	uuid_t ih_fsid;
+	uuid_t ih_sessid;
+		/* the dump session which kept the list
+		 */
+	u_int64_t ih_cnt;
+		/* number of entries
+		 */
+	char ih_pad2[ 16 ];
+};
+
+typedef struct il_hdr il_hdr_t;
+
+struct il_ent {
+	xfs_ino_t ie_ino;
+	u_int32_t ie_gen;
+	u_int32_t ie_extents;
+	off64_t ie_size;
+	int64_t ie_firstblk;
+		/* extent count, size and disk address of the first data
+		 * extent (see il_firstblk( )) when listed: with the mtime,
+		 * all inolist_dataunchanged( ) has to go on
+		 */
+};
+
+typedef struct il_ent il_ent_t;
+
+#define IL_NOBLK	( ( int64_t )-1 )
+	/* ie_firstblk of a file with no data extent in its first
+	 * IL_BMAPLEN - 1 extents
+	 */
+#define IL_BLKUNKNOWN	( ( int64_t )-2 )
+	/* ie_firstblk of a file whose extent map could not be had. never
+	 * taken to match
+	 */
+#define IL_BMAPLEN	16
+	/* extent map entries asked for by il_firstblk( ), including the
+	 * header entry
+	 */
+
+#define IL_WBUFSZ	0x10000
+	/* size of the buffer through which the new list is written
+	 */
+
+
+/* declarations of externally defined global variables ***********************/
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static il_ent_t *il_find( xfs_bstat_t *statp );
+static int64_t il_firstblk( xfs_bstat_t *statp );
+static bool_t il_write( void *bufp, size_t sz );
+static bool_t il_flush( void );
+static bool_t il_drop( void );
+static int il_inocmp( const void *ap, const void *bp );
+static void il_prune( void );
+static void il_abandon( void );
+
+
+/* definition of locally defined global variables ****************************/
+
+
+/* definition of locally defined static variables *****************************/
+
+static bool_t sc_ilpr = BOOL_FALSE;
+	/* a new list is being built
+	 */
+static char sc_ilpath[ MAXPATHLEN ];
+static char sc_iltmppath[ MAXPATHLEN ];
+static char sc_ilfsidstr[ 37 ];
+static jdm_fshandle_t *sc_ilfshandlep = 0;
+static uuid_t sc_ilfsid;
+static uuid_t sc_ilsessid;
+
+static char *sc_iloldp = 0;
+	/* the list of the base, mapped. NULL if there is none usable
+	 */
+static size_t sc_iloldsz = 0;
+static il_ent_t *sc_iloldentp = 0;
+static size_t sc_iloldcnt = 0;
+static time32_t sc_ilbasetime = 0;
+
+static intgen_t sc_ilfd = -1;
+	/* the new list, being written
+	 */
+static char *sc_ilwbufp = 0;
+static size_t sc_ilwbuflen = 0;
+static u_int64_t sc_ilcnt = 0;
+static xfs_ino_t sc_illastino = 0;
+
+static xfs_ino_t *sc_ilskipp = 0;
+	/* files inolist_add( ) listed but the streams did not dump,
+	 * in no order. MUST be accessed under lock( )
+	 */
+static size_t sc_ilskipcnt = 0;
+static size_t sc_ilskipmax = 0;
+
+
+/* definition of locally defined global functions ****************************/
+
+void
+inolist_init( jdm_fshandle_t *fshandlep,
+	      uuid_t *fsidp,
+	      uuid_t *sessidp,
+	      uuid_t *baseidp,
+	      time32_t basetime )
+{
+	char string_uuid[ 37 ];
+	il_hdr_t hdr;
+	struct stat64 st;
+	intgen_t fd;
+
+	ASSERT( ! sc_ilpr );
+
+	sc_ilfshandlep = fshandlep;
+	uuid_unparse( *fsidp, sc_ilfsidstr );
+	uuid_copy( sc_ilfsid, *fsidp );
+	uuid_copy( sc_ilsessid, *sessidp );
+	sc_ilbasetime = basetime;
+
+	/* map the list of the base. anything amiss means there is none.
+	 */
+	if ( baseidp ) {
+		char basepath[ MAXPATHLEN ];
+
+		uuid_unparse( *baseidp, string_uuid );
+		if ( snprintf( basepath,
+			       sizeof( basepath ),
+			       "%s/%s%s.%s",
+			       XFSDUMP_DIRPATH,
+			       IL_PREFIX,
+			       sc_ilfsidstr,
+			       string_uuid ) >= ( intgen_t )sizeof( basepath )) {
+			fd = -1;
+			errno = ENAMETOOLONG;
+		} else {
+			fd = open( basepath, O_RDONLY );
+		}
+		if ( fd >= 0 ) {
+			if ( fstat64( fd, &st ) == 0
+			     &&
+			     st.st_size >= ( off64_t )sizeof( il_hdr_t )
+			     &&
+			     ( u_int64_t )st.st_size < ( u_int64_t )SIZE_MAX ) {
+				sc_iloldsz = ( size_t )st.st_size;
+				sc_iloldp = ( char * )mmap( 0,
+							    sc_iloldsz,
+							    PROT_READ,
+							    MAP_SHARED,
+							    fd,
+							    0 );
+				if ( sc_iloldp == ( char * )MAP_FAILED ) {
+					sc_iloldp = 0;
+				}
+			}
+			( void )close( fd );
+		} else if ( errno != ENOENT ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "unable to open inode list %s: %s\n"),
+			      basepath,
+			      strerror( errno ));
+		}
+		if ( sc_iloldp ) {
+			il_hdr_t *hdrp = ( il_hdr_t * )sc_iloldp;
+
+			if ( strncmp( hdrp->ih_magic,
+				      IL_MAGIC,
+				      sizeof( hdrp->ih_magic ))
+			     ||
+			     hdrp->ih_version != IL_VERSION
+			     ||
+			     uuid_compare( hdrp->ih_fsid, *fsidp )
+			     ||
+			     uuid_compare( hdrp->ih_sessid, *baseidp )
+			     ||
+			     hdrp->ih_cnt > sc_iloldsz / sizeof( il_ent_t )
+			     ||
+			     sizeof( il_hdr_t )
+			     +
+			     hdrp->ih_cnt * sizeof( il_ent_t )
+			     !=
+			     ( u_int64_t )sc_iloldsz ) {
+				mlog( MLOG_NORMAL | MLOG_WARNING, _(
+				      "ignoring corrupt inode list %s\n"),
+				      basepath );
+				( void )munmap( ( void * )sc_iloldp,
+						sc_iloldsz );
+				sc_iloldp = 0;
+			} else {
+				sc_iloldentp = ( il_ent_t * )( hdrp + 1 );
+				sc_iloldcnt = ( size_t )hdrp->ih_cnt;
+				mlog( MLOG_DEBUG,
+				      "inode list %s: %llu files\n",
+				      basepath,
+				      hdrp->ih_cnt );
+			}
+		}
+
+		/* without the list of the base, what this dump leaves
+		 * restored is unknown.
+		 */
+		if ( ! sc_iloldp ) {
+			mlog( MLOG_VERBOSE | MLOG_NOTE, _(
+			      "base dump kept no inode list: "
+			      "dumping the data of all changed files, "
+			      "and keeping no inode list\n") );
+			return;
+		}
+	}
+
+	/* begin the new list in a file of its own, renamed into place by
+	 * inolist_end( ). leave room for the header, written last.
+	 */
+	uuid_unparse( *sessidp, string_uuid );
+	if ( snprintf( sc_ilpath,
+		       sizeof( sc_ilpath ),
+		       "%s/%s%s.%s",
+		       XFSDUMP_DIRPATH,
+		       IL_PREFIX,
+		       sc_ilfsidstr,
+		       string_uuid ) >= ( intgen_t )sizeof( sc_ilpath )
+	     ||
+	     snprintf( sc_iltmppath,
+		       sizeof( sc_iltmppath ),
+		       "%s.XXXXXX",
+		       sc_ilpath ) >= ( intgen_t )sizeof( sc_iltmppath )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "inode list pathname too long\n") );
+		sc_iltmppath[ 0 ] = 0;
+		return;
+	}
+	sc_ilfd = mkstemp( sc_iltmppath );
+	if ( sc_ilfd < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to create inode list %s: %s\n"),
+		      sc_iltmppath,
+		      strerror( errno ));
+		sc_iltmppath[ 0 ] = 0;
+		return;
+	}
+	sc_ilwbufp = ( char * )malloc( IL_WBUFSZ );
+	ASSERT( sc_ilwbufp );
+	sc_ilwbuflen = 0;
+	sc_ilcnt = 0;
+	sc_illastino = 0;
+	sc_ilpr = BOOL_TRUE;
+
+	memset( ( void * )&hdr, 0, sizeof( hdr ));
+	( void )il_write( ( void * )&hdr, sizeof( hdr ));
+}
+
+bool_t
+inolist_base( void )
+{
+	return sc_iloldp ? BOOL_TRUE : BOOL_FALSE;
+}
+
+bool_t
+inolist_inbase( xfs_bstat_t *statp )
+{
+	return il_find( statp ) ? BOOL_TRUE : BOOL_FALSE;
+}
+
+bool_t
+inolist_dataunchanged( xfs_bstat_t *statp )
+{
+	il_ent_t *entp;
+
+	if ( ( statp->bs_mode & S_IFMT ) != S_IFREG ) {
+		return BOOL_FALSE;
+	}
+	if ( statp->bs_mtime.tv_sec >= sc_ilbasetime ) {
+		return BOOL_FALSE;
+	}
+
+	/* the mtime may have been set back after the data was rewritten
+	 * (touch -d, rsync -t, cp -p): a change of size or layout gives
+	 * that away. the extent map is the costly check, so it goes last.
+	 */
+	entp = il_find( statp );
+	if ( ! entp
+	     ||
+	     entp->ie_size != statp->bs_size
+	     ||
+	     entp->ie_extents != ( u_int32_t )statp->bs_extents
+	     ||
+	     entp->ie_firstblk == IL_BLKUNKNOWN
+	     ||
+	     il_firstblk( statp ) != entp->ie_firstblk ) {
+		return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+void
+inolist_add( xfs_bstat_t *statp )
+{
+	il_ent_t *entp;
+	il_ent_t ent;
+
+	if ( ! sc_ilpr ) {
+		return;
+	}
+	ASSERT( ( statp->bs_mode & S_IFMT ) == S_IFREG );
+
+	/* bisection needs ascending inos. a subtree dump visits
+	 * files in tree order, but keeps no list.
+	 */
+	if ( sc_ilcnt && statp->bs_ino <= sc_illastino ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "ino %llu out of order in inode list: "
+		      "keeping no inode list\n"),
+		      statp->bs_ino );
+		il_abandon( );
+		return;
+	}
+
+	memset( ( void * )&ent, 0, sizeof( ent ));
+	ent.ie_ino = statp->bs_ino;
+	ent.ie_gen = statp->bs_gen;
+	ent.ie_extents = ( u_int32_t )statp->bs_extents;
+	ent.ie_size = statp->bs_size;
+
+	/* a file whose inode has not changed since the base keeps the
+	 * layout listed there; only the others need their extent map
+	 */
+	entp = statp->bs_ctime.tv_sec < sc_ilbasetime ? il_find( statp ) : 0;
+	ent.ie_firstblk = entp ? entp->ie_firstblk : il_firstblk( statp );
+	if ( il_write( ( void * )&ent, sizeof( ent ))) {
+		sc_ilcnt++;
+		sc_illastino = statp->bs_ino;
+	}
+}
+
+void
+inolist_skip( xfs_ino_t ino )
+{
+	lock( );
+	if ( sc_ilpr ) {
+		if ( sc_ilskipcnt == sc_ilskipmax ) {
+			sc_ilskipmax = sc_ilskipmax ? 2 * sc_ilskipmax : 64;
+			sc_ilskipp = ( xfs_ino_t * )realloc(
+						( void * )sc_ilskipp,
+						sc_ilskipmax
+						*
+						sizeof( xfs_ino_t ));
+			ASSERT( sc_ilskipp );
+		}
+		sc_ilskipp[ sc_ilskipcnt++ ] = ino;
+	}
+	unlock( );
+}
+
+void
+inolist_end( bool_t completepr )
+{
+	il_hdr_t hdr;
+
+	if ( sc_iloldp ) {
+		( void )munmap( ( void * )sc_iloldp, sc_iloldsz );
+		sc_iloldp = 0;
+		sc_iloldentp = 0;
+		sc_iloldcnt = 0;
+	}
+
+	if ( ! sc_ilpr ) {
+		return;
+	}
+
+	/* an interrupted dump may be the base of a resumed one, but not
+	 * of an incremental: keep no list for it.
+	 */
+	if ( ! completepr ) {
+		il_abandon( );
+		return;
+	}
+
+	memset( ( void * )&hdr, 0, sizeof( hdr ));
+	strncpy( hdr.ih_magic, IL_MAGIC, sizeof( hdr.ih_magic ));
+	hdr.ih_version = IL_VERSION;
+	uuid_copy( hdr.ih_fsid, sc_ilfsid );
+	uuid_copy( hdr.ih_sessid, sc_ilsessid );
+	if ( ! il_flush( ) || ! il_drop( )) {
+		return;
+	}
+	hdr.ih_cnt = sc_ilcnt;
+	if ( pwrite64( sc_ilfd, ( void * )&hdr, sizeof( hdr ), 0 )
+	     !=
+	     ( ssize_t )sizeof( hdr )
+	     ||
+	     fsync( sc_ilfd )
+	     ||
+	     rename( sc_iltmppath, sc_ilpath )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to save inode list %s: %s\n"),
+		      sc_ilpath,
+		      strerror( errno ));
+		il_abandon( );
+		return;
+	}
+	mlog( MLOG_DEBUG,
+	      "inode list %s: saved %llu files\n",
+	      sc_ilpath,
+	      sc_ilcnt );
+
+	sc_iltmppath[ 0 ] = 0;
+	il_abandon( );
+	il_prune( );
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+/* il_find - returns the entry for the file in the list of the base, if
+ * there is one and the generation matches
+ */
+static il_ent_t *
+il_find( xfs_bstat_t *statp )
+{
+	size_t lo = 0;
+	size_t hi = sc_iloldcnt;
+
+	if ( ! sc_iloldp ) {
+		return 0;
+	}
+
+	while ( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		il_ent_t *entp = &sc_iloldentp[ mid ];
+
+		if ( entp->ie_ino < statp->bs_ino ) {
+			lo = mid + 1;
+		} else if ( entp->ie_ino > statp->bs_ino ) {
+			hi = mid;
+		} else {
+			return entp->ie_gen == statp->bs_gen ? entp : 0;
+		}
+	}
+
+	return 0;
+}
+
+/* il_firstblk - returns the disk address of the first data extent of the
+ * file, IL_NOBLK if it has none, or IL_BLKUNKNOWN if its extent map cannot
+ * be had. a file rewritten after truncation, as by cp -p, gets new blocks,
+ * so this gives it away when its size and extent count do not.
+ */
+static int64_t
+il_firstblk( xfs_bstat_t *statp )
+{
+	struct getbmapx bmap[ IL_BMAPLEN ];
+	int64_t blk;
+	intgen_t fd;
+	intgen_t bmix;
+
+	if ( ! statp->bs_extents ) {
+		return IL_NOBLK;
+	}
+	fd = jdm_open( sc_ilfshandlep, statp, O_RDONLY );
+	if ( fd < 0 ) {
+		mlog( MLOG_DEBUG,
+		      "unable to open ino %llu for its extent map: %s\n",
+		      statp->bs_ino,
+		      strerror( errno ));
+		return IL_BLKUNKNOWN;
+	}
+	memset( ( void * )bmap, 0, sizeof( bmap ));
+	bmap[ 0 ].bmv_offset = 0;
+	bmap[ 0 ].bmv_length = -1;
+	bmap[ 0 ].bmv_count = IL_BMAPLEN;
+	bmap[ 0 ].bmv_iflags = BMV_IF_NO_DMAPI_READ;
+	blk = IL_BLKUNKNOWN;
+	if ( ioctl( fd, XFS_IOC_GETBMAPX, bmap ) == 0 ) {
+		blk = IL_NOBLK;
+		for ( bmix = 1 ; bmix <= bmap[ 0 ].bmv_entries ; bmix++ ) {
+			if ( bmap[ bmix ].bmv_block >= 0 ) {
+				blk = bmap[ bmix ].bmv_block;
+				break;
+			}
+		}
+	}
+	( void )close( fd );
+
+	return blk;
+}
+
+/* il_write - appends to the new list through the write buffer. on
+ * failure, reports it and abandons the new list.
+ */
+static bool_t
+il_write( void *bufp, size_t sz )
+{
+	char *p = ( char * )bufp;
+
+	if ( ! sc_ilpr ) {
+		return BOOL_FALSE;
+	}
+
+	while ( sz > 0 ) {
+		size_t cnt = min( sz, IL_WBUFSZ - sc_ilwbuflen );
+
+		memcpy( ( void * )( sc_ilwbufp + sc_ilwbuflen ),
+			( void * )p,
+			cnt );
+		sc_ilwbuflen += cnt;
+		p += cnt;
+		sz -= cnt;
+		if ( sc_ilwbuflen == IL_WBUFSZ && ! il_flush( )) {
+			return BOOL_FALSE;
+		}
+	}
+
+	return BOOL_TRUE;
+}
+
+/* il_flush - writes out the write buffer
+ */
+static bool_t
+il_flush( void )
+{
+	ssize_t nwritten;
+
+	if ( ! sc_ilpr ) {
+		return BOOL_FALSE;
+	}
+	if ( sc_ilwbuflen == 0 ) {
+		return BOOL_TRUE;
+	}
+
+	nwritten = write( sc_ilfd, ( void * )sc_ilwbufp, sc_ilwbuflen );
+	if ( nwritten != ( ssize_t )sc_ilwbuflen ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to write inode list %s: %s\n"),
+		      sc_iltmppath,
+		      nwritten < 0 ? strerror( errno ) : _("short write") );
+		il_abandon( );
+		return BOOL_FALSE;
+	}
+	sc_ilwbuflen = 0;
+
+	return BOOL_TRUE;
+}
+
+/* il_drop - removes the files skipped by the streams from the list, all
+ * of which has been written out, by copying each of its entries down
+ * over those dropped before it. on failure, reports it and abandons the
+ * new list.
+ */
+static bool_t
+il_drop( void )
+{
+	off64_t rdoff = ( off64_t )sizeof( il_hdr_t );
+	off64_t wroff = rdoff;
+	u_int64_t remcnt = sc_ilcnt;
+	u_int64_t dropcnt = 0;
+
+	if ( ! sc_ilskipcnt ) {
+		return BOOL_TRUE;
+	}
+	qsort( ( void * )sc_ilskipp,
+	       sc_ilskipcnt,
+	       sizeof( xfs_ino_t ),
+	       il_inocmp );
+
+	while ( remcnt ) {
+		il_ent_t *entp = ( il_ent_t * )sc_ilwbufp;
+		size_t entcnt;
+		size_t keepcnt;
+		size_t ix;
+		ssize_t nread;
+
+		entcnt = IL_WBUFSZ / sizeof( il_ent_t );
+		if ( ( u_int64_t )entcnt > remcnt ) {
+			entcnt = ( size_t )remcnt;
+		}
+		nread = pread64( sc_ilfd,
+				 ( void * )entp,
+				 entcnt * sizeof( il_ent_t ),
+				 rdoff );
+		if ( nread != ( ssize_t )( entcnt * sizeof( il_ent_t ))) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "unable to read inode list %s: %s\n"),
+			      sc_iltmppath,
+			      nread < 0 ? strerror( errno ) : _("short read") );
+			il_abandon( );
+			return BOOL_FALSE;
+		}
+		rdoff += ( off64_t )nread;
+		remcnt -= ( u_int64_t )entcnt;
+
+		for ( keepcnt = 0, ix = 0 ; ix < entcnt ; ix++ ) {
+			if ( bsearch( ( void * )&entp[ ix ].ie_ino,
+				      ( void * )sc_ilskipp,
+				      sc_ilskipcnt,
+				      sizeof( xfs_ino_t ),
+				      il_inocmp )) {
+				dropcnt++;
+				continue;
+			}
+			entp[ keepcnt++ ] = entp[ ix ];
+		}
+		if ( keepcnt
+		     &&
+		     pwrite64( sc_ilfd,
+			       ( void * )entp,
+			       keepcnt * sizeof( il_ent_t ),
+			       wroff )
+		     !=
+		     ( ssize_t )( keepcnt * sizeof( il_ent_t ))) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "unable to write inode list %s: %s\n"),
+			      sc_iltmppath,
+			      strerror( errno ));
+			il_abandon( );
+			return BOOL_FALSE;
+		}
+		wroff += ( off64_t )( keepcnt * sizeof( il_ent_t ));
+	}
+
+	if ( ftruncate64( sc_ilfd, wroff )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to write inode list %s: %s\n"),
+		      sc_iltmppath,
+		      strerror( errno ));
+		il_abandon( );
+		return BOOL_FALSE;
+	}
+	mlog( MLOG_DEBUG,
+	      "inode list %s: dropped %llu files not dumped\n",
+	      sc_iltmppath,
+	      dropcnt );
+	sc_ilcnt -= dropcnt;
+
+	return BOOL_TRUE;
+}
+
+static int
+il_inocmp( const void *ap, const void *bp )
+{
+	xfs_ino_t a = *( xfs_ino_t * )ap;
+	xfs_ino_t b = *( xfs_ino_t * )bp;
+
+	return a < b ? -1 : ( a > b ? 1 : 0 );
+}
+
+/* il_prune - removes the lists this file system's dumps kept which are
+ * no longer in the inventory, and so can no longer be the base of a dump
+ */
+static void
+il_prune( void )
+{
+	char prefix[ sizeof( IL_PREFIX ) + 37 ];
+	size_t prefixlen;
+	struct dirent *dep;
+	DIR *dirp;
+
+	sprintf( prefix, "%s%s.", IL_PREFIX, sc_ilfsidstr );
+	prefixlen = strlen( prefix );
+
+	dirp = opendir( XFSDUMP_DIRPATH );
+	if ( ! dirp ) {
+		return;
+	}
+	while ( ( dep = readdir( dirp )) != 0 ) {
+		char path[ MAXPATHLEN ];
+		inv_session_t *sessp;
+		uuid_t sessid;
+
+		if ( strncmp( dep->d_name, prefix, prefixlen )
+		     ||
+		     strlen( dep->d_name + prefixlen ) != 36
+		     ||
+		     uuid_parse( dep->d_name + prefixlen, sessid )
+		     ||
+		     ! uuid_compare( sessid, sc_ilsessid )) {
+			continue;
+		}
+		sessp = 0;
+		if ( inv_get_session_byuuid( &sessid, &sessp )) {
+			inv_free_session( &sessp );
+			continue;
+		}
+		sprintf( path, "%s/%s", XFSDUMP_DIRPATH, dep->d_name );
+		mlog( MLOG_DEBUG,
+		      "removing inode list %s: session not in inventory\n",
+		      path );
+		( void )unlink( path );
+	}
+	( void )closedir( dirp );
+}
+
+/* il_abandon - stops building the new list and removes its file, if it
+ * was not renamed into place
+ */
+static void
+il_abandon( void )
+{
+	sc_ilpr = BOOL_FALSE;
+	if ( sc_ilfd >= 0 ) {
+		( void )close( sc_ilfd );
+		sc_ilfd = -1;
+	}
+	if ( sc_iltmppath[ 0 ] ) {
+		( void )unlink( sc_iltmppath );
+		sc_iltmppath[ 0 ] = 0;
+	}
+	if ( sc_ilwbufp ) {
+		free( ( void * )sc_ilwbufp );
+		sc_ilwbufp = 0;
+	}
+	sc_ilwbuflen = 0;
+	if ( sc_ilskipp ) {
+		free( ( void * )sc_ilskipp );
+		sc_ilskipp = 0;
+	}
+	sc_ilskipcnt = 0;
+	sc_ilskipmax = 0;
+}
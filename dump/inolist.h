@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef INOLIST_H
+#define INOLIST_H
+
+/* inolist.[hc] - the regular files whose data each dump left restored
+ *
+ * with -g, a file whose ctime but not mtime has changed since the base
+ * dump (a chmod, chown, link or unlink) is dumped as its file header and
+ * extended attributes alone (FILEHDR_FLAGS_METAONLY), and a cumulative
+ * restore keeps the data it restored before.
+ *
+ * an old mtime alone does not show the data is in the base: a file made
+ * by tar, cp -p or a rename from another file system is new but carries
+ * the mtime of its source. so each dump made with -g keeps a list of the
+ * ino and generation of every regular file whose data a cumulative
+ * restore of it and its bases has restored, in a file next to the
+ * inventory named for the file system and the dump session. a file is
+ * dumped without data only if it is in the list of the base with the
+ * same size, extent count and disk address of its first data extent.
+ *
+ * data rewritten in place, keeping size and layout, and its mtime then
+ * set back to before the base dump is still taken to be unchanged.
+ *
+ * the list is written in the order the bulkstat scan of inomap_build( )
+ * visits the files, which is ascending ino order, and searched by
+ * bisection.
+ */
+
+/* inolist_init - maps the list kept by the base dump baseidp, if given,
+ * of the file system fsid, and begins the list of this dump, sessid.
+ * basetime is the time of the base. with no base, as at level 0, only
+ * the new list is begun; an incremental dump whose base kept no list
+ * keeps none either. files are opened through fshandlep to read their
+ * extent maps.
+ */
+extern void inolist_init( jdm_fshandle_t *fshandlep,
+			  uuid_t *fsidp,
+			  uuid_t *sessidp,
+			  uuid_t *baseidp,
+			  time32_t basetime );
+
+/* inolist_base - returns BOOL_TRUE if the list of the base is mapped
+ */
+extern bool_t inolist_base( void );
+
+/* inolist_inbase - returns BOOL_TRUE if the file is in the list of
+ * the base
+ */
+extern bool_t inolist_inbase( xfs_bstat_t *statp );
+
+/* inolist_dataunchanged - returns BOOL_TRUE if the file is a regular file
+ * in the list of the base with the size, extent count and first data
+ * extent it has now, and its mtime is before the base dump
+ */
+extern bool_t inolist_dataunchanged( xfs_bstat_t *statp );
+
+/* inolist_add - called by the bulkstat scan for each regular file whose
+ * data will be restored by a cumulative restore of this dump: those
+ * dumped, and those unchanged which are in the list of the base.
+ */
+extern void inolist_add( xfs_bstat_t *statp );
+
+/* inolist_skip - called by the streams for each regular file whose data
+ * they then did not dump after all, as when it could not be opened.
+ * inolist_end( ) drops it from the list.
+ */
+extern void inolist_skip( xfs_ino_t ino );
+
+/* inolist_end - unmaps the list of the base. if completepr, saves the
+ * new list and removes those of dumps no longer in the inventory;
+ * otherwise discards it.
+ */
+extern void inolist_end( bool_t completepr );
+
+#endif /* INOLIST_H */
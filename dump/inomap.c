@@ -37,6 +37,9 @@
 #include "hsmapi.h"
 
 #include "inomap.h"
+#include "segix.h"
+#include "treecache.h"
+#include "inolist.h"
 #include "arch_xlate.h"
 #include "exit.h"
 #include <attr/attributes.h>
@@ -51,6 +54,19 @@
 	/* size (in bytes) of buf passed to diriter (when not recursive)
 	 */
 
+/* context passed by supprt_prune to itself for the entries of a directory
+ */
+struct prune_ctx {
+	bool_t pc_changedpr;
+		/* some entry must be dumped
+		 */
+	tc_dir_t pc_dir;
+		/* the entries, for the directory tree cache
+		 */
+};
+
+typedef struct prune_ctx prune_ctx_t;
+
 /* declarations of externally defined global symbols *************************/
 
 extern bool_t preemptchk( int );
@@ -288,7 +304,7 @@ inomap_build( jdm_fshandle_t *fshandlep,
 	 * no children needing dumping.
 	 */
 	if ( pruneneeded ) {
-		bool_t	rootdump = BOOL_FALSE;
+		prune_ctx_t rootctx;
 
 		mlog( MLOG_VERBOSE | MLOG_INOMAP, _(
 		      "ino map phase 2: "
@@ -297,11 +313,13 @@ inomap_build( jdm_fshandle_t *fshandlep,
 		*inomap_statpassp = 0;
 		*inomap_statphasep = 2;
 
-		(void) supprt_prune( &rootdump,
+		memset( ( void * )&rootctx, 0, sizeof( rootctx ));
+		(void) supprt_prune( &rootctx,
 				     fshandlep,
 				     fsfd,
 				     rootstatp,
 				     NULL );
+		treecache_free( &rootctx.pc_dir );
 		*inomap_statphasep = 0;
 
 		if ( preemptchk( PREEMPT_FULL )) {
@@ -514,6 +532,12 @@ cb_add( void *arg1,
 		return 0;
 	}
 
+	/* let the directory tree cache see if it is still current
+	 */
+	if ( mode == S_IFDIR ) {
+		treecache_note( statp );
+	}
+
 	/* if no portion of this ino is in the resume range,
 	 * then only dump it if it has changed since the interrupted
 	 * dump.
@@ -632,8 +656,19 @@ cb_add( void *arg1,
 				    (gen_t)statp->bs_gen,
 				    MAP_NDR_CHANGE );
 			cb_nondircnt++;
-			cb_datasz += estimated_size;
-			cb_hdrsz += ( EXTENTHDR_SZ * (statp->bs_extents + 1) );
+
+			/* with -g, a file whose data is already restored
+			 * is dumped as a header and a lone extent header
+			 */
+			if ( inolist_dataunchanged( statp )) {
+				cb_hdrsz += EXTENTHDR_SZ;
+			} else {
+				cb_datasz += estimated_size;
+				cb_hdrsz += ( EXTENTHDR_SZ * (statp->bs_extents + 1) );
+			}
+			if ( mode == S_IFREG ) {
+				inolist_add( statp );
+			}
 		}
 	} else if ( resumed ) {
 		ASSERT( mode != S_IFDIR );
@@ -651,6 +686,9 @@ cb_add( void *arg1,
 				    ino,
 				    (gen_t)statp->bs_gen,
 				    MAP_NDR_NOCHNG );
+			if ( mode == S_IFREG && inolist_inbase( statp )) {
+				inolist_add( statp );
+			}
 		}
 	}
 
@@ -704,20 +742,30 @@ cb_inoresumed( xfs_ino_t ino )
 /* supprt_prune -  does supprt directory entry pruning.
  * recurses downward looking for modified inodes, & clears supprt
  * (-> nochng) on the way back up after examining all descendents.
+ * the entries of a directory unchanged since the directory tree cache
+ * was written are taken from the cache rather than read.
  */
 /* ARGSUSED */
 static bool_t			/* false, used as diriter callback */
-supprt_prune( void *arg1,	/* ancestors marked as changed? */
+supprt_prune( void *arg1,	/* parent's prune_ctx_t */
 	      jdm_fshandle_t *fshandlep,
 	      intgen_t fsfd,
 	      xfs_bstat_t *statp,
 	      char *name )
 {
 	static bool_t cbrval = BOOL_FALSE;
+	prune_ctx_t *pctxp = ( prune_ctx_t * )arg1;
 	intgen_t state;
 
+	treecache_add( &pctxp->pc_dir, statp );
+
 	if ( ( statp->bs_mode & S_IFMT ) == S_IFDIR ) {
-		bool_t changed_below = BOOL_FALSE;
+		prune_ctx_t ctx;
+		tc_subdir_t *subdirp;
+		size_t subdircnt;
+		xfs_ino_t *nondirp;
+		size_t nondircnt;
+		bool_t completepr;
 
 		state = inomap_get_state( cb_inomap_contextp, statp->bs_ino );
 		if ( state != MAP_DIR_CHANGE &&
@@ -733,17 +781,61 @@ supprt_prune( void *arg1,	/* ancestors marked as changed? */
 					  state );
 		}
 
-		( void )diriter( fshandlep,
-				 fsfd,
-				 statp,
-				 supprt_prune,
-				 (void *)&changed_below,
-				 &cbrval,
-				 NULL,
-				 0 );
+		memset( ( void * )&ctx, 0, sizeof( ctx ));
+		if ( treecache_get( statp,
+				    &subdirp,
+				    &subdircnt,
+				    &nondirp,
+				    &nondircnt )) {
+			xfs_bstat_t entstat;
+			size_t entix;
+
+			/* only the ino, gen and type of an entry are
+			 * looked at, here and by jdm_open( )
+			 */
+			memset( ( void * )&entstat, 0, sizeof( entstat ));
+			entstat.bs_mode = S_IFDIR;
+			for ( entix = 0 ; entix < subdircnt ; entix++ ) {
+				entstat.bs_ino = subdirp[ entix ].ts_ino;
+				entstat.bs_gen = subdirp[ entix ].ts_gen;
+				( void )supprt_prune( ( void * )&ctx,
+						      fshandlep,
+						      fsfd,
+						      &entstat,
+						      NULL );
+			}
+			entstat.bs_mode = S_IFREG;
+			entstat.bs_gen = 0;
+			for ( entix = 0 ; entix < nondircnt ; entix++ ) {
+				entstat.bs_ino = nondirp[ entix ];
+				( void )supprt_prune( ( void * )&ctx,
+						      fshandlep,
+						      fsfd,
+						      &entstat,
+						      NULL );
+			}
+			completepr = BOOL_TRUE;
+		} else {
+			completepr = diriter( fshandlep,
+					      fsfd,
+					      statp,
+					      supprt_prune,
+					      ( void * )&ctx,
+					      &cbrval,
+					      NULL,
+					      0 ) == 0;
+		}
+
+		/* a directory which could not be read completely is left
+		 * out of the cache, so the next dump reads it again
+		 */
+		if ( completepr ) {
+			treecache_put( statp, &ctx.pc_dir );
+		}
+		treecache_free( &ctx.pc_dir );
 
 		if ( state == MAP_DIR_SUPPRT ) {
-			if ( changed_below == BOOL_FALSE ) {
+			if ( ctx.pc_changedpr == BOOL_FALSE ) {
 				inomap_set_state( cb_inomap_contextp,
 						  statp->bs_ino,
 						  MAP_DIR_NOCHNG );
@@ -753,18 +845,18 @@ supprt_prune( void *arg1,	/* ancestors marked as changed? */
 				/* Directory entries back up the hierarchy */
 				/* to be dumped - as either MAP_DIR_SUPPRT */
 				/* or as MAP_DIR_CHANGE in inode state map */
-				*( bool_t * )arg1 = BOOL_TRUE;
+				pctxp->pc_changedpr = BOOL_TRUE;
 			}
 		}
 		else if ( state == MAP_DIR_CHANGE ) {
 			/* Directory entries back up the hierarchy must get */
 			/* dumped - as either MAP_DIR_SUPPRT/MAP_DIR_CHANGE */
-			*( bool_t * )arg1 = BOOL_TRUE;
+			pctxp->pc_changedpr = BOOL_TRUE;
 		}
 		return cbrval;
 	}
 
-	if ( *(bool_t *)arg1 == BOOL_TRUE ) {	/* shortcut, sibling changed */
+	if ( pctxp->pc_changedpr == BOOL_TRUE ) { /* shortcut, sibling changed */
 		return cbrval;
 	}
 
@@ -781,7 +873,7 @@ supprt_prune( void *arg1,	/* ancestors marked as changed? */
 	if ( state == MAP_NDR_CHANGE ) {
 		/* Directory entries back up the hierarchy must get */
 		/* dumped - as either MAP_DIR_SUPPRT/MAP_DIR_CHANGE */
-		*( bool_t * )arg1 = BOOL_TRUE;
+		pctxp->pc_changedpr = BOOL_TRUE;
 	}
 	return cbrval;
 }
@@ -857,8 +949,13 @@ cb_startpt( void *arg1,
 
 	ASSERT( cb_startptix < cb_startptcnt );
 
-	estimate = estimate_dump_space( statp );
-	cb_accum += estimate + ( EXTENTHDR_SZ * (statp->bs_extents + 1) );
+	if ( inolist_dataunchanged( statp )) {
+		estimate = 0;
+		cb_accum += EXTENTHDR_SZ;
+	} else {
+		estimate = estimate_dump_space( statp );
+		cb_accum += estimate + ( EXTENTHDR_SZ * (statp->bs_extents + 1) );
+	}
 
 	/* loop until no new start points found. loop is necessary
 	 * to handle the pathological case of a huge file so big it
@@ -989,6 +1086,7 @@ static struct inomap {
 	intgen_t hnkmaplen;
 	i2gseg_t *i2gmap;
 	seg_addr_t lastseg;
+	segix_t segix;
 } inomap;
 
 static inline void
@@ -1084,6 +1182,11 @@ inomap_init( intgen_t igrpcnt )
 		calloc( inomap.hnkmaplen * SEGPERHNK, sizeof(i2gseg_t) );
 	if (!inomap.hnkmap || !inomap.i2gmap)
 		return -1;
+
+	/* the segment index only speeds up lookups; without it
+	 * inomap_find_seg searches the map
+	 */
+	(void)segix_init( &inomap.segix, ( size_t )igrpcnt );
 	return 0;
 }
 
@@ -1188,6 +1291,14 @@ cb_add_inogrp( void *arg1, intgen_t fsfd, xfs_inogrp_t *inogrp )
 	segp = inomap_addr2seg( lastsegp );
 	segp->base = inogrp->xi_startino;
 
+	if ( inomap.segix.si_slotp
+	     &&
+	     ! segix_add( &inomap.segix,
+			  inomap.hnkmap,
+			  ( size_t )inomap_addr2segix( lastsegp ))) {
+		segix_free( &inomap.segix );
+	}
+
 	return 0;
 }
 
@@ -1254,10 +1365,12 @@ inomap_find_hnk( seg_addr_t *addrp, xfs_ino_t ino )
 	return BOOL_FALSE;
 }
 
-/* use binary search to find the hunk containing the given
- * inode, and then binary search the hunk to find the correct
- * segment, if any. use the supplied addr as the starting
- * point for the search.
+/* find the segment containing the given inode, if any. the supplied
+ * addr is checked first, since callers mostly ask about the same or
+ * the next segment. otherwise look the inode up in the segment index.
+ * if there is none, use binary search to find the hunk containing the
+ * inode, and then binary search the hunk to find the correct segment,
+ * using the supplied addr as the starting point for the search.
  */
 static bool_t
 inomap_find_seg( seg_addr_t *addrp, xfs_ino_t ino )
@@ -1270,6 +1383,23 @@ inomap_find_seg( seg_addr_t *addrp, xfs_ino_t ino )
 		inomap_reset_context( addrp );
 	}
 
+	if ( inomap_validaddr( addrp ) ) {
+		segp = inomap_addr2seg( addrp );
+		if ( segp->base <= ino && ino < segp->base + INOPERSEG ) {
+			return BOOL_TRUE;
+		}
+	}
+
+	if ( inomap.segix.si_slotp ) {
+		size_t segix;
+
+		if ( !segix_find( &inomap.segix, inomap.hnkmap, ino, &segix ) )
+			return BOOL_FALSE;
+		addrp->hnkoff = ( intgen_t )( segix / SEGPERHNK );
+		addrp->segoff = ( intgen_t )( segix % SEGPERHNK );
+		return BOOL_TRUE;
+	}
+
 	if ( !inomap_find_hnk( addrp, ino ) )
 		return BOOL_FALSE;
 
@@ -0,0 +1,620 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+#include <xfs/jdm.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <uuid/uuid.h>
+
+#include "types.h"
+#include "mlog.h"
+#include "global.h"
+#include "inventory.h"
+#include "treecache.h"
+
+
+/* structure definitions used locally ****************************************/
+
+/* the cache file is a header, a record for each directory put, and an
+ * index of the records sorted by ino. the records of a directory are
+ * its tc_rec_t, then its tc_subdir_t's, then the inos of its other
+ * entries. everything is in host byte order: the file never leaves
+ * the host which wrote it, and a foreign one fails the version check.
+ */
+#define TC_MAGIC	"xfsdtc1"
+#define TC_VERSION	1
+
+struct tc_hdr {
+	char th_magic[ 8 ];
+	u_int32_t th_version;
+	time32_t th_time;
+		/* no directory modified before this time has changed
+		 * since its entries were read
+		 */
+	uuid_t th_fsid;
+	u_int64_t th_dircnt;
+		/* number of records, and of index entries
+		 */
+	u_int64_t th_indexoff;
+	char th_pad[ 16 ];
+};
+
+typedef struct tc_hdr tc_hdr_t;
+
+struct tc_rec {
+	xfs_ino_t tr_ino;
+	u_int32_t tr_gen;
+	u_int32_t tr_pad;
+	u_int64_t tr_subdircnt;
+	u_int64_t tr_nondircnt;
+};
+
+typedef struct tc_rec tc_rec_t;
+
+struct tc_ix {
+	xfs_ino_t ti_ino;
+	u_int64_t ti_off;
+};
+
+typedef struct tc_ix tc_ix_t;
+
+#define TC_WBUFSZ	0x10000
+	/* size of the buffer through which the new cache is written
+	 */
+
+#define TC_DIRINCR	64
+	/* growth increment of the tc_dir_t arrays, in entries
+	 */
+
+
+/* declarations of externally defined global variables ***********************/
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static tc_rec_t *tc_lookup( xfs_ino_t ino, size_t *ixp );
+static bool_t tc_write( void *bufp, size_t sz );
+static bool_t tc_flush( void );
+static int tc_ixcmp( const void *ap, const void *bp );
+static void tc_abandon( void );
+
+
+/* definition of locally defined global variables ****************************/
+
+
+/* definition of locally defined static variables *****************************/
+
+static bool_t sc_tcpr = BOOL_FALSE;
+	/* a new cache is being built
+	 */
+static char sc_tcpath[ MAXPATHLEN ];
+static char sc_tctmppath[ MAXPATHLEN ];
+static uuid_t sc_tcfsid;
+static time32_t sc_tctime;
+
+static char *sc_tcoldp = 0;
+	/* the old cache, mapped. NULL if there is none usable
+	 */
+static size_t sc_tcoldsz = 0;
+static tc_hdr_t *sc_tcoldhdrp = 0;
+static tc_ix_t *sc_tcoldixp = 0;
+static u_char_t *sc_tcvalidp = 0;
+	/* one per old index entry: set by treecache_note( ) if the
+	 * directory's entries are still current
+	 */
+static size_t sc_tchitcnt = 0;
+
+static intgen_t sc_tcfd = -1;
+	/* the new cache, being written
+	 */
+static char *sc_tcwbufp = 0;
+static size_t sc_tcwbuflen = 0;
+static u_int64_t sc_tcwoff = 0;
+static tc_ix_t *sc_tcixp = 0;
+static size_t sc_tcixcnt = 0;
+static size_t sc_tcixsz = 0;
+
+
+/* definition of locally defined global functions ****************************/
+
+void
+treecache_init( uuid_t *fsidp, time32_t now )
+{
+	char string_uuid[ 37 ];
+	tc_hdr_t hdr;
+	struct stat64 st;
+	intgen_t fd;
+
+	ASSERT( ! sc_tcpr );
+
+	/* the new cache is built in a file of its own, so concurrent dumps
+	 * of the same filesystem cannot write into each other's
+	 */
+	uuid_unparse( *fsidp, string_uuid );
+	if ( snprintf( sc_tcpath,
+		       sizeof( sc_tcpath ),
+		       "%s/treecache.%s",
+		       XFSDUMP_DIRPATH,
+		       string_uuid ) >= ( intgen_t )sizeof( sc_tcpath )
+	     ||
+	     snprintf( sc_tctmppath,
+		       sizeof( sc_tctmppath ),
+		       "%s.XXXXXX",
+		       sc_tcpath ) >= ( intgen_t )sizeof( sc_tctmppath )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "directory tree cache pathname too long\n") );
+		sc_tctmppath[ 0 ] = 0;
+		return;
+	}
+	uuid_copy( sc_tcfsid, *fsidp );
+	sc_tctime = now;
+
+	/* map the old cache. anything amiss just means there is none.
+	 */
+	fd = open( sc_tcpath, O_RDONLY );
+	if ( fd >= 0 ) {
+		if ( fstat64( fd, &st ) == 0
+		     &&
+		     st.st_size >= ( off64_t )sizeof( tc_hdr_t )
+		     &&
+		     ( u_int64_t )st.st_size < ( u_int64_t )SIZE_MAX ) {
+			sc_tcoldsz = ( size_t )st.st_size;
+			sc_tcoldp = ( char * )mmap( 0,
+						    sc_tcoldsz,
+						    PROT_READ,
+						    MAP_SHARED,
+						    fd,
+						    0 );
+			if ( sc_tcoldp == ( char * )MAP_FAILED ) {
+				sc_tcoldp = 0;
+			}
+		}
+		( void )close( fd );
+	} else if ( errno != ENOENT ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to open directory tree cache %s: %s\n"),
+		      sc_tcpath,
+		      strerror( errno ));
+	}
+	if ( sc_tcoldp ) {
+		tc_hdr_t *hdrp = ( tc_hdr_t * )sc_tcoldp;
+		u_int64_t ixsz = hdrp->th_dircnt * sizeof( tc_ix_t );
+
+		if ( strncmp( hdrp->th_magic,
+			      TC_MAGIC,
+			      sizeof( hdrp->th_magic ))
+		     ||
+		     hdrp->th_version != TC_VERSION
+		     ||
+		     uuid_compare( hdrp->th_fsid, *fsidp )
+		     ||
+		     hdrp->th_dircnt > sc_tcoldsz / sizeof( tc_ix_t )
+		     ||
+		     hdrp->th_indexoff < sizeof( tc_hdr_t )
+		     ||
+		     hdrp->th_indexoff % sizeof( xfs_ino_t )
+		     ||
+		     hdrp->th_indexoff + ixsz != ( u_int64_t )sc_tcoldsz ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "ignoring corrupt directory tree cache %s\n"),
+			      sc_tcpath );
+			( void )munmap( ( void * )sc_tcoldp, sc_tcoldsz );
+			sc_tcoldp = 0;
+		} else {
+			sc_tcoldhdrp = hdrp;
+			sc_tcoldixp = ( tc_ix_t * )( sc_tcoldp
+						     +
+						     hdrp->th_indexoff );
+			sc_tcvalidp = ( u_char_t * )
+				      calloc( ( size_t )hdrp->th_dircnt + 1,
+					      sizeof( u_char_t ));
+			ASSERT( sc_tcvalidp );
+			mlog( MLOG_DEBUG,
+			      "directory tree cache %s: %llu directories\n",
+			      sc_tcpath,
+			      hdrp->th_dircnt );
+		}
+	}
+
+	/* begin the new cache. leave room for the header, written last.
+	 */
+	sc_tcfd = mkstemp( sc_tctmppath );
+	if ( sc_tcfd < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to create directory tree cache %s: %s\n"),
+		      sc_tctmppath,
+		      strerror( errno ));
+		sc_tctmppath[ 0 ] = 0;
+		return;
+	}
+	sc_tcwbufp = ( char * )malloc( TC_WBUFSZ );
+	ASSERT( sc_tcwbufp );
+	sc_tcwbuflen = 0;
+	sc_tcwoff = 0;
+	sc_tcixcnt = 0;
+	sc_tchitcnt = 0;
+	sc_tcpr = BOOL_TRUE;
+
+	memset( ( void * )&hdr, 0, sizeof( hdr ));
+	( void )tc_write( ( void * )&hdr, sizeof( hdr ));
+}
+
+void
+treecache_note( xfs_bstat_t *statp )
+{
+	time32_t ltime;
+	tc_rec_t *recp;
+	size_t ix;
+
+	if ( ! sc_tcoldp ) {
+		return;
+	}
+
+	recp = tc_lookup( statp->bs_ino, &ix );
+	if ( ! recp || recp->tr_gen != ( u_int32_t )statp->bs_gen ) {
+		return;
+	}
+
+	/* adding, removing or renaming an entry sets the directory's mtime
+	 * and ctime. the ctime cannot be set back by utime(2).
+	 */
+	ltime = max( statp->bs_mtime.tv_sec, statp->bs_ctime.tv_sec );
+	if ( ltime < sc_tcoldhdrp->th_time ) {
+		sc_tcvalidp[ ix ] = 1;
+	}
+}
+
+bool_t
+treecache_get( xfs_bstat_t *statp,
+	       tc_subdir_t **subdirpp,
+	       size_t *subdircntp,
+	       xfs_ino_t **nondirpp,
+	       size_t *nondircntp )
+{
+	tc_rec_t *recp;
+	size_t ix;
+
+	if ( ! sc_tcoldp ) {
+		return BOOL_FALSE;
+	}
+
+	recp = tc_lookup( statp->bs_ino, &ix );
+	if ( ! recp || ! sc_tcvalidp[ ix ] ) {
+		return BOOL_FALSE;
+	}
+
+	*subdirpp = ( tc_subdir_t * )( recp + 1 );
+	*subdircntp = ( size_t )recp->tr_subdircnt;
+	*nondirpp = ( xfs_ino_t * )( *subdirpp + *subdircntp );
+	*nondircntp = ( size_t )recp->tr_nondircnt;
+	sc_tchitcnt++;
+
+	return BOOL_TRUE;
+}
+
+void
+treecache_add( tc_dir_t *dirp, xfs_bstat_t *statp )
+{
+	if ( ! sc_tcpr ) {
+		return;
+	}
+
+	if ( ( statp->bs_mode & S_IFMT ) == S_IFDIR ) {
+		tc_subdir_t *subdirp;
+
+		if ( dirp->td_subdircnt == dirp->td_subdirsz ) {
+			dirp->td_subdirsz += TC_DIRINCR;
+			dirp->td_subdirp = ( tc_subdir_t * )
+					   realloc( ( void * )dirp->td_subdirp,
+						    dirp->td_subdirsz
+						    *
+						    sizeof( tc_subdir_t ));
+			ASSERT( dirp->td_subdirp );
+		}
+		subdirp = &dirp->td_subdirp[ dirp->td_subdircnt++ ];
+		subdirp->ts_ino = statp->bs_ino;
+		subdirp->ts_gen = ( u_int32_t )statp->bs_gen;
+		subdirp->ts_pad = 0;
+	} else {
+		if ( dirp->td_nondircnt == dirp->td_nondirsz ) {
+			dirp->td_nondirsz += TC_DIRINCR;
+			dirp->td_nondirp = ( xfs_ino_t * )
+					   realloc( ( void * )dirp->td_nondirp,
+						    dirp->td_nondirsz
+						    *
+						    sizeof( xfs_ino_t ));
+			ASSERT( dirp->td_nondirp );
+		}
+		dirp->td_nondirp[ dirp->td_nondircnt++ ] = statp->bs_ino;
+	}
+}
+
+void
+treecache_put( xfs_bstat_t *statp, tc_dir_t *dirp )
+{
+	tc_rec_t rec;
+	tc_ix_t *ixp;
+
+	if ( ! sc_tcpr ) {
+		return;
+	}
+
+	if ( sc_tcixcnt == sc_tcixsz ) {
+		sc_tcixsz = sc_tcixsz ? sc_tcixsz * 2 : 1024;
+		sc_tcixp = ( tc_ix_t * )realloc( ( void * )sc_tcixp,
+						 sc_tcixsz * sizeof( tc_ix_t ));
+		ASSERT( sc_tcixp );
+	}
+	ixp = &sc_tcixp[ sc_tcixcnt ];
+	ixp->ti_ino = statp->bs_ino;
+	ixp->ti_off = sc_tcwoff;
+
+	memset( ( void * )&rec, 0, sizeof( rec ));
+	rec.tr_ino = statp->bs_ino;
+	rec.tr_gen = ( u_int32_t )statp->bs_gen;
+	rec.tr_subdircnt = dirp->td_subdircnt;
+	rec.tr_nondircnt = dirp->td_nondircnt;
+	if ( ! tc_write( ( void * )&rec, sizeof( rec ))
+	     ||
+	     ! tc_write( ( void * )dirp->td_subdirp,
+			 dirp->td_subdircnt * sizeof( tc_subdir_t ))
+	     ||
+	     ! tc_write( ( void * )dirp->td_nondirp,
+			 dirp->td_nondircnt * sizeof( xfs_ino_t ))) {
+		return;
+	}
+	sc_tcixcnt++;
+}
+
+void
+treecache_free( tc_dir_t *dirp )
+{
+	if ( dirp->td_subdirp ) {
+		free( ( void * )dirp->td_subdirp );
+	}
+	if ( dirp->td_nondirp ) {
+		free( ( void * )dirp->td_nondirp );
+	}
+	memset( ( void * )dirp, 0, sizeof( *dirp ));
+}
+
+void
+treecache_end( bool_t completepr )
+{
+	tc_hdr_t hdr;
+
+	if ( sc_tcoldp ) {
+		mlog( MLOG_VERBOSE, _(
+		      "directory tree cache: "
+		      "%llu of %llu directories reused\n"),
+		      ( u_int64_t )sc_tchitcnt,
+		      sc_tcoldhdrp->th_dircnt );
+		( void )munmap( ( void * )sc_tcoldp, sc_tcoldsz );
+		sc_tcoldp = 0;
+		sc_tcoldhdrp = 0;
+		sc_tcoldixp = 0;
+		free( ( void * )sc_tcvalidp );
+		sc_tcvalidp = 0;
+	}
+
+	if ( ! sc_tcpr ) {
+		return;
+	}
+
+	/* a cache with no directories is what an interrupted walk, or
+	 * a level 0 dump which has no walk, leaves. keep the old one.
+	 */
+	if ( ! completepr || sc_tcixcnt == 0 ) {
+		tc_abandon( );
+		return;
+	}
+
+	/* the index follows the records. diriter order is not ino order,
+	 * so sort it for tc_lookup( ).
+	 */
+	qsort( ( void * )sc_tcixp, sc_tcixcnt, sizeof( tc_ix_t ), tc_ixcmp );
+	memset( ( void * )&hdr, 0, sizeof( hdr ));
+	strncpy( hdr.th_magic, TC_MAGIC, sizeof( hdr.th_magic ));
+	hdr.th_version = TC_VERSION;
+	hdr.th_time = sc_tctime;
+	uuid_copy( hdr.th_fsid, sc_tcfsid );
+	hdr.th_dircnt = sc_tcixcnt;
+	hdr.th_indexoff = sc_tcwoff;
+	if ( ! tc_write( ( void * )sc_tcixp, sc_tcixcnt * sizeof( tc_ix_t ))
+	     ||
+	     ! tc_flush( )) {
+		return;
+	}
+	if ( pwrite64( sc_tcfd, ( void * )&hdr, sizeof( hdr ), 0 )
+	     !=
+	     ( ssize_t )sizeof( hdr )
+	     ||
+	     fsync( sc_tcfd )
+	     ||
+	     rename( sc_tctmppath, sc_tcpath )) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to save directory tree cache %s: %s\n"),
+		      sc_tcpath,
+		      strerror( errno ));
+		tc_abandon( );
+		return;
+	}
+	mlog( MLOG_DEBUG,
+	      "directory tree cache %s: saved %llu directories\n",
+	      sc_tcpath,
+	      ( u_int64_t )sc_tcixcnt );
+
+	sc_tctmppath[ 0 ] = 0;
+	tc_abandon( );
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+/* tc_lookup - binary search of the old index. returns the record of
+ * ino, and its index position in *ixp, or NULL if not cached or if
+ * the record does not fit before the index.
+ */
+static tc_rec_t *
+tc_lookup( xfs_ino_t ino, size_t *ixp )
+{
+	size_t lo = 0;
+	size_t hi = ( size_t )sc_tcoldhdrp->th_dircnt;
+	u_int64_t indexoff = sc_tcoldhdrp->th_indexoff;
+
+	while ( lo < hi ) {
+		size_t mid = lo + ( hi - lo ) / 2;
+		tc_ix_t *ip = &sc_tcoldixp[ mid ];
+
+		if ( ip->ti_ino < ino ) {
+			lo = mid + 1;
+		} else if ( ip->ti_ino > ino ) {
+			hi = mid;
+		} else {
+			tc_rec_t *recp;
+			u_int64_t room;
+
+			if ( ip->ti_off < sizeof( tc_hdr_t )
+			     ||
+			     ip->ti_off % sizeof( xfs_ino_t )
+			     ||
+			     ip->ti_off + sizeof( tc_rec_t ) > indexoff ) {
+				return 0;
+			}
+			recp = ( tc_rec_t * )( sc_tcoldp + ip->ti_off );
+			room = indexoff - ip->ti_off - sizeof( tc_rec_t );
+			if ( recp->tr_ino != ino
+			     ||
+			     recp->tr_subdircnt > room / sizeof( tc_subdir_t )
+			     ||
+			     recp->tr_nondircnt > room / sizeof( xfs_ino_t )
+			     ||
+			     recp->tr_subdircnt * sizeof( tc_subdir_t )
+			     +
+			     recp->tr_nondircnt * sizeof( xfs_ino_t )
+			     > room ) {
+				return 0;
+			}
+			*ixp = mid;
+			return recp;
+		}
+	}
+
+	return 0;
+}
+
+/* tc_write - appends to the new cache through the write buffer. on
+ * failure, reports it and abandons the new cache.
+ */
+static bool_t
+tc_write( void *bufp, size_t sz )
+{
+	char *p = ( char * )bufp;
+
+	if ( ! sc_tcpr ) {
+		return BOOL_FALSE;
+	}
+
+	while ( sz > 0 ) {
+		size_t cnt = min( sz, TC_WBUFSZ - sc_tcwbuflen );
+
+		memcpy( ( void * )( sc_tcwbufp + sc_tcwbuflen ),
+			( void * )p,
+			cnt );
+		sc_tcwbuflen += cnt;
+		sc_tcwoff += cnt;
+		p += cnt;
+		sz -= cnt;
+		if ( sc_tcwbuflen == TC_WBUFSZ && ! tc_flush( )) {
+			return BOOL_FALSE;
+		}
+	}
+
+	return BOOL_TRUE;
+}
+
+/* tc_flush - writes out the write buffer
+ */
+static bool_t
+tc_flush( void )
+{
+	ssize_t nwritten;
+
+	if ( ! sc_tcpr ) {
+		return BOOL_FALSE;
+	}
+	if ( sc_tcwbuflen == 0 ) {
+		return BOOL_TRUE;
+	}
+
+	nwritten = write( sc_tcfd, ( void * )sc_tcwbufp, sc_tcwbuflen );
+	if ( nwritten != ( ssize_t )sc_tcwbuflen ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "unable to write directory tree cache %s: %s\n"),
+		      sc_tctmppath,
+		      nwritten < 0 ? strerror( errno ) : _("short write") );
+		tc_abandon( );
+		return BOOL_FALSE;
+	}
+	sc_tcwbuflen = 0;
+
+	return BOOL_TRUE;
+}
+
+static int
+tc_ixcmp( const void *ap, const void *bp )
+{
+	xfs_ino_t a = ( ( tc_ix_t * )ap )->ti_ino;
+	xfs_ino_t b = ( ( tc_ix_t * )bp )->ti_ino;
+
+	return a < b ? -1 : ( a > b ? 1 : 0 );
+}
+
+/* tc_abandon - stops building the new cache and removes its file, if it
+ * was not renamed into place
+ */
+static void
+tc_abandon( void )
+{
+	sc_tcpr = BOOL_FALSE;
+	if ( sc_tcfd >= 0 ) {
+		( void )close( sc_tcfd );
+		sc_tcfd = -1;
+	}
+	if ( sc_tctmppath[ 0 ] ) {
+		( void )unlink( sc_tctmppath );
+	}
+	if ( sc_tcwbufp ) {
+		free( ( void * )sc_tcwbufp );
+		sc_tcwbufp = 0;
+	}
+	if ( sc_tcixp ) {
+		free( ( void * )sc_tcixp );
+		sc_tcixp = 0;
+	}
+	sc_tcixcnt = 0;
+	sc_tcixsz = 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+#ifndef TREECACHE_H
+#define TREECACHE_H
+
+/* treecache.[hc] - persistent directory tree cache
+ *
+ * the subtree pruning phase of inomap_build( ) walks the whole directory
+ * tree, reading every directory and bulkstat'ing every entry, to find
+ * the unchanged directories which lead to no changes. on a large file
+ * system this walk, not the bulkstat scan, dominates an incremental.
+ *
+ * the walk records the subdirectories and other entries of each directory
+ * in a file kept next to the inventory, one per file system. the next
+ * incremental takes the entries of any directory not modified since that
+ * file was written from it, without reading the directory.
+ *
+ * a directory is known to be unmodified if neither its mtime nor its
+ * ctime is at or after the time the cache was begun, and its generation
+ * is the same. adding, removing or renaming an entry updates both.
+ */
+
+/* a cached subdirectory. the generation lets the walk open it by
+ * handle without a bulkstat.
+ */
+struct tc_subdir {
+	xfs_ino_t ts_ino;
+	u_int32_t ts_gen;
+	u_int32_t ts_pad;
+};
+
+typedef struct tc_subdir tc_subdir_t;
+
+/* tc_dir_t - the entries of one directory, gathered by the walk for
+ * treecache_put( ). the arrays grow as needed.
+ */
+struct tc_dir {
+	tc_subdir_t *td_subdirp;
+	size_t td_subdircnt;
+	size_t td_subdirsz;
+	xfs_ino_t *td_nondirp;
+	size_t td_nondircnt;
+	size_t td_nondirsz;
+};
+
+typedef struct tc_dir tc_dir_t;
+
+/* treecache_init - maps the cache left by an earlier dump of the file
+ * system fsid, if any, and begins a new one. now is the time the new
+ * cache will be valid from; it must not be later than the start of the
+ * bulkstat scan. problems with the cache are reported but are never
+ * fatal: the walk just reads the directories.
+ */
+extern void treecache_init( uuid_t *fsidp, time32_t now );
+
+/* treecache_note - called during the bulkstat scan for each directory.
+ * notes whether its cached entries, if any, are still current.
+ */
+extern void treecache_note( xfs_bstat_t *statp );
+
+/* treecache_get - if the entries of the directory are cached and current,
+ * returns BOOL_TRUE and points the arguments into the cache.
+ */
+extern bool_t treecache_get( xfs_bstat_t *statp,
+			     tc_subdir_t **subdirpp,
+			     size_t *subdircntp,
+			     xfs_ino_t **nondirpp,
+			     size_t *nondircntp );
+
+/* treecache_add - adds an entry to a tc_dir_t. does nothing if no new
+ * cache is being built.
+ */
+extern void treecache_add( tc_dir_t *dirp, xfs_bstat_t *statp );
+
+/* treecache_put - records the entries of a directory in the new cache
+ * file. called once for each directory completely read.
+ */
+extern void treecache_put( xfs_bstat_t *statp, tc_dir_t *dirp );
+
+/* treecache_free - frees the arrays of a tc_dir_t
+ */
+extern void treecache_free( tc_dir_t *dirp );
+
+/* treecache_end - unmaps the old cache. if completepr and any directories
+ * were put, replaces it with the new one; otherwise discards the new one
+ * and leaves the old in place.
+ */
+extern void treecache_end( bool_t completepr );
+
+#endif /* TREECACHE_H */
@@ -27,7 +27,7 @@
  * facilitating easy changes.
  */
 
-#define GETOPT_CMDSTRING	"gwrqdL:u:l:s:t:v:m:f:i"
+#define GETOPT_CMDSTRING	"bgwrqdL:u:l:s:t:v:m:f:in:B:"
 
 #define	GETOPT_DUMPDEST		'f'	/* dump dest. file (drive.c) */
 #define	GETOPT_LEVEL		'l'	/* dump level (content_inode.c) */
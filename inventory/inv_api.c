@@ -757,6 +757,7 @@ inv_delete_mediaobj( uuid_t *moid )
 	invt_fstab_t *arr;
 	int numfs, i, fd, invfd;
 	char fname[INV_STRLEN];
+	void *objectfound;
 
 	fd = fstab_getall( &arr, &cnt, &numfs, forwhat );
 	if ( fd < 0 || numfs <= 0 ) {
@@ -786,7 +787,10 @@ inv_delete_mediaobj( uuid_t *moid )
 			return BOOL_FALSE;
 		}
 
-		if ( search_invt( invfd, NULL, (void **)&moid, 
+		/* the media object id goes in as the search argument:
+		 * search_invt() clears the result pointer before searching
+		 */
+		if ( search_invt( invfd, (void *)moid, &objectfound,
 				  (search_callback_t) stobj_delete_mobj )
 		    < 0 )
 			return BOOL_FALSE;
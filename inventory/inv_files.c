@@ -47,6 +47,8 @@ static char inv_fstabp[MGR_PATH_MAX];
 static char inv_dirpathp[MGR_PATH_MAX];
 static char inv_lockfilep[MGR_PATH_MAX];
 
+static void inv_setup_paths( void );
+
 char *
 inv_dirpath( void )
 {
@@ -101,8 +103,30 @@ inv_setup_base( void )
 	else
 		inv_base = old_inv_base;
 
-	/* also setup the dependent paths now
-	 */
+	inv_setup_paths();
+
+	return 1;
+}
+
+/* roots the inventory at the given directory instead of /var/lib/xfsdump.
+ * used by the inventory benchmark, so that neither it nor the real
+ * inventory disturbs the other.
+ */
+int
+inv_setup_base_at( char *base )
+{
+	if (strlen(base) + strlen(MGR_LOCKFILE) >= MGR_PATH_MAX)
+		return 0;
+
+	inv_base = base;
+	inv_setup_paths();
+
+	return 1;
+}
+
+static void
+inv_setup_paths( void )
+{
 	strcpy(inv_dirpathp, inv_base);
 	strcat(inv_dirpathp, MGR_DIRPATH);
 
@@ -111,6 +135,4 @@ inv_setup_base( void )
 
 	strcpy(inv_lockfilep, inv_base);
 	strcat(inv_lockfilep, MGR_LOCKFILE);
-
-	return 1;
 }
@@ -906,7 +906,7 @@ stobj_delete_mobj(int fd,
 		  void **buf )
 {
 	/* XXX fd needs to be locked EX, not SH */
-	uuid_t *moid = *buf;
+	uuid_t *moid = arg;
 	invt_session_t ses;
 	invt_stream_t  *strms;
 	off64_t		off;
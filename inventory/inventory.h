@@ -298,6 +298,9 @@ inv_DEBUG_print( int argc, char **argv );
 extern intgen_t
 inv_setup_base( void );
 
+extern intgen_t
+inv_setup_base_at( char *base );
+
 extern char *
 inv_dirpath( void );
 
@@ -21,9 +21,13 @@
 
 #include <sys/file.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <fcntl.h>
 #include "types.h"
 #include "mlog.h"
+#include "qlock.h"
+#include "global.h"
+#include "drive.h"
 #include "getopt.h"
 #include "inv_priv.h"
 
@@ -44,25 +48,29 @@ static char *dev_str[] = { "/dev/usr/lib", "/dev/usr", "/dev/u/sw/courses",
 			   "/dev/root", "/dev/a/xfs/xlv/e", "/dev/dana/hates/me",
 			   "/dev/the/krays" };
 
-typedef enum { BULL = -1, WRI, REC, QUE, DEL, MP, QUE2 } hi;
+typedef enum { BULL = -1, WRI, REC, QUE, DEL, MP, QUE2, BEN } hi;
 
 void usage( void );
 char *progname;
 char *sesfile;
 
+/* needed by the common code
+ */
+pid_t parentpid;
+size_t pgsz;
+drive_t **drivepp = 0;
+
 
 void
 CREAT_mfiles( inv_stmtoken_t tok, uuid_t *moid, ino_t f, ino_t n )
 {
 	uuid_t labelid;
 	char label[128], strbuf[20];
-	char *str;
-	unsigned int stat;
+	char str[40];
 
-	uuid_create( &labelid, &stat );
-	uuid_to_string( &labelid, &str, &stat );
+	uuid_generate( labelid );
+	uuid_unparse( labelid, str );
 	strncpy( strbuf, str, 8 );
-	free (str);
 	strbuf[8] = '\0';
 	sprintf(label,"%s_%s (%d-%d)\0","MEDIA_FILE", strbuf, (int)f, (int)n );
 
@@ -83,6 +91,7 @@ intgen_t
 recons_test( int howmany )
 {
 	int fd, i, rval = 1;
+	invt_sessinfo_t sinfo;
 	
 	ses sarr[ SESLIM];
 	
@@ -103,7 +112,8 @@ recons_test( int howmany )
 	
 	
 	for ( i=0; i<howmany && i < SESLIM; i++ ){
-		if ( inv_put_sessioninfo( sarr[i].buf, sarr[i].sz ) < 0)
+		if ( ! stobj_unpack_sessinfo( sarr[i].buf, sarr[i].sz, &sinfo ) ||
+		     ! inv_put_sessioninfo( &sinfo ) )
 			printf("$ insert failed.\n");
 	}
 
@@ -120,17 +130,15 @@ delete_test( int n )
 {
 	int fd, i;
 	uuid_t moid;
-	char *str = 0;
-	unsigned int stat;
+	char str[40];
 
 	fd = open( "moids", O_RDONLY );
 	if ( fd < 0 ) return -1;
 	
 	get_invtrecord( fd, &moid, sizeof(uuid_t), (n-1)* sizeof( uuid_t),
 		        SEEK_SET, 0 );
-	uuid_to_string( &moid, &str, &stat );
+	uuid_unparse( moid, str );
 	printf("Searching for Moid = %s\n", str );
-	free( str );
 	if (! inv_delete_mediaobj( &moid ) ) return -1;
 	    
 	return 1;
@@ -140,12 +148,11 @@ delete_test( int n )
 int
 sess_queries_byuuid(char *uu)
 {
-	u_int stat;
 	uuid_t uuid;
 	inv_session_t *ses;
 	invt_pr_ctx_t prctx;
 
-	uuid_from_string (uu, &uuid, &stat);
+	uuid_parse (uu, uuid);
 	printf("uuid = %s\n", uu);
 	if (inv_get_session_byuuid(&uuid, &ses)) {
 		if (!ses)
@@ -244,7 +251,6 @@ intgen_t
 write_test( int nsess, int nstreams, int nmedia, int dumplevel )
 {
 	int i,j,k,m,fd;
-	unsigned int stat;
 	uuid_t *fsidp;
 	inv_idbtoken_t tok1;
 	inv_sestoken_t tok2;
@@ -253,7 +259,7 @@ write_test( int nsess, int nstreams, int nmedia, int dumplevel )
 	char label[120];
 	uuid_t fsidarr[8], labelid;
 	uuid_t sesidarr[8];
-	char *str;
+	char str[40];
 	char strbuf[128];
 	void *bufp;
 	size_t sz;
@@ -262,10 +268,8 @@ write_test( int nsess, int nstreams, int nmedia, int dumplevel )
 #ifdef FIRSTTIME
 	printf("first time!\n");
 	for (i=0; i<8; i++) {
-		uuid_create( &fsidarr[i], &stat );
-		ASSERT ( stat == uuid_s_ok );
-		uuid_create( &sesidarr[i], &stat );
-		ASSERT ( stat == uuid_s_ok );
+		uuid_generate( fsidarr[i] );
+		uuid_generate( sesidarr[i] );
 	}
 	fd = open( "uuids", O_RDWR | O_CREAT );
 	PUT_REC(fd, (void *)fsidarr, sizeof (uuid_t) * 8, 0L );
@@ -291,10 +295,9 @@ write_test( int nsess, int nstreams, int nmedia, int dumplevel )
 		tok1 = inv_open( INV_BY_UUID, INV_SEARCH_N_MOD, fsidp );
 		ASSERT (tok1 != INV_TOKEN_NULL );
 
-		uuid_create( &labelid, &stat );
-		uuid_to_string( &labelid, &str, &stat );
+		uuid_generate( labelid );
+		uuid_unparse( labelid, str );
 		strncpy( strbuf, str, 8 );
-		free (str);
 		strbuf[8] = '\0';
 		sprintf(label,"%s_%s (%d)\0","SESSION_LABEL", strbuf, i );
 		
@@ -341,10 +344,258 @@ write_test( int nsess, int nstreams, int nmedia, int dumplevel )
 }
 
 
+/*----------------------------------------------------------------------*/
+/* bench_test                                                           */
+/*                                                                      */
+/* Builds an inventory of nsess sessions of one file system, each with  */
+/* nstreams streams of nmedia media files, and times the calls xfsdump  */
+/* makes at startup and xfsrestore makes to find a session, printing    */
+/* the mean and worst latency of each. The inventory is created under   */
+/* base (a fresh directory in /var/tmp if NULL) and is left there.      */
+/*----------------------------------------------------------------------*/
+
+typedef struct bench_stat {
+	char	*bs_name;
+	int	bs_nops;
+	double	bs_total;	/* microseconds */
+	double	bs_max;
+} bench_stat_t;
+
+static double
+bench_now( void )
+{
+	struct timeval tv;
+
+	( void )gettimeofday( &tv, 0 );
+	return ( double )tv.tv_sec * 1000000.0 + ( double )tv.tv_usec;
+}
+
+static void
+bench_add( bench_stat_t *bs, double start )
+{
+	double us = bench_now( ) - start;
+
+	bs->bs_nops++;
+	bs->bs_total += us;
+	if ( us > bs->bs_max )
+		bs->bs_max = us;
+}
+
+static void
+bench_report( bench_stat_t *bs )
+{
+	printf( "%-32s %8d ops %12.1f us mean %12.1f us max\n",
+		bs->bs_name,
+		bs->bs_nops,
+		bs->bs_nops ? bs->bs_total / bs->bs_nops : 0.0,
+		bs->bs_max );
+}
+
+/* what xfsdump -I does: print every session of every file system
+ */
+static void
+bench_print_all( void )
+{
+	invt_counter_t *cnt = NULL;
+	invt_fstab_t *arr = NULL;
+	int fd, numfs, i;
+	inv_idbtoken_t tok;
+	invt_pr_ctx_t prctx;
+
+	memset( &prctx, 0, sizeof( prctx ) );
+	prctx.depth = PR_DEFAULT;
+	prctx.level = PR_MAXLEVEL;
+	prctx.mobj.type = INVT_NULLTYPE;
+
+	fd = fstab_getall( &arr, &cnt, &numfs, INV_SEARCH_ONLY );
+	if ( fd < 0 )
+		return;
+	close( fd );
+	free( cnt );
+
+	for ( i = 0; i < numfs; i++ ) {
+		tok = inv_open( INV_BY_UUID, INV_SEARCH_ONLY,
+				&arr[i].ft_uuid );
+		if ( tok == INV_TOKEN_NULL )
+			break;
+		prctx.index = i;
+		invmgr_inv_print( tok->d_invindex_fd, &prctx );
+		inv_close( tok );
+	}
+	free( arr );
+}
+
+#define BENCH_NPRINT	3	/* full -I listings are slow: only a few */
+
+intgen_t
+bench_test( int nsess, int nstreams, int nmedia, int niters, char *base )
+{
+	static char basebuf[] = "/var/tmp/invbench.XXXXXX";
+	int i, k, m, nmiss;
+	int save1, save2, nullfd;
+	uuid_t fsid;
+	uuid_t *sesids;
+	char label[INV_STRLEN];
+	inv_idbtoken_t tok1;
+	inv_sestoken_t tok2;
+	inv_stmtoken_t tok3;
+	inv_session_t *ses;
+	double start;
+	bench_stat_t wrist = { "write session" };
+	bench_stat_t lessst = { "inv_lastsession_level_lessthan" };
+	bench_stat_t uuidst = { "inv_get_session_byuuid" };
+	bench_stat_t labst = { "inv_get_session_bylabel" };
+	bench_stat_t prst = { "print inventory (-I)" };
+	bench_stat_t delst = { "inv_delete_mediaobj" };
+
+	if ( nsess <= 0 || niters <= 0 )
+		return -1;
+
+	if ( ! base ) {
+		base = mkdtemp( basebuf );
+		if ( ! base ) {
+			perror( "mkdtemp" );
+			return -1;
+		}
+	} else if ( mkdir( base, S_IRWXU ) && errno != EEXIST ) {
+		perror( base );
+		return -1;
+	}
+	if ( ! inv_setup_base_at( base ) ) {
+		printf( "%s: path too long\n", base );
+		return -1;
+	}
+
+	sesids = ( uuid_t * )calloc( ( size_t )nsess, sizeof( uuid_t ) );
+	if ( ! sesids )
+		return -1;
+	uuid_generate( fsid );
+	srandom( 1 );
+
+	/* write the sessions the way xfsdump does, cycling through the
+	 * dump levels. each session's id doubles as its media object id.
+	 */
+	for ( i = 0; i < nsess; i++ ) {
+		start = bench_now( );
+		tok1 = inv_open( INV_BY_UUID, INV_SEARCH_N_MOD, &fsid );
+		if ( tok1 == INV_TOKEN_NULL )
+			return -1;
+		uuid_generate( sesids[i] );
+		sprintf( label, "BENCH_%d", i );
+		tok2 = inv_writesession_open( tok1, &fsid, &sesids[i], label,
+					      BOOL_FALSE, BOOL_FALSE,
+					      ( u_char )( i % 10 ), nstreams,
+					      ( time32_t )( time( NULL )
+							    - nsess + i ),
+					      mnt_str[0], dev_str[0] );
+		if ( tok2 == INV_TOKEN_NULL )
+			return -1;
+		for ( m = 0; m < nstreams; m++ ) {
+			tok3 = inv_stream_open( tok2, "/dev/rmt" );
+			if ( tok3 == INV_TOKEN_NULL )
+				return -1;
+			for ( k = 0; k < nmedia; k++ )
+				CREAT_mfiles( tok3, &sesids[i], k * 100,
+					      k * 100 + 99 );
+			inv_stream_close( tok3, BOOL_TRUE );
+		}
+		inv_writesession_close( tok2 );
+		inv_close( tok1 );
+		bench_add( &wrist, start );
+	}
+	bench_report( &wrist );
+
+	/* the base session search at the start of an incremental dump
+	 */
+	tok1 = inv_open( INV_BY_UUID, INV_SEARCH_ONLY, &fsid );
+	if ( tok1 == INV_TOKEN_NULL )
+		return -1;
+	for ( k = 0; k < niters; k++ ) {
+		start = bench_now( );
+		if ( inv_lastsession_level_lessthan( tok1, ( u_char )( k % 10 ),
+						     &ses ) && ses )
+			inv_free_session( &ses );
+		bench_add( &lessst, start );
+	}
+	inv_close( tok1 );
+	bench_report( &lessst );
+
+	/* session lookups by id and by label, as for xfsrestore -S and -L
+	 */
+	for ( nmiss = 0, k = 0; k < niters; k++ ) {
+		i = ( int )( random( ) % nsess );
+		start = bench_now( );
+		if ( inv_get_session_byuuid( &sesids[i], &ses ) && ses )
+			inv_free_session( &ses );
+		else
+			nmiss++;
+		bench_add( &uuidst, start );
+	}
+	bench_report( &uuidst );
+	if ( nmiss )
+		printf( "%d sessions not found by id\n", nmiss );
+
+	for ( nmiss = 0, k = 0; k < niters; k++ ) {
+		i = ( int )( random( ) % nsess );
+		sprintf( label, "BENCH_%d", i );
+		start = bench_now( );
+		if ( inv_get_session_bylabel( label, &ses ) && ses )
+			inv_free_session( &ses );
+		else
+			nmiss++;
+		bench_add( &labst, start );
+	}
+	bench_report( &labst );
+	if ( nmiss )
+		printf( "%d sessions not found by label\n", nmiss );
+
+	/* full listings, with the output thrown away
+	 */
+	fflush( stdout );
+	fflush( stderr );
+	save1 = dup( 1 );
+	save2 = dup( 2 );
+	nullfd = open( "/dev/null", O_WRONLY );
+	for ( k = 0; k < BENCH_NPRINT && nullfd >= 0; k++ ) {
+		dup2( nullfd, 1 );
+		dup2( nullfd, 2 );
+		start = bench_now( );
+		bench_print_all( );
+		fflush( stdout );
+		fflush( stderr );
+		bench_add( &prst, start );
+		dup2( save1, 1 );
+		dup2( save2, 2 );
+	}
+	if ( nullfd >= 0 )
+		close( nullfd );
+	close( save1 );
+	close( save2 );
+	bench_report( &prst );
+
+	/* last, since it modifies the inventory: delete media objects
+	 * spread evenly through the sessions
+	 */
+	for ( k = 0; k < niters && k < nsess; k++ ) {
+		i = ( int )( ( ( long long )k * nsess ) / min( niters, nsess ) );
+		start = bench_now( );
+		if ( ! inv_delete_mediaobj( &sesids[i] ) )
+			return -1;
+		bench_add( &delst, start );
+	}
+	bench_report( &delst );
+
+	printf( "inventory left in %s\n", base );
+	free( sesids );
+	return 1;
+}
+
+
 void usage( void )
 {
-	printf("( %s ./inv w|r|q -v <verbosity> -s <nsess>"
-	       "-t <strms> -m <nmediafiles> \n", optarg );
+	printf("( %s ./inv w|r|q|b -v <verbosity> -s <nsess>"
+	       "-t <strms> -m <nmediafiles> -n <niters> -B <basedir>\n",
+	       optarg );
 }
 
 
@@ -390,25 +641,21 @@ mp_test(int nstreams)
 main(int argc, char *argv[])
 {
 	int rval = -1, nsess = 8, nmedia = 2, nstreams = 3, level = 0;
+	int niters = 1000;
 	int cc = 0;
 	extern char *optarg;
 	extern int optind;
 	char *uuid = NULL;
 	char *label = NULL;
+	char *base = NULL;
 	hi op = BULL;
 
 	progname = argv[0];
+	parentpid = getpid( );
+	pgsz = ( size_t )getpagesize( );
 	sesfile = "sessions";
 	ASSERT( argc > 1 );
 	
-	mlog_init( argc, argv );
-
-	if (! inv_DEBUG_print(argc, argv))
-		return 0;
-	
-	optind = 1;
-	optarg = 0;
-
 	while( ( cc = getopt( argc, argv, GETOPT_CMDSTRING)) != EOF ) {
 		switch ( cc ) {
 		      case 'w':
@@ -434,6 +681,18 @@ main(int argc, char *argv[])
 			op = QUE2;
 			break;
 
+		      case 'b':
+			op = BEN;
+			break;
+
+		      case 'n':
+			niters = atoi( optarg );
+			break;
+
+		      case 'B':
+			base = optarg;
+			break;
+
 		      case 'u':
 			uuid = optarg;
 			break;
@@ -469,7 +728,17 @@ main(int argc, char *argv[])
 			break;
 		}
 	}
-	
+
+	/* after our own options: these parse argv with the xfsdump
+	 * command string, and getopt may permute it
+	 */
+	mlog_init1( argc, argv );
+	qlock_init( BOOL_TRUE );
+	mlog_init2( );
+	inv_setup_base( );
+
+	if (! inv_DEBUG_print(argc, argv))
+		return 0;
 	
 	if ( op == WRI )
 		rval = write_test( nsess, nstreams, nmedia, level );
@@ -481,6 +750,8 @@ main(int argc, char *argv[])
 		rval = delete_test( nsess );
 	else if ( op == MP )
 		rval = mp_test (nstreams);
+	else if ( op == BEN )
+		rval = bench_test( nsess, nstreams, nmedia, niters, base );
 	else if ( op == QUE2 ) {
 		if (uuid)
 			rval = sess_queries_byuuid(uuid);
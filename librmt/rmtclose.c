@@ -50,14 +50,21 @@ int fildes;
 
 static int _rmt_close(int fildes)
 {
-	int rc;
+	int rc, drc;
+
+	/*
+	 *	a failed pipelined write must still fail the close, but
+	 *	must not keep the unit from being closed
+	 */
+
+	drc = _rmt_drain(fildes, RMT_DRAIN_ALL);
 
 	if (_rmt_command(fildes, "C\n") != -1)
 	{
 		rc = _rmt_status(fildes);
 
 		_rmt_abort(fildes);
-		return(rc);
+		return(drc == -1 ? -1 : rc);
 	}
 
 	return(-1);
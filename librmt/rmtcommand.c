@@ -29,11 +29,29 @@
 
 /*
  *	_rmt_command --- attempt to perform a remote tape command
+ *
+ *	the replies to any pipelined reads or writes still in flight are
+ *	collected first, so the caller's reply is the next one in the pipe.
  */
 
 int _rmt_command(fildes, buf)
 int fildes;
 char *buf;
+{
+	if (_rmt_drain(fildes, RMT_DRAIN_ALL) == -1)
+		return(-1);
+
+	return(_rmt_send(fildes, buf));
+}
+
+
+/*
+ *	_rmt_send --- send a command without collecting outstanding replies
+ */
+
+int _rmt_send(fildes, buf)
+int fildes;
+char *buf;
 {
 	register int blen;
 	void (*pstat)();
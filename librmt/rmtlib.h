@@ -49,6 +49,16 @@
 #define BUFMAGIC	64
 #define MAXUNIT		4
 
+/*
+ *	RMT_WINMAX --- Maximum number of commands kept in flight per unit
+ *	RMT_DRAIN_* --- Outstanding replies collected by _rmt_drain
+ */
+
+#define RMT_WINMAX	16
+#define RMT_DRAIN_WRITE	1
+#define RMT_DRAIN_READ	2
+#define RMT_DRAIN_ALL	(RMT_DRAIN_WRITE | RMT_DRAIN_READ)
+
 /*
  *	Useful macros.
  *
@@ -83,9 +93,16 @@ extern int _rmt_host[MAXUNIT];
 int isrmt (int);
 void _rmt_abort(int);
 int _rmt_command(int, char *);
+int _rmt_send(int, char *);
 int _rmt_dev (char *);
 int _rmt_status(int);
 int _rmt_msgson(void);
 void _rmt_msg(int level, const char *msg, ...);
 void _rmt_turnonmsgsbyenv(void);
 void rmt_turnonmsgs(int code);
+int rmtsetwindow(int, int);
+void _rmt_pipereset(int);
+int _rmt_window(int);
+int _rmt_drain(int, int);
+int _rmt_pipewrite(int, char *, unsigned int);
+int _rmt_piperead(int, char *, unsigned int);
@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <signal.h>
+#include <errno.h>
+
+#include "rmtlib.h"
+
+/*
+ *	Pipelined remote I/O.
+ *
+ *	With a window of one, every W or R command waits for its reply
+ *	before the next command is sent, so the link sits idle for a full
+ *	round trip per record. With a larger window, up to that many write
+ *	commands are sent before the oldest status is collected, and reads
+ *	are requested that many records ahead. The replies queue up in the
+ *	pipe from the remote rmt and are consumed in order.
+ *
+ *	A write error is reported by the first rmtwrite (or other command)
+ *	issued after its status arrives, so the caller must assume that up
+ *	to window - 1 records acknowledged before the error did not reach
+ *	the media.
+ *
+ *	Any command other than W or R first collects all outstanding
+ *	replies. Read-ahead replies not yet consumed by the caller are
+ *	discarded and the tape is spaced back over them, so the caller
+ *	sees the position it expects.
+ */
+
+/*
+ *	spacing operations used to undo read-ahead. the codes are the
+ *	same for IRIX and Linux remote hosts (see rmtioctl.c).
+ */
+
+#define RMT_MTBSF	2
+#define RMT_MTBSR	4
+
+struct rmt_pipe {
+	int rp_window;		/* max commands in flight; 1 is synchronous */
+	int rp_wpend;		/* write statuses not yet collected */
+	int rp_whead;		/* ring index of oldest outstanding write */
+	unsigned int rp_wcnt[RMT_WINMAX];
+				/* byte counts of outstanding writes */
+	int rp_rpend;		/* read replies not yet collected */
+	unsigned int rp_rsz;	/* size requested by outstanding reads */
+	int rp_rstop;		/* last read was short: stop reading ahead */
+};
+
+typedef struct rmt_pipe rmt_pipe_t;
+
+static rmt_pipe_t _rmt_pipe[MAXUNIT] = {
+	{ 1, 0, 0, { 0 }, 0, 0, 0 },
+	{ 1, 0, 0, { 0 }, 0, 0, 0 },
+	{ 1, 0, 0, { 0 }, 0, 0, 0 },
+	{ 1, 0, 0, { 0 }, 0, 0, 0 }
+};
+
+static int _rmt_reapwrite(int);
+static int _rmt_reply(int, char *, unsigned int);
+static int _rmt_space(int, int, int);
+
+
+/*
+ *	Set the number of commands kept in flight on a remote unit.
+ *	Ignored for local files.
+ */
+
+int rmtsetwindow(int fildes, int window)
+{
+	int unit;
+
+	if (!isrmt(fildes))
+		return(0);
+
+	if (window < 1 || window > RMT_WINMAX)
+	{
+		setoserror( EINVAL );
+		return(-1);
+	}
+
+	unit = fildes - REM_BIAS;
+	if (_rmt_drain(unit, RMT_DRAIN_ALL) == -1)
+		return(-1);
+
+	_rmt_pipe[unit].rp_window = window;
+	_rmt_msg(RMTDBG, "rmtsetwindow: fd = %d, window = %d\n", unit, window);
+	return(0);
+}
+
+
+/*
+ *	_rmt_pipereset --- forget all outstanding commands on a unit
+ */
+
+void _rmt_pipereset(int fildes)
+{
+	rmt_pipe_t *pp = &_rmt_pipe[fildes];
+
+	pp->rp_window = 1;
+	pp->rp_wpend = 0;
+	pp->rp_whead = 0;
+	pp->rp_rpend = 0;
+	pp->rp_rsz = 0;
+	pp->rp_rstop = 0;
+}
+
+
+int _rmt_window(int fildes)
+{
+	return(_rmt_pipe[fildes].rp_window);
+}
+
+
+/*
+ *	_rmt_drain --- collect the replies to outstanding commands
+ *
+ *	All write statuses are read even if one reports an error; the
+ *	first error is returned. Unconsumed read-ahead data is thrown
+ *	away and the tape spaced back over it.
+ */
+
+int _rmt_drain(int fildes, int which)
+{
+	rmt_pipe_t *pp = &_rmt_pipe[fildes];
+	char junk[BUFMAGIC * 16];
+	int rval = 0;
+	int err = 0;
+
+	if ((which & RMT_DRAIN_WRITE) && pp->rp_wpend)
+	{
+		_rmt_msg(RMTDBG, "rmtdrain: fd = %d, %d writes\n",
+			 fildes, pp->rp_wpend);
+		while (pp->rp_wpend)
+		{
+			if (_rmt_reapwrite(fildes) == -1 && rval == 0)
+			{
+				rval = -1;
+				err = errno;
+			}
+		}
+	}
+
+	if ((which & RMT_DRAIN_READ) && pp->rp_rpend)
+	{
+		int reccnt = 0;
+		int fmcnt = 0;
+		int errcnt = 0;
+
+		_rmt_msg(RMTDBG, "rmtdrain: fd = %d, %d reads\n",
+			 fildes, pp->rp_rpend);
+
+		/*
+		 * count the data records read before the first file mark,
+		 * and the file marks; records beyond the first file mark are
+		 * undone by spacing back over the file marks.
+		 */
+
+		while (pp->rp_rpend)
+		{
+			int rc, i, n;
+
+			pp->rp_rpend--;
+			rc = _rmt_status(fildes);
+			if (rc == -1)
+			{
+				if (READ(fildes) == -1)
+				{
+					rval = -1;
+					err = errno;
+					break;
+				}
+				errcnt++;
+				continue;
+			}
+			for (i = 0; i < rc; i += n)
+			{
+				n = read(READ(fildes), junk,
+					 rc - i < sizeof(junk) ?
+					 rc - i : sizeof(junk));
+				if (n <= 0)
+				{
+					_rmt_abort(fildes);
+					setoserror( EIO );
+					return(-1);
+				}
+			}
+			if (rc == 0)
+				fmcnt++;
+			else if (fmcnt == 0)
+				reccnt++;
+		}
+		pp->rp_rstop = 0;
+
+		/*
+		 * after a read error the position is unknown; leave the
+		 * tape where it is rather than guess.
+		 */
+
+		if (rval == 0 && errcnt)
+		{
+			_rmt_msg(RMTWARN,
+				 _("rmt: read error while discarding read-ahead, "
+				 "tape position not restored\n"));
+		}
+		else if (rval == 0)
+		{
+			if ((fmcnt && _rmt_space(fildes, RMT_MTBSF, fmcnt) == -1)
+			    ||
+			    (reccnt && _rmt_space(fildes, RMT_MTBSR, reccnt)
+			     == -1))
+			{
+				_rmt_msg(RMTWARN,
+					 _("rmt: unable to space back over "
+					 "%d read-ahead records\n"),
+					 reccnt);
+				if (READ(fildes) == -1)
+				{
+					rval = -1;
+					err = errno;
+				}
+			}
+		}
+	}
+
+	if (rval == -1)
+		setoserror( err );
+	return(rval);
+}
+
+
+/*
+ *	_rmt_pipewrite --- send a write without waiting for its status
+ */
+
+int _rmt_pipewrite(int fildes, char *buf, unsigned int nbyte)
+{
+	rmt_pipe_t *pp = &_rmt_pipe[fildes];
+	char buffer[BUFMAGIC];
+	void (*pstat)();
+
+	if (_rmt_drain(fildes, RMT_DRAIN_READ) == -1)
+		return(-1);
+
+	/*
+	 *	make room in the window. on error collect the remaining
+	 *	statuses so the pipe is back in step, and report the first.
+	 */
+
+	while (pp->rp_wpend >= pp->rp_window)
+	{
+		if (_rmt_reapwrite(fildes) == -1)
+		{
+			int err = errno;
+
+			(void)_rmt_drain(fildes, RMT_DRAIN_WRITE);
+			setoserror( err );
+			return(-1);
+		}
+	}
+
+	sprintf(buffer, "W%d\n", nbyte);
+	if (_rmt_send(fildes, buffer) == -1)
+		return(-1);
+
+	pstat = signal(SIGPIPE, SIG_IGN);
+	if (write(WRITE(fildes), buf, nbyte) != nbyte)
+	{
+		signal(SIGPIPE, pstat);
+		_rmt_abort(fildes);
+		setoserror( EIO );
+		return(-1);
+	}
+	signal(SIGPIPE, pstat);
+
+	pp->rp_wcnt[(pp->rp_whead + pp->rp_wpend) % RMT_WINMAX] = nbyte;
+	pp->rp_wpend++;
+	return(nbyte);
+}
+
+
+/*
+ *	_rmt_piperead --- read a record, keeping requests for the
+ *	following records in flight
+ */
+
+int _rmt_piperead(int fildes, char *buf, unsigned int nbyte)
+{
+	rmt_pipe_t *pp = &_rmt_pipe[fildes];
+	char buffer[BUFMAGIC];
+	int rc;
+
+	if (_rmt_drain(fildes, RMT_DRAIN_WRITE) == -1)
+		return(-1);
+
+	/*
+	 *	outstanding requests of another size are of no use
+	 */
+
+	if (pp->rp_rpend && pp->rp_rsz != nbyte)
+	{
+		if (_rmt_drain(fildes, RMT_DRAIN_READ) == -1)
+			return(-1);
+	}
+
+	sprintf(buffer, "R%d\n", nbyte);
+	while (pp->rp_rpend == 0
+	       ||
+	       (!pp->rp_rstop && pp->rp_rpend < pp->rp_window))
+	{
+		if (_rmt_send(fildes, buffer) == -1)
+			return(-1);
+		pp->rp_rpend++;
+		pp->rp_rsz = nbyte;
+	}
+
+	pp->rp_rpend--;
+	rc = _rmt_reply(fildes, buf, nbyte);
+
+	/*
+	 *	a short read, file mark or error usually ends the data; do
+	 *	not request more until the caller reads a full record again
+	 */
+
+	pp->rp_rstop = (rc != nbyte);
+	return(rc);
+}
+
+
+/*
+ *	_rmt_reapwrite --- collect the status of the oldest outstanding write
+ */
+
+static int _rmt_reapwrite(int fildes)
+{
+	rmt_pipe_t *pp = &_rmt_pipe[fildes];
+	unsigned int nbyte;
+	int rc;
+
+	nbyte = pp->rp_wcnt[pp->rp_whead];
+	pp->rp_whead = (pp->rp_whead + 1) % RMT_WINMAX;
+	pp->rp_wpend--;
+
+	rc = _rmt_status(fildes);
+	if (rc == -1)
+		return(-1);
+
+	/*
+	 *	a short write can no longer be returned as such; report
+	 *	it the way a tape reports running out of media
+	 */
+
+	if (rc != nbyte)
+	{
+		_rmt_msg(RMTDBG, "rmtreapwrite: fd = %d, wrote %d of %u\n",
+			 fildes, rc, nbyte);
+		setoserror( ENOSPC );
+		return(-1);
+	}
+	return(0);
+}
+
+
+/*
+ *	_rmt_reply --- read the status and data of one R command
+ */
+
+static int _rmt_reply(int fildes, char *buf, unsigned int nbyte)
+{
+	int rc, i, n;
+
+	if ((rc = _rmt_status(fildes)) == -1)
+		return(-1);
+
+	if (rc > nbyte)
+	{
+		_rmt_abort(fildes);
+		setoserror( EIO );
+		return(-1);
+	}
+
+	for (i = 0; i < rc; i += n)
+	{
+		n = read(READ(fildes), buf + i, rc - i);
+		if (n <= 0)
+		{
+			_rmt_abort(fildes);
+			setoserror( EIO );
+			return(-1);
+		}
+	}
+
+	return(rc);
+}
+
+
+/*
+ *	_rmt_space --- issue a tape spacing operation
+ */
+
+static int _rmt_space(int fildes, int op, int count)
+{
+	char buffer[BUFMAGIC];
+
+	sprintf(buffer, "I%d\n%d\n", op, count);
+	if (_rmt_send(fildes, buffer) == -1)
+		return(-1);
+	return(_rmt_status(fildes) == -1 ? -1 : 0);
+}
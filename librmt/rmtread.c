@@ -56,6 +56,9 @@ static int _rmt_read(int fildes, char *buf, unsigned int nbyte)
 	int rc, i;
 	char buffer[BUFMAGIC];
 
+	if (_rmt_window(fildes) > 1)
+		return(_rmt_piperead(fildes, buf, nbyte));
+
 	sprintf(buffer, "R%d\n", nbyte);
 	if (_rmt_command(fildes, buffer) == -1 || (rc = _rmt_status(fildes)) == -1)
 		return(-1);
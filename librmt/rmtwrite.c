@@ -57,6 +57,9 @@ static int _rmt_write(int fildes, char *buf, unsigned int nbyte)
 	char buffer[BUFMAGIC];
 	void (*pstat)();
 
+	if (_rmt_window(fildes) > 1)
+		return(_rmt_pipewrite(fildes, buf, nbyte));
+
 	sprintf(buffer, "W%d\n", nbyte);
 	if (_rmt_command(fildes, buffer) == -1)
 		return(-1);
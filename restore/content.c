@@ -65,6 +65,7 @@
 #include "arch_xlate.h"
 #include "win.h"
 #include "hsmapi.h"
+#include "fprint.h"
 
 /* content.c - manages restore content
  */
@@ -354,10 +355,30 @@ struct stream_context {
 	char       sc_path[2 * MAXPATHLEN];
 	intgen_t   sc_fd;
 	intgen_t   sc_hsmflags;
+	char       sc_refpath[MAXPATHLEN];
+	char      *sc_refbufp;
+	size_t     sc_refbufsz;
+		/* for copying the chunks of EXTENTHDR_TYPE_REF extents:
+		 * the pathname of the file copied from, and a buffer
+		 * grown to the largest chunk seen
+		 */
 };
 
 typedef struct stream_context stream_context_t;
 
+/* context of restore_extentref_cb( ): the chunk sought, and why the
+ * last link tried did not hold it
+ */
+struct extentref_context {
+	stream_context_t *ec_strctxp;
+	extentref_t *ec_erefp;
+	off64_t ec_sz;
+	char *ec_reasonstr;
+	bool_t ec_foundpr;
+};
+
+typedef struct extentref_context extentref_context_t;
+
 /* persistent state file header - two parts: accumulation state
  * which spans several sessions, and session state. each has a valid
  * bit, and no fields are valid until the valid bit is set.
@@ -536,6 +557,11 @@ struct pers {
 		bool_t inomapdelpr;
 			/* deleted session ino map
 			 */
+		bool_t dynpartpr;
+			/* dump streams were handed inode ranges dynamically
+			 * (CIH_DUMPATTR_DYNPART): ino order follows media
+			 * file order only within each stream
+			 */
 	} s;
 };
 
@@ -561,10 +587,18 @@ struct tran {
 	bool_t t_toconlypr;
 		/* just display table of contents; don't restore files
 		 */
+	bool_t t_tocdirspr;
+		/* take the table of contents from the directories and
+		 * inode map alone; don't read the non-directory files
+		 */
 	bool_t t_noinvupdatepr;
 		/* true if inventory is NOT to be updated when on-media
 		 * inventory encountered.
 		 */
+	bool_t t_refholespr;
+		/* a dedup dump may be restored in part, leaving holes
+		 * where data refers to a file not restored (-u)
+		 */
 	bool_t t_dumpidknwnpr;
 		/* determined during initialization; if false, set during
 		 * per-stream init
@@ -655,6 +689,7 @@ static bool_t Media_prompt_change( drive_t *drivep,
 				   bool_t maybeholespr );
 
 static bool_t Inv_validate_cmdline( void );
+static bool_t dirrefcompat( content_inode_hdr_t *scrhdrp );
 static bool_t dumpcompat( bool_t resumepr,
 			  ix_t level,
 			  uuid_t baseid,
@@ -711,6 +746,9 @@ static rv_t applydirdump( drive_t *drivep,
 			  content_inode_hdr_t *scrhdrp,
 			  filehdr_t *fhdrp );
 static rv_t treepost( char *path1, char *path2 );
+static rv_t tocdirs( char *path );
+static bool_t tocdirs_ino_cb( void *ctxp, xfs_ino_t ino );
+static bool_t tocdirs_path_cb( void *ctxp, char *path );
 static rv_t applynondirdump( drive_t *drivep,
 			     dh_t fileh,
 			     content_inode_hdr_t *scrhdrp,
@@ -756,6 +794,17 @@ static rv_t restore_extent( filehdr_t *fhdrp,
 			    char *path,
 			    drive_t *drivep,
 			    off64_t *bytesreadp );
+static rv_t restore_extentref( filehdr_t *fhdrp,
+			       extenthdr_t *ehdrp,
+			       int fd,
+			       char *path,
+			       drive_t *drivep );
+static bool_t restore_extentref_read( intgen_t srcfd,
+				      stream_context_t *strctxp,
+				      extentref_t *erefp,
+				      off64_t sz,
+				      char **reasonstrp );
+static bool_t restore_extentref_cb( void *contextp, char *path );
 static bool_t askinvforbaseof( uuid_t baseid, inv_session_t *sessp );
 static void addobj( bag_t *bagp,
 		    uuid_t *objidp,
@@ -794,6 +843,7 @@ static rv_t restore_extattr( drive_t *drivep,
 static bool_t restore_dir_extattr_cb( char *path, dah_t dah );
 static bool_t restore_dir_extattr_cb_cb( extattrhdr_t *ahdrp, void *ctxp );
 static void setextattr( char *path, extattrhdr_t *ahdrp );
+static void clearextattr( intgen_t fd, char *path );
 static void partial_reg(ix_t d_index, xfs_ino_t ino, off64_t fsize,
                         off64_t offset, off64_t sz);
 static bool_t partial_check (xfs_ino_t ino, off64_t fsize);
@@ -915,6 +965,9 @@ content_init( intgen_t argc, char *argv[ ], size64_t vmsz )
 		case GETOPT_TOC:
 			tranp->t_toconlypr = BOOL_TRUE;
 			break;
+		case GETOPT_TOCDIRS:
+			tranp->t_tocdirspr = BOOL_TRUE;
+			break;
 		case GETOPT_CUMULATIVE:
 			cumpr = BOOL_TRUE;
 			break;
@@ -1105,6 +1158,9 @@ content_init( intgen_t argc, char *argv[ ], size64_t vmsz )
 		case GETOPT_NOINVUPDATE:
 			tranp->t_noinvupdatepr = BOOL_TRUE;
 			break;
+		case GETOPT_REFHOLES:
+			tranp->t_refholespr = BOOL_TRUE;
+			break;
 		case GETOPT_SETDM:
 			restoredmpr = BOOL_TRUE;
 			break;
@@ -1145,6 +1201,14 @@ content_init( intgen_t argc, char *argv[ ], size64_t vmsz )
 		usage( );
 		return BOOL_FALSE;
 	}
+	if ( tranp->t_tocdirspr && ! tranp->t_toconlypr ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR, _(
+		      "-%c option requires -%c option\n"),
+		      GETOPT_TOCDIRS,
+		      GETOPT_TOC );
+		usage( );
+		return BOOL_FALSE;
+	}
 	if ( resumepr && tranp->t_toconlypr ) {
 		mlog( MLOG_NORMAL | MLOG_ERROR, _(
 		      "-%c and -%c option cannot be used together\n"),
@@ -2071,6 +2135,10 @@ content_stream_restore( ix_t thrdix )
 			Media_end( Mediap );
 			return EXIT_ERROR;
 		}
+		if ( ! dirrefcompat( scrhdrp )) {
+			Media_end( Mediap );
+			return EXIT_ERROR;
+		}
 		strncpyterm( persp->s.dumplab,
 			     grhdrp->gh_dumplabel,
 			     sizeof( persp->s.dumplab ));
@@ -2362,15 +2430,34 @@ content_stream_restore( ix_t thrdix )
 		}
 		}
 
+		/* a table of contents taken from the directories is
+		 * complete once the tree is
+		 */
+		if ( tranp->t_tocdirspr ) {
+			rv = tocdirs( path1 );
+			switch ( rv ) {
+			case RV_OK:
+				break;
+			case RV_INTR:
+				Media_end( Mediap );
+				return EXIT_INTERRUPT;
+			case RV_CORE:
+			default:
+				Media_end( Mediap );
+				return EXIT_FAULT;
+			}
+		}
+
 		/* release exclusion
 		 */
 		tranp->t_sync4 = SYNC_DONE;
 	}
 
 	/* now all are free to do concurrent non-dir restore!
-	 * apply media files until there are no more, or we are interrupted
+	 * apply media files until there are no more, or we are interrupted.
+	 * none are needed for a table of contents taken from the directories.
 	 */
-	for (;;) {
+	while ( ! tranp->t_tocdirspr ) {
 		mlog( MLOG_DEBUG,
 		      "getting next media file for non-dir restore\n" );
 		rv = Media_mfile_next( Mediap,
@@ -2702,6 +2789,120 @@ content_statline( char **linespp[ ] )
 	return 1;
 }
 
+size_t
+content_statrec( char *buf, size_t bufsz )
+{
+	size64_t inodone;
+	off64_t datadone;
+	size64_t inocnt;
+	off64_t datacnt;
+	double percent;
+	double rate;
+	long eta;
+	time_t elapsed;
+	time_t now;
+	size_t len;
+	ix_t i;
+
+	/* content_complete( ) discards the persistent state of a restore
+	 * which need not be resumed
+	 */
+	if ( ! persp || ! tranp || ! persp->s.stat_valpr ) {
+		return 0;
+	}
+
+	now = time( 0 );
+	elapsed = persp->s.accumtime + ( now - tranp->t_starttime );
+
+	/* not under lock, as for content_statline( )
+	 */
+	inodone = persp->s.stat_inodone;
+	datadone = persp->s.stat_datadone;
+	inocnt = persp->s.stat_inocnt;
+	datacnt = persp->s.stat_datacnt;
+
+	if ( datacnt ) {
+		percent = ( double )datadone / ( double )datacnt;
+		percent *= 100.0;
+		if ( percent > 100.0 ) {
+			percent = 100.0;
+		}
+	} else {
+		percent = 0.0;
+	}
+
+	/* average rate over the whole restore, including any earlier
+	 * interrupted invocations
+	 */
+	rate = 0.0;
+	eta = -1;
+	if ( elapsed > 0 && persp->s.dirdonepr ) {
+		rate = ( double )datadone / ( double )elapsed;
+		if ( rate > 0.0 && datacnt >= datadone ) {
+			eta = ( long )( ( double )( datacnt - datadone )
+					/
+					rate );
+		}
+	}
+
+	len = ( size_t )snprintf( buf,
+				  bufsz,
+				  "{\"prog\":\"xfsrestore\","
+				  "\"time\":%ld,"
+				  "\"elapsed\":%ld,"
+				  "\"phase\":\"%s\","
+				  "\"dirs_done\":%llu,"
+				  "\"dirs_total\":%llu,"
+				  "\"dirents_done\":%llu,"
+				  "\"inodes_done\":%llu,"
+				  "\"inodes_total\":%llu,"
+				  "\"bytes_done\":%lld,"
+				  "\"bytes_total\":%lld,"
+				  "\"percent\":%.1f,"
+				  "\"rate\":%.0f,"
+				  "\"eta\":%ld,"
+				  "\"drives\":[",
+				  ( long )now,
+				  ( long )elapsed,
+				  persp->s.dirdonepr ? "nondir" : "dir",
+				  ( unsigned long long )tranp->t_dirdonecnt,
+				  ( unsigned long long )tranp->t_dircnt,
+				  ( unsigned long long )tranp->t_direntcnt,
+				  ( unsigned long long )inodone,
+				  ( unsigned long long )inocnt,
+				  ( long long )datadone,
+				  ( long long )datacnt,
+				  percent,
+				  rate,
+				  eta );
+
+	for ( i = 0 ; i < drivecnt && len < bufsz ; i++ ) {
+		drive_hdr_t *drhdrp = drivepp[ i ]->d_readhdrp;
+		media_hdr_t *mrhdrp = ( media_hdr_t * )drhdrp->dh_upper;
+
+		len += ( size_t )snprintf( buf + len,
+					   bufsz - len,
+					   "%s{\"drive\":%u,"
+					   "\"dumpfile\":%d,"
+					   "\"mediafile\":%d}",
+					   i ? "," : "",
+					   ( unsigned int )i,
+					   ( intgen_t )mrhdrp->mh_dumpfileix,
+					   ( intgen_t )mrhdrp->mh_mediafileix );
+	}
+	if ( len < bufsz ) {
+		len += ( size_t )snprintf( buf + len, bufsz - len, "]}\n" );
+	}
+
+	/* a truncated record is useless to a parser; drop it
+	 */
+	if ( len >= bufsz ) {
+		return 0;
+	}
+
+	return len;
+}
+
 void
 content_showinv( void )
 {
@@ -2977,6 +3178,16 @@ applydirdump( drive_t *drivep,
 			if (dirh == NH_NULL)
 			    return RV_ERROR;
 
+			/* unchanged since the base dump: no entries follow,
+			 * keep those already in the tree
+			 */
+			if ( fhdrp->fh_flags & FILEHDR_FLAGS_DIRREF ) {
+				tree_refdir( dirh );
+				tree_enddir( dirh );
+				tranp->t_dirdonecnt++;
+				continue;
+			}
+
 			/* read the directory entries, and populate the
 			 * tree with them. we can tell when we are done
 			 * by looking for a null dirent.
@@ -3133,6 +3344,12 @@ eatdirdump( drive_t *drivep,
 			continue;
 		}
 
+		/* dumped by reference: no entries follow
+		 */
+		if ( fhdrp->fh_flags & FILEHDR_FLAGS_DIRREF ) {
+			continue;
+		}
+
 		/* read the directory entries.
 		 * we can tell when we are done
 		 * by looking for a null dirent.
@@ -3291,6 +3508,48 @@ treepost( char *path1, char *path2 )
 	return RV_OK;
 }
 
+/* displays the table of contents from the tree and inode map alone,
+ * without reading the non-directory portion of the dump: lists each
+ * selected name of each non-directory the inode map says was dumped,
+ * in ino order. only one thread, after treepost( ).
+ */
+static rv_t
+tocdirs( char *path )
+{
+	mlog( MLOG_VERBOSE, _(
+	      "listing non-directory files from directories\n") );
+
+	inomap_cbiter( 1 << MAP_NDR_CHANGE, tocdirs_ino_cb, ( void * )path );
+
+	if ( cldmgr_stop_requested( )) {
+		return RV_INTR;
+	}
+
+	return RV_OK;
+}
+
+/* ARGSUSED */
+static bool_t
+tocdirs_ino_cb( void *ctxp, xfs_ino_t ino )
+{
+	if ( cldmgr_stop_requested( )) {
+		return BOOL_FALSE;
+	}
+
+	return tree_cb_ino( ino, tocdirs_path_cb, 0, ( char * )ctxp );
+}
+
+/* ARGSUSED */
+static bool_t
+tocdirs_path_cb( void *ctxp, char *path )
+{
+	mlog( MLOG_NORMAL | MLOG_BARE,
+	      "%s\n",
+	      path );
+
+	return BOOL_TRUE;
+}
+
 static rv_t
 applynondirdump( drive_t *drivep,
 		 dh_t fileh,
@@ -3304,6 +3563,7 @@ applynondirdump( drive_t *drivep,
 	bool_t ahcs;
 	egrp_t first_egrp;
 	egrp_t next_egrp;
+	xfs_ino_t neededino;
 	stream_context_t *strctxp = (stream_context_t *)drivep->d_strmcontextp;
 
 	/* determine if file header and/or extent heade checksums present
@@ -3329,6 +3589,10 @@ applynondirdump( drive_t *drivep,
 	 */
 	pi_bracketneededegrps( fileh, &first_egrp, &next_egrp );
 
+	/* the next ino needed, if the media file is indexed
+	 */
+	neededino = 0;
+
 	for ( ; ; ) {
 		drive_ops_t *dop = drivep->d_opsp;
 		drive_mark_t drivemark;
@@ -3421,6 +3685,30 @@ applynondirdump( drive_t *drivep,
 			}
 		}
 
+		/* if the media file is indexed, skip ahead to the next
+		 * ino needed. not while in the midst of one needed: the
+		 * rest of it would be skipped.
+		 */
+		if ( dop->do_seek_ino
+		     &&
+		     ! resyncpr
+		     &&
+		     bstatp->bs_ino >= neededino ) {
+			if ( ! inomap_rst_next( bstatp->bs_ino,
+						INO64MAX,
+						&neededino )) {
+				neededino = INO64MAX;
+			}
+			if ( neededino > bstatp->bs_ino
+			     &&
+			     ( * dop->do_seek_ino )( drivep, neededino )) {
+				mlog( MLOG_DEBUG,
+				      "skipped to media file index entry "
+				      "preceding ino %llu\n",
+				      neededino );
+			}
+		}
+
 		do {
 			/* get a mark for the next read, in case we restart here
 			 */
@@ -5113,6 +5401,10 @@ pi_addfile( Media_t *Mediap,
 		persp->s.stat_valpr = BOOL_TRUE;
 	}
 
+	if ( scrhdrp->cih_dumpattr & CIH_DUMPATTR_DYNPART ) {
+		persp->s.dynpartpr = BOOL_TRUE;
+	}
+
 	/* if we see a terminator, we know we have seen the end of
 	 * a stream.
 	 */
@@ -5176,7 +5468,9 @@ pi_addfile( Media_t *Mediap,
 			return DH_NULL;
 		}
 		ASSERT( drhdrp->dh_drivecnt > 0 );
-		if ( drhdrp->dh_driveix < drhdrp->dh_drivecnt - 1 ) {
+		if ( drhdrp->dh_driveix < drhdrp->dh_drivecnt - 1
+		     &&
+		     ! persp->s.dynpartpr ) {
 			/* if this is not in the last stream, we know
 			 * there is at least one other media file in
 			 * the following stream, and we know its start pt
@@ -5244,7 +5538,9 @@ pi_addfile( Media_t *Mediap,
 		pi_seestrmend( drhdrp->dh_driveix );
 		pi_seeobjstrmend( drhdrp->dh_driveix,
 				  mrhdrp->mh_mediaix );
-		if ( drhdrp->dh_driveix < drhdrp->dh_drivecnt - 1 ) {
+		if ( drhdrp->dh_driveix < drhdrp->dh_drivecnt - 1
+		     &&
+		     ! persp->s.dynpartpr ) {
 			( void )pi_insertfile( drhdrp->dh_drivecnt,
 					       drhdrp->dh_driveix + 1,
 					       0,
@@ -5752,6 +6048,13 @@ pi_scanfileendino( dh_t fileh )
 		    }
 		}
 	    }
+
+	    /* if dynamically partitioned, the next stream may begin
+	     * below the end of this media file
+	     */
+	    if ( mode && persp->s.dynpartpr ) {
+		return INO64MAX;
+	    }
 	}
 	return INO64MAX;
 }
@@ -5782,6 +6085,16 @@ pi_bracketneededegrps( dh_t thisfileh, egrp_t *first_egrp, egrp_t *next_egrp )
 	      strmh = DH2S( strmh )->s_nexth ) {
 	    dh_t objh;
 
+	    /* if dynamically partitioned, only media files of the same
+	     * stream are known to be in ino order
+	     */
+	    if ( persp->s.dynpartpr ) {
+		if ( thisfoundpr ) {
+		    break;
+		}
+		prech = DH_NULL;
+	    }
+
 	    for ( objh = DH2S( strmh )->s_cldh
 		  ;
 		  objh != DH_NULL
@@ -6057,6 +6370,7 @@ pi_neededobjs_nondir_alloc( bool_t *knownholesprp,
 
 	do {
 		egrp_t headegrp;
+		egrp_t gapendegrp;
 		bool_t foundgappr;
 
 		/* advance the head until we see the next media file which has
@@ -6079,9 +6393,16 @@ pi_neededobjs_nondir_alloc( bool_t *knownholesprp,
 		}
 
 		/* see if the range of egrps from head up to but not including
-		 * tail needed according to ino map
+		 * tail needed according to ino map. if dynamically
+		 * partitioned, the tail media file may extend beyond the
+		 * head: only the end of the world bounds it.
 		 */
-		if ( gapneeded( &tailegrp, &headegrp )) {
+		gapendegrp = headegrp;
+		if ( persp->s.dynpartpr ) {
+			gapendegrp.eg_ino = INO64MAX;
+			gapendegrp.eg_off = OFF64MAX;
+		}
+		if ( gapneeded( &tailegrp, &gapendegrp )) {
 			foundgappr = BOOL_TRUE;
 		} else {
 			foundgappr = BOOL_FALSE;
@@ -6772,6 +7093,68 @@ dumpcompat( bool_t resumepr, ix_t level, uuid_t baseid, bool_t logpr )
 	return BOOL_TRUE;
 }
 
+/* a dump with unchanged directories dumped by reference (xfsdump -D)
+ * holds only the changes to the directory hierarchy, and one with files
+ * dumped without their unchanged data (xfsdump -g) only the changes to
+ * those files, so either must be applied on top of its base. dumpcompat( )
+ * checks the base for cumulative restores. file data dumped by reference
+ * (xfsdump -u) is copied from the file it refers to, so a dump holding
+ * any is restored whole unless holes are accepted (-u).
+ */
+static bool_t
+dirrefcompat( content_inode_hdr_t *scrhdrp )
+{
+	if ( ( scrhdrp->cih_dumpattr & CIH_DUMPATTR_METAONLY )
+	     &&
+	     ! tranp->t_toconlypr
+	     &&
+	     ! persp->a.cumpr ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR, _(
+		      "dump omits the data of files whose data is unchanged "
+		      "and can only be applied by a cumulative restore "
+		      "(-%c) on top of its base\n"),
+		      GETOPT_CUMULATIVE );
+		return BOOL_FALSE;
+	}
+
+	if ( ( scrhdrp->cih_dumpattr & CIH_DUMPATTR_DEDUP )
+	     &&
+	     ! tranp->t_toconlypr
+	     &&
+	     ( persp->a.stcnt || persp->a.interpr )
+	     &&
+	     ! tranp->t_refholespr ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR, _(
+		      "dump refers to the data of one file for another, "
+		      "so restoring part of it may leave holes in the "
+		      "files restored: specify -%c to accept them\n"),
+		      GETOPT_REFHOLES );
+		return BOOL_FALSE;
+	}
+
+	if ( ! ( scrhdrp->cih_dumpattr & CIH_DUMPATTR_DIRREF )) {
+		return BOOL_TRUE;
+	}
+
+	if ( tranp->t_toconlypr ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "dump omits the entries of unchanged directories: "
+		      "contents listing is incomplete\n") );
+		return BOOL_TRUE;
+	}
+
+	if ( ! persp->a.cumpr ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR, _(
+		      "dump omits the entries of unchanged directories "
+		      "and can only be applied by a cumulative restore "
+		      "(-%c) on top of its base\n"),
+		      GETOPT_CUMULATIVE );
+		return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
 /* prompts for a new media object. supplies list of media objects still
  * needed, and indicates if there are or may be unidentified media objects
  * still needed/available
@@ -7107,6 +7490,11 @@ restore_file( drive_t *drivep,
 		       bstatp->bs_gen,
 		       bstatp->bs_ctime.tv_sec,
 		       bstatp->bs_mtime.tv_sec,
+		       ( fhdrp->fh_flags & FILEHDR_FLAGS_METAONLY )
+		       ?
+		       BOOL_TRUE
+		       :
+		       BOOL_FALSE,
 		       restore_file_cb,
 		       &context,
 		       path1,
@@ -7248,6 +7636,7 @@ restore_reg( drive_t *drivep,
 	struct fsxattr fsxattr;
 	struct stat64 stat;
 	intgen_t oflags;
+	bool_t metaonlypr;
 
 	if ( !path )
 		return BOOL_TRUE;
@@ -7282,12 +7671,29 @@ restore_reg( drive_t *drivep,
 	if ( tranp->t_toconlypr )
 		return BOOL_TRUE;
 
-	oflags = O_CREAT | O_RDWR;
+	/* a file dumped without its data (xfsdump -g) keeps the data
+	 * restored from the base, so must already exist
+	 */
+	metaonlypr = ( fhdrp->fh_flags & FILEHDR_FLAGS_METAONLY )
+		     ?
+		     BOOL_TRUE
+		     :
+		     BOOL_FALSE;
+
+	oflags = metaonlypr ? O_RDWR : O_CREAT | O_RDWR;
 	if (persp->a.dstdirisxfspr && bstatp->bs_xflags & XFS_XFLAG_REALTIME)
 		oflags |= O_DIRECT;
 			
 	*fdp = open( path, oflags, S_IRUSR | S_IWUSR );
 	if ( *fdp < 0 ) {
+		if ( metaonlypr && errno == ENOENT ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "%s not found: data of ino %llu is not in "
+			      "the restored base: discarding\n"),
+			      path,
+			      bstatp->bs_ino );
+			return BOOL_TRUE;
+		}
 		mlog( MLOG_NORMAL | MLOG_WARNING,
 		      _("open of %s failed: %s: discarding ino %llu\n"),
 		      path,
@@ -7296,12 +7702,28 @@ restore_reg( drive_t *drivep,
 		return BOOL_TRUE;
 	}
 
+	/* the file was not unlinked, so remove the extended attributes
+	 * it has now: those dumped follow the data.
+	 */
+	if ( metaonlypr ) {
+		clearextattr( *fdp, path );
+	}
+
 	rval = fstat64( *fdp, &stat );
 	if ( rval != 0 ) {
 		mlog( MLOG_VERBOSE | MLOG_WARNING,
 		      _("attempt to stat %s failed: %s\n"),
 		      path,
 		      strerror( errno ));
+	} else if ( metaonlypr ) {
+		if ( stat.st_size != bstatp->bs_size ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "%s is %lld bytes, not %lld as dumped: "
+			      "restored base is not that of the dump\n"),
+			      path,
+			      stat.st_size,
+			      bstatp->bs_size );
+		}
 	} else {
 		if ( stat.st_size != bstatp->bs_size ) {
 			mlog( MLOG_TRACE,
@@ -7373,6 +7795,12 @@ restore_extent_group( drive_t *drivep,
 	off64_t bytesread;
 	rv_t rv;
 
+	/* a file dumped without its data is complete with its header
+	 */
+	if ( fhdrp->fh_flags & FILEHDR_FLAGS_METAONLY ) {
+		restoredsz = bstatp->bs_size;
+	}
+
 	/* copy data extents from media to the file
 	 */
 	for ( ; ; ) {
@@ -7423,6 +7851,21 @@ restore_extent_group( drive_t *drivep,
 			continue;
 		}
 
+		/* data identical to a chunk already restored: copy it
+		 */
+		if ( ehdr.eh_type == EXTENTHDR_TYPE_REF ) {
+			rv = restore_extentref( fhdrp,
+						&ehdr,
+						fd,
+						path,
+						drivep );
+			if ( rv != RV_OK ) {
+				*rvp = rv;
+				return BOOL_FALSE;
+			}
+			continue;
+		}
+
 		/* real data
 		 */
 		ASSERT( ehdr.eh_type == EXTENTHDR_TYPE_DATA );
@@ -8258,6 +8701,232 @@ discard_padding( size_t sz, drive_t *drivep )
 	}
 }
 
+/* reads the extentref_t following an EXTENTHDR_TYPE_REF extent hdr, and
+ * copies the chunk it locates into the file being restored. the chunk was
+ * dumped earlier in the media file, so the file holding it has already
+ * been restored, unless it was not selected or could not be written:
+ * the copy there is used only if it still has the chunk's fingerprint.
+ * the chunk may be earlier in the same file. fd == -1 signifies no write.
+ */
+static rv_t
+restore_extentref( filehdr_t *fhdrp,
+		   extenthdr_t *ehdrp,
+		   int fd,
+		   char *path,
+		   drive_t *drivep )
+{
+	bstat_t *bstatp = &fhdrp->fh_stat;
+	drive_ops_t *dop = drivep->d_opsp;
+	stream_context_t *strctxp = (stream_context_t *)drivep->d_strmcontextp;
+	off64_t off = ehdrp->eh_offset;
+	off64_t sz = ehdrp->eh_sz;
+	extentref_t eref;
+	extentref_t tmperef;
+	char *reasonstr;
+	intgen_t nread;
+	intgen_t nwritten;
+	intgen_t rval;
+	size_t ntowrite;
+
+	/* REFERENCED */
+	nread = read_buf( ( char * )&tmperef,
+			  sizeof( tmperef ),
+			  ( void * )drivep,
+			  ( rfp_t )dop->do_read,
+			  ( rrbfp_t )dop->do_return_read_buf,
+			  &rval );
+	switch( rval ) {
+	case 0:
+		break;
+	case DRIVE_ERROR_EOD:
+	case DRIVE_ERROR_EOF:
+	case DRIVE_ERROR_EOM:
+	case DRIVE_ERROR_MEDIA:
+		return RV_EOD;
+	case DRIVE_ERROR_CORRUPTION:
+		return RV_CORRUPT;
+	case DRIVE_ERROR_DEVICE:
+		return RV_DRIVE;
+	case DRIVE_ERROR_CORE:
+	default:
+		return RV_CORE;
+	}
+	ASSERT( ( size_t )nread == sizeof( tmperef ));
+	xlate_extentref( &tmperef, &eref, 1 );
+
+	mlog( MLOG_NITTY,
+	      "read extent ref ino %llu offset %lld\n",
+	      eref.er_ino,
+	      eref.er_offset );
+
+	if ( fd == -1 || off >= bstatp->bs_size ) {
+		return RV_OK;
+	}
+	ASSERT( path );
+
+	if ( sz <= 0 || sz > ( off64_t )INTGENMAX ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING, _(
+		      "bad extent ref size %lld for %s offset %lld: "
+		      "not restoring extent\n"),
+		      sz,
+		      path,
+		      off );
+		return RV_OK;
+	}
+	if ( ( size_t )sz > strctxp->sc_refbufsz ) {
+		char *bufp;
+
+		bufp = ( char * )realloc( ( void * )strctxp->sc_refbufp,
+					  ( size_t )sz );
+		if ( ! bufp ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "unable to allocate %lld bytes "
+			      "for extent ref: %s: "
+			      "not restoring extent off %lld of %s\n"),
+			      sz,
+			      strerror( errno ),
+			      off,
+			      path );
+			return RV_OK;
+		}
+		strctxp->sc_refbufp = bufp;
+		strctxp->sc_refbufsz = ( size_t )sz;
+	}
+
+	/* find and read the earlier chunk. the tree may hold more than one
+	 * generation of er_ino during a cumulative restore, and the extent
+	 * ref does not say which: every link is tried until the chunk read
+	 * from one matches the fingerprint.
+	 */
+	if ( eref.er_ino == bstatp->bs_ino ) {
+		if ( ! restore_extentref_read( fd,
+					       strctxp,
+					       &eref,
+					       sz,
+					       &reasonstr )) {
+			goto unresolved;
+		}
+	} else {
+		extentref_context_t ectx;
+
+		ectx.ec_strctxp = strctxp;
+		ectx.ec_erefp = &eref;
+		ectx.ec_sz = sz;
+		ectx.ec_reasonstr = _("not restored");
+		ectx.ec_foundpr = BOOL_FALSE;
+		( void )tree_cb_ino( eref.er_ino,
+				     restore_extentref_cb,
+				     ( void * )&ectx,
+				     strctxp->sc_refpath );
+		if ( ! ectx.ec_foundpr ) {
+			reasonstr = ectx.ec_reasonstr;
+			goto unresolved;
+		}
+	}
+
+	/* write no further than the end of the file
+	 */
+	if ( sz > bstatp->bs_size - off ) {
+		ntowrite = ( size_t )( bstatp->bs_size - off );
+	} else {
+		ntowrite = ( size_t )sz;
+	}
+	for ( nwritten = 0 ; nwritten < ( intgen_t )ntowrite ; ) {
+		rval = pwrite64( fd,
+				 strctxp->sc_refbufp + nwritten,
+				 ntowrite - ( size_t )nwritten,
+				 off + ( off64_t )nwritten );
+		if ( rval <= 0 ) {
+			mlog( MLOG_NORMAL | MLOG_WARNING, _(
+			      "attempt to write %u bytes to %s at "
+			      "offset %lld failed: %s\n"),
+			      ntowrite - ( size_t )nwritten,
+			      path,
+			      off + ( off64_t )nwritten,
+			      rval < 0 ? strerror( errno ) : _("no space"));
+			break;
+		}
+		nwritten += rval;
+	}
+
+	return RV_OK;
+
+unresolved:
+	mlog( MLOG_NORMAL | MLOG_WARNING, _(
+	      "unable to restore %s offset %lld sz %lld: "
+	      "data is a copy of ino %llu offset %lld, %s\n"),
+	      path,
+	      off,
+	      sz,
+	      eref.er_ino,
+	      eref.er_offset,
+	      reasonstr );
+	return RV_OK;
+}
+
+/* restore_extentref_read - reads the chunk erefp locates from srcfd into
+ * the ref buffer of the stream, and checks it against the fingerprint.
+ * a short read means it was the end of its file, padded with zeros when
+ * dumped.
+ */
+static bool_t
+restore_extentref_read( intgen_t srcfd,
+			stream_context_t *strctxp,
+			extentref_t *erefp,
+			off64_t sz,
+			char **reasonstrp )
+{
+	u_int64_t fp[ FPRINT_WORDS ];
+	intgen_t nread;
+
+	nread = pread64( srcfd,
+			 strctxp->sc_refbufp,
+			 ( size_t )sz,
+			 erefp->er_offset );
+	if ( nread < 0 ) {
+		*reasonstrp = strerror( errno );
+		return BOOL_FALSE;
+	}
+	if ( ( off64_t )nread < sz ) {
+		memset( ( void * )( strctxp->sc_refbufp + nread ),
+			0,
+			( size_t )sz - ( size_t )nread );
+	}
+	fprint_calc( strctxp->sc_refbufp, ( size_t )sz, fp );
+	if ( memcmp( ( void * )fp,
+		     ( void * )erefp->er_fprint,
+		     sizeof( erefp->er_fprint ))) {
+		*reasonstrp = _("restored copy differs");
+		return BOOL_FALSE;
+	}
+
+	return BOOL_TRUE;
+}
+
+/* tree_cb_ino( ) callback for restore_extentref( ): stops at the first
+ * link to a file holding the chunk
+ */
+static bool_t
+restore_extentref_cb( void *contextp, char *path )
+{
+	extentref_context_t *ectxp = ( extentref_context_t * )contextp;
+	intgen_t srcfd;
+
+	srcfd = open( path, O_RDONLY );
+	if ( srcfd < 0 ) {
+		ectxp->ec_reasonstr = strerror( errno );
+		return BOOL_TRUE;
+	}
+	ectxp->ec_foundpr = restore_extentref_read( srcfd,
+						    ectxp->ec_strctxp,
+						    ectxp->ec_erefp,
+						    ectxp->ec_sz,
+						    &ectxp->ec_reasonstr );
+	( void )close( srcfd );
+
+	return ! ectxp->ec_foundpr;
+}
+
 static rv_t
 restore_extent( filehdr_t *fhdrp,
 		extenthdr_t *ehdrp,
@@ -8310,6 +8979,38 @@ restore_extent( filehdr_t *fhdrp,
 			isrealtime = BOOL_TRUE;
 	}
 
+	/* if nothing is to be written, skip over the data. the drive
+	 * seeks over it if the media allows.
+	 */
+	if ( fd == -1 && dop->do_skip ) {
+		intgen_t rval;
+
+		if ( off < bstatp->bs_size ) {
+			*bytesreadp = min( sz, bstatp->bs_size - off );
+		}
+		rval = ( * dop->do_skip )( drivep, sz );
+		if ( ! rval ) {
+			return RV_OK;
+		}
+		mlog( MLOG_NORMAL, _(
+		      "attempt to skip %lld bytes failed\n"),
+		      sz );
+		switch( rval ) {
+		case DRIVE_ERROR_EOF:
+		case DRIVE_ERROR_EOD:
+		case DRIVE_ERROR_EOM:
+		case DRIVE_ERROR_MEDIA:
+			return RV_EOD;
+		case DRIVE_ERROR_CORRUPTION:
+			return RV_CORRUPT;
+		case DRIVE_ERROR_DEVICE:
+			return RV_DRIVE;
+		case DRIVE_ERROR_CORE:
+		default:
+			return RV_CORE;
+		}
+	}
+
 	/* move from media to fs.
 	 */
 	while ( sz ) {
@@ -8724,6 +9425,64 @@ setextattr( char *path, extattrhdr_t *ahdrp )
 	}
 }
 
+/* removes all extended attributes of a file in every namespace, as
+ * unlinking it before the restore would
+ */
+static void
+clearextattr( intgen_t fd, char *path )
+{
+	static intgen_t namespaces[ ] = { 0, ATTR_ROOT, ATTR_SECURE };
+	int32_t listbuf[ 1024 ];
+	attrlist_t *listp = ( attrlist_t * )listbuf;
+	ix_t nsix;
+
+	for ( nsix = 0
+	      ;
+	      nsix < sizeof( namespaces ) / sizeof( namespaces[ 0 ] )
+	      ;
+	      nsix++ ) {
+		intgen_t flag = namespaces[ nsix ];
+
+		/* removing attributes invalidates the cursor, so list
+		 * afresh until none are left
+		 */
+		for ( ; ; ) {
+			attrlist_cursor_t cursor;
+			intgen_t i;
+
+			memset( ( void * )&cursor, 0, sizeof( cursor ));
+			if ( attr_listf( fd,
+					 ( char * )listbuf,
+					 sizeof( listbuf ),
+					 flag,
+					 &cursor )) {
+				mlog( MLOG_VERBOSE | MLOG_WARNING, _(
+				      "unable to list extended attributes "
+				      "of %s: %s\n"),
+				      path,
+				      strerror( errno ));
+				break;
+			}
+			if ( listp->al_count == 0 ) {
+				break;
+			}
+			for ( i = 0 ; i < listp->al_count ; i++ ) {
+				attrlist_ent_t *entp = ATTR_ENTRY( listbuf, i );
+
+				if ( attr_removef( fd, entp->a_name, flag )) {
+					mlog( MLOG_VERBOSE | MLOG_WARNING, _(
+					      "unable to remove extended "
+					      "attribute %s of %s: %s\n"),
+					      entp->a_name,
+					      path,
+					      strerror( errno ));
+					return;
+				}
+			}
+		}
+	}
+}
+
 #ifdef DEBUGPARTIALS
 /*
  * Debug code to view the partials in the partial register
@@ -9017,6 +9776,8 @@ ehdr_typestr( int32_t type )
 		return "DATA";
 	case EXTENTHDR_TYPE_HOLE:
 		return "HOLE";
+	case EXTENTHDR_TYPE_REF:
+		return "REF";
 	default:
 		return "?";
 	}
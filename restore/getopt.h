@@ -26,7 +26,7 @@
  * purpose is to contain that command string.
  */
 
-#define GETOPT_CMDSTRING	"a:b:c:def:himn:op:qrs:tv:wABCDEFG:H:I:JL:M:NO:PQRS:TUVWX:Y:Z"
+#define GETOPT_CMDSTRING	"a:b:c:def:hij:lmn:op:qrs:tuv:wABCDEFG:H:I:JK:L:M:NO:PQRS:TUVWX:Y:Z"
 
 #define GETOPT_WORKSPACE	'a'	/* workspace dir (content.c) */
 #define GETOPT_BLOCKSIZE        'b'     /* blocksize for rmt */
@@ -37,9 +37,9 @@
 /*				'g' */
 #define	GETOPT_HELP		'h'	/* display version and usage */
 #define	GETOPT_INTERACTIVE	'i'	/* interactive subtree selection */
-/*				'j' */
+#define	GETOPT_RMTWINDOW	'j'	/* rmt commands in flight (drive_minrmt.c) */
 /*				'k' */
-/*				'l' */
+#define	GETOPT_TOCDIRS		'l'	/* contents from dirs only (content.c) */
 #define GETOPT_MINRMT		'm'	/* use minimal rmt protocol */
 #define	GETOPT_NEWER		'n'	/* only restore files newer than arg */
 #define	GETOPT_OWNER		'o'	/* restore owner/grp even if not root */
@@ -48,7 +48,7 @@
 #define	GETOPT_CUMULATIVE	'r'	/* accumulating restore (content.c) */
 #define	GETOPT_SUBTREE		's'	/* subtree restore (content.c) */
 #define	GETOPT_TOC		't'	/* display contents only (content.c) */
-/*				'u' */
+#define	GETOPT_REFHOLES		'u'	/* partial restore of -u dump (content.c) */
 #define	GETOPT_VERBOSITY	'v'	/* verbosity level (0 to 4 ) */
 #define	GETOPT_SMALLWINDOW	'w'	/* use a small window for dir entries */
 /*				'x' */
@@ -64,7 +64,7 @@
 #define GETOPT_MAXSTACKSZ	'H'	/* maximum stack size (bytes) */
 #define GETOPT_INVPRINT         'I'     /* just display the inventory */
 #define	GETOPT_NOINVUPDATE	'J'	/* do not update the dump inventory */
-/*				'K' */
+#define	GETOPT_PROGRESSFILE	'K'	/* progress record file or fd (main.c) */
 #define	GETOPT_DUMPLABEL	'L'	/* dump session label (global.c) */
 #define	GETOPT_MEDIALABEL	'M'	/* media object label (media.c) */
 #define	GETOPT_TIMESTAMP	'N'	/* show timestamps in log msgs */
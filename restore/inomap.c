@@ -37,6 +37,7 @@
 #include "content.h"
 #include "content_inode.h"
 #include "inomap.h"
+#include "segix.h"
 #include "mmap.h"
 #include "arch_xlate.h"
 
@@ -92,6 +93,10 @@ static hnk_t *roothnkp = 0;
 static hnk_t *tailhnkp;
 static seg_t *lastsegp;
 static xfs_ino_t last_ino_added;
+static segix_t segix;
+	/* hash of the segments of the mapped inomap, for map_getsegment( ).
+	 * not in use (segix.si_slotp NULL) if it could not be built.
+	 */
 
 /* map context and operators
  */
@@ -421,7 +426,28 @@ inomap_sync_pers( char *hkdir )
 						 SEGPERHNK * ( hnkcnt - 1 )
 						 -
 						 1 ) ];
-	
+
+	/* index the segments, so they can be found without searching.
+	 * not fatal if this fails: map_getsegment( ) falls back to
+	 * binary search.
+	 */
+	if ( segix_init( &segix, ( size_t )segcnt )) {
+		size_t ix;
+
+		for ( ix = 0 ; ix < ( size_t )segcnt ; ix++ ) {
+			if ( ! segix_add( &segix, roothnkp, ix )) {
+				mlog( MLOG_DEBUG,
+				      "inomap segment index not used: "
+				      "segment %llu base ino %llu\n",
+				      ( u_int64_t )ix,
+				      roothnkp[ ix / SEGPERHNK ]
+				      .seg[ ix % SEGPERHNK ].base );
+				segix_free( &segix );
+				break;
+			}
+		}
+	}
+
 	/* now all inomap operators will work
 	 */
 	return BOOL_TRUE;
@@ -480,22 +506,27 @@ inomap_sanitize( void )
 	}
 }
 
-/* called to mark a non-dir ino as TO be restored
+/* called to mark a non-dir ino as TO be restored, if it was dumped
  */
 void
 inomap_rst_add( xfs_ino_t ino )
 {
 		ASSERT( pers_fd >= 0 );
-		( void )map_set( ino, MAP_NDR_CHANGE );
+		if ( map_getset( ino, 0, BOOL_FALSE ) == MAP_NDR_NOREST ) {
+			( void )map_set( ino, MAP_NDR_CHANGE );
+		}
 }
 
-/* called to mark a non-dir ino as NOT to be restored
+/* called to mark a non-dir ino as NOT to be restored. inos not dumped
+ * are left alone, so the map still tells which inos were dumped.
  */
 void
 inomap_rst_del( xfs_ino_t ino )
 {
 		ASSERT( pers_fd >= 0 );
-		( void )map_set( ino, MAP_NDR_NOREST );
+		if ( map_getset( ino, 0, BOOL_FALSE ) == MAP_NDR_CHANGE ) {
+			( void )map_set( ino, MAP_NDR_NOREST );
+		}
 }
 
 /* called to ask if any inos in the given range need to be restored.
@@ -503,6 +534,17 @@ inomap_rst_del( xfs_ino_t ino )
  */
 bool_t
 inomap_rst_needed( xfs_ino_t firstino, xfs_ino_t lastino )
+{
+	xfs_ino_t ino;
+
+	return inomap_rst_next( firstino, lastino, &ino );
+}
+
+/* like inomap_rst_needed( ), but also returns by reference the first
+ * ino in the range which needs to be restored.
+ */
+bool_t
+inomap_rst_next( xfs_ino_t firstino, xfs_ino_t lastino, xfs_ino_t *inop )
 {
 	hnk_t *hnkp;
 	seg_t *segp;
@@ -510,6 +552,7 @@ inomap_rst_needed( xfs_ino_t firstino, xfs_ino_t lastino )
 	/* if inomap not restored/resynced, just say yes
 	 */
 	if ( ! roothnkp ) {
+		*inop = firstino;
 		return BOOL_TRUE;
 	}
 
@@ -519,8 +562,18 @@ inomap_rst_needed( xfs_ino_t firstino, xfs_ino_t lastino )
 		return BOOL_FALSE;
 	}
 
-	/* find the hunk/seg containing first ino or any ino beyond
+	/* find the hunk/seg containing first ino or any ino beyond.
+	 * usually first ino is in a segment, and the index finds it.
 	 */
+	if ( segix.si_slotp ) {
+		size_t ix;
+
+		segp = segix_find( &segix, roothnkp, firstino, &ix );
+		if ( segp ) {
+			hnkp = &roothnkp[ ix / SEGPERHNK ];
+			goto begin;
+		}
+	}
 	for ( hnkp = roothnkp ; hnkp != 0 ; hnkp = hnkp->nextp ) {
 		if ( firstino > hnkp->maxino ) {
 			continue;
@@ -555,6 +608,7 @@ begin:
 			}
 			state = SEG_GET_BITS( segp, ino );
 			if ( state == MAP_NDR_CHANGE ) {
+				*inop = ino;
 				return BOOL_TRUE;
 			}
 		}
@@ -653,6 +707,14 @@ map_getsegment( xfs_ino_t ino )
 	u_int64_t hnk;
 	u_int64_t seg;
 
+	/* the segment index finds the segment in about one probe
+	 */
+	if ( segix.si_slotp ) {
+		size_t ix;
+
+		return segix_find( &segix, roothnkp, ino, &ix );
+	}
+
 	/* Use binary search to find the hunk that contains the inode number,
 	 * if any.  This counts on the fact that all the hunks are contiguous
 	 * in memory and therefore can be treated as an array instead of a
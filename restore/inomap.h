@@ -76,6 +76,9 @@ extern rv_t inomap_restore_pers( drive_t *drivep,
 extern void inomap_del_pers( char *hkdir );
 extern void inomap_sanitize( void );
 extern bool_t inomap_rst_needed( xfs_ino_t begino, xfs_ino_t endino );
+extern bool_t inomap_rst_next( xfs_ino_t begino,
+				xfs_ino_t endino,
+				xfs_ino_t *inop );
 extern void inomap_rst_add( xfs_ino_t ino );
 extern void inomap_rst_del( xfs_ino_t ino );
 extern rv_t inomap_discard( drive_t *drivep, content_inode_hdr_t *scrhdrp );
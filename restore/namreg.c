@@ -24,6 +24,7 @@
 #include <sys/ioctl.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h>
 
 #include "types.h"
 #include "lock.h"
@@ -35,14 +36,60 @@
 /* structure definitions used locally ****************************************/
 
 #define max( a, b )	( ( ( a ) > ( b ) ) ? ( a ) : ( b ) )
+#define min( a, b )	( ( ( a ) < ( b ) ) ? ( a ) : ( b ) )
 
 #define NAMREG_AVGLEN	10
 
+/* name record formats. a plain record is a one byte name length followed
+ * by the name. a front-coded record is a header followed by the part of
+ * the name not shared with the previous name in its block.
+ */
+#define NAMREG_FMT_PLAIN	0
+#define NAMREG_FMT_FRONT	1
+
+#define FC_PRELEN	0	/* bytes shared with the previous name */
+#define FC_SUFLEN	1	/* bytes following the header */
+#define FC_BACKHI	2	/* distance back to the first record */
+#define FC_BACKLO	3	/*   of the block, in bytes */
+#define FC_HDRSZ	4
+
+/* a block begins with a name stored whole, and closes after NAMREG_BLKCNT
+ * names or once it spans NAMREG_BLKSZ bytes, so one small read covers
+ * all a name is rebuilt from.
+ */
+#define NAMREG_BLKCNT	16
+#define NAMREG_BLKSZ	1024
+#define NAMREG_RECMAX	( FC_HDRSZ + NAME_MAX )
+#define NAMREG_READSZ	( NAMREG_BLKSZ + NAMREG_RECMAX )
+
+/* names are deduplicated through a direct-mapped cache of recently
+ * registered names, sized from the inocnt hint.
+ */
+#define NAMREG_DEDUPMIN	( 1 << 12 )
+#define NAMREG_DEDUPMAX	( 1 << 20 )
+
 /* persistent context for a namreg - placed in first page
  * of the namreg file by namreg_init if not a sync
  */
 struct namreg_pers {
 	off64_t np_appendoff;
+	size_t np_hdlbits;
+		/* bits available to a handle. zero in a registry left
+		 * by a release without this field: 32.
+		 */
+	size_t np_fmt;
+		/* record format. zero in a registry left by a release
+		 * without this field: plain.
+		 */
+	off64_t np_blkoff;
+	size_t np_blkcnt;
+		/* offset of the first record of the current front-coding
+		 * block, and number of names in it
+		 */
+	size_t np_prevlen;
+	char np_prevname[ NAME_MAX + 1 ];
+		/* last name written: the base of the next front-coded one
+		 */
 };
 
 typedef struct namreg_pers namreg_pers_t;
@@ -54,44 +101,60 @@ typedef struct namreg_pers namreg_pers_t;
 
 #define	NAMREG_BUFSIZE	32768
 
+struct namreg_dedup {
+	nrh_t nd_nrh;
+	u_int32_t nd_hash;
+	u_int32_t nd_len;
+};
+
+typedef struct namreg_dedup namreg_dedup_t;
+
 struct namreg_tran {
 	char *nt_pathname;
 	int nt_fd;
 	bool_t nt_at_endpr;
 	size_t nt_off;
 	char nt_buf[NAMREG_BUFSIZE];
+	namreg_dedup_t *nt_dedupp;
+	size_t nt_dedupmask;
+	size64_t nt_getcnt;
 };
 
 typedef struct namreg_tran namreg_tran_t;
 
 
+/* handle limits are relative to the number of handle bits the user
+ * can store (see namreg_sethdlbits)
+ */
+#define HDLBITS			( npp->np_hdlbits )
+
 #ifdef NAMREGCHK
 
 /* macros for manipulating namreg handles when handle consistency
  * checking is enabled.
  */
 #define CHKBITCNT		2
-#define	CHKBITSHIFT		( NBBY * sizeof( nrh_t ) - CHKBITCNT )
-#define	CHKBITLOMASK		( ( 1 << CHKBITCNT ) - 1 )
+#define	CHKBITSHIFT		( HDLBITS - CHKBITCNT )
+#define	CHKBITLOMASK		( ( ( nrh_t )1 << CHKBITCNT ) - 1 )
 #define	CHKBITMASK		( CHKBITLOMASK << CHKBITSHIFT )
 #define CHKHDLCNT		CHKBITSHIFT
-#define CHKHDLMASK		( ( 1 << CHKHDLCNT ) - 1 )
+#define CHKHDLMASK		( ( ( nrh_t )1 << CHKHDLCNT ) - 1 )
 #define CHKGETBIT( h )		( ( h >> CHKBITSHIFT ) & CHKBITLOMASK )
 #define CHKGETHDL( h )		( h & CHKHDLMASK )
-#define CHKMKHDL( c, h )	( ( ( c << CHKBITSHIFT ) & CHKBITMASK )	\
+#define CHKMKHDL( c, h )	( ( ( ( c ) << CHKBITSHIFT ) & CHKBITMASK )\
 				  |					\
 				  ( h & CHKHDLMASK ))
 #define HDLMAX			( ( off64_t )CHKHDLMASK )
+#define HDL2OFF( h )		( ( off64_t )( size64_t )CHKGETHDL( h ))
 
 #else /* NAMREGCHK */
 
 #define HDLMAX			( ( ( off64_t )1			\
 				    <<					\
-				    ( ( off64_t )NBBY			\
-				      *					\
-				      ( off64_t )sizeof( nrh_t )))	\
+				    ( off64_t )HDLBITS )		\
 				  -					\
 				  ( off64_t )2 ) /* 2 to avoid NRH_NULL */
+#define HDL2OFF( h )		( ( off64_t )( size64_t )( h ))
 
 #endif /* NAMREGCHK */
 
@@ -102,6 +165,12 @@ extern size_t pgsz;
 
 /* forward declarations of locally defined static functions ******************/
 
+static void namreg_addfront( char *name, size_t namelen );
+static intgen_t namreg_read( off64_t off, char *bufp, size_t len );
+static intgen_t namreg_getname( off64_t off, char **namep );
+static bool_t namreg_match( nrh_t nrh, char *name, size_t namelen );
+static inline u_int32_t namreg_hash( char *name, size_t namelen );
+
 
 /* definition of locally defined global variables ****************************/
 
@@ -248,26 +317,100 @@ namreg_init( char *hkdir, bool_t resume, u_int64_t inocnt )
 	 */
 	if ( ! resume ) {
 		npp->np_appendoff = ( off64_t )NAMREG_PERS_SZ;
+		npp->np_fmt = NAMREG_FMT_FRONT;
+		npp->np_blkoff = npp->np_appendoff;
+		npp->np_blkcnt = 0;
+		npp->np_prevlen = 0;
+	}
+	if ( ! npp->np_hdlbits ) {
+		npp->np_hdlbits = NBBY * sizeof( size32_t );
 	}
 
 	/* initialize transient state
 	 */
 	ntp->nt_at_endpr = BOOL_FALSE;
 
+	/* allocate the dedup cache. without one, every name is
+	 * simply written.
+	 */
+	{
+	size_t dedupcnt;
+	size_t ix;
+
+	for ( dedupcnt = NAMREG_DEDUPMIN
+	      ;
+	      dedupcnt < NAMREG_DEDUPMAX && ( u_int64_t )dedupcnt < inocnt
+	      ;
+	      dedupcnt <<= 1 )
+		;
+	ntp->nt_dedupp = ( namreg_dedup_t * )calloc( dedupcnt,
+						      sizeof( namreg_dedup_t ));
+	if ( ntp->nt_dedupp ) {
+		for ( ix = 0 ; ix < dedupcnt ; ix++ ) {
+			ntp->nt_dedupp[ ix ].nd_nrh = NRH_NULL;
+		}
+		ntp->nt_dedupmask = dedupcnt - 1;
+	} else {
+		mlog( MLOG_VERBOSE | MLOG_NOTE, _(
+		      "no memory for name registry dedup cache\n") );
+	}
+	}
+
 	return BOOL_TRUE;
 }
 
+void
+namreg_sethdlbits( size_t hdlbits )
+{
+	ASSERT( npp );
+	ASSERT( hdlbits <= NBBY * sizeof( nrh_t ));
+	ASSERT( hdlbits < NBBY * sizeof( off64_t ));
+
+	npp->np_hdlbits = hdlbits;
+}
+
 nrh_t
 namreg_add( char *name, size_t namelen )
 {
 	off64_t oldoff;
 	unsigned char c;
 	nrh_t nrh;
+	namreg_dedup_t *ndp;
+	u_int32_t hash;
 	
 	/* sanity checks
 	 */
 	ASSERT( ntp );
 	ASSERT( npp );
+	ASSERT( namelen < 256 );
+
+	/* an identical name registered recently can share its handle,
+	 * since names are never deleted
+	 */
+	ndp = 0;
+	hash = 0;
+	if ( ntp->nt_dedupp ) {
+		hash = namreg_hash( name, namelen );
+		ndp = &ntp->nt_dedupp[ hash & ntp->nt_dedupmask ];
+		if ( ndp->nd_nrh != NRH_NULL
+		     &&
+		     ndp->nd_hash == hash
+		     &&
+		     ndp->nd_len == ( u_int32_t )namelen
+		     &&
+		     namreg_match( ndp->nd_nrh, name, namelen )) {
+			return ndp->nd_nrh;
+		}
+	}
+
+	/* the handle is the offset; refuse if it won't fit
+	 */
+	if ( npp->np_appendoff > HDLMAX ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR, _(
+		      "name registry exceeds %u bit handle limit\n"),
+		      ( unsigned int )npp->np_hdlbits );
+		return NRH_NULL;
+	}
 
 	/* make sure file pointer is positioned to append
 	 */
@@ -285,7 +428,7 @@ namreg_add( char *name, size_t namelen )
 		ntp->nt_at_endpr = BOOL_TRUE;
 	}
 
-	if (ntp->nt_off + namelen + 1 > sizeof(ntp->nt_buf)) {
+	if (ntp->nt_off + FC_HDRSZ + namelen > sizeof(ntp->nt_buf)) {
 		if (namreg_flush() != RV_OK) {
 			return NRH_NULL;
 		}
@@ -295,18 +438,21 @@ namreg_add( char *name, size_t namelen )
 	 */
 	oldoff = npp->np_appendoff;
 
-	/* write a one byte unsigned string length into the buffer.
-	 */
-	ASSERT( namelen < 256 );
-	c = ( unsigned char )( namelen & 0xff );
-	ntp->nt_buf[ntp->nt_off++] = c;
+	if ( npp->np_fmt == NAMREG_FMT_FRONT ) {
+		namreg_addfront( name, namelen );
+	} else {
+		/* write a one byte unsigned string length into the buffer.
+		 */
+		c = ( unsigned char )( namelen & 0xff );
+		ntp->nt_buf[ntp->nt_off++] = c;
 
-	/* write the name string into the buffer.
-	 */
-	memcpy(ntp->nt_buf + ntp->nt_off, name, namelen);
-	ntp->nt_off += namelen;
+		/* write the name string into the buffer.
+		 */
+		memcpy(ntp->nt_buf + ntp->nt_off, name, namelen);
+		ntp->nt_off += namelen;
 
-	npp->np_appendoff += ( off64_t )( 1 + namelen );
+		npp->np_appendoff += ( off64_t )( 1 + namelen );
+	}
 	ASSERT( oldoff <= HDLMAX );
 
 #ifdef NAMREGCHK
@@ -321,6 +467,12 @@ namreg_add( char *name, size_t namelen )
 
 #endif /* NAMREGCHK */
 
+	if ( ndp ) {
+		ndp->nd_nrh = nrh;
+		ndp->nd_hash = hash;
+		ndp->nd_len = ( u_int32_t )namelen;
+	}
+
 	return nrh;
 }
 
@@ -371,10 +523,8 @@ namreg_get( nrh_t nrh,
 	    size_t bufsz )
 {
 	off64_t newoff;
-	intgen_t nread;
-	size_t len;
-	static char read_buf[256];
-	/* long enough for the longest allowed name (255), plus 1 for length */
+	intgen_t len;
+	char *namep;
 #ifdef NAMREGCHK
 	nrh_t chkbit;
 #endif /* NAMREGCHK */
@@ -390,15 +540,9 @@ namreg_get( nrh_t nrh,
 
 	/* convert the handle into the offset
 	 */
+	newoff = HDL2OFF( nrh );
 #ifdef NAMREGCHK
-
-	newoff = ( off64_t )( size64_t )CHKGETHDL( nrh );
 	chkbit = CHKGETBIT( nrh );
-
-#else /* NAMREGCHK */
-
-	newoff = ( off64_t )( size64_t )nrh;
-
 #endif /* NAMREGCHK */
 
 	/* do sanity check on offset
@@ -409,49 +553,24 @@ namreg_get( nrh_t nrh,
 
 	lock( );
 
-	if ( ntp->nt_at_endpr && ntp->nt_off ) {
-		if (namreg_flush() != RV_OK) {
-			unlock( );
-			return -3;
-		}
-	}
+	ntp->nt_getcnt++;
 
-	/* seek to the name
-	 */
-	newoff = lseek64( ntp->nt_fd, newoff, SEEK_SET );
-	if ( newoff == ( off64_t )-1 ) {
-		unlock( );
-		mlog( MLOG_NORMAL, _(
-		      "lseek of namreg failed: %s\n"),
-		      strerror( errno ));
-		return -3;
-	}
-
-	/* read the name length and the name itself in one call
-	 * NOTE: assumes read_buf is big enough for the longest
-	 * allowed name (255 chars) plus one byte for length.
-	 */
-	nread = read( ntp->nt_fd, ( void * )read_buf, sizeof(read_buf) );
-	if ( nread <= 0 ) {
+	len = namreg_getname( newoff, &namep );
+	if ( len < 0 ) {
 		unlock( );
-		mlog( MLOG_NORMAL, _(
-		      "read of namreg failed: %s (nread = %d)\n"),
-		      strerror( errno ),
-		      nread );
-		return -3;
+		return len;
 	}
 
 	/* deal with a short caller-supplied buffer
 	 */
-	len = ( size_t )read_buf[0];
-	if ( bufsz < len + 1 ) {
+	if ( bufsz < ( size_t )len + 1 ) {
 		unlock( );
 		return -1;
 	}
 
 	/* copy the name into the caller-supplied buffer.
 	 */
-	strncpy(bufp, read_buf+1, len);
+	memcpy( bufp, namep, ( size_t )len );
 
 #ifdef NAMREGCHK
 
@@ -467,12 +586,227 @@ namreg_get( nrh_t nrh,
 	 */
 	bufp[ len ] = 0;
 
-	ntp->nt_at_endpr = BOOL_FALSE;
-	
 	unlock( );
 
-	return ( intgen_t )len;
+	return len;
+}
+
+size64_t
+namreg_getnum_gets( void )
+{
+	return ntp ? ntp->nt_getcnt : 0;
 }
 
 
 /* definition of locally defined static functions ****************************/
+
+/* appends a front-coded record for the name to the buffer. caller has
+ * made room for the worst case, a name stored whole.
+ */
+static void
+namreg_addfront( char *name, size_t namelen )
+{
+	u_char_t *hdrp;
+	size_t prelen;
+	size_t suflen;
+	off64_t backoff;
+
+	/* close the current block if full
+	 */
+	if ( npp->np_blkcnt >= NAMREG_BLKCNT
+	     ||
+	     npp->np_appendoff - npp->np_blkoff > ( off64_t )NAMREG_BLKSZ ) {
+		npp->np_blkoff = npp->np_appendoff;
+		npp->np_blkcnt = 0;
+	}
+	backoff = npp->np_appendoff - npp->np_blkoff;
+	ASSERT( backoff <= ( off64_t )NAMREG_BLKSZ );
+
+	/* share what we can with the previous name in the block
+	 */
+	prelen = 0;
+	if ( npp->np_blkcnt ) {
+		size_t maxlen = min( namelen, npp->np_prevlen );
+		while ( prelen < maxlen
+			&&
+			name[ prelen ] == npp->np_prevname[ prelen ] ) {
+			prelen++;
+		}
+	}
+	suflen = namelen - prelen;
+
+	hdrp = ( u_char_t * )ntp->nt_buf + ntp->nt_off;
+	hdrp[ FC_PRELEN ] = ( u_char_t )prelen;
+	hdrp[ FC_SUFLEN ] = ( u_char_t )suflen;
+	hdrp[ FC_BACKHI ] = ( u_char_t )( backoff >> NBBY );
+	hdrp[ FC_BACKLO ] = ( u_char_t )( backoff & 0xff );
+	memcpy( ntp->nt_buf + ntp->nt_off + FC_HDRSZ, name + prelen, suflen );
+	ntp->nt_off += FC_HDRSZ + suflen;
+	npp->np_appendoff += ( off64_t )( FC_HDRSZ + suflen );
+
+	memcpy( npp->np_prevname, name, namelen );
+	npp->np_prevlen = namelen;
+	npp->np_blkcnt++;
+}
+
+/* reads registry bytes, whether already written or still in the append
+ * buffer. returns the number of bytes read, short at the end of the
+ * registry, or -1 if the read fails.
+ */
+static intgen_t
+namreg_read( off64_t off, char *bufp, size_t len )
+{
+	off64_t bufoff;
+	size_t cnt;
+
+	bufoff = npp->np_appendoff - ( off64_t )ntp->nt_off;
+	if ( off + ( off64_t )len > npp->np_appendoff ) {
+		len = ( size_t )( npp->np_appendoff - off );
+	}
+
+	cnt = 0;
+	if ( off < bufoff ) {
+		ssize_t nread;
+
+		cnt = min( len, ( size_t )( bufoff - off ));
+		nread = pread64( ntp->nt_fd, ( void * )bufp, cnt, off );
+		if ( nread < 0 ) {
+			return -1;
+		}
+		if ( ( size_t )nread < cnt ) {
+			return ( intgen_t )nread;
+		}
+	}
+	if ( cnt < len ) {
+		memcpy( bufp + cnt,
+			ntp->nt_buf + ( size_t )( off + ( off64_t )cnt - bufoff ),
+			len - cnt );
+		cnt = len;
+	}
+
+	return ( intgen_t )cnt;
+}
+
+/* retrieves the name whose record begins at off. points *namep at a
+ * static copy, not null-terminated, and returns its length; returns -3
+ * if the registry can't be read. caller must hold the lock.
+ */
+static intgen_t
+namreg_getname( off64_t off, char **namep )
+{
+	static char read_buf[ NAMREG_READSZ ];
+	static char name_buf[ NAME_MAX + 1 ];
+	u_char_t *hdrp;
+	off64_t backoff;
+	size_t len;
+	intgen_t nread;
+	char *p;
+
+	/* a plain record is the length and the name
+	 */
+	if ( npp->np_fmt != NAMREG_FMT_FRONT ) {
+		nread = namreg_read( off, read_buf, NAME_MAX + 1 );
+		if ( nread <= 0 ) {
+			mlog( MLOG_NORMAL, _(
+			      "read of namreg failed: %s (nread = %d)\n"),
+			      strerror( errno ),
+			      nread );
+			return -3;
+		}
+		len = ( size_t )( u_char_t )read_buf[ 0 ];
+		ASSERT( ( intgen_t )len < nread );
+		*namep = read_buf + 1;
+		return ( intgen_t )len;
+	}
+
+	/* a front-coded name is rebuilt from the first record of its
+	 * block up to its own
+	 */
+	nread = namreg_read( off, read_buf, FC_HDRSZ );
+	if ( nread < FC_HDRSZ ) {
+		mlog( MLOG_NORMAL, _(
+		      "read of namreg failed: %s (nread = %d)\n"),
+		      strerror( errno ),
+		      nread );
+		return -3;
+	}
+	hdrp = ( u_char_t * )read_buf;
+	backoff = ( ( off64_t )hdrp[ FC_BACKHI ] << NBBY )
+		  |
+		  ( off64_t )hdrp[ FC_BACKLO ];
+	ASSERT( backoff <= ( off64_t )NAMREG_BLKSZ );
+	ASSERT( backoff <= off - ( off64_t )NAMREG_PERS_SZ );
+
+	nread = namreg_read( off - backoff,
+			     read_buf,
+			     ( size_t )backoff + NAMREG_RECMAX );
+	if ( nread < ( intgen_t )backoff + FC_HDRSZ ) {
+		mlog( MLOG_NORMAL, _(
+		      "read of namreg failed: %s (nread = %d)\n"),
+		      strerror( errno ),
+		      nread );
+		return -3;
+	}
+
+	len = 0;
+	for ( p = read_buf ; ; ) {
+		size_t prelen;
+		size_t suflen;
+
+		hdrp = ( u_char_t * )p;
+		prelen = ( size_t )hdrp[ FC_PRELEN ];
+		suflen = ( size_t )hdrp[ FC_SUFLEN ];
+		if ( prelen > len
+		     ||
+		     p + FC_HDRSZ + suflen > read_buf + nread ) {
+			mlog( MLOG_NORMAL | MLOG_ERROR, _(
+			      "corrupt name registry record at %lld\n"),
+			      ( long long )( off - backoff + ( p - read_buf )));
+			return -3;
+		}
+		memcpy( name_buf + prelen, p + FC_HDRSZ, suflen );
+		len = prelen + suflen;
+		if ( p == read_buf + backoff ) {
+			break;
+		}
+		p += FC_HDRSZ + suflen;
+		ASSERT( p <= read_buf + backoff );
+	}
+
+	*namep = name_buf;
+	return ( intgen_t )len;
+}
+
+/* returns TRUE if the registered name is the given name
+ */
+static bool_t
+namreg_match( nrh_t nrh, char *name, size_t namelen )
+{
+	char *regnamep;
+	intgen_t reglen;
+	bool_t matchpr;
+
+	lock( );
+	reglen = namreg_getname( HDL2OFF( nrh ), &regnamep );
+	matchpr = reglen == ( intgen_t )namelen
+		  &&
+		  ! memcmp( regnamep, name, namelen );
+	unlock( );
+
+	return matchpr;
+}
+
+/* FNV-1a over the name
+ */
+static inline u_int32_t
+namreg_hash( char *name, size_t namelen )
+{
+	u_int32_t val = 2166136261U;
+	size_t ix;
+
+	for ( ix = 0 ; ix < namelen ; ix++ ) {
+		val ^= ( u_char_t )name[ ix ];
+		val *= 16777619U;
+	}
+	return val;
+}
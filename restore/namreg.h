@@ -24,10 +24,11 @@
  * name.
  */
 
-/* nrh_t - handle to a registered name
+/* nrh_t - handle to a registered name. only the low bits set by
+ * namreg_sethdlbits( ) are ever used.
  */
-typedef size32_t nrh_t;
-#define NRH_NULL	SIZE32MAX
+typedef size64_t nrh_t;
+#define NRH_NULL	SIZE64MAX
 
 
 /* namreg_init - creates the name registry. resync is TRUE if the
@@ -39,8 +40,15 @@ extern bool_t namreg_init( char *housekeepingdir,
 			   u_int64_t inocnt );
 
 
+/* namreg_sethdlbits - sets the number of bits the user can store for a
+ * handle. namreg_add( ) fails once the registry outgrows it. defaults
+ * to 32; retained across a resync.
+ */
+extern void namreg_sethdlbits( size_t hdlbits );
+
+
 /* namreg_add - registers a name. name does not need to be null-terminated.
- * returns handle for use with namreg_get().
+ * returns handle for use with namreg_get(), or NRH_NULL on failure.
  */
 extern nrh_t namreg_add( char *name, size_t namelen );
 
@@ -61,4 +69,9 @@ extern rv_t namreg_flush( void );
  */
 extern intgen_t namreg_get( nrh_t nrh, char *bufp, size_t bufsz );
 
+/* namreg_getnum_gets - returns the number of namreg_get calls made by
+ * this process, for statistics.
+ */
+extern size64_t namreg_getnum_gets( void );
+
 #endif /* NAMREG_H */
@@ -36,8 +36,11 @@
 extern size_t pgsz;
 extern size_t pgmask;
 
-/* node handle limits
+/* node handle limits. the user tells node_init how many bits of a
+ * handle it can store; all limits are relative to that.
  */
+#define HDLBITS			( node_hdrp->nh_hdlbits )
+
 #ifdef NODECHK
 
 /* macros for manipulating node handles when handle consistency
@@ -45,22 +48,23 @@ extern size_t pgmask;
  * with the node gen count, described below.
  */
 #define HDLGENCNT		4
-#define	HDLGENSHIFT		( NBBY * sizeof ( nh_t ) - HDLGENCNT )
+#define	HDLGENSHIFT		( HDLBITS - HDLGENCNT )
 #define	HDLGENLOMASK		( ( 1 << HDLGENCNT ) - 1 )
-#define	HDLGENMASK		( HDLGENLOMASK << HDLGENSHIFT )
+#define	HDLGENMASK		( ( nh_t )HDLGENLOMASK << HDLGENSHIFT )
 #define HDLNIXCNT		HDLGENSHIFT
-#define HDLNIXMASK		( ( 1 << HDLNIXCNT ) - 1 )
+#define HDLNIXMASK		( ( ( nh_t )1 << HDLNIXCNT ) - 1 )
 #define HDLGETGEN( h )		( ( u_char_t )				\
-				  ( ( ( int )h >> HDLGENSHIFT )		\
+				  ( ( ( nh_t )h >> HDLGENSHIFT )	\
 				    &					\
 				    HDLGENLOMASK ))
-#define HDLGETNIX( h )		( ( nix_t )( ( int )h & HDLNIXMASK ))
-#define HDLMKHDL( g, n )	( ( nh_t )( ( ( ( int )g << HDLGENSHIFT )\
+#define HDLGETNIX( h )		( ( nix_t )( ( nh_t )h & HDLNIXMASK ))
+#define HDLMKHDL( g, n )	( ( nh_t )( ( ( ( nh_t )g << HDLGENSHIFT )\
 					      &				\
 					      HDLGENMASK )		\
 					  |				\
-					  ( ( int )n & HDLNIXMASK )))
-#define NIX_MAX			( ( off64_t )HDLNIXMASK )
+					  ( ( nh_t )n & HDLNIXMASK )))
+#define NIX_MAX			( ( off64_t )HDLNIXMASK - ( off64_t )1 )
+				/* 1 so a stored handle is never all ones */
 
 /* the housekeeping byte of each node will hold two check fields:
  * a gen count, initialized to the node ix and incremented each time a node
@@ -97,9 +101,7 @@ extern size_t pgmask;
 
 #define NIX_MAX			( ( ( off64_t )1			\
 				    <<					\
-				    ( ( off64_t )NBBY			\
-				      *					\
-				      ( off64_t )sizeof( nh_t )))	\
+				    ( off64_t )HDLBITS )		\
 				  -					\
 				  ( off64_t )2 ) /* 2 to avoid NH_NULL */
 
@@ -176,12 +178,19 @@ struct node_hdr {
 		 * free list. never reaches nh_nodesperseg: instead set
 		 * to zero and bump nh_virgsegreloff by one segment.
 		 */
+	size_t nh_hdlbits;
+		/* number of handle bits the user can store. zero in
+		 * state left by a release without this field: 32.
+		 */
 };
 
 typedef struct node_hdr node_hdr_t;
 
 static node_hdr_t *node_hdrp;
 static intgen_t node_fd;
+static size64_t node_alloccnt;
+	/* number of node_alloc calls made by this process
+	 */
 
 /* ARGSUSED */
 bool_t
@@ -191,7 +200,8 @@ node_init( intgen_t fd,
 	   ix_t nodehkix,
 	   size_t nodealignsz,
 	   size64_t vmsz,
-	   size64_t dirs_nondirs_cnt )
+	   size64_t dirs_nondirs_cnt,
+	   size_t hdlbits )
 {
 	size64_t nodesz;
 	size64_t winmap_mem;
@@ -205,7 +215,8 @@ node_init( intgen_t fd,
 	/* sanity checks
 	 */
 	ASSERT( sizeof( node_hdr_t ) <= NODE_HDRSZ );
-	ASSERT( sizeof( nh_t ) < sizeof( off64_t ));
+	ASSERT( hdlbits <= NBBY * sizeof( nh_t ));
+	ASSERT( hdlbits < NBBY * sizeof( off64_t ));
 	ASSERT( nodehkix < usrnodesz );
 	ASSERT( usrnodesz >= sizeof( char * ) + 1 );
 		/* so node is at least big enough to hold
@@ -282,6 +293,7 @@ node_init( intgen_t fd,
 	node_hdrp->nh_firstsegoff = off + ( off64_t )NODE_HDRSZ;
 	node_hdrp->nh_virgsegreloff = 0;
 	node_hdrp->nh_virgrelnix = 0;
+	node_hdrp->nh_hdlbits = hdlbits;
 
 	/* save transient context
 	 */
@@ -323,12 +335,14 @@ node_init( intgen_t fd,
 	      " segtblsz = %llu (0x%llx)"
 	      " nodesperseg = %u (0x%x)"
 	      " winmapmax = %llu (0x%llx)"
+	      " hdlbits = %u"
 	      "\n",
 	      vmsz, vmsz,
 	      segsz, segsz,
 	      segtablesz, segtablesz,
 	      nodesperseg, nodesperseg,
-	      winmapmax, winmapmax );
+	      winmapmax, winmapmax,
+	      ( unsigned int )hdlbits );
 
 	return BOOL_TRUE;
 }
@@ -356,6 +370,9 @@ node_sync( intgen_t fd, off64_t off )
 		      strerror( errno ));
 		return BOOL_FALSE;
 	}
+	if ( ! node_hdrp->nh_hdlbits ) {
+		node_hdrp->nh_hdlbits = NBBY * sizeof( size32_t );
+	}
 
 	/* save transient context
 	 */
@@ -492,9 +509,16 @@ node_alloc( void )
 	}
 
 	/* map in window containing node at top of free list,
-	 * and adjust free list.
+	 * and adjust free list. refuse if its handle won't fit in
+	 * the bits the user stores.
 	 */
 	nix = node_hdrp->nh_freenix;
+	if ( nix > NIX_MAX ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_TREE, _(
+		      "node pool exceeds %u bit handle limit\n"),
+		      ( unsigned int )node_hdrp->nh_hdlbits );
+		return NH_NULL;
+	}
 #ifdef TREE_DEBUG
 	mlog(MLOG_DEBUG | MLOG_TREE,
 	   "node_alloc(): win_map(%llu) and get head from node freelist\n",
@@ -536,9 +560,17 @@ node_alloc( void )
 #endif
 	win_unmap( NIX2OFF( nix ), ( void ** )&p );
 
+	node_alloccnt++;
+
 	return nh;
 }
 
+size64_t
+node_getnum_allocs( void )
+{
+	return node_alloccnt;
+}
+
 void *
 node_map( nh_t nh )
 {
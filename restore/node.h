@@ -23,11 +23,16 @@
  * operators alloc, free, map, and unmap nodes.
  */
 
-typedef size32_t nh_t;
-#define NH_NULL	SIZE32MAX
+/* nh_t - node handle. only the low hdlbits bits (see node_init) are ever
+ * used, so the user may store handles in fewer bits than an nh_t.
+ */
+typedef size64_t nh_t;
+#define NH_NULL	SIZE64MAX
 
 /* node_init - creates a new node abstraction.
- * user reserves one byte per node for use by the node abstraction
+ * user reserves one byte per node for use by the node abstraction.
+ * hdlbits is the number of bits the user can store for a handle; node
+ * allocation fails once the pool outgrows it.
  */
 extern bool_t node_init( intgen_t fd,		/* backing store */
 		         off64_t off,		/* offset into backing store */
@@ -35,7 +40,8 @@ extern bool_t node_init( intgen_t fd,		/* backing store */
 		         ix_t nodehkix,		/* my housekeeping byte */
 		         size_t alignsz,	/* node alignment requirement */
 		         size64_t vmsz,		/* abstractions's share of VM */
-		         size64_t dir_nondir);	/* num of dirs + nondirs */
+		         size64_t dir_nondir,	/* num of dirs + nondirs */
+		         size_t hdlbits );	/* bits per stored handle */
 
 /* node_sync - syncs up with existing node abstraction persistent state
  */
@@ -61,4 +67,9 @@ extern void node_unmap( nh_t node_handle, void **nodepp );
  */
 extern void node_free( nh_t *node_handlep );
 
+/* node_getnum_allocs - returns the number of nodes allocated by this
+ * process, for statistics.
+ */
+extern size64_t node_getnum_allocs( void );
+
 #endif /* NODE_H */
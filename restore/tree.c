@@ -60,6 +60,10 @@
  */
 #define PERS_NAME	"tree"
 
+/* name of the name hash index file (see namhash abstraction)
+ */
+#define NAMHASH_NAME	"namhash"
+
 /* orphanage specifics. ino must be otherwise unused in the dump source fs.
  * zero works.
  */
@@ -71,9 +75,21 @@
  */
 #define HASHSZ_PERVM	16
 
-/* reserve the first page for persistent state
+/* reserve the first page for persistent state. bump TREE_PERS_VERS
+ * whenever the layout of the state or of the nodes changes: tree_sync( )
+ * refuses state written in any other.
  */
+#define TREE_PERS_MAGIC	0x74726565	/* "tree" */
+#define TREE_PERS_VERS	1
+
 struct treePersStorage {
+	u_int32_t p_magic;
+		/* TREE_PERS_MAGIC. state left by a restore without this
+		 * field has the root ino here instead
+		 */
+	u_int32_t p_version;
+		/* TREE_PERS_VERS of the restore which created the state
+		 */
 	xfs_ino_t p_rootino;
 		/* ino of root
 		 */
@@ -102,6 +118,20 @@ struct treePersStorage {
 	bool_t p_restoredmpr;
 		/* restore DMI event settings
 		 */
+	bool_t p_namhashpr;
+		/* name hash index is in use. FALSE in state left by a
+		 * restore without one; lookups then walk the sibling lists.
+		 */
+	size64_t p_namhashsz;
+		/* size of name hash array (private to namhash abstraction)
+		 */
+	size_t p_namhashmask;
+		/* name hash mask (private to namhash abstraction)
+		 */
+	bool_t p_widepr;
+		/* nodes, ino hash and name hash hold wide handles. FALSE
+		 * in state left by a restore without this field.
+		 */
 };
 
 typedef struct treePersStorage treepers_t;
@@ -121,6 +151,62 @@ struct inter {
 
 typedef struct inter inter_t;
 
+/* node structure. each node represents a directory entry. the node and
+ * name handles are not fields: the housekeeping files hold them in one
+ * of two widths (see tree_init), so they are read and written with
+ * Node_geth( ) and Node_seth( ), indexed by the N_ values below.
+ * Node_map( ) hands out the node in place in both formats.
+ */
+#define N_NRH		0	/* handle to name in name registry */
+#define N_HASHH		1	/* hash array */
+#define N_PARH		2	/* parent */
+#define N_SIBH		3	/* sibling list */
+#define N_SIBPREVH	4	/* prev sibling list - dbl link list */
+#define N_CLDH		5	/* children list */
+#define N_LNKH		6	/* hard link list */
+#define N_NAMHASHH	7	/* name hash list */
+#define N_HDLCNT	8
+
+/* compact node format: 32 bit node and name handles. used unless the
+ * dump's inode counts say the handles could run out (see tree_init).
+ */
+#define NODESZ_COMPACT	48
+#define HDLBITS_COMPACT	32
+
+struct node {
+	xfs_ino_t n_ino;		/*  8  8 ino */
+	dah_t n_dah;			/*  4 12 handle to directory attributes */
+	gen_t n_gen;			/*  2 14 generation count mod 0x10000 */
+	u_char_t n_flags;		/*  1 15 action and state flags */
+	u_char_t n_nodehkbyte;		/*  1 16 given to node abstraction */
+	size32_t n_hdllo[ N_HDLCNT ];	/* 32 48 handles, low bits */
+};
+
+typedef struct node node_t;
+
+/* wide node format: 48 bit node and name handles. the compact node
+ * holds the low 32 bits, followed by the high 16 bits, so the node
+ * fills exactly one 64 byte cache line. dirattr handles index
+ * directories only and stay 32 bits.
+ */
+#define NODESZ_WIDE	64
+#define HDLBITS_WIDE	48
+
+struct node48 {
+	node_t n48_node;			/* 48 48 compact part */
+	u_int16_t n48_hdlhi[ N_HDLCNT ];	/* 16 64 handles, high bits */
+};
+
+typedef struct node48 node48_t;
+
+/* choose the wide format when a dump has more than this many dirs
+ * and nondirs. the node handles would still fit, but at an average
+ * name length of 64 the name registry would outgrow 32 bit handles,
+ * and a cumulative restore keeps adding names to it.
+ */
+#define WIDE_ENTCNT	( ( size64_t )1 << 26 )
+
+
 /* transient state
  */
 struct tran {
@@ -147,9 +233,15 @@ struct tran {
 	intgen_t t_persfd;
 		/* file descriptor of the persistent state file
 		 */
-	nh_t *t_hashp;
+	void *t_hashp;
 		/* pointer to mapped hash array (private to hash abstraction)
 		 */
+	intgen_t t_namhashfd;
+	void *t_namhashp;
+		/* file descriptor and mapping of the name hash array
+		 * (private to namhash abstraction). mapping is NULL
+		 * if the index is not in use.
+		 */
 	char t_namebuf[ NAME_MAX + 1 ];
 		/* to hold names temporarily retrieved from name registry
 		 */
@@ -160,29 +252,6 @@ struct tran {
 
 typedef struct tran tran_t;
 
-
-/* node structure. each node represents a directory entry
- */
-#define NODESZ	48
-
-struct node {
-	xfs_ino_t n_ino;		/* 8  8 ino */
-	nrh_t n_nrh;		/* 4 12 handle to name in name registry */
-	dah_t n_dah;		/* 4 16 handle to directory attributes */
-	nh_t n_hashh;		/* 4 20 hash array */
-	nh_t n_parh;		/* 4 24 parent */
-	nh_t n_sibh;		/* 4 28 sibling list */
-	nh_t n_sibprevh;	/* 4 32 prev sibling list - dbl link list */
-	nh_t n_cldh;		/* 4 36 children list */
-	nh_t n_lnkh;		/* 4 40 hard link list */
-	gen_t n_gen;		/* 2 42 generation count mod 0x10000 */
-	u_char_t n_flags;	/* 1 43 action and state flags */
-	u_char_t n_nodehkbyte;	/* 1 44 given to node abstraction */
-	int32_t pad;		/* 4 48 padding to 8 byte boundary */
-};
-
-typedef struct node node_t;
-
 #define NF_REAL		( 1 << 0 )
 	/* set when the corresponding file/dir has been created in
 	 * the restore destination.
@@ -255,8 +324,12 @@ static nh_t Node_alloc( xfs_ino_t ino,
 static void Node_free( nh_t *nhp );
 static node_t * Node_map( nh_t nh );
 static void Node_unmap( nh_t nh, node_t **npp );
+static inline nh_t Node_geth( node_t *np, ix_t hix );
+static inline void Node_seth( node_t *np, ix_t hix, nh_t hdl );
+static inline size32_t hdl_pack32( size64_t hdl );
+static inline size64_t hdl_unpack32( size32_t hdl );
 static intgen_t Node2path_recurse( nh_t nh, char *buf, intgen_t bufsz );
-static void adopt( nh_t parh, nh_t cldh, nrh_t nrh );
+static void adopt( nh_t parh, nh_t cldh, nrh_t nrh, char *name );
 static nrh_t disown( nh_t cldh );
 static void selsubtree( nh_t nh, bool_t sensepr );
 static void selsubtree_recurse_down( nh_t nh, bool_t sensepr );
@@ -276,12 +349,22 @@ static bool_t hash_init( size64_t vmsz,
 			 size64_t nondircnt,
 			 char *perspath );
 static bool_t hash_sync( char *perspath );
+static inline nh_t hashent_get( void *arrayp, size64_t hix );
+static inline void hashent_set( void *arrayp, size64_t hix, nh_t nh );
 static inline size_t hash_val(xfs_ino_t ino, size_t hashmask);
 static void hash_in( nh_t nh );
 static void hash_out( nh_t nh );
 static nh_t hash_find( xfs_ino_t ino, gen_t gen );
 static void hash_iter( bool_t ( * cbfp )( void *contextp, nh_t hashh ),
 		       void *contextp );
+static bool_t namhash_init( size64_t vmsz,
+			    size64_t dircnt,
+			    size64_t nondircnt );
+static bool_t namhash_sync( void );
+static inline size_t namhash_val( nh_t parh, char *name, size_t hashmask );
+static void namhash_in( nh_t nh, char *name );
+static void namhash_out( nh_t nh );
+static nh_t namhash_find( nh_t parh, char *name, nh_t likeh );
 static void setdirattr( dah_t dah, char *path );
 static bool_t tsi_walkpath( char *arg, nh_t rooth, nh_t cwdh,
 			    dlog_pcbp_t pcb, void *pctxp,
@@ -338,7 +421,8 @@ tree_init( char *hkdir,
 	 */
 	ASSERT( ! ( PERSSZ % pgsz ));
 	ASSERT( sizeof( persp ) <= PERSSZ );
-	ASSERT( sizeof( node_t ) <= NODESZ );
+	ASSERT( sizeof( node_t ) == NODESZ_COMPACT );
+	ASSERT( sizeof( node48_t ) == NODESZ_WIDE );
 	ASSERT( ! persp );
 	ASSERT( ! tranp );
 
@@ -422,6 +506,17 @@ tree_init( char *hkdir,
 		      strerror( errno ));
 		return BOOL_FALSE;
 	}
+	persp->p_magic = TREE_PERS_MAGIC;
+	persp->p_version = TREE_PERS_VERS;
+
+	/* choose the node format. the hash arrays and the name registry
+	 * size their handles to match, so this must precede them.
+	 */
+	persp->p_widepr = ( dircnt + nondircnt > WIDE_ENTCNT );
+	namreg_sethdlbits( persp->p_widepr ? HDLBITS_WIDE : HDLBITS_COMPACT );
+	mlog( MLOG_DEBUG | MLOG_TREE,
+	      "using %s housekeeping node format\n",
+	      persp->p_widepr ? "wide" : "compact" );
 
 	/* create the hash abstraction. it will map more of the
 	 * persistent state file.
@@ -431,20 +526,40 @@ tree_init( char *hkdir,
 		return BOOL_FALSE;
 	}
 
+	/* create the name hash abstraction. it maps a file of its own,
+	 * and gets the same share of vm as the ino hash. failure just
+	 * leaves the index out.
+	 */
+	( void )namhash_init( vmsz / HASHSZ_PERVM, dircnt, nondircnt );
+
 	/* initialize the node abstraction. let it's use of backing store
 	 * begin immediately after the hash abstraction. give it the remainder
 	 * of vm.
 	 */
 	ASSERT( persp->p_hashsz <= ( size64_t )( OFF64MAX - ( off64_t )PERSSZ));
 	nodeoff = ( off64_t )PERSSZ + ( off64_t )persp->p_hashsz;
-	ASSERT( vmsz > ( size64_t )nodeoff );
-	ok = node_init( tranp->t_persfd, 
-		        nodeoff,
-		        NODESZ,
-			 ( ix_t )offsetofmember( node_t, n_nodehkbyte ),
-		        sizeof( size64_t ), /* node alignment */
-		        vmsz - ( size64_t )nodeoff,
-			dircnt + nondircnt );
+	ASSERT( vmsz > ( size64_t )nodeoff + persp->p_namhashsz );
+	if ( persp->p_widepr ) {
+		ok = node_init( tranp->t_persfd,
+				nodeoff,
+				NODESZ_WIDE,
+				( ix_t )offsetofmember( node_t,
+							n_nodehkbyte ),
+				sizeof( size64_t ), /* node alignment */
+				vmsz - ( size64_t )nodeoff - persp->p_namhashsz,
+				dircnt + nondircnt,
+				HDLBITS_WIDE );
+	} else {
+		ok = node_init( tranp->t_persfd,
+				nodeoff,
+				NODESZ_COMPACT,
+				( ix_t )offsetofmember( node_t,
+							n_nodehkbyte ),
+				sizeof( size64_t ), /* node alignment */
+				vmsz - ( size64_t )nodeoff - persp->p_namhashsz,
+				dircnt + nondircnt,
+				HDLBITS_COMPACT );
+	}
 	if ( ! ok ) {
 		return BOOL_FALSE;
 	}
@@ -474,7 +589,7 @@ tree_init( char *hkdir,
 	if (persp->p_orphh == NH_NULL)
 		return BOOL_FALSE;
 	link_in( persp->p_orphh );
-	adopt( persp->p_rooth, persp->p_orphh, NRH_NULL );
+	adopt( persp->p_rooth, persp->p_orphh, NRH_NULL, 0 );
 
 	/* record if we should attempt to restore original owner/group
 	 */
@@ -513,7 +628,8 @@ tree_sync( char *hkdir,
 	 */
 	ASSERT( ! ( PERSSZ % pgsz ));
 	ASSERT( sizeof( persp ) <= PERSSZ );
-	ASSERT( sizeof( node_t ) <= NODESZ );
+	ASSERT( sizeof( node_t ) == NODESZ_COMPACT );
+	ASSERT( sizeof( node48_t ) == NODESZ_WIDE );
 	ASSERT( ! persp );
 	ASSERT( ! tranp );
 
@@ -585,6 +701,23 @@ tree_sync( char *hkdir,
 		return BOOL_FALSE;
 	}
 
+	/* the handles and nodes have changed size over time: misreading
+	 * them would corrupt the restore, so give up on any other format
+	 */
+	if ( persp->p_magic != TREE_PERS_MAGIC
+	     ||
+	     persp->p_version != TREE_PERS_VERS ) {
+		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_TREE, _(
+		      "%s was written by an incompatible version of "
+		      "xfsrestore (format %u, expected %u): "
+		      "remove the housekeeping directory and restart "
+		      "the restore\n"),
+		      perspath,
+		      persp->p_magic == TREE_PERS_MAGIC ? persp->p_version : 0,
+		      TREE_PERS_VERS );
+		return BOOL_FALSE;
+	}
+
 	/* update the fullpr field of the persistent state to match
 	 * the input of our caller.
 	 */
@@ -598,6 +731,12 @@ tree_sync( char *hkdir,
 		return BOOL_FALSE;
 	}
 
+	/* re-map the name hash index, if the previous session had one
+	 */
+	if ( persp->p_namhashpr ) {
+		( void )namhash_sync( );
+	}
+
 	/* synchronize with the node abstraction.
 	 */
 	ASSERT( persp->p_hashsz <= ( size64_t )( OFF64MAX - ( off64_t )PERSSZ));
@@ -648,7 +787,7 @@ tree_marknoref_recurse( nh_t parh )
 		parp->n_flags &= ~( NF_REFED | NF_DUMPEDDIR | NF_NEWORPH );
 
 		parp->n_dah = DAH_NULL;
-		cldh = parp->n_cldh;
+		cldh = Node_geth( parp, N_CLDH );
 		Node_unmap( parh, &parp  );
 	}
 	while ( cldh != NH_NULL ) {
@@ -656,7 +795,7 @@ tree_marknoref_recurse( nh_t parh )
 		nh_t nextcldh;
 		tree_marknoref_recurse( cldh ); /* RECURSION */
 		cldp = Node_map( cldh );
-		nextcldh = cldp->n_sibh;
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp  );
 		cldh = nextcldh;
 	}
@@ -753,7 +892,7 @@ tree_begindir( filehdr_t *fhdrp, dah_t *dahp )
 		if (hardh == NH_NULL)
 			return NH_NULL;
 		link_in( hardh );
-		adopt( persp->p_orphh, hardh, NRH_NULL );
+		adopt( persp->p_orphh, hardh, NRH_NULL, 0 );
 		*dahp = dah;
 	}
 
@@ -808,47 +947,49 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 			intgen_t namebuflen; 
 
 			hardp->n_flags |= NF_REFED;
-			if ( hardp->n_parh == persp->p_orphh ) {
+			if ( Node_geth( hardp, N_PARH ) == persp->p_orphh ) {
 				/* dir now seen as entry
 				 * if in orph but REAL, must be pending rename
 				 */
 				if ( ( hardp->n_flags & NF_REAL )
 				     &&
-				     hardp->n_lnkh == NH_NULL ) {
-					hardp->n_lnkh = Node_alloc( ino,
-								    gen,
-								    NRH_NULL,
-								    DAH_NULL,
-								    0 );
-					if (hardp->n_lnkh == NH_NULL)
+				     Node_geth( hardp, N_LNKH ) == NH_NULL ) {
+					Node_seth( hardp,
+						   N_LNKH,
+						   Node_alloc( ino,
+							       gen,
+							       NRH_NULL,
+							       DAH_NULL,
+							       0 ));
+					if (Node_geth( hardp, N_LNKH ) == NH_NULL)
 						return RV_ERROR;
 				}
-				if ( hardp->n_lnkh != NH_NULL ) {
+				if ( Node_geth( hardp, N_LNKH ) != NH_NULL ) {
 					ASSERT( hardp->n_flags & NF_REAL );
-					renameh = hardp->n_lnkh;
+					renameh = Node_geth( hardp, N_LNKH );
 					renamep = Node_map( renameh );
-					if ( renamep->n_parh == NH_NULL ) {
+					if ( Node_geth( renamep, N_PARH ) == NH_NULL ) {
 						mlog( MLOG_DEBUG | MLOG_TREE,
 						      "dirent %s %llu %u: "
 						      "adopting (dir par)\n",
 						      name,
 						      ino,
 						      gen );
-						renamep->n_parh = parh;
+						Node_seth( renamep, N_PARH, parh );
 					}
-					if ( renamep->n_parh != parh ) {
+					if ( Node_geth( renamep, N_PARH ) != parh ) {
 						mlog( MLOG_DEBUG | MLOG_TREE,
 						      "dirent %s %llu %u: "
 						      "re-adopting (dir par)\n",
 						      name,
 						      ino,
 						      gen );
-						renamep->n_parh = parh;
+						Node_seth( renamep, N_PARH, parh );
 					}
-					if ( renamep->n_nrh != NRH_NULL ) {
+					if ( Node_geth( renamep, N_NRH ) != NRH_NULL ) {
 						namebuflen
 						=
-						namreg_get( renamep->n_nrh,
+						namreg_get( Node_geth( renamep, N_NRH ),
 							    tranp->t_namebuf,
 						    sizeof( tranp->t_namebuf ));
 						ASSERT( namebuflen > 0 );
@@ -867,28 +1008,29 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 							      gen,
 							     tranp->t_namebuf );
 							namreg_del(
-							       renamep->n_nrh );
-							renamep->n_nrh =
-								       NRH_NULL;
+							       Node_geth( renamep, N_NRH ) );
+							Node_seth( renamep, N_NRH, NRH_NULL );
 						}
 					}
-					if ( renamep->n_nrh == NRH_NULL ) {
-						renamep->n_nrh
-						=
-						namreg_add( name, namelen );
-						renamep->n_parh = parh;
+					if ( Node_geth( renamep, N_NRH ) == NRH_NULL ) {
+						Node_seth( renamep,
+							   N_NRH,
+							   namreg_add( name, namelen ));
+						Node_seth( renamep, N_PARH, parh );
 					}
 					Node_unmap( renameh, &renamep );
 				} else {
 					nrh_t nrh;
 
 					hardp->n_flags &= ~NF_NEWORPH;
-					ASSERT( hardp->n_nrh == NRH_NULL );
-					ASSERT( hardp->n_parh != NH_NULL );
+					ASSERT( Node_geth( hardp, N_NRH ) == NRH_NULL );
+					ASSERT( Node_geth( hardp, N_PARH ) != NH_NULL );
 					nrh = disown( hardh );
 					ASSERT( nrh == NRH_NULL );
 					nrh = namreg_add( name, namelen );
-					adopt( parh, hardh, nrh );
+					if ( nrh == NRH_NULL )
+						return RV_ERROR;
+					adopt( parh, hardh, nrh, name );
 					mlog( MLOG_DEBUG | MLOG_TREE,
 					      "dirent %s %llu %u: "
 					      "updating (dir)\n",
@@ -897,19 +1039,21 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 					      gen );
 				}
 			} else {
-				ASSERT( hardp->n_nrh != NRH_NULL );
+				ASSERT( Node_geth( hardp, N_NRH ) != NRH_NULL );
 				namebuflen
 				=
-				namreg_get( hardp->n_nrh,
+				namreg_get( Node_geth( hardp, N_NRH ),
 					    tranp->t_namebuf,
 					    sizeof( tranp->t_namebuf ));
 				ASSERT( namebuflen > 0 );
-				if ( hardp->n_parh == parh
+				if ( Node_geth( hardp, N_PARH ) == parh
 				     &&
 				     ! strcmp( tranp->t_namebuf, name )) {
 					/* dir seen as entry again
 					 */
-					if ( hardp->n_lnkh != NH_NULL ) {
+					if ( Node_geth( hardp, N_LNKH ) != NH_NULL ) {
+						nh_t renameh = Node_geth( hardp, N_LNKH );
+
 						/* rescind rename
 						 */
 						mlog( MLOG_DEBUG | MLOG_TREE,
@@ -918,7 +1062,8 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 						      name,
 						      ino,
 						      gen );
-						Node_free( &hardp->n_lnkh );
+						Node_free( &renameh );
+						Node_seth( hardp, N_LNKH, renameh );
 					} else {
 						mlog( MLOG_DEBUG | MLOG_TREE,
 						      "dirent %s %llu %u: "
@@ -932,7 +1077,7 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 					 */
 					nh_t renameh;
 					node_t *renamep;
-					if ( hardp->n_lnkh == NH_NULL ) {
+					if ( Node_geth( hardp, N_LNKH ) == NH_NULL ) {
 						renameh = Node_alloc( ino,
 								      gen,
 								      NRH_NULL,
@@ -940,7 +1085,7 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 								      0 );
 						if (renameh == NH_NULL)
 							return RV_ERROR;
-						hardp->n_lnkh = renameh;
+						Node_seth( hardp, N_LNKH, renameh );
 					} else {
 						mlog( MLOG_DEBUG | MLOG_TREE,
 						      "dirent %s %llu %u: "
@@ -948,23 +1093,23 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 						      name,
 						      ino,
 						      gen );
-						renameh = hardp->n_lnkh;
+						renameh = Node_geth( hardp, N_LNKH );
 						renamep = Node_map( renameh );
-						renamep->n_parh = NH_NULL;
-						if ( renamep->n_nrh
+						Node_seth( renamep, N_PARH, NH_NULL );
+						if ( Node_geth( renamep, N_NRH )
 						     !=
 						     NRH_NULL ) {
-						   namreg_del( renamep->n_nrh );
+						   namreg_del( Node_geth( renamep, N_NRH ) );
 						}
-						renamep->n_nrh = NRH_NULL;
+						Node_seth( renamep, N_NRH, NRH_NULL );
 						Node_unmap( renameh, &renamep );
 					}
 					renamep = Node_map( renameh );
-					ASSERT( hardp->n_parh != NH_NULL );
-					if ( hardp->n_parh != parh ) {
+					ASSERT( Node_geth( hardp, N_PARH ) != NH_NULL );
+					if ( Node_geth( hardp, N_PARH ) != parh ) {
 						/* different parent
 						 */
-						renamep->n_parh = parh;
+						Node_seth( renamep, N_PARH, parh );
 						mlog( MLOG_DEBUG | MLOG_TREE,
 						      "dirent %s %llu %u: "
 						      "renaming (parent)\n",
@@ -975,8 +1120,9 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 					if ( strcmp( tranp->t_namebuf, name )) {
 						/* different name
 						 */
-						renamep->n_nrh =
-						    namreg_add( name, namelen );
+						Node_seth( renamep,
+							   N_NRH,
+							   namreg_add( name, namelen ));
 						mlog( MLOG_DEBUG | MLOG_TREE,
 						      "dirent %s %llu %u: "
 						      "renaming (name)\n",
@@ -1009,6 +1155,8 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 				nrh_t nrh;
 				nh_t linkh;
 				nrh = namreg_add( name, namelen );
+				if ( nrh == NRH_NULL )
+					return RV_ERROR;
 				linkh = Node_alloc( ino,
 						    gen,
 						    NRH_NULL,
@@ -1017,7 +1165,7 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 				if (linkh == NH_NULL)
 					return RV_ERROR;
 				link_in( linkh );
-				adopt( parh, linkh, nrh );
+				adopt( parh, linkh, nrh, name );
 				mlog( MLOG_DEBUG | MLOG_TREE,
 				      "dirent %s %llu %u: "
 				      "adding (link)\n",
@@ -1032,6 +1180,8 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 		 */
 		nrh_t nrh;
 		nrh = namreg_add( name, namelen );
+		if ( nrh == NRH_NULL )
+			return RV_ERROR;
 		hardh = Node_alloc( ino,
 				    gen,
 				    NRH_NULL,
@@ -1040,7 +1190,7 @@ tree_addent( nh_t parh, xfs_ino_t ino, size_t g, char *name, size_t namelen )
 		if (hardh == NH_NULL)
 			return RV_ERROR;
 		link_in( hardh );
-		adopt( parh, hardh, nrh );
+		adopt( parh, hardh, nrh, name );
 		mlog( MLOG_DEBUG | MLOG_TREE,
 		      "dirent %s %llu %u: "
 		      "adding (new)\n",
@@ -1057,6 +1207,31 @@ tree_enddir( nh_t dirh )
 {
 }
 
+/* a directory not dumped is treated by tree_adjref( ) as unchanged: if
+ * referenced, so are all its entries. tree_begindir( ) marked this one
+ * dumped; take that back.
+ */
+void
+tree_refdir( nh_t dirh )
+{
+	node_t *dirp;
+
+	dirp = Node_map( dirh );
+	dirp->n_flags &= ~NF_DUMPEDDIR;
+
+	/* tree_marknoref( ) cleared NF_NEWORPH, so if set tree_begindir( )
+	 * just created the node: the base dump was never applied here.
+	 */
+	if ( ( dirp->n_flags & NF_NEWORPH ) && ! tranp->t_toconlypr ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
+		      "directory ino %llu dumped by reference "
+		      "but not present in restored tree: "
+		      "its entries are unknown\n"),
+		      dirp->n_ino );
+	}
+	Node_unmap( dirh, &dirp );
+}
+
 bool_t
 tree_subtree_parse( bool_t sensepr, char *path )
 {
@@ -1134,7 +1309,7 @@ tree_post( char *path1, char *path2 )
 		mlog( MLOG_DEBUG | MLOG_TREE,
 		      "eliminating unreferenced directory entries\n" );
 		rootp = Node_map( persp->p_rooth );
-		cldh = rootp->n_cldh;
+		cldh = Node_geth( rootp, N_CLDH );
 		Node_unmap( persp->p_rooth, &rootp );
 		ok = noref_elim_recurse( persp->p_rooth,
 					 cldh,
@@ -1151,7 +1326,7 @@ tree_post( char *path1, char *path2 )
 	mlog( MLOG_DEBUG | MLOG_TREE,
 	      "making new directories\n" );
 	rootp = Node_map( persp->p_rooth );
-	cldh = rootp->n_cldh;
+	cldh = Node_geth( rootp, N_CLDH );
 	Node_unmap( persp->p_rooth, &rootp );
 	ok = mkdirs_recurse( persp->p_rooth, cldh, path1 );
 	if ( ! ok ) {
@@ -1168,7 +1343,7 @@ tree_post( char *path1, char *path2 )
 		mlog( MLOG_DEBUG | MLOG_TREE,
 		      "performing directory renames\n" );
 		orphp = Node_map( persp->p_orphh );
-		cldh = orphp->n_cldh;
+		cldh = Node_geth( orphp, N_CLDH );
 		Node_unmap( persp->p_orphh, &orphp );
 		ok = rename_dirs( cldh, path1, path2 );
 		if ( ! ok ) {
@@ -1220,14 +1395,14 @@ noref_elim_recurse( nh_t parh,
 		cldp = Node_map( cldh );
 		ino = cldp->n_ino;
 		gen = cldp->n_gen;
-		inorphanagepr = cldp->n_parh == persp->p_orphh;
+		inorphanagepr = Node_geth( cldp, N_PARH ) == persp->p_orphh;
 		isdirpr = ( cldp->n_flags & NF_ISDIR );
 		isrealpr = ( cldp->n_flags & NF_REAL );
 		isrefpr = ( cldp->n_flags & NF_REFED );
-		isrenamepr = ( isdirpr && cldp->n_lnkh != NH_NULL );
-		renameh = cldp->n_lnkh;
-		grandcldh = cldp->n_cldh;
-		nextcldh = cldp->n_sibh;
+		isrenamepr = ( isdirpr && Node_geth( cldp, N_LNKH ) != NH_NULL );
+		renameh = Node_geth( cldp, N_LNKH );
+		grandcldh = Node_geth( cldp, N_CLDH );
+		nextcldh = Node_geth( cldp, N_SIBH );
 
 #ifdef TREE_DEBUG
 		ok = Node2path( cldh, path1, _("noref debug") );
@@ -1306,7 +1481,7 @@ noref_elim_recurse( nh_t parh,
 				}
 				nrh = disown( cldh );
 				ASSERT( nrh != NRH_NULL );
-				adopt( persp->p_orphh, cldh, NRH_NULL );
+				adopt( persp->p_orphh, cldh, NRH_NULL, 0 );
 				ok = Node2path( cldh,
 						path2,
 						_("tmp dir rename dst") );
@@ -1315,7 +1490,7 @@ noref_elim_recurse( nh_t parh,
 					nrh_t dummynrh;
 					dummynrh = disown( cldh );
 					ASSERT( dummynrh == NRH_NULL );
-					adopt( parh, cldh, nrh );
+					adopt( parh, cldh, nrh, 0 );
 					cldh = nextcldh;
 					continue;
 				}
@@ -1335,19 +1510,19 @@ noref_elim_recurse( nh_t parh,
 					      strerror( errno ));
 					dummynrh = disown( cldh );
 					ASSERT( dummynrh == NRH_NULL );
-					adopt( parh, cldh, nrh );
+					adopt( parh, cldh, nrh, 0 );
 					cldh = nextcldh;
 					continue;
 				}
 				cldp = Node_map( cldh );
 				renamep = Node_map( renameh );
-				if ( renamep->n_nrh == NRH_NULL ) {
-					renamep->n_nrh = nrh;
+				if ( Node_geth( renamep, N_NRH ) == NRH_NULL ) {
+					Node_seth( renamep, N_NRH, nrh );
 				} else {
 					namreg_del( nrh );
 				}
-				if ( renamep->n_parh == NH_NULL ) {
-					renamep->n_parh = parh;
+				if ( Node_geth( renamep, N_PARH ) == NH_NULL ) {
+					Node_seth( renamep, N_PARH, parh );
 				}
 				cldp->n_flags |= NF_NEWORPH;
 				Node_unmap( renameh, &renamep );
@@ -1393,7 +1568,7 @@ noref_elim_recurse( nh_t parh,
 					hardp = Node_map( hardh );
 					hardisrefpr = hardp->n_flags & NF_REFED;
 					hardisrealpr = hardp->n_flags & NF_REAL;
-					nexthardh = hardp->n_lnkh;
+					nexthardh = Node_geth( hardp, N_LNKH );
 					Node_unmap( hardh, &hardp );
 					if ( hardh != cldh && hardisrealpr ) {
 						break;
@@ -1424,7 +1599,7 @@ noref_elim_recurse( nh_t parh,
 				}
 				nrh = disown( cldh );
 				ASSERT( nrh != NRH_NULL );
-				adopt( persp->p_orphh, cldh, NRH_NULL );
+				adopt( persp->p_orphh, cldh, NRH_NULL, 0 );
 				ok = Node2path( cldh,
 						path2,
 						_("tmp nondir rename dst") );
@@ -1433,7 +1608,7 @@ noref_elim_recurse( nh_t parh,
 					nrh_t dummynrh;
 					dummynrh = disown( cldh );
 					ASSERT( dummynrh == NRH_NULL );
-					adopt( parh, cldh, nrh );
+					adopt( parh, cldh, nrh, 0 );
 					cldh = nextcldh;
 					continue;
 				}
@@ -1453,7 +1628,7 @@ noref_elim_recurse( nh_t parh,
 					      strerror( errno ));
 					dummynrh = disown( cldh );
 					ASSERT( dummynrh == NRH_NULL );
-					adopt( parh, cldh, nrh );
+					adopt( parh, cldh, nrh, 0 );
 					cldh = nextcldh;
 					continue;
 				}
@@ -1524,8 +1699,8 @@ mkdirs_recurse( nh_t parh, nh_t cldh, char *path )
 		isrealpr = ( cldp->n_flags & NF_REAL );
 		isrefpr = ( cldp->n_flags & NF_REFED );
 		isselpr = ( cldp->n_flags & NF_SUBTREE );
-		grandcldh = cldp->n_cldh;
-		nextcldh = cldp->n_sibh;
+		grandcldh = Node_geth( cldp, N_CLDH );
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp );
 
 		/* if needed, create a directory and update real flag
@@ -1595,11 +1770,11 @@ rename_dirs( nh_t cldh,
 		nh_t newnrh;
 
 		cldp = Node_map( cldh );
-		parh = cldp->n_parh;
+		parh = Node_geth( cldp, N_PARH );
 		isdirpr = cldp->n_flags & NF_ISDIR;
-		renameh = cldp->n_lnkh;
+		renameh = Node_geth( cldp, N_LNKH );
 		isrenamepr = isdirpr && renameh != NH_NULL;
-		nextcldh = cldp->n_sibh;
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp );
 		ASSERT( parh == persp->p_orphh );
 
@@ -1611,8 +1786,8 @@ rename_dirs( nh_t cldh,
 			bool_t ok;
 
 			renamep = Node_map( renameh );
-			newparh = renamep->n_parh;
-			newnrh = renamep->n_nrh;
+			newparh = Node_geth( renamep, N_PARH );
+			newnrh = Node_geth( renamep, N_NRH );
 			Node_unmap( renameh, &renamep );
 			ok = Node2path( cldh, path1, _("rename dir") );
 			if ( ! ok ) {
@@ -1621,14 +1796,14 @@ rename_dirs( nh_t cldh,
 			}
 			dummynrh = disown( cldh );
 			ASSERT( dummynrh == NRH_NULL );
-			adopt( newparh, cldh, newnrh );
+			adopt( newparh, cldh, newnrh, 0 );
 			ok = Node2path( cldh, path2, _("rename dir") );
 			if ( ! ok ) {
 				dummynrh = disown( cldh );
 				ASSERT( dummynrh == newnrh );
-				adopt( persp->p_orphh, cldh, NRH_NULL );
+				adopt( persp->p_orphh, cldh, NRH_NULL, 0 );
 				cldp = Node_map( cldh );
-				cldp->n_nrh = NRH_NULL;
+				Node_seth( cldp, N_NRH, NRH_NULL );
 				Node_unmap( cldh, &cldp );
 				cldh = nextcldh;
 				continue;
@@ -1647,13 +1822,13 @@ rename_dirs( nh_t cldh,
 				      strerror( errno ));
 				dummynrh = disown( cldh );
 				ASSERT( dummynrh == newnrh );
-				adopt( persp->p_orphh, cldh, NRH_NULL );
+				adopt( persp->p_orphh, cldh, NRH_NULL, 0 );
 				cldh = nextcldh;
 				continue;
 			}
 			cldp = Node_map( cldh );
 			cldp->n_flags &= ~NF_NEWORPH;
-			cldp->n_lnkh = NH_NULL;
+			Node_seth( cldp, N_LNKH, NH_NULL );
 			Node_unmap( cldh, &cldp );
 			Node_free( &renameh );
 		}
@@ -1674,6 +1849,7 @@ tree_cb_links( xfs_ino_t ino,
 	       u_int32_t biggen,
 	       int32_t ctime,
 	       int32_t mtime,
+	       bool_t keepdatapr,
 	       bool_t ( * funcp )( void *contextp,
 				   bool_t linkpr,
 				   char *path1,
@@ -1767,9 +1943,14 @@ tree_cb_links( xfs_ino_t ino,
 				 * We're the first stream to restore this file.
 				 * Unlink it first to remove extended attributes
 				 * that may have been set since the dump was
-				 * taken.
+				 * taken. unless keeping its data, as when
+				 * only its metadata was dumped.
 				 */
-				if ( ! tranp->t_toconlypr && exists ) {
+				if ( ! tranp->t_toconlypr
+				     &&
+				     exists
+				     &&
+				     ! keepdatapr ) {
 					rval = unlink( path );
 					if ( rval && errno != ENOENT ) {
 						mlog( MLOG_NORMAL | 
@@ -1894,7 +2075,7 @@ tree_cb_links( xfs_ino_t ino,
 				return RV_ERROR; /* allocation failed */
 			}
 			link_in( nh );
-			adopt( persp->p_orphh, nh, NRH_NULL );
+			adopt( persp->p_orphh, nh, NRH_NULL, 0 );
 			ok = Node2path( nh, path1, _("orphan") );
 			ASSERT( ok );
 			( void )( * funcp )( contextp, BOOL_FALSE, path1,path2);
@@ -1903,6 +2084,67 @@ tree_cb_links( xfs_ino_t ino,
 	return RV_OK;
 }
 
+/* lists the links of every generation of ino in the tree. a table of
+ * contents is never cumulative, so there the tree holds only one. a
+ * cumulative restore may also hold links to an earlier generation of a
+ * reused ino, so the callback must check it has the right file, as
+ * restore_extentref( ) does with the fingerprint of the chunk it seeks.
+ * inos not referenced by any directory are not listed, since without
+ * their file headers there is no name for them in the orphanage.
+ */
+bool_t
+tree_cb_ino( xfs_ino_t ino,
+	     bool_t ( * funcp )( void *contextp, char *path ),
+	     void *contextp,
+	     char *path )
+{
+	nh_t hashh;
+	nh_t nexthashh;
+
+	for ( hashh = hashent_get( tranp->t_hashp,
+				   hash_val( ino, persp->p_hashmask ))
+	      ;
+	      hashh != NH_NULL
+	      ;
+	      hashh = nexthashh ) {
+		node_t *np;
+		xfs_ino_t hashino;
+		nh_t nh;
+
+		np = Node_map( hashh );
+		hashino = np->n_ino;
+		nexthashh = Node_geth( np, N_HASHH );
+		Node_unmap( hashh, &np );
+		if ( hashino != ino ) {
+			continue;
+		}
+
+		/* list each selected hard link
+		 */
+		for ( nh = hashh ; nh != NH_NULL ; nh = link_nexth( nh )) {
+			u_char_t flags;
+
+			np = Node_map( nh );
+			flags = np->n_flags;
+			Node_unmap( nh, &np );
+			if ( ! ( flags & NF_SUBTREE )) {
+				continue;
+			}
+			if ( ! Node2path( nh, path, _("list") )) {
+				continue;
+			}
+			if ( path_beginswith( path, tranp->t_hkdir )) {
+				continue;
+			}
+			if ( ! ( * funcp )( contextp, path )) {
+				return BOOL_FALSE;
+			}
+		}
+	}
+
+	return BOOL_TRUE;
+}
+
 /* uses flags cleared during directory restore (NF_DUMPEDDIR and NF_REFED )
  * to determine what directory entries are no longer needed. this can
  * be done because whenever a directory chenges, it and all of its current
@@ -1941,7 +2183,7 @@ tree_adjref_recurse( nh_t cldh,
 		}
 		clddumpedpr = ( intgen_t )cldp->n_flags & NF_DUMPEDDIR;
 		cldrefedpr = ( intgen_t )cldp->n_flags & NF_REFED;
-		grandcldh = cldp->n_cldh;
+		grandcldh = Node_geth( cldp, N_CLDH );
 		Node_unmap( cldh, &cldp  );
 	}
 	while ( grandcldh != NH_NULL ) {
@@ -1950,7 +2192,7 @@ tree_adjref_recurse( nh_t cldh,
 		tree_adjref_recurse( grandcldh, clddumpedpr, cldrefedpr );
 								/* RECURSION */
 		grandcldp = Node_map( grandcldh );
-		nextgrandcldh = grandcldp->n_sibh;
+		nextgrandcldh = Node_geth( grandcldp, N_SIBH );
 		Node_unmap( grandcldh, &grandcldp  );
 		grandcldh = nextgrandcldh;
 	}
@@ -1970,7 +2212,7 @@ tree_extattr( bool_t ( * cbfunc )( char *path, dah_t dah ), char *path )
 	bool_t ok;
 
 	rootp = Node_map( persp->p_rooth );
-	cldh = rootp->n_cldh;
+	cldh = Node_geth( rootp, N_CLDH );
 	Node_unmap( persp->p_rooth, &rootp );
 	ok = tree_extattr_recurse( persp->p_rooth, cldh, cbfunc, path );
 
@@ -2001,8 +2243,8 @@ tree_extattr_recurse( nh_t parh,
 		isdirpr = ( cldp->n_flags & NF_ISDIR );
 		isrealpr = ( cldp->n_flags & NF_REAL );
 		isselpr = ( cldp->n_flags & NF_SUBTREE );
-		grandcldh = cldp->n_cldh;
-		nextcldh = cldp->n_sibh;
+		grandcldh = Node_geth( cldp, N_CLDH );
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp );
 
 		/* if a real selected directory, recurse
@@ -2139,7 +2381,7 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 		 */
 		if ( ! isrealpr && ! isrefpr ) {
 			mlog( MLOG_NITTY | MLOG_TREE,
-			      "freeing node %x: not real, not referenced\n",
+			      "freeing node %llx: not real, not referenced\n",
 			      nh );
 			link_iter_unlink( &link_iter_context, nh );
 			Node_unmap( nh, &np );
@@ -2152,7 +2394,7 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 		 */
 		if ( ! isrealpr &&   isrefpr && ! isselpr ) {
 			mlog( MLOG_NITTY | MLOG_TREE,
-			      "skipping node %x: not selected\n",
+			      "skipping node %llx: not selected\n",
 			      nh );
 			Node_unmap( nh, &np );
 			continue;
@@ -2162,11 +2404,11 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 		 */
 		if ( ! isrealpr &&   isrefpr &&   isselpr ) {
 			mlog( MLOG_NITTY | MLOG_TREE,
-			      "making node %x dst: "
+			      "making node %llx dst: "
 			      "not real, refed, sel\n",
 			      nh );
 			link_iter_unlink( &link_iter_context, nh );
-			np->n_lnkh = rndstheadh;
+			Node_seth( np, N_LNKH, rndstheadh );
 			rndstheadh = nh;
 			Node_unmap( nh, &np );
 			continue;
@@ -2176,10 +2418,10 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 		 */
 		if (   isrealpr && ! isrefpr &&   isselpr ) {
 			mlog( MLOG_NITTY | MLOG_TREE,
-			      "making node %x src: real, not refed, sel\n",
+			      "making node %llx src: real, not refed, sel\n",
 			      nh );
 			link_iter_unlink( &link_iter_context, nh );
-			np->n_lnkh = rnsrcheadh;
+			Node_seth( np, N_LNKH, rnsrcheadh );
 			rnsrcheadh = nh;
 			Node_unmap( nh, &np );
 			continue;
@@ -2191,13 +2433,13 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 		 */
 		if (   isrealpr && ( isrefpr || !isselpr ) ) {
 			mlog( MLOG_NITTY | MLOG_TREE,
-			      "skipping node %x: %s\n",
+			      "skipping node %llx: %s\n",
 			      nh,
 			      isselpr ? "real and ref" : "real and not sel" );
 			Node_unmap( nh, &np );
 			if ( lnsrch == NH_NULL ) {
 				mlog( MLOG_NITTY | MLOG_TREE,
-				      "node %x will be link src\n",
+				      "node %llx will be link src\n",
 				      nh );
 				lnsrch = nh;
 			}
@@ -2217,8 +2459,8 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 
 		dsth = rndstheadh;
 		dstp = Node_map( dsth );
-		rndstheadh = dstp->n_lnkh;
-		dstp->n_lnkh = NH_NULL;
+		rndstheadh = Node_geth( dstp, N_LNKH );
+		Node_seth( dstp, N_LNKH, NH_NULL );
 		Node_unmap( dsth, &dstp );
 
 		/* build pathname to dst
@@ -2237,8 +2479,8 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 
 			srch = rnsrcheadh;
 			srcp = Node_map( srch );
-			rnsrcheadh = srcp->n_lnkh;
-			srcp->n_lnkh = NH_NULL;
+			rnsrcheadh = Node_geth( srcp, N_LNKH );
+			Node_seth( srcp, N_LNKH, NH_NULL );
 			Node_unmap( srch, &srcp );
 
 			/* build a path to src
@@ -2317,7 +2559,7 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 
 		if ( ! successpr ) {
 			mlog( MLOG_NITTY | MLOG_TREE,
-			      "no link src for node %x\n",
+			      "no link src for node %llx\n",
 			      dsth );
 		} else {
 			dstp = Node_map( dsth );
@@ -2339,8 +2581,8 @@ proc_hardlinks_cb( void *contextp, nh_t hardheadh )
 
 		srch = rnsrcheadh;
 		srcp = Node_map( srch );
-		rnsrcheadh = srcp->n_lnkh;
-		srcp->n_lnkh = NH_NULL;
+		rnsrcheadh = Node_geth( srcp, N_LNKH );
+		Node_seth( srcp, N_LNKH, NH_NULL );
 		Node_unmap( srch, &srcp );
 
 		ok = Node2path( srch, phcbp->path1, _("unlink") );
@@ -2401,7 +2643,7 @@ static bool_t
 tree_setattr_recurse( nh_t parh, char *path )
 {
 	node_t *parp = Node_map( parh );
-	nh_t cldh = parp->n_cldh;
+	nh_t cldh = Node_geth( parp, N_CLDH );
 	Node_unmap( parh, &parp );
 	while ( cldh != NH_NULL ) {
 		nh_t nextcldh;
@@ -2416,7 +2658,7 @@ tree_setattr_recurse( nh_t parh, char *path )
 
 		/* get next cld
 		 */
-		nextcldh = cldp->n_sibh;
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp );
 
 		/* if is a real selected dir, go ahead.
@@ -2781,8 +3023,8 @@ tsi_cmd_pwd_recurse( void *ctxp,
 	ASSERT( nh != NH_NULL );
 
 	np = Node_map( nh );
-	nrh = np->n_nrh;
-	parh = np->n_parh;
+	nrh = Node_geth( np, N_NRH );
+	parh = Node_geth( np, N_PARH );
 	Node_unmap( nh, &np );
 	if ( parh != persp->p_rooth ) {
 		tsi_cmd_pwd_recurse( ctxp, pcb, pctxp, parh );
@@ -2853,8 +3095,8 @@ tsi_cmd_ls( void *ctxp,
 		nrh_t nrh;
 		nh_t nextcldh;
 		cldp = Node_map( cldh );
-		nrh = cldp->n_nrh;
-		nextcldh = cldp->n_sibh;
+		nrh = Node_geth( cldp, N_NRH );
+		nextcldh = Node_geth( cldp, N_SIBH );
 		isdirpr = ( cldp->n_flags & NF_ISDIR );
 		isselpr = ( cldp->n_flags & NF_SUBTREE );
 		ino = cldp->n_ino;
@@ -3194,8 +3436,8 @@ tsi_walkpath( char *arg, nh_t rooth, nh_t cwdh,
 	/* get the parent of the starting point, and its cld list
 	 */
 	namedp = Node_map( namedh );
-	parh = namedp->n_parh;
-	cldh = namedp->n_cldh;
+	parh = Node_geth( namedp, N_PARH );
+	cldh = Node_geth( namedp, N_CLDH );
 	ino = namedp->n_ino;
 	isselpr = ( namedp->n_flags & NF_SUBTREE );
 	ASSERT( namedp->n_flags & NF_ISDIR );
@@ -3283,8 +3525,8 @@ tsi_walkpath( char *arg, nh_t rooth, nh_t cwdh,
 			}
 			namedh = parh;
 			namedp = Node_map( namedh );
-			parh = namedp->n_parh;
-			cldh = namedp->n_cldh;
+			parh = Node_geth( namedp, N_PARH );
+			cldh = Node_geth( namedp, N_CLDH );
 			ino = namedp->n_ino;
 			isselpr = ( namedp->n_flags & NF_SUBTREE );
 			Node_unmap( namedh, &namedp );
@@ -3296,33 +3538,48 @@ tsi_walkpath( char *arg, nh_t rooth, nh_t cwdh,
 
 		/* look for child with right name
 		 */
-		sibh = cldh;
-		while ( sibh != NH_NULL ) {
-			node_t *sibp;
-			nh_t nextsibh;
-			nrh_t nrh;
-			/* REFERENCED */
-			intgen_t siblen;
-
-			sibp = Node_map( sibh );
-			nrh = sibp->n_nrh;
-			nextsibh = sibp->n_sibh;
-			cldh = sibp->n_cldh;
-			ino = sibp->n_ino;
-			isselpr = ( sibp->n_flags & NF_SUBTREE );
-			isdirpr = ( sibp->n_flags & NF_ISDIR );
-			Node_unmap( sibh, &sibp );
-			ASSERT( nrh != NRH_NULL || sibh == persp->p_orphh );
-			if ( nrh != NRH_NULL ) {
-				siblen = namreg_get( nrh,
-						     tranp->t_inter.i_name,
-					       sizeof( tranp->t_inter.i_name ));
-				ASSERT( siblen > 0 );
-				if ( ! strcmp( nbuf, tranp->t_inter.i_name )) {
-					break;
+		if ( tranp->t_namhashp ) {
+			sibh = namhash_find( namedh, nbuf, NH_NULL );
+			if ( sibh != NH_NULL ) {
+				node_t *sibp = Node_map( sibh );
+				cldh = Node_geth( sibp, N_CLDH );
+				ino = sibp->n_ino;
+				isselpr = ( sibp->n_flags & NF_SUBTREE );
+				isdirpr = ( sibp->n_flags & NF_ISDIR );
+				Node_unmap( sibh, &sibp );
+			}
+		} else {
+			sibh = cldh;
+			while ( sibh != NH_NULL ) {
+				node_t *sibp;
+				nh_t nextsibh;
+				nrh_t nrh;
+				/* REFERENCED */
+				intgen_t siblen;
+
+				sibp = Node_map( sibh );
+				nrh = Node_geth( sibp, N_NRH );
+				nextsibh = Node_geth( sibp, N_SIBH );
+				cldh = Node_geth( sibp, N_CLDH );
+				ino = sibp->n_ino;
+				isselpr = ( sibp->n_flags & NF_SUBTREE );
+				isdirpr = ( sibp->n_flags & NF_ISDIR );
+				Node_unmap( sibh, &sibp );
+				ASSERT( nrh != NRH_NULL
+					||
+					sibh == persp->p_orphh );
+				if ( nrh != NRH_NULL ) {
+					siblen = namreg_get( nrh,
+						      tranp->t_inter.i_name,
+						sizeof( tranp->t_inter.i_name ));
+					ASSERT( siblen > 0 );
+					if ( ! strcmp( nbuf,
+						       tranp->t_inter.i_name )) {
+						break;
+					}
 				}
+				sibh = nextsibh;
 			}
-			sibh = nextsibh;
 		}
 
 		/* if no match, complain
@@ -3368,14 +3625,15 @@ Node_alloc( xfs_ino_t ino, gen_t gen, nrh_t nrh, dah_t dah, size_t flags )
 	    return NH_NULL;
 	np = Node_map( nh );
 	np->n_ino = ino;
-	np->n_nrh = nrh;
+	Node_seth( np, N_NRH, nrh );
 	np->n_dah = dah;
-	np->n_hashh = NH_NULL;
-	np->n_parh = NH_NULL;
-	np->n_sibh = NH_NULL;
-	np->n_sibprevh = NH_NULL;
-	np->n_cldh = NH_NULL;
-	np->n_lnkh = NH_NULL;
+	Node_seth( np, N_HASHH, NH_NULL );
+	Node_seth( np, N_PARH, NH_NULL );
+	Node_seth( np, N_SIBH, NH_NULL );
+	Node_seth( np, N_SIBPREVH, NH_NULL );
+	Node_seth( np, N_CLDH, NH_NULL );
+	Node_seth( np, N_LNKH, NH_NULL );
+	Node_seth( np, N_NAMHASHH, NH_NULL );
 	np->n_gen = gen;
 	np->n_flags = ( u_char_t )flags;
 	Node_unmap( nh, &np  );
@@ -3389,20 +3647,21 @@ Node_free( nh_t *nhp )
 	np = Node_map( *nhp );
 	np->n_ino = 0;
 	np->n_gen = 0;
-	if ( np->n_nrh != NRH_NULL ) {
-		namreg_del( np->n_nrh );
-		np->n_nrh = NRH_NULL;
+	if ( Node_geth( np, N_NRH ) != NRH_NULL ) {
+		namreg_del( Node_geth( np, N_NRH ) );
+		Node_seth( np, N_NRH, NRH_NULL );
 	}
-	if ( np->n_dah != NRH_NULL ) {
+	if ( np->n_dah != DAH_NULL ) {
 		dirattr_del( np->n_dah );
-		np->n_dah = NRH_NULL;
+		np->n_dah = DAH_NULL;
 	}
 	np->n_flags = 0;
-	np->n_parh = NH_NULL;
-	np->n_sibh = NH_NULL;
-	np->n_sibprevh = NH_NULL;
-	np->n_cldh = NH_NULL;
-	np->n_lnkh = NH_NULL;
+	Node_seth( np, N_PARH, NH_NULL );
+	Node_seth( np, N_SIBH, NH_NULL );
+	Node_seth( np, N_SIBPREVH, NH_NULL );
+	Node_seth( np, N_CLDH, NH_NULL );
+	Node_seth( np, N_LNKH, NH_NULL );
+	Node_seth( np, N_NAMHASHH, NH_NULL );
 	Node_unmap( *nhp, &np  );
 	node_free( nhp );
 }
@@ -3416,7 +3675,7 @@ Node_map( nh_t nh )
 	node_t *n = ( node_t * )node_map( nh );
 	if ( n == NULL ) {
 		mlog( MLOG_ERROR | MLOG_TREE, _(
-			"failed to map in node (node handle: %u)\n"), nh);
+			"failed to map in node (node handle: %llu)\n"), nh);
 		exit(EXIT_ERROR);
 	}
 	return n;
@@ -3428,6 +3687,57 @@ Node_unmap( nh_t nh, node_t **npp )
 	node_unmap( nh, ( void ** )npp );
 }
 
+/* packed handles reserve all ones for the null handle
+ */
+static inline size32_t
+hdl_pack32( size64_t hdl )
+{
+	if ( hdl == SIZE64MAX ) {
+		return SIZE32MAX;
+	}
+	ASSERT( hdl < ( size64_t )SIZE32MAX );
+	return ( size32_t )hdl;
+}
+
+static inline size64_t
+hdl_unpack32( size32_t hdl )
+{
+	return hdl == SIZE32MAX ? SIZE64MAX : ( size64_t )hdl;
+}
+
+#define HDL48NULL	( ( ( size64_t )1 << HDLBITS_WIDE ) - 1 )
+
+static inline nh_t
+Node_geth( node_t *np, ix_t hix )
+{
+	size64_t hdl;
+
+	ASSERT( hix < N_HDLCNT );
+	if ( ! persp->p_widepr ) {
+		return hdl_unpack32( np->n_hdllo[ hix ] );
+	}
+	hdl = ( ( size64_t )( ( node48_t * )np )->n48_hdlhi[ hix ] << 32 )
+	      |
+	      ( size64_t )np->n_hdllo[ hix ];
+	return hdl == HDL48NULL ? NH_NULL : hdl;
+}
+
+static inline void
+Node_seth( node_t *np, ix_t hix, nh_t hdl )
+{
+	ASSERT( hix < N_HDLCNT );
+	if ( ! persp->p_widepr ) {
+		np->n_hdllo[ hix ] = hdl_pack32( hdl );
+		return;
+	}
+	if ( hdl == NH_NULL ) {
+		hdl = HDL48NULL;
+	}
+	ASSERT( hdl <= HDL48NULL );
+	np->n_hdllo[ hix ] = ( size32_t )hdl;
+	( ( node48_t * )np )->n48_hdlhi[ hix ] = ( u_int16_t )( hdl >> 32 );
+}
+
 /* builds a pathname for the specified node, relative to root
  * returns FALSE if pathname too long
  */
@@ -3479,10 +3789,10 @@ Node2path_recurse( nh_t nh, char *buf, intgen_t bufsz )
 	/* extract useful node members
 	 */
 	np = Node_map( nh );
-	parh = np->n_parh;
+	parh = Node_geth( np, N_PARH );
 	ino = np->n_ino;
 	gen = np->n_gen;
-	nrh = np->n_nrh;
+	nrh = Node_geth( np, N_NRH );
 	Node_unmap( nh, &np );
 
 	/* build path to parent
@@ -3527,8 +3837,10 @@ Node2path_recurse( nh_t nh, char *buf, intgen_t bufsz )
 
 /* family abstraction *********************************************************/
 
+/* name is that of nrh if known to the caller, else NULL
+ */
 static void
-adopt( nh_t parh, nh_t cldh, nrh_t nrh )
+adopt( nh_t parh, nh_t cldh, nrh_t nrh, char *name )
 {
 	node_t *parp;
 	node_t *cldp;
@@ -3542,23 +3854,29 @@ adopt( nh_t parh, nh_t cldh, nrh_t nrh )
 
 	/* fix up our child - put at front of child list */
 	cldp = Node_map( cldh );
-	cldp->n_parh = parh;
-	cldp->n_nrh = nrh;
+	Node_seth( cldp, N_PARH, parh );
+	Node_seth( cldp, N_NRH, nrh );
 	parp = Node_map( parh );
-	cldp->n_sibh = parp->n_cldh;
-	cldp->n_sibprevh = NH_NULL;
+	Node_seth( cldp, N_SIBH, Node_geth( parp, N_CLDH ) );
+	Node_seth( cldp, N_SIBPREVH, NH_NULL );
 	Node_unmap( cldh, &cldp  );
 
 	/* fix up old first child i.e. child's new sibling */
-	if ( parp->n_cldh != NH_NULL ) { /* if parent has a child */
-	    sibp = Node_map( parp->n_cldh );
-	    sibp->n_sibprevh = cldh;
-	    Node_unmap( parp->n_cldh, &sibp );
+	if ( Node_geth( parp, N_CLDH ) != NH_NULL ) { /* if parent has a child */
+	    sibp = Node_map( Node_geth( parp, N_CLDH ) );
+	    Node_seth( sibp, N_SIBPREVH, cldh );
+	    Node_unmap( Node_geth( parp, N_CLDH ), &sibp );
 	}
 
         /* fix up parent */
-	parp->n_cldh = cldh;
+	Node_seth( parp, N_CLDH, cldh );
 	Node_unmap( parh, &parp  );
+
+	/* index by name. orphans have none
+	 */
+	if ( tranp->t_namhashp && nrh != NRH_NULL ) {
+		namhash_in( cldh, name );
+	}
 }
 
 static nrh_t
@@ -3571,9 +3889,9 @@ disown( nh_t cldh )
 
 	cldp = Node_map( cldh );
 
-	nrh = cldp->n_nrh;
+	nrh = Node_geth( cldp, N_NRH );
 
-	parh = cldp->n_parh;
+	parh = Node_geth( cldp, N_PARH );
 	ASSERT( parh != NH_NULL );
 	if ( parh == NH_NULL ) {
 		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
@@ -3581,46 +3899,49 @@ disown( nh_t cldh )
 		      "which has no parent!\n") );
 		return nrh;
 	}
+	if ( tranp->t_namhashp && nrh != NRH_NULL ) {
+		namhash_out( cldh );
+	}
 	parp = Node_map( parh );
-	ASSERT( parp->n_cldh != NH_NULL );
-	if ( parp->n_cldh == NH_NULL ) {
+	ASSERT( Node_geth( parp, N_CLDH ) != NH_NULL );
+	if ( Node_geth( parp, N_CLDH ) == NH_NULL ) {
 		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
 		      "attempt to disown child "
 		      "when parent has no children!\n") );
 		return nrh;
 	}
-	if ( parp->n_cldh == cldh ) {
+	if ( Node_geth( parp, N_CLDH ) == cldh ) {
 		/* child is the first one in the child list */
-		parp->n_cldh = cldp->n_sibh;
-		if ( cldp->n_sibh != NH_NULL ) {
-			node_t *sibp = Node_map( cldp->n_sibh );
-			sibp->n_sibprevh = NH_NULL; 
-			Node_unmap( cldp->n_sibh, &sibp );
+		Node_seth( parp, N_CLDH, Node_geth( cldp, N_SIBH ) );
+		if ( Node_geth( cldp, N_SIBH ) != NH_NULL ) {
+			node_t *sibp = Node_map( Node_geth( cldp, N_SIBH ) );
+			Node_seth( sibp, N_SIBPREVH, NH_NULL ); 
+			Node_unmap( Node_geth( cldp, N_SIBH ), &sibp );
 		}
 	} else {
 		/* child is further down the child list */
 		/* use double link list to find previous link */
-		nh_t prevcldh = cldp->n_sibprevh;
+		nh_t prevcldh = Node_geth( cldp, N_SIBPREVH );
 		node_t *prevcldp;
 
 		ASSERT(prevcldh != NH_NULL); /* must be a previous */
 		prevcldp = Node_map( prevcldh );
 
 		/* fix up previous */
-		prevcldp->n_sibh = cldp->n_sibh; 
+		Node_seth( prevcldp, N_SIBH, Node_geth( cldp, N_SIBH ) ); 
 		Node_unmap( prevcldh, &prevcldp  );
 
 		/* fix up next */
-		if ( cldp->n_sibh != NH_NULL ) {
-			node_t *sibp = Node_map( cldp->n_sibh );
-			sibp->n_sibprevh = prevcldh; 
-			Node_unmap( cldp->n_sibh, &sibp );
+		if ( Node_geth( cldp, N_SIBH ) != NH_NULL ) {
+			node_t *sibp = Node_map( Node_geth( cldp, N_SIBH ) );
+			Node_seth( sibp, N_SIBPREVH, prevcldh ); 
+			Node_unmap( Node_geth( cldp, N_SIBH ), &sibp );
 		}
 	}
 	Node_unmap( parh, &parp  );
-	cldp->n_parh = NH_NULL;
-	cldp->n_sibh = NH_NULL;
-	cldp->n_sibprevh = NH_NULL;
+	Node_seth( cldp, N_PARH, NH_NULL );
+	Node_seth( cldp, N_SIBH, NH_NULL );
+	Node_seth( cldp, N_SIBPREVH, NH_NULL );
 	Node_unmap( cldh, &cldp  );
 
 	return nrh;
@@ -3644,7 +3965,7 @@ selsubtree( nh_t nh, bool_t sensepr )
 	/* get parent
 	 */
 	np = Node_map( nh );
-	parh = np->n_parh;
+	parh = Node_geth( np, N_PARH );
 	Node_unmap( nh, &np );
 
 	/* next adjust ancestory
@@ -3658,7 +3979,7 @@ selsubtree( nh_t nh, bool_t sensepr )
 			parp->n_flags |= NF_SUBTREE;
 		} else {
 			bool_t atleastonechildselpr = BOOL_FALSE;
-			nh_t cldh = parp->n_cldh;
+			nh_t cldh = Node_geth( parp, N_CLDH );
 			while ( cldh != NH_NULL ) {
 				node_t *cldp;
 				nh_t nextcldh;
@@ -3669,7 +3990,7 @@ selsubtree( nh_t nh, bool_t sensepr )
 					     BOOL_TRUE
 					     :
 					     BOOL_FALSE;
-				nextcldh = cldp->n_sibh;
+				nextcldh = Node_geth( cldp, N_SIBH );
 				Node_unmap( cldh, &cldp );
 				if ( cldsensepr ) {
 					atleastonechildselpr = BOOL_TRUE;
@@ -3683,7 +4004,7 @@ selsubtree( nh_t nh, bool_t sensepr )
 				 */
 			}
 		}
-		newparh = parp->n_parh;
+		newparh = Node_geth( parp, N_PARH );
 		Node_unmap( parh, &parp );
 		parh = newparh;
 	}
@@ -3708,7 +4029,7 @@ selsubtree_recurse_down( nh_t nh, bool_t sensepr )
 		} else {
 			np->n_flags &= ~NF_SUBTREE;
 		}
-		cldh = np->n_cldh;
+		cldh = Node_geth( np, N_CLDH );
 		ino = np->n_ino;
 		gen = np->n_gen;
 		isdirpr = ( np->n_flags & NF_ISDIR );
@@ -3753,7 +4074,7 @@ selsubtree_recurse_down( nh_t nh, bool_t sensepr )
 			selsubtree_recurse_down( cldh, sensepr );
 		}
 		cldp = Node_map( cldh );
-		nextcldh = cldp->n_sibh;
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp  );
 		cldh = nextcldh;
 	}
@@ -3779,7 +4100,7 @@ link_nexth( nh_t nh )
 	nh_t nexth;
 
 	np = Node_map( nh );
-	nexth = np->n_lnkh;
+	nexth = Node_geth( np, N_LNKH );
 	Node_unmap( nh, &np );
 	return nexth;
 }
@@ -3790,14 +4111,22 @@ link_nexth( nh_t nh )
 static nh_t
 link_matchh( nh_t hardh, nh_t parh, char *name )
 {
+	if ( tranp->t_namhashp ) {
+		return hardh == NH_NULL
+		       ?
+		       NH_NULL
+		       :
+		       namhash_find( parh, name, hardh );
+	}
+
 	while ( hardh != NH_NULL ) {
 		node_t *np;
 		nh_t nexth;
 		np = Node_map( hardh );
-		if ( np->n_parh == parh ) {
+		if ( Node_geth( np, N_PARH ) == parh ) {
 			/* REFERENCED */
 			intgen_t namelen;
-			namelen = namreg_get( np->n_nrh,
+			namelen = namreg_get( Node_geth( np, N_NRH ),
 					      tranp->t_namebuf,
 					      sizeof( tranp->t_namebuf ));
 			ASSERT( namelen > 0 );
@@ -3806,7 +4135,7 @@ link_matchh( nh_t hardh, nh_t parh, char *name )
 				break;
 			}
 		}
-		nexth = np->n_lnkh;
+		nexth = Node_geth( np, N_LNKH );
 		Node_unmap( hardh, &np );
 		hardh = nexth;
 	}
@@ -3852,20 +4181,20 @@ link_in( nh_t nh )
 		mlog(MLOG_DEBUG | MLOG_TREE,
 		    "link_in(): put at end of hash list\n");
 #endif
-		while ( prevp->n_lnkh != NH_NULL ) {
-			nh_t nexth = prevp->n_lnkh;
+		while ( Node_geth( prevp, N_LNKH ) != NH_NULL ) {
+			nh_t nexth = Node_geth( prevp, N_LNKH );
 			Node_unmap( prevh, &prevp  );
 			prevh = nexth;
 			prevp = Node_map( prevh );
 		}
-		prevp->n_lnkh = nh;
+		Node_seth( prevp, N_LNKH, nh );
 		Node_unmap( prevh, &prevp  );
 	}
 
 	/* since always put at end of hard link list, make node's
 	 * lnk member terminate list.
 	 */
-	np->n_lnkh = NH_NULL;
+	Node_seth( np, N_LNKH, NH_NULL );
 	Node_unmap( nh, &np  );
 #ifdef TREE_DEBUG
 	mlog(MLOG_DEBUG | MLOG_TREE,
@@ -3898,23 +4227,23 @@ link_out( nh_t nh )
 	 */
 	if ( nh == hardh ) {
 		hash_out( nh );
-		if ( np->n_lnkh != NH_NULL ) {
-			hash_in( np->n_lnkh );
+		if ( Node_geth( np, N_LNKH ) != NH_NULL ) {
+			hash_in( Node_geth( np, N_LNKH ) );
 		}
 	} else {
 		nh_t prevh = hardh;
 		node_t *prevp = Node_map( prevh );
-		while ( prevp->n_lnkh != nh ) {
-			nh_t nexth = prevp->n_lnkh;
+		while ( Node_geth( prevp, N_LNKH ) != nh ) {
+			nh_t nexth = Node_geth( prevp, N_LNKH );
 			Node_unmap( prevh, &prevp  );
 			prevh = nexth;
 			ASSERT( prevh != NH_NULL );
 			prevp = Node_map( prevh );
 		}
-		prevp->n_lnkh = np->n_lnkh;
+		Node_seth( prevp, N_LNKH, Node_geth( np, N_LNKH ) );
 		Node_unmap( prevh, &prevp  );
 	}
-	np->n_lnkh = NH_NULL;
+	Node_seth( np, N_LNKH, NH_NULL );
 
 	/* release the mapping
 	 */
@@ -3977,7 +4306,7 @@ link_iter_next( link_iter_context_t *link_iter_contextp )
 	 */
 	link_iter_contextp->li_prevh = tmplasth;
 	lastp = Node_map( tmplasth );
-	link_iter_contextp->li_lasth = lastp->n_lnkh;
+	link_iter_contextp->li_lasth = Node_geth( lastp, N_LNKH );
 	Node_unmap( tmplasth, &lastp );
 
 	/* if NULL, flag done
@@ -4006,8 +4335,8 @@ link_iter_unlink( link_iter_context_t *link_iter_contextp, nh_t nh )
 	/* get the next node in list
 	 */
 	lastp = Node_map( link_iter_contextp->li_lasth );
-	nexth = lastp->n_lnkh;
-	lastp->n_lnkh = NH_NULL;
+	nexth = Node_geth( lastp, N_LNKH );
+	Node_seth( lastp, N_LNKH, NH_NULL );
 	Node_unmap( link_iter_contextp->li_lasth, &lastp );
 
 	if ( link_iter_contextp->li_lasth == link_iter_contextp->li_headh ) {
@@ -4021,7 +4350,7 @@ link_iter_unlink( link_iter_context_t *link_iter_contextp, nh_t nh )
 		node_t *prevp;
 		ASSERT( link_iter_contextp->li_prevh != NH_NULL );
 		prevp = Node_map( link_iter_contextp->li_prevh );
-		prevp->n_lnkh = nexth;
+		Node_seth( prevp, N_LNKH, nexth );
 		Node_unmap( link_iter_contextp->li_prevh, &prevp );
 	}
 	link_iter_contextp->li_lasth = link_iter_contextp->li_prevh;
@@ -4031,7 +4360,30 @@ link_iter_unlink( link_iter_context_t *link_iter_contextp, nh_t nh )
 
 /* hash abstraction *********************************************************/
 
-#define HASHLEN_MIN	( pgsz / sizeof( nh_t ))
+/* the hash arrays hold handles in the width of the node format
+ */
+#define HASHENTSZ	( persp->p_widepr ? sizeof( nh_t ) : sizeof( size32_t ))
+#define HASHLEN_MIN	( pgsz / HASHENTSZ )
+
+static inline nh_t
+hashent_get( void *arrayp, size64_t hix )
+{
+	if ( persp->p_widepr ) {
+		return ( ( nh_t * )arrayp )[ hix ];
+	} else {
+		return hdl_unpack32( ( ( size32_t * )arrayp )[ hix ] );
+	}
+}
+
+static inline void
+hashent_set( void *arrayp, size64_t hix, nh_t nh )
+{
+	if ( persp->p_widepr ) {
+		( ( nh_t * )arrayp )[ hix ] = nh;
+	} else {
+		( ( size32_t * )arrayp )[ hix ] = hdl_pack32( nh );
+	}
+}
 
 static bool_t
 hash_init( size64_t vmsz,
@@ -4047,13 +4399,13 @@ hash_init( size64_t vmsz,
 
 	/* sanity checks
 	 */
-	ASSERT( pgsz % sizeof( nh_t ) == 0 );
+	ASSERT( pgsz % HASHENTSZ == 0 );
 
 	/* calculate the size of the hash array. must be a power of two,
 	 * and a multiple of the page size. don't use more than the available
 	 * vm. but enforce a minimum.
 	 */
-	vmlen = vmsz / sizeof( nh_t );
+	vmlen = vmsz / HASHENTSZ;
 	hashlenmax = min( vmlen, SIZEMAX );
 	hashlen = ( dircnt + nondircnt );
 	hashlen = max( hashlen, ( size64_t )HASHLEN_MIN );
@@ -4073,18 +4425,18 @@ hash_init( size64_t vmsz,
 
 	/* record hash size in persistent state
 	 */
-	persp->p_hashsz = hashlen * sizeof( nh_t );
+	persp->p_hashsz = hashlen * HASHENTSZ;
 
 	/* map the hash array just after the persistent state header
 	 */
 	ASSERT( persp->p_hashsz <= SIZEMAX );
 	ASSERT( ! ( persp->p_hashsz % ( size64_t )pgsz ));
 	ASSERT( ! ( PERSSZ % pgsz ));
-	tranp->t_hashp = ( nh_t * ) mmap_autogrow(
+	tranp->t_hashp = mmap_autogrow(
 					    ( size_t )persp->p_hashsz,
 					    tranp->t_persfd,
 					    ( off64_t )PERSSZ );
-	if ( tranp->t_hashp == ( nh_t * )-1 ) {
+	if ( tranp->t_hashp == ( void * )-1 ) {
 		mlog( MLOG_NORMAL | MLOG_TREE, _(
 		      "unable to mmap hash array into %s: %s\n"),
 		      perspath,
@@ -4095,7 +4447,7 @@ hash_init( size64_t vmsz,
 	/* initialize the hash array to all NULL node handles
 	 */
 	for ( hix = 0 ; hix < ( ix_t )hashlen ; hix++ ) {
-		tranp->t_hashp[ hix ] = NH_NULL;
+		hashent_set( tranp->t_hashp, hix, NH_NULL );
 	}
 
 	/* build a hash mask. this works because hashlen is a power of two.
@@ -4114,23 +4466,23 @@ hash_sync( char *perspath )
 
 	/* sanity checks
 	 */
-	ASSERT( pgsz % sizeof( nh_t ) == 0 );
+	ASSERT( pgsz % HASHENTSZ == 0 );
 
 	/* retrieve the hash size from the persistent state
 	 */
 	hashsz = persp->p_hashsz;
-	ASSERT( ! ( hashsz % sizeof( nh_t )));
+	ASSERT( ! ( hashsz % HASHENTSZ ));
 
 	/* map the hash array just after the persistent state header
 	 */
 	ASSERT( hashsz <= SIZEMAX );
 	ASSERT( ! ( hashsz % ( size64_t )pgsz ));
 	ASSERT( ! ( PERSSZ % pgsz ));
-	tranp->t_hashp = ( nh_t * ) mmap_autogrow(
+	tranp->t_hashp = mmap_autogrow(
 					    ( size_t )hashsz,
 					    tranp->t_persfd,
 					    ( off64_t )PERSSZ );
-	if ( tranp->t_hashp == ( nh_t * )-1 ) {
+	if ( tranp->t_hashp == ( void * )-1 ) {
 		mlog( MLOG_NORMAL | MLOG_TREE, _(
 		      "unable to mmap hash array into %s: %s\n"),
 		      perspath,
@@ -4159,7 +4511,6 @@ hash_in( nh_t nh )
 	node_t *np;
 	xfs_ino_t ino;
 	size_t hix;
-	nh_t *entryp;
 
 	/* get a mapping to the node
 	 */
@@ -4177,15 +4528,11 @@ hash_in( nh_t nh )
 	 */
 	hix = hash_val(ino, persp->p_hashmask);
 
-	/* get a pointer to the indexed hash array entry
-	 */
-	entryp = &tranp->t_hashp[ hix ];
-
 	/* insert into the list, at the head
 	 */
-	ASSERT( np->n_hashh == NH_NULL );
-	np->n_hashh = *entryp;
-	*entryp = nh;
+	ASSERT( Node_geth( np, N_HASHH ) == NH_NULL );
+	Node_seth( np, N_HASHH, hashent_get( tranp->t_hashp, hix ) );
+	hashent_set( tranp->t_hashp, hix, nh );
 
 	/* release the mapping
 	 */
@@ -4199,7 +4546,6 @@ hash_out( nh_t nh )
 	xfs_ino_t ino;
 	nh_t hashheadh;
 	size_t hix;
-	nh_t *entryp;
 
 	/* get a mapping to the node
 	 */
@@ -4209,35 +4555,34 @@ hash_out( nh_t nh )
 	 */
 	ino = np->n_ino;
 
-	/* get a pointer to the hash array entry
+	/* get the index of the hash array entry
 	 */
 	hix = hash_val(ino, persp->p_hashmask);
-	entryp = &tranp->t_hashp[ hix ];
 
 	/* get the handle of the first node in the appropriate hash array
 	 */
-	hashheadh = *entryp;
+	hashheadh = hashent_get( tranp->t_hashp, hix );
 	ASSERT( hashheadh != NH_NULL );
 	
 	/* if node is first in list, replace entry with following node.
 	 * otherwise, walk the list until found.
 	 */
 	if ( hashheadh == nh ) {
-		*entryp = np->n_hashh;
+		hashent_set( tranp->t_hashp, hix, Node_geth( np, N_HASHH ) );
 	} else {
 		nh_t prevh = hashheadh;
 		node_t *prevp = Node_map( prevh );
-		while ( prevp->n_hashh != nh ) {
-			nh_t nexth = prevp->n_hashh;
+		while ( Node_geth( prevp, N_HASHH ) != nh ) {
+			nh_t nexth = Node_geth( prevp, N_HASHH );
 			Node_unmap( prevh, &prevp  );
 			prevh = nexth;
 			ASSERT( prevh != NH_NULL );
 			prevp = Node_map( prevh );
 		}
-		prevp->n_hashh = np->n_hashh;
+		Node_seth( prevp, N_HASHH, Node_geth( np, N_HASHH ) );
 		Node_unmap( prevh, &prevp  );
 	}
-	np->n_hashh = NH_NULL;
+	Node_seth( np, N_HASHH, NH_NULL );
 
 	/* release the mapping
 	 */
@@ -4254,7 +4599,7 @@ hash_find( xfs_ino_t ino, gen_t gen )
 	/* get handle to first node in appropriate hash array
 	 */
 	hix = hash_val(ino, persp->p_hashmask);
-	nh = tranp->t_hashp[ hix ];
+	nh = hashent_get( tranp->t_hashp, hix );
 
 	/* if list empty, return null handle
 	 */
@@ -4272,7 +4617,7 @@ hash_find( xfs_ino_t ino, gen_t gen )
 	 */
 	np = Node_map( nh );
 	while ( np->n_ino != ino || np->n_gen != gen ) {
-		nh_t nextnh = np->n_hashh;
+		nh_t nextnh = Node_geth( np, N_HASHH );
 		Node_unmap( nh, &np  );
 		nh = nextnh;
 		if ( nh == NH_NULL ) {
@@ -4298,10 +4643,10 @@ static void
 hash_iter( bool_t ( * cbfp )( void *contextp, nh_t hashh ), void *contextp )
 {
 	ix_t hix;
-	size64_t hashlen = persp->p_hashsz / sizeof( nh_t );
+	size64_t hashlen = persp->p_hashsz / HASHENTSZ;
 
 	for ( hix = 0 ; hix < ( ix_t )hashlen ; hix++ ) {
-		nh_t nh = tranp->t_hashp[ hix ];
+		nh_t nh = hashent_get( tranp->t_hashp, hix );
 
 		while ( nh != NH_NULL ) {
 			node_t *np;
@@ -4309,7 +4654,7 @@ hash_iter( bool_t ( * cbfp )( void *contextp, nh_t hashh ), void *contextp )
 			bool_t ok;
 
 			np = Node_map( nh );
-			nexth = np->n_hashh;
+			nexth = Node_geth( np, N_HASHH );
 			Node_unmap( nh, &np );
 
 			ok = ( * cbfp )( contextp, nh );
@@ -4322,6 +4667,275 @@ hash_iter( bool_t ( * cbfp )( void *contextp, nh_t hashh ), void *contextp )
 	}
 }
 
+/* name hash abstraction ****************************************************/
+
+/* indexes each named child by ( parent handle, name ), so a directory
+ * entry can be found without walking the parent's child list. chained
+ * through n_namhashh. the bucket array lives in a file of its own in
+ * the housekeeping dir, so it survives an interrupted or cumulative
+ * restore along with the node file.
+ */
+
+static bool_t
+namhash_init( size64_t vmsz,
+	      size64_t dircnt,
+	      size64_t nondircnt )
+{
+	char *namhashpath;
+	size64_t hashlen;
+	size64_t loghashlen;
+	size64_t hashlenmax;
+	ix_t hix;
+
+	persp->p_namhashpr = BOOL_FALSE;
+	persp->p_namhashsz = 0;
+	tranp->t_namhashp = 0;
+
+	/* size the array as hash_init( ) does: a power of two,
+	 * at least a page, within the vm given.
+	 */
+	hashlenmax = min( vmsz / HASHENTSZ, SIZEMAX );
+	hashlen = max( dircnt + nondircnt, ( size64_t )HASHLEN_MIN );
+	hashlen = min( hashlen, hashlenmax );
+	for ( loghashlen = 0
+	      ;
+	      ( ( size64_t )1 << loghashlen ) <= hashlen
+	      ;
+	      loghashlen++ )
+		;
+	hashlen = ( size64_t )1 << loghashlen;
+	if ( hashlen > hashlenmax ) {
+		hashlen >>= 1;
+	}
+	if ( hashlen < HASHLEN_MIN ) {
+		mlog( MLOG_VERBOSE | MLOG_TREE, _(
+		      "not enough memory for directory name index\n") );
+		return BOOL_FALSE;
+	}
+
+	/* create and map the index file
+	 */
+	namhashpath = open_pathalloc( tranp->t_hkdir, NAMHASH_NAME, 0 );
+	( void )unlink( namhashpath );
+	tranp->t_namhashfd = open( namhashpath,
+				   O_RDWR | O_CREAT,
+				   S_IRUSR | S_IWUSR );
+	if ( tranp->t_namhashfd < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
+		      "could not open %s: %s: "
+		      "directory name index disabled\n"),
+		      namhashpath,
+		      strerror( errno ));
+		free( ( void * )namhashpath );
+		return BOOL_FALSE;
+	}
+	tranp->t_namhashp = mmap_autogrow(
+					    ( size_t )( hashlen * HASHENTSZ ),
+					    tranp->t_namhashfd,
+					    ( off64_t )0 );
+	if ( tranp->t_namhashp == ( void * )-1 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
+		      "unable to mmap %s: %s: "
+		      "directory name index disabled\n"),
+		      namhashpath,
+		      strerror( errno ));
+		tranp->t_namhashp = 0;
+		( void )close( tranp->t_namhashfd );
+		( void )unlink( namhashpath );
+		free( ( void * )namhashpath );
+		return BOOL_FALSE;
+	}
+	free( ( void * )namhashpath );
+
+	for ( hix = 0 ; hix < ( ix_t )hashlen ; hix++ ) {
+		hashent_set( tranp->t_namhashp, hix, NH_NULL );
+	}
+
+	persp->p_namhashsz = hashlen * HASHENTSZ;
+	persp->p_namhashmask = ( size_t )( hashlen - 1 );
+	persp->p_namhashpr = BOOL_TRUE;
+
+	return BOOL_TRUE;
+}
+
+static bool_t
+namhash_sync( void )
+{
+	char *namhashpath;
+
+	ASSERT( persp->p_namhashpr );
+	ASSERT( persp->p_namhashsz <= SIZEMAX );
+
+	/* if the index can't be recovered, stop using it for good: nodes
+	 * adopted from now on would be missing from it.
+	 */
+	namhashpath = open_pathalloc( tranp->t_hkdir, NAMHASH_NAME, 0 );
+	tranp->t_namhashfd = open( namhashpath, O_RDWR );
+	if ( tranp->t_namhashfd < 0 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
+		      "could not open %s: %s: "
+		      "directory name index disabled\n"),
+		      namhashpath,
+		      strerror( errno ));
+		free( ( void * )namhashpath );
+		persp->p_namhashpr = BOOL_FALSE;
+		return BOOL_FALSE;
+	}
+	tranp->t_namhashp = mmap_autogrow(
+					    ( size_t )persp->p_namhashsz,
+					    tranp->t_namhashfd,
+					    ( off64_t )0 );
+	if ( tranp->t_namhashp == ( void * )-1 ) {
+		mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
+		      "unable to mmap %s: %s: "
+		      "directory name index disabled\n"),
+		      namhashpath,
+		      strerror( errno ));
+		tranp->t_namhashp = 0;
+		( void )close( tranp->t_namhashfd );
+		free( ( void * )namhashpath );
+		persp->p_namhashpr = BOOL_FALSE;
+		return BOOL_FALSE;
+	}
+	free( ( void * )namhashpath );
+
+	return BOOL_TRUE;
+}
+
+/* FNV-1a over the name, seeded with the parent handle
+ */
+static inline size_t
+namhash_val( nh_t parh, char *name, size_t hashmask )
+{
+	u_int32_t val = 2166136261U ^ ( u_int32_t )( parh ^ ( parh >> 32 ));
+
+	while ( *name ) {
+		val ^= ( u_char_t )*name++;
+		val *= 16777619U;
+	}
+	val ^= ( u_int32_t )( parh ^ ( parh >> 32 )) * 0x9e3779b1U;
+	return ( size_t )val & hashmask;
+}
+
+/* adds an adopted, named node to the index. if name is NULL, it is
+ * retrieved from the name registry.
+ */
+static void
+namhash_in( nh_t nh, char *name )
+{
+	char namebuf[ NAME_MAX + 1 ];
+	node_t *np;
+	size_t hix;
+
+	np = Node_map( nh );
+	ASSERT( Node_geth( np, N_PARH ) != NH_NULL );
+	ASSERT( Node_geth( np, N_NRH ) != NRH_NULL );
+	if ( ! name ) {
+		/* REFERENCED */
+		intgen_t namelen;
+		namelen = namreg_get( Node_geth( np, N_NRH ), namebuf, sizeof( namebuf ));
+		ASSERT( namelen > 0 );
+		name = namebuf;
+	}
+	hix = namhash_val( Node_geth( np, N_PARH ), name, persp->p_namhashmask );
+	Node_seth( np, N_NAMHASHH, hashent_get( tranp->t_namhashp, hix ) );
+	hashent_set( tranp->t_namhashp, hix, nh );
+	Node_unmap( nh, &np );
+}
+
+/* removes a node from the index. must be called while the node still
+ * has its parent and name.
+ */
+static void
+namhash_out( nh_t nh )
+{
+	char namebuf[ NAME_MAX + 1 ];
+	node_t *np;
+	size_t hix;
+	nh_t headh;
+	/* REFERENCED */
+	intgen_t namelen;
+
+	np = Node_map( nh );
+	ASSERT( Node_geth( np, N_PARH ) != NH_NULL );
+	ASSERT( Node_geth( np, N_NRH ) != NRH_NULL );
+	namelen = namreg_get( Node_geth( np, N_NRH ), namebuf, sizeof( namebuf ));
+	ASSERT( namelen > 0 );
+	hix = namhash_val( Node_geth( np, N_PARH ), namebuf, persp->p_namhashmask );
+	headh = hashent_get( tranp->t_namhashp, hix );
+	ASSERT( headh != NH_NULL );
+	if ( headh == nh ) {
+		hashent_set( tranp->t_namhashp, hix, Node_geth( np, N_NAMHASHH ) );
+	} else {
+		nh_t prevh = headh;
+		node_t *prevp = Node_map( prevh );
+		while ( Node_geth( prevp, N_NAMHASHH ) != nh ) {
+			nh_t nexth = Node_geth( prevp, N_NAMHASHH );
+			Node_unmap( prevh, &prevp );
+			prevh = nexth;
+			ASSERT( prevh != NH_NULL );
+			prevp = Node_map( prevh );
+		}
+		Node_seth( prevp, N_NAMHASHH, Node_geth( np, N_NAMHASHH ) );
+		Node_unmap( prevh, &prevp );
+	}
+	Node_seth( np, N_NAMHASHH, NH_NULL );
+	Node_unmap( nh, &np );
+}
+
+/* returns the child of parh named name, or NH_NULL. if likeh is not
+ * NH_NULL, only a child with the same ino and gen qualifies. if there
+ * are several, returns the most recently adopted, as a walk of the
+ * child list would.
+ */
+static nh_t
+namhash_find( nh_t parh, char *name, nh_t likeh )
+{
+	xfs_ino_t ino = 0;
+	gen_t gen = 0;
+	nh_t nh;
+
+	if ( likeh != NH_NULL ) {
+		node_t *likep = Node_map( likeh );
+		ino = likep->n_ino;
+		gen = likep->n_gen;
+		Node_unmap( likeh, &likep );
+	}
+
+	nh = hashent_get( tranp->t_namhashp,
+			  namhash_val( parh, name, persp->p_namhashmask ));
+	while ( nh != NH_NULL ) {
+		node_t *np;
+		nh_t nexth;
+		bool_t candpr;
+		nrh_t nrh;
+
+		np = Node_map( nh );
+		nexth = Node_geth( np, N_NAMHASHH );
+		nrh = Node_geth( np, N_NRH );
+		candpr = Node_geth( np, N_PARH ) == parh
+			 &&
+			 ( likeh == NH_NULL
+			   ||
+			   ( np->n_ino == ino && np->n_gen == gen ));
+		Node_unmap( nh, &np );
+		if ( candpr ) {
+			/* REFERENCED */
+			intgen_t namelen;
+			namelen = namreg_get( nrh,
+					      tranp->t_namebuf,
+					      sizeof( tranp->t_namebuf ));
+			ASSERT( namelen > 0 );
+			if ( ! strcmp( name, tranp->t_namebuf )) {
+				return nh;
+			}
+		}
+		nh = nexth;
+	}
+
+	return NH_NULL;
+}
+
 /* misc static functions *****************************************************/
 
 #ifdef TREE_CHK
@@ -4333,12 +4947,18 @@ static bool_t
 Node_chk( nh_t nh, nh_t *nexthashhp, nh_t *nextlnkhp )
 {
 	node_t *np;
-	node_t n;
+	nh_t hashh;
+	nh_t lnkh;
+	nh_t parh;
+	nh_t cldh;
+	nh_t sibh;
+	nrh_t nrh;
+	dah_t dah;
 	char nambuf[ NAME_MAX + 1 ];
 	bool_t okaccum;
 
 	mlog( MLOG_NITTY + 1 | MLOG_TREE,
-	      "checking node nh == 0x%x\n",
+	      "checking node nh == 0x%llx\n",
 	      nh );
 
 	okaccum = BOOL_TRUE;
@@ -4352,57 +4972,63 @@ Node_chk( nh_t nh, nh_t *nexthashhp, nh_t *nextlnkhp )
 
 	np = Node_map( nh );
 	ASSERT( np );
-	n = *np;
+	hashh = Node_geth( np, N_HASHH );
+	lnkh = Node_geth( np, N_LNKH );
+	parh = Node_geth( np, N_PARH );
+	cldh = Node_geth( np, N_CLDH );
+	sibh = Node_geth( np, N_SIBH );
+	nrh = Node_geth( np, N_NRH );
+	dah = np->n_dah;
 	Node_unmap( nh, &np );
 
-	if ( ! nexthashhp && n.n_hashh != NH_NULL ) {
+	if ( ! nexthashhp && hashh != NH_NULL ) {
 		mlog( MLOG_NORMAL | MLOG_ERROR | MLOG_TREE, _(
-		      "nh 0x%x np 0x%x hash link not null\n"),
+		      "nh 0x%llx np 0x%x hash link not null\n"),
 		      nh,
 		      np );
 		okaccum = BOOL_FALSE;
 	}
 
-	if ( n.n_hashh != NH_NULL ) {
-		np = Node_map( n.n_hashh );
-		Node_unmap( n.n_hashh, &np );
+	if ( hashh != NH_NULL ) {
+		np = Node_map( hashh );
+		Node_unmap( hashh, &np );
 	}
 
-	if ( n.n_lnkh != NH_NULL ) {
-		np = Node_map( n.n_lnkh );
-		Node_unmap( n.n_lnkh, &np );
+	if ( lnkh != NH_NULL ) {
+		np = Node_map( lnkh );
+		Node_unmap( lnkh, &np );
 	}
 
-	if ( n.n_parh != NH_NULL ) {
-		np = Node_map( n.n_parh );
-		Node_unmap( n.n_parh, &np );
+	if ( parh != NH_NULL ) {
+		np = Node_map( parh );
+		Node_unmap( parh, &np );
 	}
 
-	if ( n.n_cldh != NH_NULL ) {
-		np = Node_map( n.n_cldh );
-		Node_unmap( n.n_cldh, &np );
+	if ( cldh != NH_NULL ) {
+		np = Node_map( cldh );
+		Node_unmap( cldh, &np );
 	}
 
-	if ( n.n_sibh != NH_NULL ) {
-		np = Node_map( n.n_sibh );
-		Node_unmap( n.n_sibh, &np );
+	if ( sibh != NH_NULL ) {
+		np = Node_map( sibh );
+		Node_unmap( sibh, &np );
 	}
 
-	if ( n.n_nrh != NRH_NULL ) {
+	if ( nrh != NRH_NULL ) {
 		intgen_t rval;
-		rval = namreg_get( n.n_nrh, nambuf, sizeof( nambuf ));
+		rval = namreg_get( nrh, nambuf, sizeof( nambuf ));
 		ASSERT( rval >= 0 );
 	}
 
-	if ( n.n_dah != DAH_NULL ) {
-		( void )dirattr_get_mode( n.n_dah );
+	if ( dah != DAH_NULL ) {
+		( void )dirattr_get_mode( dah );
 	}
 
 	if ( nexthashhp ) {
-		*nexthashhp = n.n_hashh;
+		*nexthashhp = hashh;
 	}
 
-	*nextlnkhp = n.n_lnkh;
+	*nextlnkhp = lnkh;
 
 	return okaccum;
 }
@@ -4411,14 +5037,14 @@ bool_t
 tree_chk( void )
 {
 	ix_t hix;
-	size64_t hashlen = persp->p_hashsz / sizeof( nh_t );
+	size64_t hashlen = persp->p_hashsz / HASHENTSZ;
 	bool_t ok;
 	bool_t okaccum;
 
 	okaccum = BOOL_TRUE;
 
 	for ( hix = 0 ; hix < ( ix_t )hashlen ; hix++ ) {
-		nh_t hashh = tranp->t_hashp[ hix ];
+		nh_t hashh = hashent_get( tranp->t_hashp, hix );
 
 		mlog( MLOG_NITTY + 1 | MLOG_TREE,
 		      "checking hix %u\n",
@@ -4461,7 +5087,7 @@ tree_chk2( void )
 	      "tree hierarchy check\n" );
 
 	rootp = Node_map( persp->p_rooth );
-	cldh = rootp->n_cldh;
+	cldh = Node_geth( rootp, N_CLDH );
 	Node_unmap( persp->p_rooth, &rootp );
 
 	ok = tree_chk2_recurse( cldh, persp->p_rooth );
@@ -4489,10 +5115,10 @@ tree_chk2_recurse( nh_t cldh, nh_t parh )
 		cldp = Node_map( cldh );
 		ino = cldp->n_ino;
 		gen = cldp->n_gen;
-		nodeparh = cldp->n_parh;
-		nrh = cldp->n_nrh;
-		grandcldh = cldp->n_cldh;
-		nextcldh = cldp->n_sibh;
+		nodeparh = Node_geth( cldp, N_PARH );
+		nrh = Node_geth( cldp, N_NRH );
+		grandcldh = Node_geth( cldp, N_CLDH );
+		nextcldh = Node_geth( cldp, N_SIBH );
 		Node_unmap( cldh, &cldp );
 
 		if ( parh == persp->p_orphh ) {
@@ -4509,7 +5135,7 @@ tree_chk2_recurse( nh_t cldh, nh_t parh )
 
 		if ( nodeparh == NH_NULL ) {
 			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
-			      "node %x %s %llu %u parent NULL\n"),
+			      "node %llx %s %llu %u parent NULL\n"),
 			      cldh,
 			      tranp->t_namebuf,
 			      ino,
@@ -4517,8 +5143,8 @@ tree_chk2_recurse( nh_t cldh, nh_t parh )
 			return BOOL_FALSE;
 		} else if ( nodeparh != parh ) {
 			mlog( MLOG_NORMAL | MLOG_WARNING | MLOG_TREE, _(
-			      "node %x %s %llu %u parent mismatch: "
-			      "nodepar %x par %x\n"),
+			      "node %llx %s %llu %u parent mismatch: "
+			      "nodepar %llx par %llx\n"),
 			      cldh,
 			      tranp->t_namebuf,
 			      ino,
@@ -4528,7 +5154,7 @@ tree_chk2_recurse( nh_t cldh, nh_t parh )
 			return BOOL_FALSE;
 		} else {
 			mlog( MLOG_DEBUG | MLOG_TREE,
-			      "node %x %s %llu %u  parent %x\n",
+			      "node %llx %s %llu %u  parent %llx\n",
 			      cldh,
 			      tranp->t_namebuf,
 			      ino,
@@ -61,6 +61,12 @@ extern rv_t tree_addent( nh_t dirh,
  */
 extern void tree_enddir( nh_t dirh );
 
+/* tree_refdir - in place of tree_addent( ) calls, for a directory dumped
+ * without its entries (FILEHDR_FLAGS_DIRREF): the entries already in the
+ * tree remain referenced. takes dirh from tree_begindir( ).
+ */
+extern void tree_refdir( nh_t dirh );
+
 #ifdef TREE_CHK
 /* tree_chk - do a sanity check of the tree prior to post-processing and
  * non-dir restoral. returns FALSE if corruption detected.
@@ -83,10 +89,14 @@ extern bool_t tree_subtree_parse( bool_t sensepr, char *path );
 
 extern bool_t tree_post( char *path1, char *path2 );
 
+/* calls funcp for each link to ino to be restored. if keepdatapr, the
+ * existing file is kept, not unlinked before funcp restores it.
+ */
 extern rv_t tree_cb_links( xfs_ino_t ino,
 			   u_int32_t biggen,
 			   int32_t ctime,
 			   int32_t mtime,
+			   bool_t keepdatapr,
 			   bool_t ( * funcp )( void *contextp,
 					       bool_t linkpr,
 					       char *path1,
@@ -95,6 +105,17 @@ extern rv_t tree_cb_links( xfs_ino_t ino,
 			   char *path1,
 			   char *path2 );
 
+/* like tree_cb_links( ), but for a table of contents taken from the
+ * directories alone, and for finding the file an extent ref copies
+ * from: calls the callback with the pathname of each selected hard
+ * link to ino, whatever its generation, until the callback returns
+ * FALSE. returns FALSE if the callback does.
+ */
+extern bool_t tree_cb_ino( xfs_ino_t ino,
+			   bool_t ( * funcp )( void *contextp, char *path ),
+			   void *contextp,
+			   char *path );
+
 /* called after all dirs have been restored. adjusts the ref flags,
  * by noting that dirents not refed because their parents were not dumped
  * are virtually reffed if their parents are refed.
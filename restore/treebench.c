@@ -0,0 +1,1122 @@
+/*
+ * Copyright (c) 2026 The xfsdump contributors.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it would be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write the Free Software Foundation,
+ * Inc.,  51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <xfs/xfs.h>
+#include <xfs/jdm.h>
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ftw.h>
+#include <limits.h>
+
+#include "types.h"
+#include "exit.h"
+#include "util.h"
+#include "openutil.h"
+#include "qlock.h"
+#include "lock.h"
+#include "stream.h"
+#include "mlog.h"
+#include "global.h"
+#include "drive.h"
+#include "content.h"
+#include "content_inode.h"
+#include "arch_xlate.h"
+#include "inomap.h"
+#include "namreg.h"
+#include "dirattr.h"
+#include "node.h"
+#include "tree.h"
+#include "win.h"
+
+
+/* treebench.c - synthetic workload benchmark for the restore tree engine
+ *
+ * generates the directory portion of a dump of a complete tree of
+ * directories, and feeds it to the tree, node, name registry, directory
+ * attribute, window and inode map abstractions exactly as applydirdump( )
+ * and treepost( ) in content.c would, against a fresh housekeeping
+ * directory. reports the rate of each phase, the number of nodes
+ * allocated, name registry lookups, window maps and mmap calls (misses),
+ * and the peak resident set size.
+ *
+ * with -c, a second, incremental session is restored on top of the
+ * first, in which the given percentage of directories are changed: each
+ * of their files is either kept, renamed, deleted or replaced by a new
+ * inode. the changed directories and their ancestors are dumped. each
+ * session runs in its own process, as would each xfsrestore -r.
+ *
+ * everything is a deterministic function of the seed, so runs with the
+ * same arguments do the same work. a working directory given on the
+ * command line is left behind; the default one is removed on exit.
+ */
+
+
+/* structure definitions used locally ****************************************/
+
+#define TB_ROOTINO	128
+	/* root ino of the synthetic file system
+	 */
+
+#define TB_PERSPGCNT	4
+	/* pages of persistent header for the tree and inomap state files;
+	 * content.c sizes this to its own pers_t
+	 */
+
+/* the in-memory media file from which inomap_restore_pers( ) reads
+ * the inode map
+ */
+struct tb_media {
+	char *tm_bufp;
+	size_t tm_bufsz;
+	size_t tm_off;
+};
+
+typedef struct tb_media tb_media_t;
+
+/* statistics sampled at the beginning and end of each phase
+ */
+struct tb_sample {
+	u_int64_t ts_usecs;
+	size64_t ts_nodecnt;
+	size64_t ts_namgetcnt;
+	size64_t ts_winmapcnt;
+	size64_t ts_winmmapcnt;
+};
+
+typedef struct tb_sample tb_sample_t;
+
+
+/* declarations of externally defined global symbols *************************/
+
+extern int optind;
+extern int opterr;
+extern char *optarg;
+
+
+/* forward declarations of locally defined static functions ******************/
+
+static bool_t tb_session( ix_t sessix );
+static bool_t tb_dirs( ix_t sessix, size64_t *entcntp );
+static bool_t tb_inomap( ix_t sessix, char *hkdir );
+static bool_t tb_entry( ix_t sessix,
+			size64_t dirix,
+			size64_t entix,
+			xfs_ino_t *inop,
+			char *namebuf,
+			size_t *namelenp );
+static bool_t tb_dumpedpr( ix_t sessix, size64_t dirix );
+static bool_t tb_churnedpr( ix_t sessix, size64_t dirix );
+static void tb_mkname( char pfx,
+		       size64_t ix,
+		       size64_t dirix,
+		       size64_t entix,
+		       char *namebuf,
+		       size_t *namelenp );
+static u_int64_t tb_hash( size64_t dirix, size64_t entix, u_int64_t salt );
+static seg_t *tb_getseg( hnk_t *hnkp, xfs_ino_t ino );
+static intgen_t tb_getstate( hnk_t *hnkp, xfs_ino_t ino );
+static void tb_setstate( hnk_t *hnkp, xfs_ino_t ino, intgen_t state );
+static char *tb_read( drive_t *drivep,
+		      size_t wantedcnt,
+		      size_t *actualcntp,
+		      intgen_t *statp );
+static void tb_return_read_buf( drive_t *drivep, char *bufp, size_t bufsz );
+static void tb_sample( tb_sample_t *tsp );
+static void tb_report( char *phase,
+		       tb_sample_t *begp,
+		       tb_sample_t *endp,
+		       size64_t opcnt,
+		       char *opname );
+static u_int64_t tb_usecs( void );
+static bool_t tb_getnum( char *arg, size64_t *valp );
+static intgen_t tb_done( intgen_t exitcode );
+static intgen_t tb_rmcb( const char *path,
+			 const struct stat *statp,
+			 intgen_t flag,
+			 struct FTW *ftwp );
+
+
+/* definition of globals normally defined in main.c, drive.c, content.c *****/
+
+char *progname = 0;
+bool_t miniroot = BOOL_TRUE;
+pid_t parentpid;
+size_t pgsz;
+size_t pgmask;
+size_t perssz;
+bool_t restore_rootdir_permissions = BOOL_FALSE;
+drive_t **drivepp = 0;
+
+
+/* definition of locally defined static variables *****************************/
+
+/* workload parameters
+ */
+static size64_t tb_depth = 3;
+static size64_t tb_fanout = 8;
+static size64_t tb_filecnt = 32;
+static size64_t tb_namemin = 4;
+static size64_t tb_namemax = 24;
+static size64_t tb_linkpct = 0;
+static size64_t tb_churnpct = 0;
+static size64_t tb_seed = 1;
+static size64_t tb_vmsz = 0;
+static bool_t tb_toconlypr = BOOL_FALSE;
+
+/* derived from the above
+ */
+static size64_t tb_dircnt;
+	/* directories in the complete tree
+	 */
+static size64_t tb_leafbegix;
+	/* index of the first directory with no subdirectories
+	 */
+static xfs_ino_t tb_filebegino;
+	/* ino of the first file of the first session
+	 */
+static xfs_ino_t tb_lastino;
+static u_char_t *tb_dumpedmapp;
+	/* directories dumped by the incremental session
+	 */
+static char *tb_hkdir;
+static char *tb_dstdir;
+static char *tb_tmpdir;
+	/* the default working directory, removed by tb_done( )
+	 */
+
+
+/* definition of locally defined global functions ****************************/
+
+void
+usage( void )
+{
+	fprintf( stderr,
+		 "usage: %s [-d depth] [-f fanout] [-n files per dir]\n"
+		 "\t[-l min name length] [-L max name length]"
+		 " [-H hard link %%]\n"
+		 "\t[-c incremental churn %%] [-s seed] [-m vm MB] [-t]"
+		 " [-v verbosity]\n"
+		 "\t[workdir]\n",
+		 progname );
+}
+
+/* ARGSUSED */
+bool_t
+content_overwrite_ok( char *path,
+		      int32_t ctime,
+		      int32_t mtime,
+		      char **reasonstrp,
+		      bool_t *exists )
+{
+	*exists = BOOL_FALSE;
+	return BOOL_TRUE;
+}
+
+int
+main( int argc, char *argv[ ] )
+{
+	char workbuf[ MAXPATHLEN ];
+	char *workdir;
+	intgen_t level;
+	size64_t sesscnt;
+	size64_t lvlcnt;
+	ix_t sessix;
+	intgen_t c;
+
+	progname = argv[ 0 ];
+	level = MLOG_VERBOSE;
+	workdir = 0;
+
+	opterr = 0;
+	while ( ( c = getopt( argc, argv, "c:d:f:H:l:L:m:n:s:tv:" )) != EOF ) {
+		size64_t *valp;
+
+		switch ( c ) {
+		case 'c':
+			valp = &tb_churnpct;
+			break;
+		case 'd':
+			valp = &tb_depth;
+			break;
+		case 'f':
+			valp = &tb_fanout;
+			break;
+		case 'H':
+			valp = &tb_linkpct;
+			break;
+		case 'l':
+			valp = &tb_namemin;
+			break;
+		case 'L':
+			valp = &tb_namemax;
+			break;
+		case 'm':
+			valp = &tb_vmsz;
+			break;
+		case 'n':
+			valp = &tb_filecnt;
+			break;
+		case 's':
+			valp = &tb_seed;
+			break;
+		case 't':
+			tb_toconlypr = BOOL_TRUE;
+			continue;
+		case 'v':
+			level = atoi( optarg );
+			if ( level < MLOG_SILENT || level > MLOG_NITTY ) {
+				usage( );
+				return EXIT_ERROR;
+			}
+			continue;
+		default:
+			usage( );
+			return EXIT_ERROR;
+		}
+		if ( ! tb_getnum( optarg, valp )) {
+			fprintf( stderr,
+				 "%s: -%c argument invalid\n",
+				 progname,
+				 c );
+			usage( );
+			return EXIT_ERROR;
+		}
+	}
+	if ( optind < argc - 1 ) {
+		usage( );
+		return EXIT_ERROR;
+	}
+	if ( optind == argc - 1 ) {
+		workdir = argv[ optind ];
+	}
+
+	if ( tb_fanout < 1
+	     ||
+	     tb_namemin < 1
+	     ||
+	     tb_namemax < tb_namemin
+	     ||
+	     tb_namemax > NAME_MAX
+	     ||
+	     tb_linkpct > 100
+	     ||
+	     tb_churnpct > 100 ) {
+		fprintf( stderr,
+			 "%s: workload parameter out of range\n",
+			 progname );
+		return EXIT_ERROR;
+	}
+
+	/* size the tree: one root, then fanout subdirectories per
+	 * directory to the given depth
+	 */
+	tb_dircnt = 1;
+	lvlcnt = 1;
+	tb_leafbegix = 0;
+	while ( tb_depth-- > 0 ) {
+		tb_leafbegix = tb_dircnt;
+		lvlcnt *= tb_fanout;
+		tb_dircnt += lvlcnt;
+		if ( tb_dircnt > ( size64_t )INT32MAX ) {
+			fprintf( stderr,
+				 "%s: too many directories\n",
+				 progname );
+			return EXIT_ERROR;
+		}
+	}
+	if ( tb_dircnt == 1 ) {
+		tb_leafbegix = 0;
+	}
+	if ( tb_filecnt > ( size64_t )INT32MAX / tb_dircnt ) {
+		fprintf( stderr,
+			 "%s: too many files\n",
+			 progname );
+		return EXIT_ERROR;
+	}
+	tb_filebegino = TB_ROOTINO + tb_dircnt;
+	tb_lastino = tb_filebegino + 2 * tb_dircnt * tb_filecnt - 1;
+
+	/* the changed directories of the incremental session and their
+	 * ancestors are dumped
+	 */
+	sesscnt = tb_churnpct ? 2 : 1;
+	if ( sesscnt > 1 ) {
+		size64_t dirix;
+
+		tb_dumpedmapp = ( u_char_t * )calloc( ( size_t )tb_dircnt, 1 );
+		ASSERT( tb_dumpedmapp );
+		for ( dirix = 0 ; dirix < tb_dircnt ; dirix++ ) {
+			size64_t ix;
+
+			if ( ! tb_churnedpr( 1, dirix )) {
+				continue;
+			}
+			for ( ix = dirix ; ! tb_dumpedmapp[ ix ] ; ) {
+				tb_dumpedmapp[ ix ] = 1;
+				if ( ix == 0 ) {
+					break;
+				}
+				ix = ( ix - 1 ) / tb_fanout;
+			}
+		}
+	}
+
+	/* create the working, housekeeping and destination directories
+	 */
+	if ( ! workdir ) {
+		strcpy( workbuf, "/var/tmp/treebench.XXXXXX" );
+		workdir = mkdtemp( workbuf );
+		if ( ! workdir ) {
+			fprintf( stderr,
+				 "%s: mkdtemp failed: %s\n",
+				 progname,
+				 strerror( errno ));
+			return EXIT_ERROR;
+		}
+		tb_tmpdir = strdup( workdir );
+		ASSERT( tb_tmpdir );
+	} else if ( mkdir( workdir, S_IRWXU ) && errno != EEXIST ) {
+		fprintf( stderr,
+			 "%s: mkdir %s failed: %s\n",
+			 progname,
+			 workdir,
+			 strerror( errno ));
+		return tb_done( EXIT_ERROR );
+	}
+	if ( ! realpath( workdir, workbuf )) {
+		fprintf( stderr,
+			 "%s: %s: %s\n",
+			 progname,
+			 workdir,
+			 strerror( errno ));
+		return tb_done( EXIT_ERROR );
+	}
+	tb_hkdir = open_pathalloc( workbuf, "hk", 0 );
+	tb_dstdir = open_pathalloc( workbuf, "dst", 0 );
+	if ( mkdir( tb_hkdir, S_IRWXU ) || mkdir( tb_dstdir, S_IRWXU )) {
+		fprintf( stderr,
+			 "%s: %s must be empty: %s\n",
+			 progname,
+			 workbuf,
+			 strerror( errno ));
+		return tb_done( EXIT_ERROR );
+	}
+
+	/* bring up what main.c would for the tree abstractions
+	 */
+	mlog_init0( );
+	parentpid = getpid( );
+	stream_init( );
+	if ( ! qlock_init( miniroot ) || ! mlog_init2( ) || ! lock_init( )) {
+		return tb_done( EXIT_ERROR );
+	}
+	mlog_override_level( level );
+	pgsz = ( size_t )getpagesize( );
+	pgmask = pgsz - 1;
+	perssz = TB_PERSPGCNT * pgsz;
+	if ( ! tb_vmsz ) {
+		struct rlimit64 rlimit64;
+		( void )getrlimit64( RLIMIT_AS, &rlimit64 );
+		tb_vmsz = ( size64_t )rlimit64.rlim_cur / 4;
+	} else {
+		tb_vmsz *= 1024 * 1024;
+	}
+
+	printf( "%s: %llu dirs, %llu entries per dir, "
+		"names %llu-%llu chars, %llu%% hard links",
+		progname,
+		tb_dircnt,
+		tb_fanout + tb_filecnt,
+		tb_namemin,
+		tb_namemax,
+		tb_linkpct );
+	if ( sesscnt > 1 ) {
+		printf( ", %llu%% churn", tb_churnpct );
+	}
+	printf( "%s\n%s: working in %s\n",
+		tb_toconlypr ? ", table of contents only" : "",
+		progname,
+		workbuf );
+	fflush( stdout );
+
+	/* each session is restored by its own process, so only the
+	 * persistent state is carried over
+	 */
+	for ( sessix = 0 ; sessix < ( ix_t )sesscnt ; sessix++ ) {
+		pid_t pid;
+		intgen_t status;
+
+		pid = fork( );
+		if ( pid < 0 ) {
+			fprintf( stderr,
+				 "%s: fork failed: %s\n",
+				 progname,
+				 strerror( errno ));
+			return tb_done( EXIT_ERROR );
+		}
+		if ( pid == 0 ) {
+			parentpid = getpid( );
+			exit( tb_session( sessix ) ? EXIT_NORMAL : EXIT_ERROR );
+		}
+		if ( waitpid( pid, &status, 0 ) < 0
+		     ||
+		     ! WIFEXITED( status )
+		     ||
+		     WEXITSTATUS( status ) != EXIT_NORMAL ) {
+			fprintf( stderr,
+				 "%s: session %u failed\n",
+				 progname,
+				 ( unsigned int )sessix );
+			return tb_done( EXIT_ERROR );
+		}
+	}
+
+	return tb_done( EXIT_NORMAL );
+}
+
+
+/* definition of locally defined static functions ****************************/
+
+/* restores one session's directories, in the order content.c does
+ */
+static bool_t
+tb_session( ix_t sessix )
+{
+	tb_sample_t begs;
+	tb_sample_t ends;
+	tb_sample_t sess;
+	size64_t dumpdircnt;
+	size64_t entcnt;
+	struct rusage ru;
+	char *path1;
+	char *path2;
+	bool_t ok;
+
+	path1 = ( char * )calloc( 1, 2 * MAXPATHLEN );
+	ASSERT( path1 );
+	path2 = ( char * )calloc( 1, 2 * MAXPATHLEN );
+	ASSERT( path2 );
+	if ( chdir( tb_dstdir )) {
+		fprintf( stderr,
+			 "%s: chdir %s failed: %s\n",
+			 progname,
+			 tb_dstdir,
+			 strerror( errno ));
+		return BOOL_FALSE;
+	}
+
+	if ( sessix == 0 ) {
+		dumpdircnt = tb_dircnt;
+	} else {
+		size64_t dirix;
+
+		for ( dumpdircnt = 0, dirix = 0 ; dirix < tb_dircnt ; dirix++ ) {
+			dumpdircnt += tb_dumpedmapp[ dirix ];
+		}
+	}
+	printf( "session %u: %s, %llu dirs dumped\n",
+		( unsigned int )sessix,
+		sessix ? "incremental" : "full",
+		dumpdircnt );
+
+	tb_sample( &begs );
+	sess = begs;
+
+	/* initialize or sync up with the abstractions
+	 */
+	ok = dirattr_init( tb_hkdir, BOOL_FALSE, dumpdircnt );
+	if ( ok && sessix == 0 ) {
+		ok = namreg_init( tb_hkdir,
+				  BOOL_FALSE,
+				  tb_dircnt + tb_dircnt * tb_filecnt );
+		ok = ok && tree_init( tb_hkdir,
+				      tb_dstdir,
+				      tb_toconlypr,
+				      BOOL_FALSE,
+				      TB_ROOTINO,
+				      TB_ROOTINO,
+				      tb_lastino,
+				      tb_dircnt,
+				      tb_dircnt * tb_filecnt,
+				      tb_vmsz,
+				      BOOL_TRUE,
+				      BOOL_FALSE,
+				      BOOL_FALSE );
+	} else if ( ok ) {
+		ok = namreg_init( tb_hkdir, BOOL_TRUE, 0 );
+		ok = ok && inomap_sync_pers( tb_hkdir );
+		ok = ok && tree_sync( tb_hkdir,
+				      tb_dstdir,
+				      tb_toconlypr,
+				      BOOL_FALSE,
+				      BOOL_FALSE );
+	}
+	if ( ! ok ) {
+		return BOOL_FALSE;
+	}
+	tree_marknoref( );
+	ok = tb_inomap( sessix, tb_hkdir );
+	if ( ! ok ) {
+		return BOOL_FALSE;
+	}
+	tb_sample( &ends );
+	tb_report( "init", &begs, &ends, 0, 0 );
+
+	/* the directory dump
+	 */
+	begs = ends;
+	win_locks_off( );
+	ok = tb_dirs( sessix, &entcnt );
+	win_locks_on( );
+	if ( ! ok ) {
+		return BOOL_FALSE;
+	}
+	if ( dirattr_flush( ) != RV_OK || namreg_flush( ) != RV_OK ) {
+		return BOOL_FALSE;
+	}
+	tb_sample( &ends );
+	tb_report( "dirs", &begs, &ends, entcnt, "entries" );
+
+	/* post-processing, as treepost( ) with no subtree selections
+	 */
+	begs = ends;
+	ok = tree_adjref( );
+	if ( ok ) {
+		tree_markallsubtree( BOOL_TRUE );
+		ok = tree_post( path1, path2 );
+	}
+	if ( ! ok ) {
+		return BOOL_FALSE;
+	}
+	tb_sample( &ends );
+	tb_report( "post", &begs, &ends, 0, 0 );
+
+	/* directory attributes and orphanage, as finalize( )
+	 */
+	if ( ! tb_toconlypr ) {
+		begs = ends;
+		ok = tree_setattr( path1 );
+		ok = ok && tree_delorph( );
+		if ( ! ok ) {
+			return BOOL_FALSE;
+		}
+		tb_sample( &ends );
+		tb_report( "attr", &begs, &ends, 0, 0 );
+	}
+	inomap_del_pers( tb_hkdir );
+
+	tb_report( "total", &sess, &ends, 0, 0 );
+	( void )getrusage( RUSAGE_SELF, &ru );
+	printf( "  peak rss %ld KB\n", ru.ru_maxrss );
+	fflush( stdout );
+
+	return BOOL_TRUE;
+}
+
+/* feeds the dumped directories to the tree in ino order, as
+ * applydirdump( )
+ */
+static bool_t
+tb_dirs( ix_t sessix, size64_t *entcntp )
+{
+	char namebuf[ NAME_MAX + 1 ];
+	filehdr_t fhdr;
+	size64_t entcnt;
+	size64_t dirix;
+
+	entcnt = 0;
+	memset( ( void * )&fhdr, 0, sizeof( fhdr ));
+	fhdr.fh_stat.bs_mode = S_IFDIR | S_IRWXU;
+	fhdr.fh_stat.bs_nlink = 2;
+
+	for ( dirix = 0 ; dirix < tb_dircnt ; dirix++ ) {
+		size64_t entix;
+		dah_t dah;
+		nh_t dirh;
+
+		if ( ! tb_dumpedpr( sessix, dirix )) {
+			continue;
+		}
+
+		fhdr.fh_stat.bs_ino = TB_ROOTINO + dirix;
+		dah = DAH_NULL;
+		dirh = tree_begindir( &fhdr, &dah );
+		if ( dirh == NH_NULL ) {
+			return BOOL_FALSE;
+		}
+
+		/* subdirectories first, then files
+		 */
+		for ( entix = 0 ; entix < tb_fanout + tb_filecnt ; entix++ ) {
+			xfs_ino_t ino;
+			size_t namelen;
+
+			if ( ! tb_entry( sessix,
+					 dirix,
+					 entix,
+					 &ino,
+					 namebuf,
+					 &namelen )) {
+				continue;
+			}
+			if ( tree_addent( dirh,
+					  ino,
+					  0,
+					  namebuf,
+					  namelen ) != RV_OK ) {
+				return BOOL_FALSE;
+			}
+			entcnt++;
+		}
+		tree_enddir( dirh );
+	}
+
+	*entcntp = entcnt;
+	return BOOL_TRUE;
+}
+
+/* builds the session's inode map and has inomap_restore_pers( ) read it
+ * from memory, as it would from the media
+ */
+static bool_t
+tb_inomap( ix_t sessix, char *hkdir )
+{
+	content_inode_hdr_t scrhdr;
+	drive_ops_t dops;
+	drive_t drive;
+	tb_media_t media;
+	xfs_ino_t firstbase;
+	size64_t segcnt;
+	size64_t hnkcnt;
+	size64_t dircnt;
+	size64_t nondircnt;
+	size64_t dirix;
+	size64_t ix;
+	hnk_t *hnkp;
+	hnk_t *mhnkp;
+	xfs_ino_t ino;
+	rv_t rv;
+
+	firstbase = TB_ROOTINO & ~( ( xfs_ino_t )INOPERSEG - 1 );
+	segcnt = ( tb_lastino - firstbase ) / INOPERSEG + 1;
+	hnkcnt = ( segcnt + SEGPERHNK - 1 ) / SEGPERHNK;
+	hnkp = ( hnk_t * )calloc( ( size_t )hnkcnt, sizeof( hnk_t ));
+	ASSERT( hnkp );
+	for ( ix = 0 ; ix < segcnt ; ix++ ) {
+		seg_t *segp = &hnkp[ ix / SEGPERHNK ].seg[ ix % SEGPERHNK ];
+		segp->base = firstbase + ix * INOPERSEG;
+		hnkp[ ix / SEGPERHNK ].maxino = segp->base + INOPERSEG - 1;
+	}
+
+	/* every dir and referenced file is in the map. a full dump has
+	 * dumped them all. an incremental has dumped the dirs it dumps,
+	 * and the files it renamed or replaced.
+	 */
+	for ( dirix = 0 ; dirix < tb_dircnt ; dirix++ ) {
+		bool_t dumpedpr = tb_dumpedpr( sessix, dirix );
+		size64_t entix;
+
+		tb_setstate( hnkp,
+			     TB_ROOTINO + dirix,
+			     dumpedpr ? MAP_DIR_CHANGE : MAP_DIR_NOCHNG );
+		for ( entix = tb_fanout
+		      ;
+		      entix < tb_fanout + tb_filecnt
+		      ;
+		      entix++ ) {
+			xfs_ino_t oldino;
+			size_t namelen;
+			char oldnamebuf[ NAME_MAX + 1 ];
+			char namebuf[ NAME_MAX + 1 ];
+
+			( void )tb_entry( 0,
+					  dirix,
+					  entix,
+					  &oldino,
+					  oldnamebuf,
+					  &namelen );
+			if ( sessix == 0 ) {
+				tb_setstate( hnkp, oldino, MAP_NDR_CHANGE );
+				continue;
+			}
+			if ( ! tb_entry( sessix,
+					 dirix,
+					 entix,
+					 &ino,
+					 namebuf,
+					 &namelen )) {
+				continue;
+			}
+			if ( ino != oldino || strcmp( namebuf, oldnamebuf )) {
+				tb_setstate( hnkp, ino, MAP_NDR_CHANGE );
+			} else if ( tb_getstate( hnkp, ino ) == MAP_INO_UNUSED ) {
+				tb_setstate( hnkp, ino, MAP_NDR_NOCHNG );
+			}
+		}
+	}
+
+	/* count what went in, as the dump's inomap_build( ) would
+	 */
+	dircnt = 0;
+	nondircnt = 0;
+	for ( ino = firstbase ; ino < firstbase + segcnt * INOPERSEG ; ino++ ) {
+		intgen_t state = tb_getstate( hnkp, ino );
+
+		if ( state == MAP_DIR_CHANGE || state == MAP_DIR_NOCHNG ) {
+			dircnt++;
+		} else if ( state != MAP_INO_UNUSED ) {
+			nondircnt++;
+		}
+	}
+
+	/* translate to media format
+	 */
+	mhnkp = ( hnk_t * )calloc( ( size_t )hnkcnt, sizeof( hnk_t ));
+	ASSERT( mhnkp );
+	for ( ix = 0 ; ix < hnkcnt ; ix++ ) {
+		xlate_hnk( &mhnkp[ ix ], &hnkp[ ix ], -1 );
+	}
+	free( ( void * )hnkp );
+
+	memset( ( void * )&scrhdr, 0, sizeof( scrhdr ));
+	scrhdr.cih_level = ( int32_t )sessix;
+	scrhdr.cih_rootino = TB_ROOTINO;
+	scrhdr.cih_inomap_hnkcnt = hnkcnt;
+	scrhdr.cih_inomap_segcnt = segcnt;
+	scrhdr.cih_inomap_dircnt = dircnt;
+	scrhdr.cih_inomap_nondircnt = nondircnt;
+	scrhdr.cih_inomap_firstino = TB_ROOTINO;
+	scrhdr.cih_inomap_lastino = tb_lastino;
+
+	memset( ( void * )&dops, 0, sizeof( dops ));
+	dops.do_read = tb_read;
+	dops.do_return_read_buf = tb_return_read_buf;
+	memset( ( void * )&drive, 0, sizeof( drive ));
+	drive.d_opsp = &dops;
+	drive.d_contextp = ( void * )&media;
+	media.tm_bufp = ( char * )mhnkp;
+	media.tm_bufsz = ( size_t )hnkcnt * sizeof( hnk_t );
+	media.tm_off = 0;
+
+	rv = inomap_restore_pers( &drive, &scrhdr, hkdir );
+	free( ( void * )mhnkp );
+
+	return rv == RV_OK;
+}
+
+/* generates an entry of a directory: the subdirectories, then the files.
+ * returns FALSE if the entry is not present in the session.
+ */
+static bool_t
+tb_entry( ix_t sessix,
+	  size64_t dirix,
+	  size64_t entix,
+	  xfs_ino_t *inop,
+	  char *namebuf,
+	  size_t *namelenp )
+{
+	size64_t fileix;
+	size64_t ino;
+	char pfx;
+
+	if ( entix < tb_fanout ) {
+		if ( dirix >= tb_leafbegix ) {
+			return BOOL_FALSE;
+		}
+		*inop = TB_ROOTINO + dirix * tb_fanout + 1 + entix;
+		tb_mkname( 'd', entix, dirix, entix, namebuf, namelenp );
+		return BOOL_TRUE;
+	}
+
+	/* a file is either its own inode, or a hard link to a file
+	 * of an earlier directory
+	 */
+	fileix = entix - tb_fanout;
+	ino = tb_filebegino + dirix * tb_filecnt + fileix;
+	if ( dirix > 0
+	     &&
+	     tb_hash( dirix, entix, 1 ) % 100 < tb_linkpct ) {
+		ino = tb_filebegino
+		      +
+		      ( tb_hash( dirix, entix, 2 ) % dirix ) * tb_filecnt
+		      +
+		      tb_hash( dirix, entix, 3 ) % tb_filecnt;
+	}
+	pfx = 'f';
+
+	/* churn: keep, rename, delete or replace with a new inode
+	 */
+	if ( tb_churnedpr( sessix, dirix )) {
+		switch ( tb_hash( dirix, entix, 4 ) % 4 ) {
+		case 1:
+			pfx = 'r';
+			break;
+		case 2:
+			return BOOL_FALSE;
+		case 3:
+			ino += tb_dircnt * tb_filecnt;
+			break;
+		}
+	}
+
+	*inop = ( xfs_ino_t )ino;
+	tb_mkname( pfx, fileix, dirix, entix, namebuf, namelenp );
+	return BOOL_TRUE;
+}
+
+static bool_t
+tb_dumpedpr( ix_t sessix, size64_t dirix )
+{
+	return sessix == 0 || tb_dumpedmapp[ dirix ];
+}
+
+static bool_t
+tb_churnedpr( ix_t sessix, size64_t dirix )
+{
+	return sessix > 0 && tb_hash( dirix, 0, 5 ) % 100 < tb_churnpct;
+}
+
+/* a name is a prefix unique within the directory, padded out with
+ * letters to a length drawn uniformly from the configured range
+ */
+static void
+tb_mkname( char pfx,
+	   size64_t ix,
+	   size64_t dirix,
+	   size64_t entix,
+	   char *namebuf,
+	   size_t *namelenp )
+{
+	static char digits[ ] = "0123456789abcdefghijklmnopqrstuvwxyz";
+	size_t len;
+	size_t namelen;
+	u_int64_t h;
+
+	len = 0;
+	namebuf[ len++ ] = pfx;
+	do {
+		namebuf[ len++ ] = digits[ ix % 36 ];
+		ix /= 36;
+	} while ( ix );
+
+	namelen = ( size_t )( tb_namemin
+			      +
+			      tb_hash( dirix, entix, 6 )
+			      %
+			      ( tb_namemax - tb_namemin + 1 ));
+	if ( namelen > len + 1 ) {
+		namebuf[ len++ ] = '.';
+		h = tb_hash( dirix, entix, 7 );
+		while ( len < namelen ) {
+			namebuf[ len++ ] = ( char )( 'a' + h % 26 );
+			h = h / 26 ? h / 26 : tb_hash( dirix, entix, len );
+		}
+	}
+	namebuf[ len ] = 0;
+	*namelenp = len;
+}
+
+/* splitmix64 of the seed, the position and a salt per use
+ */
+static u_int64_t
+tb_hash( size64_t dirix, size64_t entix, u_int64_t salt )
+{
+	u_int64_t z;
+
+	z = tb_seed * 0x9e3779b97f4a7c15ULL
+	    ^
+	    dirix * 0xbf58476d1ce4e5b9ULL
+	    ^
+	    entix * 0x94d049bb133111ebULL
+	    ^
+	    salt;
+	z = ( z ^ ( z >> 30 )) * 0xbf58476d1ce4e5b9ULL;
+	z = ( z ^ ( z >> 27 )) * 0x94d049bb133111ebULL;
+	return z ^ ( z >> 31 );
+}
+
+/* map state accessors for the contiguous segment array built by
+ * tb_inomap( ). the bits are laid out as in inomap.c.
+ */
+static seg_t *
+tb_getseg( hnk_t *hnkp, xfs_ino_t ino )
+{
+	size64_t ix;
+
+	ix = ( ino - hnkp[ 0 ].seg[ 0 ].base ) / INOPERSEG;
+	return &hnkp[ ix / SEGPERHNK ].seg[ ix % SEGPERHNK ];
+}
+
+static intgen_t
+tb_getstate( hnk_t *hnkp, xfs_ino_t ino )
+{
+	seg_t *segp = tb_getseg( hnkp, ino );
+	u_int64_t mask = ( u_int64_t )1 << ( ino - segp->base );
+
+	return ( ( segp->lobits & mask ) ? 1 : 0 )
+	       |
+	       ( ( segp->mebits & mask ) ? 2 : 0 )
+	       |
+	       ( ( segp->hibits & mask ) ? 4 : 0 );
+}
+
+static void
+tb_setstate( hnk_t *hnkp, xfs_ino_t ino, intgen_t state )
+{
+	seg_t *segp = tb_getseg( hnkp, ino );
+	u_int64_t mask;
+
+	mask = ( u_int64_t )1 << ( ino - segp->base );
+	segp->lobits &= ~mask;
+	segp->mebits &= ~mask;
+	segp->hibits &= ~mask;
+	if ( state & 1 ) {
+		segp->lobits |= mask;
+	}
+	if ( state & 2 ) {
+		segp->mebits |= mask;
+	}
+	if ( state & 4 ) {
+		segp->hibits |= mask;
+	}
+}
+
+static char *
+tb_read( drive_t *drivep,
+	 size_t wantedcnt,
+	 size_t *actualcntp,
+	 intgen_t *statp )
+{
+	tb_media_t *tmp = ( tb_media_t * )drivep->d_contextp;
+	char *bufp;
+
+	if ( tmp->tm_off >= tmp->tm_bufsz ) {
+		*actualcntp = 0;
+		*statp = DRIVE_ERROR_EOD;
+		return 0;
+	}
+	bufp = tmp->tm_bufp + tmp->tm_off;
+	*actualcntp = min( wantedcnt, tmp->tm_bufsz - tmp->tm_off );
+	tmp->tm_off += *actualcntp;
+	*statp = 0;
+	return bufp;
+}
+
+/* ARGSUSED */
+static void
+tb_return_read_buf( drive_t *drivep, char *bufp, size_t bufsz )
+{
+}
+
+static void
+tb_sample( tb_sample_t *tsp )
+{
+	tsp->ts_usecs = tb_usecs( );
+	tsp->ts_nodecnt = node_getnum_allocs( );
+	tsp->ts_namgetcnt = namreg_getnum_gets( );
+	tsp->ts_winmapcnt = win_getnum_maps( );
+	tsp->ts_winmmapcnt = win_getnum_mmaps( );
+}
+
+static void
+tb_report( char *phase,
+	   tb_sample_t *begp,
+	   tb_sample_t *endp,
+	   size64_t opcnt,
+	   char *opname )
+{
+	double secs;
+	size64_t nodecnt;
+	size64_t namgetcnt;
+
+	secs = ( double )( endp->ts_usecs - begp->ts_usecs ) / 1000000.0;
+	if ( secs <= 0.0 ) {
+		secs = 0.000001;
+	}
+	nodecnt = endp->ts_nodecnt - begp->ts_nodecnt;
+	namgetcnt = endp->ts_namgetcnt - begp->ts_namgetcnt;
+
+	printf( "  %-5s %9.3f s", phase, secs );
+	if ( opname ) {
+		printf( "  %llu %s (%.0f/s)",
+			opcnt,
+			opname,
+			( double )opcnt / secs );
+	}
+	printf( "  nodes %llu (%.0f/s)  namreg lookups %llu (%.0f/s)"
+		"  win maps %llu misses %llu\n",
+		nodecnt,
+		( double )nodecnt / secs,
+		namgetcnt,
+		( double )namgetcnt / secs,
+		endp->ts_winmapcnt - begp->ts_winmapcnt,
+		endp->ts_winmmapcnt - begp->ts_winmmapcnt );
+}
+
+static u_int64_t
+tb_usecs( void )
+{
+	struct timeval tv;
+
+	( void )gettimeofday( &tv, 0 );
+	return ( u_int64_t )tv.tv_sec * 1000000 + ( u_int64_t )tv.tv_usec;
+}
+
+static bool_t
+tb_getnum( char *arg, size64_t *valp )
+{
+	char *endp;
+
+	errno = 0;
+	*valp = ( size64_t )strtoull( arg, &endp, 0 );
+	return ! errno && endp != arg && *endp == 0;
+}
+
+/* removes the default working directory, if main( ) made one
+ */
+static intgen_t
+tb_done( intgen_t exitcode )
+{
+	if ( ! tb_tmpdir ) {
+		return exitcode;
+	}
+	if ( nftw( tb_tmpdir, tb_rmcb, 16, FTW_DEPTH | FTW_PHYS )) {
+		fprintf( stderr,
+			 "%s: unable to remove %s: %s\n",
+			 progname,
+			 tb_tmpdir,
+			 strerror( errno ));
+	}
+	free( ( void * )tb_tmpdir );
+	tb_tmpdir = 0;
+	return exitcode;
+}
+
+/* ARGSUSED */
+static intgen_t
+tb_rmcb( const char *path,
+	 const struct stat *statp,
+	 intgen_t flag,
+	 struct FTW *ftwp )
+{
+	return remove( path );
+}
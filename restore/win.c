@@ -92,6 +92,9 @@ struct tran {
 	size_t t_winmmaps;
 		/* number of window mmap calls made
 		 */
+	size_t t_winmaps;
+		/* number of win_map calls made
+		 */
 	win_t *t_lruheadp;
 		/* LRU head (re-use from this end)
 		 */
@@ -141,7 +144,16 @@ win_locks_on(void)
 size_t
 win_getnum_mmaps(void)
 {
-	return tranp->t_winmmaps;
+	return tranp ? tranp->t_winmmaps : 0;
+}
+
+/*
+ * tell me how many window lookups were made for the tree
+ */
+size_t
+win_getnum_maps(void)
+{
+	return tranp ? tranp->t_winmaps : 0;
 }
 
 void
@@ -187,6 +199,8 @@ win_map( off64_t off, void **pp )
 
 	CRITICAL_BEGIN();
 
+	tranp->t_winmaps++;
+
 	/* calculate offset within segment
 	 */
 	offwithinseg = ( size_t )( off % ( off64_t )tranp->t_segsz );
@@ -55,4 +55,9 @@ void win_locks_on(void);
  */
 size_t win_getnum_mmaps(void);
 
+/*
+ * Find out how many window lookups were made, hit or miss.
+ */
+size_t win_getnum_maps(void);
+
 #endif /* WIN_H */